@@ -0,0 +1,494 @@
+// Стенд для замеров отдельных частей VPNGate Manager без GUI.
+// Собирается только с -DVPNGATE_BUILD_BENCH=ON:
+//   vpngate-bench throughput <url> [netns] [потоков] [байт] [секунд]
+//   vpngate-bench udp <файл целей> [попыток] [параллельно ping]
+//   vpngate-bench train <адрес> [длина серии] [повторов]
+//   vpngate-bench classify [лог OpenVPN] [строк всего]
+//   vpngate-bench switch <a.ovpn> <b.ovpn> [переключений]
+#include "throughputprobe.h"
+#include "udpprober.h"
+#include "logclassifier.h"
+#include "vpnmanager.h"
+#include "gapmonitor.h"
+#include <QCoreApplication>
+#include <QTextStream>
+#include <QTimer>
+#include <QUrl>
+#include <QHash>
+#include <QFile>
+#include <QFileInfo>
+#include <QDebug>
+#include <QVector>
+#include <QProcess>
+#include <QElapsedTimer>
+#include <QRegularExpression>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+namespace {
+
+QTextStream& out() {
+    static QTextStream stream(stdout);
+    return stream;
+}
+
+// Замер скорости той же загрузкой curl, что и в TunnelTester.
+// С namespace curl идет через ip netns exec — так проверяется путь
+// через туннель или через veth с ограничением скорости (bench/throughput-netns.sh)
+int benchThroughput(const QStringList& args) {
+    if (args.isEmpty()) {
+        out() << "использование: throughput <url> [netns] [потоков] [байт] [секунд]\n";
+        return 2;
+    }
+
+    ThroughputEndpoint endpoint;
+    endpoint.url = QUrl(args.value(0));
+    if (args.size() > 2) {
+        endpoint.streams = args.value(2).toInt();
+    }
+    if (args.size() > 3) {
+        endpoint.byteBudget = args.value(3).toLongLong();
+    }
+    if (args.size() > 4) {
+        endpoint.timeBudgetMs = args.value(4).toInt() * 1000;
+    }
+
+    ThroughputProbe probe;
+    probe.setEndpoint(endpoint);
+    if (args.size() > 1 && args.value(1) != "-") {
+        probe.setNetns(args.value(1));
+    }
+
+    int result = 1;
+    QObject::connect(&probe, &ThroughputProbe::measured,
+                     [&result](bool success, double mbps, int ttfbMs, qint64 bytes) {
+        if (success) {
+            out() << QString("throughput mbps=%1 ttfb_ms=%2 bytes=%3\n")
+                     .arg(mbps, 0, 'f', 2).arg(ttfbMs).arg(bytes);
+            result = 0;
+        } else {
+            out() << QString("throughput failed bytes=%1\n").arg(bytes);
+        }
+        out().flush();
+        QCoreApplication::quit();
+    });
+
+    QTimer::singleShot(0, &probe, &ThroughputProbe::start);
+    QCoreApplication::exec();
+    return result;
+}
+
+double median(QList<double> values) {
+    if (values.isEmpty()) {
+        return -1.0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+// Цели в файле: по одной на строку, "адрес порт" или "адрес:порт"
+QList<UdpProbeTarget> readTargets(const QString& path) {
+    QList<UdpProbeTarget> targets;
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return targets;
+    }
+    while (!file.atEnd()) {
+        QString line = QString::fromUtf8(file.readLine()).trimmed();
+        if (line.isEmpty() || line.startsWith('#')) {
+            continue;
+        }
+        QStringList parts = line.split(QRegularExpression("[\\s:]+"), Qt::SkipEmptyParts);
+        UdpProbeTarget target;
+        target.address = QHostAddress(parts.value(0));
+        if (target.address.protocol() != QAbstractSocket::IPv4Protocol) {
+            continue;
+        }
+        if (parts.size() > 1) {
+            target.port = static_cast<quint16>(parts.value(1).toUInt());
+        }
+        target.identity = line;
+        targets.append(target);
+    }
+    return targets;
+}
+
+// Пакетная UDP-проверка (sendmmsg/recvmmsg) против прежнего пути —
+// отдельный процесс ping на каждый сервер, как в ServerTesterThread::testPing,
+// с тем же числом одновременных процессов, что и у очереди проверок в GUI
+int benchUdp(const QStringList& args) {
+    if (args.isEmpty()) {
+        out() << "использование: udp <файл целей> [попыток] [параллельно ping]\n";
+        return 2;
+    }
+
+    QList<UdpProbeTarget> targets = readTargets(args.value(0));
+    int attempts = args.size() > 1 ? qMax(1, args.value(1).toInt()) : 3;
+    int parallel = args.size() > 2 ? qMax(1, args.value(2).toInt()) : 4;
+    if (targets.isEmpty()) {
+        out() << "нет целей в " << args.value(0) << "\n";
+        return 2;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    UdpProber prober;
+    QString error;
+    if (!prober.open(&error)) {
+        out() << "udp open failed: " << error << "\n";
+        return 1;
+    }
+    QList<UdpProbeResult> batched = prober.probe(targets, attempts);
+    qint64 batchedMs = timer.elapsed();
+    const UdpProber::Stats& stats = prober.lastStats();
+
+    QHash<QString, double> batchedMedian;
+    for (const UdpProbeResult& result : batched) {
+        if (result.replied()) {
+            batchedMedian.insert(result.identity, median(result.rttMs));
+        }
+    }
+
+    // Прежний путь: QProcess ping, не больше parallel одновременно
+    QHash<QString, double> pingMedian;
+    int next = 0;
+    int running = 0;
+    QRegularExpression timeRe("time[=<](\\d+\\.?\\d*)");
+    std::function<void()> launchPings = [&]() {
+        while (running < parallel && next < targets.size()) {
+            const UdpProbeTarget target = targets[next++];
+            QProcess* process = new QProcess;
+            running++;
+            QObject::connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+                             [&, process, target](int, QProcess::ExitStatus) {
+                QString output = QString::fromLocal8Bit(process->readAllStandardOutput());
+                QList<double> samples;
+                QRegularExpressionMatchIterator it = timeRe.globalMatch(output);
+                while (it.hasNext()) {
+                    samples.append(it.next().captured(1).toDouble());
+                }
+                if (!samples.isEmpty()) {
+                    pingMedian.insert(target.identity, median(samples));
+                }
+                process->deleteLater();
+                running--;
+                if (running == 0 && next >= targets.size()) {
+                    QCoreApplication::quit();
+                } else {
+                    launchPings();
+                }
+            });
+            process->start("ping", QStringList() << "-c" << QString::number(attempts)
+                           << "-i" << "0.2" << "-W" << "2" << target.address.toString());
+        }
+    };
+
+    timer.restart();
+    QTimer::singleShot(0, launchPings);
+    QCoreApplication::exec();
+    qint64 pingMs = timer.elapsed();
+
+    double diffSum = 0.0;
+    int both = 0;
+    for (auto it = batchedMedian.constBegin(); it != batchedMedian.constEnd(); ++it) {
+        if (pingMedian.contains(it.key())) {
+            diffSum += std::fabs(it.value() - pingMedian.value(it.key()));
+            both++;
+        }
+    }
+
+    out() << QString("targets=%1 attempts=%2\n").arg(targets.size()).arg(attempts);
+    out() << QString("batched   wall_ms=%1 replied=%2 syscalls=%3 naive_syscalls=%4 kernel_ts=%5 user_err_us=%6\n")
+             .arg(batchedMs).arg(batchedMedian.size()).arg(stats.syscalls).arg(stats.naiveSyscalls)
+             .arg(stats.kernelTimestamps ? "yes" : "no").arg(stats.meanUserErrorUs, 0, 'f', 1);
+    out() << QString("qprocess  wall_ms=%1 replied=%2 processes=%3 parallel=%4\n")
+             .arg(pingMs).arg(pingMedian.size()).arg(targets.size()).arg(parallel);
+    out() << QString("median_rtt_diff_ms=%1 over %2 servers (ICMP и UDP-рукопожатие, разные пути обработки)\n")
+             .arg(both > 0 ? diffSum / both : 0.0, 0, 'f', 2).arg(both);
+    return 0;
+}
+
+// Оценка узкого места серией ICMP, как в UdpProber::probe. На стенде с
+// ограничением скорости (bench/train-shaped.sh) ее сравнивают с заданной полосой
+int benchTrain(const QStringList& args) {
+    QHostAddress address(args.value(0));
+    if (address.protocol() != QAbstractSocket::IPv4Protocol) {
+        out() << "использование: train <адрес> [длина серии] [повторов]\n";
+        return 2;
+    }
+    int length = args.size() > 1 ? args.value(1).toInt() : 8;
+    int repeats = args.size() > 2 ? qMax(1, args.value(2).toInt()) : 5;
+
+    UdpProber prober;
+    prober.setTrainLength(length);
+    QString error;
+    if (!prober.open(&error)) {
+        out() << "open failed: " << error << "\n";
+        return 1;
+    }
+
+    QList<double> estimates;
+    for (int i = 0; i < repeats; ++i) {
+        double mbps = prober.measureTrain(address, 1000);
+        if (mbps > 0.0) {
+            estimates.append(mbps);
+        }
+    }
+
+    if (estimates.isEmpty()) {
+        out() << "train failed (ICMP-сокет недоступен или нет ответов)\n";
+        return 1;
+    }
+    out() << QString("train mbps=%1 samples=%2/%3 length=%4\n")
+             .arg(median(estimates), 0, 'f', 2).arg(estimates.size()).arg(repeats).arg(length);
+    return 0;
+}
+
+// Прежняя классификация: строка переводится в QString и проверяется цепочкой
+// contains() в порядке таблицы LogClassifier
+LogEvent classifyWithContains(const QByteArray& raw) {
+    QString line = QString::fromUtf8(raw);
+    auto has = [&line](const char* pattern) {
+        return line.contains(QLatin1String(pattern), Qt::CaseInsensitive);
+    };
+
+    if (has("Initialization Sequence Completed")) return LogEvent::Connected;
+    if (has("AUTH_FAILED")) return LogEvent::AuthFailed;
+    if (has("WARNING: Failed running command (--up")) return LogEvent::UpScriptFailed;
+    if (has("failed to negotiate cipher")) return LogEvent::CipherError;
+    if (has("Options error") ||
+        has("Error reading username from Auth authfile") ||
+        has("Cannot open TUN/TAP dev") ||
+        has("Cannot allocate TUN/TAP dev dynamically") ||
+        has("Cannot ioctl TUNSETIFF")) return LogEvent::ConfigError;
+    if (has("TLS Error") ||
+        has("TLS key negotiation failed") ||
+        has("Fatal TLS error")) return LogEvent::TlsError;
+    if (has("connection failed") ||
+        has("Connection reset") ||
+        has("write UDP: Operation not permitted") ||
+        has("Bad encapsulated packet length")) return LogEvent::NetworkError;
+    if (has("Bad compression stub decompression header byte") ||
+        has("Decompress error")) return LogEvent::CompressionError;
+    if (has("AEAD Decrypt error") || has("cipher final failed")) return LogEvent::CipherError;
+    if (has("FRAG_IN error")) return LogEvent::FragmentError;
+    if (has("EMSGSIZE")) return LogEvent::PathMtuError;
+    if (has("ROUTE: route addition failed") ||
+        has("route gateway is not reachable")) return LogEvent::RouteError;
+    if (has("Exiting due to fatal error")) return LogEvent::FatalExit;
+    if (has("process exiting")) return LogEvent::Exiting;
+    if (has("SIGUSR1[") || has("SIGHUP[")) return LogEvent::SoftRestart;
+    if (has("deprecated") || has("WARNING:")) return LogEvent::Warning;
+    return LogEvent::None;
+}
+
+// Автомат Ахо–Корасик против прежней цепочки contains() на записанном логе.
+// Лог повторяется, пока не наберется заданное число строк; совпадение
+// результатов проверяется на каждой строке
+int benchClassify(const QStringList& args) {
+    QString path = args.value(0, QString(VPNGATE_BENCH_DATA) + "/openvpn-client.log");
+    int total = args.size() > 1 ? qMax(1, args.value(1).toInt()) : 200000;
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        out() << "не удалось открыть " << path << "\n";
+        return 2;
+    }
+    QList<QByteArray> log;
+    while (!file.atEnd()) {
+        QByteArray line = file.readLine().trimmed();
+        if (!line.isEmpty()) {
+            log.append(line);
+        }
+    }
+    if (log.isEmpty()) {
+        out() << "пустой лог " << path << "\n";
+        return 2;
+    }
+
+    QList<QByteArray> lines;
+    lines.reserve(total);
+    while (lines.size() < total) {
+        lines.append(log[lines.size() % log.size()]);
+    }
+
+    const LogClassifier& classifier = LogClassifier::instance();
+    QVector<LogEvent> fast(lines.size());
+    QVector<LogEvent> legacy(lines.size());
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < lines.size(); ++i) {
+        fast[i] = classifier.classify(lines[i]);
+    }
+    qint64 fastNs = timer.nsecsElapsed();
+
+    timer.restart();
+    for (int i = 0; i < lines.size(); ++i) {
+        legacy[i] = classifyWithContains(lines[i]);
+    }
+    qint64 legacyNs = timer.nsecsElapsed();
+
+    int mismatches = 0;
+    int matched = 0;
+    for (int i = 0; i < lines.size(); ++i) {
+        if (fast[i] != legacy[i]) {
+            if (mismatches++ < 5) {
+                out() << "mismatch: " << QString::fromUtf8(lines[i]) << "\n";
+            }
+        }
+        if (fast[i] != LogEvent::None) {
+            matched++;
+        }
+    }
+
+    out() << QString("classify log=%1 unique=%2 lines=%3 matched=%4\n")
+             .arg(path).arg(log.size()).arg(lines.size()).arg(matched);
+    out() << QString("aho-corasick total_ms=%1 ns_per_line=%2\n")
+             .arg(fastNs / 1e6, 0, 'f', 2).arg(static_cast<double>(fastNs) / lines.size(), 0, 'f', 1);
+    out() << QString("contains     total_ms=%1 ns_per_line=%2\n")
+             .arg(legacyNs / 1e6, 0, 'f', 2).arg(static_cast<double>(legacyNs) / lines.size(), 0, 'f', 1);
+    out() << QString("speedup=%1x mismatches=%2\n")
+             .arg(fastNs > 0 ? static_cast<double>(legacyNs) / fastNs : 0.0, 0, 'f', 1).arg(mismatches);
+    return mismatches == 0 ? 0 : 1;
+}
+
+// Сервер из .ovpn: адрес, порт и протокол — из первой строки remote/proto
+bool readServer(const QString& path, VpnServer* server) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QByteArray config = file.readAll();
+    server->name = QFileInfo(path).completeBaseName();
+    server->configBase64 = QString::fromLatin1(config.toBase64());
+    server->protocol = "udp";
+
+    for (const QByteArray& raw : config.split('\n')) {
+        QList<QByteArray> parts = raw.simplified().split(' ');
+        if (parts.value(0) == "remote" && server->ip.isEmpty()) {
+            server->ip = QString::fromLatin1(parts.value(1));
+            if (parts.size() > 2) {
+                server->port = parts.value(2).toInt();
+            }
+        } else if (parts.value(0) == "proto") {
+            server->protocol = QString::fromLatin1(parts.value(1)).startsWith("tcp") ? "tcp" : "udp";
+        }
+    }
+    return !server->ip.isEmpty();
+}
+
+// Сценарий make-before-break: подключение к A, затем переключения A -> B -> A...
+// Для каждого переключения GapMonitor VpnManager выдает потерянные DNS-запросы
+// и самую длинную паузу без ответов — то же, что пишется в лог GUI
+int benchSwitch(const QStringList& args) {
+    VpnServer first;
+    VpnServer second;
+    if (args.size() < 2 || !readServer(args.value(0), &first) || !readServer(args.value(1), &second)) {
+        out() << "использование: switch <a.ovpn> <b.ovpn> [переключений]\n";
+        return 2;
+    }
+    int switches = args.size() > 2 ? qMax(1, args.value(2).toInt()) : 4;
+
+    VpnManager manager;
+    manager.setConnectionTimeout(30);
+
+    int done = 0;
+    int failures = 0;
+    QList<GapMonitor::Result> gaps;
+
+    QObject::connect(&manager, &VpnManager::connectionLog, [](const QString& message) {
+        qDebug().noquote() << message;
+    });
+
+    auto switchNext = [&]() {
+        const VpnServer& target = (done % 2 == 0) ? second : first;
+        out() << QString("switch %1 -> %2\n").arg(done % 2 == 0 ? first.name : second.name, target.name);
+        out().flush();
+        manager.switchToServer(target);
+    };
+
+    QObject::connect(&manager, &VpnManager::connected, [&](const QString&) {
+        if (done == 0 && gaps.isEmpty() && !manager.isSwitching()) {
+            // Дать туннелю и маршрутам установиться перед первым замером
+            QTimer::singleShot(3000, &manager, switchNext);
+        }
+    });
+
+    QObject::connect(&manager, &VpnManager::switchCompleted,
+                     [&](const QString& from, const QString& to, const GapMonitor::Result& gap) {
+        gaps.append(gap);
+        out() << QString("gap %1 -> %2: sent=%3 lost=%4 max_gap_ms=%5 duration_ms=%6\n")
+                 .arg(from, to).arg(gap.sent).arg(gap.lost()).arg(gap.maxGapMs).arg(gap.durationMs);
+        out().flush();
+        if (++done < switches) {
+            QTimer::singleShot(3000, &manager, switchNext);
+        } else {
+            manager.disconnect();
+        }
+    });
+
+    QObject::connect(&manager, &VpnManager::connectionStatus, [&](const QString& type, const QString& message) {
+        if (type == "error") {
+            failures++;
+            out() << "error: " << message << "\n";
+            out().flush();
+        }
+    });
+
+    QObject::connect(&manager, &VpnManager::disconnected, [&]() {
+        QCoreApplication::quit();
+    });
+
+    // Общий предел на весь сценарий, чтобы скрипт не зависал на недоступном сервере
+    QTimer::singleShot((switches + 1) * 60000, &manager, [&]() {
+        out() << "timeout\n";
+        manager.disconnect();
+        QTimer::singleShot(5000, []() { QCoreApplication::quit(); });
+    });
+
+    manager.connectToServer(first);
+    QCoreApplication::exec();
+
+    if (gaps.isEmpty()) {
+        out() << QString("switch failed: ни одного переключения, ошибок %1\n").arg(failures);
+        return 1;
+    }
+
+    int lost = 0;
+    int sent = 0;
+    qint64 worstGap = 0;
+    QList<double> maxGaps;
+    for (const GapMonitor::Result& gap : gaps) {
+        lost += gap.lost();
+        sent += gap.sent;
+        worstGap = qMax(worstGap, gap.maxGapMs);
+        maxGaps.append(gap.maxGapMs);
+    }
+    out() << QString("summary switches=%1 lost=%2/%3 max_gap_ms median=%4 worst=%5\n")
+             .arg(gaps.size()).arg(lost).arg(sent).arg(median(maxGaps), 0, 'f', 0).arg(worstGap);
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+
+    const QHash<QString, std::function<int(const QStringList&)>> commands = {
+        {"throughput", benchThroughput},
+        {"udp", benchUdp},
+        {"train", benchTrain},
+        {"classify", benchClassify},
+        {"switch", benchSwitch},
+    };
+
+    QStringList args = app.arguments().mid(1);
+    QString command = args.isEmpty() ? QString() : args.takeFirst();
+    if (!commands.contains(command)) {
+        out() << "использование: vpngate-bench <" << QStringList(commands.keys()).join('|') << "> ...\n";
+        return 2;
+    }
+    return commands.value(command)(args);
+}
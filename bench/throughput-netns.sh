@@ -0,0 +1,51 @@
+#!/bin/sh
+# Проверка замера скорости на локальном стенде: HTTP-сервер на хосте,
+# клиент в отдельном namespace за veth с ограничением скорости (tc tbf).
+# Замер ThroughputProbe должен попасть в пределы заданной полосы.
+#   sudo bench/throughput-netns.sh <путь к vpngate-bench> [скорости в mbit...]
+set -eu
+
+bench="$1"; shift
+rates="${*:-5 20 50}"
+ns=vpngate-bench
+port=18080
+blob_dir=$(mktemp -d)
+
+cleanup() {
+    [ -n "${server_pid:-}" ] && kill "$server_pid" 2>/dev/null || true
+    ip netns del "$ns" 2>/dev/null || true
+    ip link del vgb-host 2>/dev/null || true
+    rm -rf "$blob_dir"
+}
+trap cleanup EXIT
+
+ip netns add "$ns"
+ip link add vgb-host type veth peer name vgb-ns
+ip link set vgb-ns netns "$ns"
+ip addr add 10.203.0.1/24 dev vgb-host
+ip link set vgb-host up
+ip -n "$ns" addr add 10.203.0.2/24 dev vgb-ns
+ip -n "$ns" link set lo up
+ip -n "$ns" link set vgb-ns up
+
+# Один поток качает файл целиком: python http.server не поддерживает Range
+streams=4
+bytes=$((16 * 1024 * 1024))
+head -c $((bytes / streams)) /dev/urandom > "$blob_dir/blob"
+(cd "$blob_dir" && exec python3 -m http.server "$port" --bind 10.203.0.1 >/dev/null 2>&1) &
+server_pid=$!
+sleep 1
+
+printf '%-10s %-12s %s\n' "limit" "measured" "error"
+for rate in $rates; do
+    # Ограничиваем направление к клиенту: загрузка идет с хоста в namespace
+    tc qdisc replace dev vgb-host root tbf rate "${rate}mbit" burst "$((rate * 2 + 16))kb" latency 50ms
+    line=$("$bench" throughput "http://10.203.0.1:$port/blob" "$ns" "$streams" "$bytes" 30)
+    mbps=$(echo "$line" | sed -n 's/.*mbps=\([0-9.]*\).*/\1/p')
+    if [ -z "$mbps" ]; then
+        printf '%-10s %-12s %s\n' "${rate}mbit" "-" "$line"
+        continue
+    fi
+    error=$(awk -v m="$mbps" -v r="$rate" 'BEGIN { printf "%+.1f%%", (m - r) * 100 / r }')
+    printf '%-10s %-12s %s\n' "${rate}mbit" "$mbps" "$error"
+done
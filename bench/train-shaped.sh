@@ -0,0 +1,40 @@
+#!/bin/sh
+# Проверка оценки пропускной способности по серии ICMP на канале с известной
+# полосой: клиент в namespace, ответы хоста идут к нему через veth с tc tbf.
+#   sudo bench/train-shaped.sh <путь к vpngate-bench> [скорости в mbit...]
+set -eu
+
+bench="$1"; shift
+rates="${*:-2 10 50 100}"
+ns=vpngate-train
+
+cleanup() {
+    ip netns del "$ns" 2>/dev/null || true
+    ip link del vgt-host 2>/dev/null || true
+}
+trap cleanup EXIT
+
+ip netns add "$ns"
+ip link add vgt-host type veth peer name vgt-ns
+ip link set vgt-ns netns "$ns"
+ip addr add 10.204.0.1/24 dev vgt-host
+ip link set vgt-host up
+ip -n "$ns" addr add 10.204.0.2/24 dev vgt-ns
+ip -n "$ns" link set lo up
+ip -n "$ns" link set vgt-ns up
+# В новом namespace ping-сокеты выключены (ping_group_range "1 0")
+ip netns exec "$ns" sysctl -q -w net.ipv4.ping_group_range="0 2147483647"
+
+printf '%-10s %-12s %s\n' "limit" "estimate" "error"
+for rate in $rates; do
+    # Burst в один пакет: иначе начало серии проходит без ограничения
+    tc qdisc replace dev vgt-host root tbf rate "${rate}mbit" burst 1600 latency 200ms
+    line=$(ip netns exec "$ns" "$bench" train 10.204.0.1 8 9 || true)
+    mbps=$(echo "$line" | sed -n 's/.*mbps=\([0-9.]*\).*/\1/p')
+    if [ -z "$mbps" ]; then
+        printf '%-10s %-12s %s\n' "${rate}mbit" "-" "$line"
+        continue
+    fi
+    error=$(awk -v m="$mbps" -v r="$rate" 'BEGIN { printf "%+.1f%%", (m - r) * 100 / r }')
+    printf '%-10s %-12s %s\n' "${rate}mbit" "$mbps" "$error"
+done
@@ -0,0 +1,143 @@
+#include "configcache.h"
+#include "vpnmanager.h"
+#include <QFutureWatcher>
+#include <QtConcurrent>
+#include <QSet>
+#include <QDebug>
+
+namespace {
+struct RenderedConfig {
+    QString identity;
+    uint sourceHash;
+    QByteArray config;
+
+    RenderedConfig() : sourceHash(0) {
+    }
+};
+}
+
+ConfigCache::ConfigCache(QObject *parent)
+: QObject(parent), generation(0), connectTimeout(45), busy(false) {
+}
+
+void ConfigCache::setConnectTimeout(int seconds) {
+    if (seconds == connectTimeout) {
+        return;
+    }
+    connectTimeout = seconds;
+    invalidate();
+}
+
+void ConfigCache::setOverrides(const QHash<QString, ConfigOverrides>& serverOverrides) {
+    if (serverOverrides == overrides) {
+        return;   // Готовые конфиги остаются в силе
+    }
+    overrides = serverOverrides;
+    invalidate();
+}
+
+void ConfigCache::invalidate() {
+    // Результаты подготовки, начатой до сброса, будут отброшены
+    ++generation;
+    entries.clear();
+    queued.clear();
+}
+
+QByteArray ConfigCache::lookup(const VpnServer& server) const {
+    auto it = entries.constFind(server.identity());
+    if (it == entries.constEnd() || it->sourceHash != qHash(server.configBase64)) {
+        return QByteArray();
+    }
+    return it->config;
+}
+
+void ConfigCache::prepare(const QList<VpnServer>& candidates) {
+    QList<VpnServer> servers;
+    QSet<QString> wanted;
+    for (const VpnServer& server : candidates) {
+        if (servers.size() >= MaxEntries) {
+            break;
+        }
+        if (server.configBase64.isEmpty() || wanted.contains(server.identity())) {
+            continue;
+        }
+        wanted.insert(server.identity());
+        servers.append(server);
+    }
+
+    // Кэш держит только текущих кандидатов
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (!wanted.contains(it.key())) {
+            it = entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    QList<VpnServer> missing;
+    for (const VpnServer& server : servers) {
+        if (lookup(server).isEmpty()) {
+            missing.append(server);
+        }
+    }
+    if (missing.isEmpty()) {
+        return;
+    }
+
+    if (busy) {
+        queued = missing;
+        return;
+    }
+    startRender(missing);
+}
+
+void ConfigCache::startRender(const QList<VpnServer>& servers) {
+    busy = true;
+
+    quint64 startedGeneration = generation;
+    int timeout = connectTimeout;
+    QHash<QString, ConfigOverrides> serverOverrides = overrides;
+    QFutureWatcher<QList<RenderedConfig>>* watcher = new QFutureWatcher<QList<RenderedConfig>>(this);
+
+    connect(watcher, &QFutureWatcher<QList<RenderedConfig>>::finished, this,
+            [this, watcher, startedGeneration]() {
+        QList<RenderedConfig> rendered = watcher->result();
+        watcher->deleteLater();
+        busy = false;
+
+        if (startedGeneration == generation) {
+            for (const RenderedConfig& item : rendered) {
+                Entry entry;
+                entry.sourceHash = item.sourceHash;
+                entry.config = item.config;
+                entries.insert(item.identity, entry);
+            }
+            emit prepared(rendered.size());
+        }
+
+        if (!queued.isEmpty()) {
+            QList<VpnServer> next = queued;
+            queued.clear();
+            prepare(next);
+        }
+    });
+
+    watcher->setFuture(QtConcurrent::run([servers, timeout, serverOverrides]() {
+        QList<RenderedConfig> rendered;
+        for (const VpnServer& server : servers) {
+            RenderedConfig item;
+            item.identity = server.identity();
+            item.sourceHash = qHash(server.configBase64);
+            item.config = render(server, timeout, QList<VpnServer>(), serverOverrides.value(item.identity));
+            rendered.append(item);
+        }
+        return rendered;
+    }));
+}
+
+QByteArray ConfigCache::render(const VpnServer& server, int connectTimeout, const QList<VpnServer>& fallbacks,
+                               const ConfigOverrides& overrides) {
+    QByteArray configData = QByteArray::fromBase64(server.configBase64.toLatin1());
+    QString configContent = QString::fromUtf8(configData);
+    return VpnManager::enhanceConfigForConnection(configContent, server, connectTimeout, fallbacks, overrides).toUtf8();
+}
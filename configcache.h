@@ -0,0 +1,56 @@
+#ifndef CONFIGCACHE_H
+#define CONFIGCACHE_H
+
+#include <QObject>
+#include <QHash>
+#include <QByteArray>
+#include <QList>
+#include "vpntypes.h"
+#include "serverprofiles.h"
+
+// Готовые конфиги для первых кандидатов списка.
+// Декодирование base64 и доработка конфига выполняются заранее в фоне,
+// при подключении остается только отдать байты openvpn.
+// Сбрасывается при смене каталога серверов, таймаута подключения
+// и поправок конфигов (выученных и буферов по BDP).
+class ConfigCache : public QObject {
+    Q_OBJECT
+
+public:
+    static constexpr int MaxEntries = 8;
+
+    explicit ConfigCache(QObject *parent = nullptr);
+
+    void setConnectTimeout(int seconds);
+    void setOverrides(const QHash<QString, ConfigOverrides>& serverOverrides);
+    void prepare(const QList<VpnServer>& candidates);
+    void invalidate();
+
+    // Пустой массив, если конфига нет или сервер изменился с момента подготовки
+    QByteArray lookup(const VpnServer& server) const;
+
+    // Итоговый конфиг: доработанные опции и remote, закрепленный за VpnServer::ip
+    static QByteArray render(const VpnServer& server, int connectTimeout,
+                             const QList<VpnServer>& fallbacks = QList<VpnServer>(),
+                             const ConfigOverrides& overrides = ConfigOverrides());
+
+signals:
+    void prepared(int count);
+
+private:
+    struct Entry {
+        uint sourceHash;   // qHash(configBase64) — конфиг сервера в каталоге мог смениться
+        QByteArray config;
+    };
+
+    QHash<QString, Entry> entries;
+    QHash<QString, ConfigOverrides> overrides;
+    QList<VpnServer> queued;   // Запрос, пришедший во время подготовки
+    quint64 generation;
+    int connectTimeout;
+    bool busy;
+
+    void startRender(const QList<VpnServer>& servers);
+};
+
+#endif // CONFIGCACHE_H
@@ -0,0 +1,364 @@
+#include "connecttiming.h"
+#include <QSettings>
+#include <QFile>
+#include <QTextStream>
+#include <QDateTime>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+// Верхние границы корзин, мс. Последняя корзина — все, что дольше
+const qint64 kBucketUpperMs[LatencyHistogram::BucketCount - 1] = {
+    50, 100, 250, 500, 1000, 2000, 3000, 5000, 8000, 15000, 30000
+};
+}
+
+QString connectPhaseName(ConnectPhase phase) {
+    switch (phase) {
+    case ConnectPhase::Spawn:     return "Запуск";
+    case ConnectPhase::Resolve:   return "RESOLVE";
+    case ConnectPhase::Wait:      return "WAIT";
+    case ConnectPhase::Auth:      return "AUTH";
+    case ConnectPhase::GetConfig: return "GET_CONFIG";
+    case ConnectPhase::AssignIp:  return "ASSIGN_IP";
+    case ConnectPhase::AddRoutes: return "ADD_ROUTES";
+    case ConnectPhase::Connected: return "CONNECTED";
+    case ConnectPhase::Total:     return "Всего";
+    }
+    return QString();
+}
+
+bool connectPhaseForState(const QString& stateName, ConnectPhase* phase) {
+    static const QHash<QString, ConnectPhase> kStates = {
+        { "RESOLVE",    ConnectPhase::Resolve },
+        { "WAIT",       ConnectPhase::Wait },
+        { "AUTH",       ConnectPhase::Auth },
+        { "GET_CONFIG", ConnectPhase::GetConfig },
+        { "ASSIGN_IP",  ConnectPhase::AssignIp },
+        { "ADD_ROUTES", ConnectPhase::AddRoutes },
+        { "CONNECTED",  ConnectPhase::Connected }
+    };
+
+    auto it = kStates.constFind(stateName);
+    if (it == kStates.constEnd()) {
+        return false;
+    }
+    *phase = it.value();
+    return true;
+}
+
+ConnectTrace::ConnectTrace()
+: startedMs(0), lastMarkMs(0), active(false), success(false) {
+    std::fill(phaseMs, phaseMs + ConnectPhaseCount, -1);
+}
+
+void ConnectTrace::start(const QString& id, const QString& name, qint64 nowMs) {
+    *this = ConnectTrace();
+    identity = id;
+    serverName = name;
+    startedMs = nowMs;
+    lastMarkMs = nowMs;
+    active = true;
+}
+
+void ConnectTrace::mark(ConnectPhase phase, qint64 nowMs) {
+    int index = static_cast<int>(phase);
+    if (!active || phaseMs[index] >= 0) {
+        return;   // Повтор состояния (например, WAIT после переподключения) не сбивает первую отметку
+    }
+    // Пропущенные фазы (RESOLVE при закрепленном IP) не отмечаются, их время уходит в следующую
+    phaseMs[index] = qMax<qint64>(0, nowMs - lastMarkMs);
+    lastMarkMs = nowMs;
+}
+
+void ConnectTrace::finish(bool ok, qint64 nowMs) {
+    if (!active) {
+        return;
+    }
+    active = false;
+    success = ok;
+    if (ok) {
+        phaseMs[static_cast<int>(ConnectPhase::Total)] = nowMs - startedMs;
+    }
+}
+
+ConnectPhase ConnectTrace::stalledPhase() const {
+    int last = -1;
+    for (int i = 0; i < static_cast<int>(ConnectPhase::Total); ++i) {
+        if (phaseMs[i] >= 0) {
+            last = i;
+        }
+    }
+    return static_cast<ConnectPhase>(qMin(last + 1, static_cast<int>(ConnectPhase::Connected)));
+}
+
+QString ConnectTrace::summary() const {
+    QStringList parts;
+    for (int i = 0; i < ConnectPhaseCount; ++i) {
+        if (phaseMs[i] >= 0) {
+            parts << QString("%1 %2 мс").arg(connectPhaseName(static_cast<ConnectPhase>(i))).arg(phaseMs[i]);
+        }
+    }
+    return parts.join(", ");
+}
+
+LatencyHistogram::LatencyHistogram()
+: total(0), sumMs(0.0) {
+    std::fill(buckets, buckets + BucketCount, 0u);
+}
+
+void LatencyHistogram::add(qint64 ms) {
+    int index = std::upper_bound(kBucketUpperMs, kBucketUpperMs + BucketCount - 1, ms - 1) - kBucketUpperMs;
+    buckets[index]++;
+    total++;
+    sumMs += ms;
+}
+
+qint64 LatencyHistogram::percentileMs(double q) const {
+    if (total == 0) {
+        return -1;
+    }
+    quint32 rank = qMax<quint32>(1, static_cast<quint32>(std::ceil(q * total)));
+    quint32 seen = 0;
+    for (int i = 0; i < BucketCount - 1; ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return kBucketUpperMs[i];
+        }
+    }
+    // Последняя корзина не ограничена сверху — возвращаем ее нижнюю границу
+    return kBucketUpperMs[BucketCount - 2];
+}
+
+qint64 LatencyHistogram::bucketUpperMs(int index) {
+    return index < BucketCount - 1 ? kBucketUpperMs[index] : -1;
+}
+
+QString LatencyHistogram::bucketLabel(int index) {
+    if (index == BucketCount - 1) {
+        return QString(">%1 мс").arg(kBucketUpperMs[BucketCount - 2]);
+    }
+    return QString("≤%1 мс").arg(kBucketUpperMs[index]);
+}
+
+QString LatencyHistogram::serialize() const {
+    QStringList parts;
+    parts << QString::number(sumMs, 'f', 0);
+    for (int i = 0; i < BucketCount; ++i) {
+        parts << QString::number(buckets[i]);
+    }
+    return parts.join(',');
+}
+
+LatencyHistogram LatencyHistogram::deserialize(const QString& text) {
+    LatencyHistogram histogram;
+    QStringList parts = text.split(',');
+    if (parts.size() != BucketCount + 1) {
+        return histogram;
+    }
+    histogram.sumMs = parts[0].toDouble();
+    for (int i = 0; i < BucketCount; ++i) {
+        histogram.buckets[i] = parts[i + 1].toUInt();
+        histogram.total += histogram.buckets[i];
+    }
+    return histogram;
+}
+
+ConnectTimingStats::ConnectTimingStats(QSettings* storage)
+: storage(storage), dirty(false) {
+    load();
+}
+
+void ConnectTimingStats::addTrace(ServerTimings& timings, const ConnectTrace& trace) {
+    for (int i = 0; i < ConnectPhaseCount; ++i) {
+        if (trace.phaseMs[i] >= 0) {
+            timings.phases[i].add(trace.phaseMs[i]);
+        }
+    }
+    if (trace.success) {
+        timings.successes++;
+    } else {
+        timings.failures++;
+        timings.stalls[static_cast<int>(trace.stalledPhase())]++;
+    }
+    timings.updatedMs = QDateTime::currentMSecsSinceEpoch();
+}
+
+void ConnectTimingStats::record(const ConnectTrace& trace) {
+    addTrace(globalTimings, trace);
+
+    ServerTimings& timings = servers[trace.identity];
+    timings.name = trace.serverName;
+    addTrace(timings, trace);
+
+    if (servers.size() > MaxServers) {
+        dropOldest();
+    }
+    dirty = true;
+}
+
+bool ConnectTimingStats::lookup(const QString& identity, ServerTimings* timings) const {
+    auto it = servers.constFind(identity);
+    if (it == servers.constEnd()) {
+        return false;
+    }
+    if (timings) {
+        *timings = it.value();
+    }
+    return true;
+}
+
+int ConnectTimingStats::deadlineSeconds(const QString& identity, int ceilingSec, QString* basis) const {
+    const int total = static_cast<int>(ConnectPhase::Total);
+    const LatencyHistogram* histogram = nullptr;
+    QString source;
+
+    auto it = servers.constFind(identity);
+    if (it != servers.constEnd() && it->phases[total].count() >= MinServerSamples) {
+        histogram = &it->phases[total];
+        source = "история сервера";
+    } else if (globalTimings.phases[total].count() >= MinGlobalSamples) {
+        histogram = &globalTimings.phases[total];
+        source = "общая история";
+    }
+
+    if (!histogram) {
+        if (basis) {
+            *basis = "нет истории";
+        }
+        return ceilingSec;
+    }
+
+    qint64 p99 = histogram->percentileMs(0.99);
+    int seconds = static_cast<int>(std::ceil(p99 * DeadlineMargin / 1000.0));
+    if (basis) {
+        *basis = QString("%1, p99 ≤%2 мс по %3 подключениям").arg(source).arg(p99).arg(histogram->count());
+    }
+    return qBound(qMin(MinDeadlineSec, ceilingSec), seconds, ceilingSec);
+}
+
+void ConnectTimingStats::dropOldest() {
+    auto oldest = servers.begin();
+    for (auto it = servers.begin(); it != servers.end(); ++it) {
+        if (it->updatedMs < oldest->updatedMs) {
+            oldest = it;
+        }
+    }
+    servers.erase(oldest);
+}
+
+bool ConnectTimingStats::exportCsv(const QString& path, QString* error) const {
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        if (error) {
+            *error = file.errorString();
+        }
+        return false;
+    }
+
+    QTextStream out(&file);
+    QStringList header = { "server", "identity", "phase", "count", "mean_ms", "p50_ms", "p95_ms", "stalls" };
+    for (int b = 0; b < LatencyHistogram::BucketCount; ++b) {
+        qint64 upper = LatencyHistogram::bucketUpperMs(b);
+        header << (upper >= 0 ? QString("le_%1").arg(upper) : QString("inf"));
+    }
+    out << header.join(';') << "\n";
+
+    auto writeTimings = [&out](const QString& name, const QString& identity, const ServerTimings& timings) {
+        for (int i = 0; i < ConnectPhaseCount; ++i) {
+            const LatencyHistogram& histogram = timings.phases[i];
+            QStringList row = {
+                name,
+                identity,
+                connectPhaseName(static_cast<ConnectPhase>(i)),
+                QString::number(histogram.count()),
+                QString::number(histogram.meanMs(), 'f', 0),
+                QString::number(histogram.percentileMs(0.50)),
+                QString::number(histogram.percentileMs(0.95)),
+                QString::number(timings.stalls[i])
+            };
+            for (int b = 0; b < LatencyHistogram::BucketCount; ++b) {
+                row << QString::number(histogram.bucket(b));
+            }
+            out << row.join(';') << "\n";
+        }
+    };
+
+    writeTimings("*", "*", globalTimings);
+    for (auto it = servers.constBegin(); it != servers.constEnd(); ++it) {
+        writeTimings(it->name, it.key(), it.value());
+    }
+    return true;
+}
+
+void ConnectTimingStats::load() {
+    globalTimings = ServerTimings();
+    servers.clear();
+    if (!storage) {
+        return;
+    }
+
+    auto readTimings = [this]() {
+        ServerTimings timings;
+        timings.name = storage->value("name").toString();
+        timings.updatedMs = storage->value("updated").toLongLong();
+        timings.successes = storage->value("successes").toInt();
+        timings.failures = storage->value("failures").toInt();
+        QStringList phases = storage->value("phases").toStringList();
+        QStringList stalls = storage->value("stalls").toStringList();
+        for (int i = 0; i < ConnectPhaseCount; ++i) {
+            timings.phases[i] = LatencyHistogram::deserialize(phases.value(i));
+            timings.stalls[i] = stalls.value(i).toInt();
+        }
+        return timings;
+    };
+
+    storage->beginGroup("global");
+    globalTimings = readTimings();
+    storage->endGroup();
+
+    int size = storage->beginReadArray("servers");
+    for (int i = 0; i < size; ++i) {
+        storage->setArrayIndex(i);
+        servers.insert(storage->value("identity").toString(), readTimings());
+    }
+    storage->endArray();
+    dirty = false;
+}
+
+void ConnectTimingStats::save() {
+    if (!storage || !dirty) {
+        return;
+    }
+
+    auto writeTimings = [this](const ServerTimings& timings) {
+        QStringList phases;
+        QStringList stalls;
+        for (int i = 0; i < ConnectPhaseCount; ++i) {
+            phases << timings.phases[i].serialize();
+            stalls << QString::number(timings.stalls[i]);
+        }
+        storage->setValue("name", timings.name);
+        storage->setValue("updated", timings.updatedMs);
+        storage->setValue("successes", timings.successes);
+        storage->setValue("failures", timings.failures);
+        storage->setValue("phases", phases);
+        storage->setValue("stalls", stalls);
+    };
+
+    storage->beginGroup("global");
+    writeTimings(globalTimings);
+    storage->endGroup();
+
+    storage->remove("servers");
+    storage->beginWriteArray("servers");
+    int index = 0;
+    for (auto it = servers.constBegin(); it != servers.constEnd(); ++it) {
+        storage->setArrayIndex(index++);
+        storage->setValue("identity", it.key());
+        writeTimings(it.value());
+    }
+    storage->endArray();
+    storage->sync();
+    dirty = false;
+}
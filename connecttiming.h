@@ -0,0 +1,129 @@
+#ifndef CONNECTTIMING_H
+#define CONNECTTIMING_H
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+
+class QSettings;
+
+// Фазы подключения в порядке прохождения. Каждая фаза — время от предыдущей
+// отметки до перехода OpenVPN в соответствующее состояние (>STATE)
+enum class ConnectPhase {
+    Spawn,       // Нажатие -> процесс запущен
+    Resolve,     // RESOLVE
+    Wait,        // WAIT — ожидание ответа сервера (TLS)
+    Auth,        // AUTH
+    GetConfig,   // GET_CONFIG — ожидание PUSH_REPLY
+    AssignIp,    // ASSIGN_IP — настройка tun
+    AddRoutes,   // ADD_ROUTES
+    Connected,   // CONNECTED
+    Total        // Нажатие -> CONNECTED
+};
+
+constexpr int ConnectPhaseCount = static_cast<int>(ConnectPhase::Total) + 1;
+
+QString connectPhaseName(ConnectPhase phase);
+// Фаза, которую завершает состояние OpenVPN; false для прочих состояний
+bool connectPhaseForState(const QString& stateName, ConnectPhase* phase);
+
+// Хронометраж одной попытки подключения
+struct ConnectTrace {
+    QString identity;
+    QString serverName;
+    qint64 startedMs;
+    qint64 lastMarkMs;
+    qint64 phaseMs[ConnectPhaseCount];   // -1 — фаза не пройдена
+    bool active;
+    bool success;
+
+    ConnectTrace();
+
+    void start(const QString& identity, const QString& serverName, qint64 nowMs);
+    void mark(ConnectPhase phase, qint64 nowMs);
+    void finish(bool success, qint64 nowMs);
+
+    ConnectPhase stalledPhase() const;   // Первая непройденная фаза — где остановилась неудачная попытка
+    QString summary() const;
+};
+
+// Гистограмма с корзинами растущей ширины: счетчики вместо всех замеров
+class LatencyHistogram {
+public:
+    static constexpr int BucketCount = 12;
+
+    LatencyHistogram();
+
+    void add(qint64 ms);
+    quint32 count() const { return total; }
+    quint32 bucket(int index) const { return buckets[index]; }
+    double meanMs() const { return total > 0 ? sumMs / total : -1.0; }
+    // Верхняя граница корзины, в которую попадает квантиль q; -1 без данных
+    qint64 percentileMs(double q) const;
+
+    static qint64 bucketUpperMs(int index);   // -1 для последней (без ограничения)
+    static QString bucketLabel(int index);
+
+    QString serialize() const;
+    static LatencyHistogram deserialize(const QString& text);
+
+private:
+    quint32 buckets[BucketCount];
+    quint32 total;
+    double sumMs;
+};
+
+// Гистограммы по фазам: общие и по каждому серверу.
+// Хранится в QSettings, по серверам — только недавние.
+class ConnectTimingStats {
+public:
+    static constexpr int MaxServers = 200;
+    // Срок подключения: p99 полного времени подключения с запасом, не меньше минимума
+    static constexpr int MinDeadlineSec = 10;
+    static constexpr double DeadlineMargin = 1.5;
+    static constexpr int MinServerSamples = 3;    // Своя история сервера считается с 3 успехов
+    static constexpr int MinGlobalSamples = 10;
+
+    struct ServerTimings {
+        QString name;
+        qint64 updatedMs;
+        int successes;
+        int failures;
+        LatencyHistogram phases[ConnectPhaseCount];
+        int stalls[ConnectPhaseCount];   // Неудачные попытки, застрявшие в фазе
+
+        ServerTimings() : updatedMs(0), successes(0), failures(0) {
+            for (int i = 0; i < ConnectPhaseCount; ++i) {
+                stalls[i] = 0;
+            }
+        }
+    };
+
+    explicit ConnectTimingStats(QSettings* storage);
+
+    void record(const ConnectTrace& trace);
+
+    const ServerTimings& global() const { return globalTimings; }
+    bool lookup(const QString& identity, ServerTimings* timings) const;
+
+    // Сколько ждать подключения к серверу: по его истории, если она есть,
+    // иначе по общей. Без данных — ceilingSec. Результат в [MinDeadlineSec, ceilingSec].
+    // basis — откуда взят срок, для лога
+    int deadlineSeconds(const QString& identity, int ceilingSec, QString* basis = nullptr) const;
+
+    bool exportCsv(const QString& path, QString* error = nullptr) const;
+
+    void load();
+    void save();
+
+private:
+    QSettings* storage;
+    ServerTimings globalTimings;
+    QHash<QString, ServerTimings> servers;
+    bool dirty;
+
+    static void addTrace(ServerTimings& timings, const ConnectTrace& trace);
+    void dropOldest();
+};
+
+#endif // CONNECTTIMING_H
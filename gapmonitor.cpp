@@ -0,0 +1,101 @@
+#include "gapmonitor.h"
+#include <QUdpSocket>
+#include <QTimer>
+#include <QNetworkDatagram>
+
+namespace {
+// Запрос A для "." — минимальный пакет, на который отвечает любой резолвер
+QByteArray buildQuery(quint16 id) {
+    QByteArray packet;
+    packet.append(static_cast<char>(id >> 8));
+    packet.append(static_cast<char>(id & 0xff));
+    packet.append("\x01\x00", 2);              // RD
+    packet.append("\x00\x01\x00\x00\x00\x00\x00\x00", 8);
+    packet.append("\x00", 1);                  // Корневое имя
+    packet.append("\x00\x01\x00\x01", 4);      // A, IN
+    return packet;
+}
+}
+
+GapMonitor::GapMonitor(QObject *parent)
+: QObject(parent)
+, socket(new QUdpSocket(this))
+, sendTimer(new QTimer(this))
+, target(QHostAddress("1.1.1.1"))
+, targetPort(53)
+, nextId(0)
+, lastReplyMs(-1)
+, active(false) {
+    sendTimer->setInterval(20);
+    sendTimer->setTimerType(Qt::PreciseTimer);
+    connect(sendTimer, &QTimer::timeout, this, &GapMonitor::sendProbe);
+    connect(socket, &QUdpSocket::readyRead, this, &GapMonitor::readReplies);
+}
+
+void GapMonitor::setInterval(int ms) {
+    sendTimer->setInterval(qBound(5, ms, 1000));
+}
+
+void GapMonitor::start() {
+    if (active) {
+        return;
+    }
+    if (socket->state() != QAbstractSocket::BoundState) {
+        socket->bind(QHostAddress::AnyIPv4, 0);
+    }
+
+    result = Result();
+    pending.clear();
+    clock.start();
+    lastReplyMs = -1;
+    active = true;
+    sendTimer->start();
+    sendProbe();
+}
+
+void GapMonitor::stop(int graceMs) {
+    if (!active) {
+        return;
+    }
+    sendTimer->stop();
+
+    QTimer::singleShot(graceMs, this, [this]() {
+        if (!active) {
+            return;
+        }
+        active = false;
+        result.durationMs = clock.elapsed();
+        pending.clear();
+        emit finished(result);
+    });
+}
+
+void GapMonitor::sendProbe() {
+    quint16 id = nextId++;
+    pending.insert(id, clock.elapsed());
+    socket->writeDatagram(buildQuery(id), target, targetPort);
+    result.sent++;
+}
+
+void GapMonitor::readReplies() {
+    while (socket->hasPendingDatagrams()) {
+        QNetworkDatagram datagram = socket->receiveDatagram();
+        QByteArray data = datagram.data();
+        if (!active || data.size() < 2) {
+            continue;
+        }
+
+        quint16 id = (static_cast<quint8>(data[0]) << 8) | static_cast<quint8>(data[1]);
+        if (pending.remove(id) == 0) {
+            continue;   // Дубликат или ответ на запрос прошлого измерения
+        }
+
+        // Первый ответ задает точку отсчета: его задержка — это RTT, а не разрыв
+        qint64 now = clock.elapsed();
+        if (lastReplyMs >= 0 && now - lastReplyMs > result.maxGapMs) {
+            result.maxGapMs = now - lastReplyMs;
+        }
+        lastReplyMs = now;
+        result.received++;
+    }
+}
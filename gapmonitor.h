@@ -0,0 +1,60 @@
+#ifndef GAPMONITOR_H
+#define GAPMONITOR_H
+
+#include <QObject>
+#include <QHostAddress>
+#include <QElapsedTimer>
+#include <QHash>
+
+class QUdpSocket;
+class QTimer;
+
+// Измерение разрыва связи при переключении туннеля.
+// Пока монитор запущен, каждые intervalMs уходит DNS-запрос через текущий
+// маршрут по умолчанию. Считаются потерянные запросы и самая длинная пауза
+// между ответами — это и есть время без туннеля.
+class GapMonitor : public QObject {
+    Q_OBJECT
+
+public:
+    struct Result {
+        int sent;
+        int received;
+        qint64 maxGapMs;      // Самый длинный интервал без ответов
+        qint64 durationMs;
+
+        Result() : sent(0), received(0), maxGapMs(0), durationMs(0) {}
+        int lost() const { return sent - received; }
+    };
+
+    explicit GapMonitor(QObject *parent = nullptr);
+
+    void setTarget(const QHostAddress& address, quint16 port = 53) { target = address; targetPort = port; }
+    void setInterval(int ms);
+
+    void start();
+    // Ответы на последние запросы ждем graceMs, затем выдаем finished
+    void stop(int graceMs = 500);
+    bool isActive() const { return active; }
+
+signals:
+    void finished(const GapMonitor::Result& result);
+
+private slots:
+    void sendProbe();
+    void readReplies();
+
+private:
+    QUdpSocket* socket;
+    QTimer* sendTimer;
+    QHostAddress target;
+    quint16 targetPort;
+    QElapsedTimer clock;
+    QHash<quint16, qint64> pending;   // ID запроса -> время отправки
+    quint16 nextId;
+    qint64 lastReplyMs;
+    bool active;
+    Result result;
+};
+
+#endif // GAPMONITOR_H
@@ -0,0 +1,763 @@
+#include "helperserver.h"
+#include "systemcommand.h"
+#include "openvpnbinary.h"
+#include "logtail.h"
+#include <QCoreApplication>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QProcess>
+#include <QFile>
+#include <QTimer>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QDateTime>
+#include <QStandardPaths>
+#include <QDir>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QDebug>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <pwd.h>
+#include <cerrno>
+#include <cstring>
+#include <csignal>
+#include <iostream>
+#include <string>
+
+namespace {
+// Программы, которые собирает PrivilegedOps::build — и больше никакие
+const QStringList allowedPrograms = { "ip", "iptables", "sysctl", "resolvectl" };
+// Ищем только в системных каталогах, PATH собеседника не учитывается
+const QStringList systemPaths = { "/usr/sbin", "/usr/bin", "/sbin", "/bin" };
+// Конфиги и реестр запущенных openvpn: root, 0700. Переживает перезапуск
+// помощника — новый экземпляр может завершить туннели прежнего
+const QString stateDir = "/run/vpngate-helper";
+const int kMaxConfigSize = 512 * 1024;
+
+// Директивы, которые запускают программы, загружают модули или читают и пишут
+// файлы от root. Флаги управления и логирования помощник задает сам
+const QStringList forbiddenDirectives = {
+    "up", "down", "route-up", "route-pre-down", "ipchange", "tls-verify", "auth-user-pass-verify",
+    "client-connect", "client-disconnect", "learn-address", "tls-crypt-v2-verify", "plugin",
+    "log", "log-append", "writepid", "status", "config", "cd", "chroot", "daemon", "tmp-dir",
+    "dev-node", "iproute", "pkcs11-providers", "engine", "providers", "askpass", "capath",
+    "crl-verify", "tls-export-cert", "client-config-dir", "ifconfig-pool-persist", "replay-persist",
+    "inetd", "setcon", "auth-gen-token-secret", "mktun", "rmtun"
+};
+// Ключи и сертификаты — только встроенные блоками, не путем к файлу
+const QStringList inlineOnlyDirectives = {
+    "ca", "cert", "key", "extra-certs", "dh", "tls-auth", "tls-crypt", "tls-crypt-v2", "pkcs12",
+    "secret", "http-proxy-user-pass"
+};
+const QStringList inlineBlocks = {
+    "ca", "cert", "key", "extra-certs", "dh", "tls-auth", "tls-crypt", "tls-crypt-v2", "pkcs12",
+    "secret", "http-proxy-user-pass", "auth-user-pass", "connection"
+};
+
+// Каталог 0700, не ссылка, владелец uid
+bool privateDirectory(const QString& path, uid_t uid) {
+    struct stat info;
+    if (lstat(QFile::encodeName(path).constData(), &info) != 0) {
+        return false;
+    }
+    return S_ISDIR(info.st_mode) && info.st_uid == uid && (info.st_mode & 0077) == 0;
+}
+}
+
+HelperServer::HelperServer(const QString& path, uid_t uid, const QByteArray& secret, QObject *parent)
+: QObject(parent), server(new QLocalServer(this)), client(nullptr), socketPath(path), clientUid(uid),
+token(secret), authenticated(false), commandsRunning(0), closing(false) {
+    connect(server, &QLocalServer::newConnection, this, &HelperServer::onNewConnection);
+}
+
+HelperServer::~HelperServer() {
+    for (QProcess* process : openvpnProcesses) {
+        process->kill();
+        process->waitForFinished(1000);
+    }
+    QFile::remove(socketPath);
+}
+
+bool HelperServer::listen(QString* error) {
+    QLocalServer::removeServer(socketPath);
+    server->setSocketOptions(QLocalServer::UserAccessOption);
+    if (!server->listen(socketPath)) {
+        *error = server->errorString();
+        return false;
+    }
+    // Сокет создан от root с правами 0700 — отдаем его пользователю GUI
+    if (chown(QFile::encodeName(socketPath).constData(), clientUid, static_cast<gid_t>(-1)) != 0) {
+        *error = "chown сокета не удался";
+        return false;
+    }
+    return true;
+}
+
+bool HelperServer::peerAllowed(qintptr descriptor, uid_t uid) {
+    struct ucred credentials;
+    socklen_t length = sizeof(credentials);
+    if (getsockopt(static_cast<int>(descriptor), SOL_SOCKET, SO_PEERCRED, &credentials, &length) != 0) {
+        return false;
+    }
+    return credentials.uid == uid;
+}
+
+void HelperServer::onNewConnection() {
+    while (QLocalSocket* socket = server->nextPendingConnection()) {
+        if (client || !peerAllowed(socket->socketDescriptor(), clientUid)) {
+            socket->write("DENIED\n");
+            socket->flush();
+            socket->disconnectFromServer();
+            socket->deleteLater();
+            continue;
+        }
+        client = socket;
+        connect(client, &QLocalSocket::readyRead, this, &HelperServer::onReadyRead);
+        connect(client, &QLocalSocket::disconnected, this, &HelperServer::onClientDisconnected);
+        // Второго клиента не будет: новые подключения больше не нужны
+        server->close();
+    }
+}
+
+void HelperServer::onReadyRead() {
+    while (client && client->canReadLine()) {
+        QByteArray line = client->readLine().trimmed();
+        if (line.isEmpty()) {
+            continue;
+        }
+
+        if (!authenticated) {
+            if (line == "AUTH " + token) {
+                authenticated = true;
+                client->write("OK\n");
+                client->flush();
+            } else {
+                client->write("DENIED\n");
+                client->flush();
+                client->disconnectFromServer();
+            }
+            continue;
+        }
+
+        QJsonDocument document = QJsonDocument::fromJson(line);
+        if (document.isObject()) {
+            handleRequest(document.object());
+        }
+    }
+}
+
+void HelperServer::handleRequest(const QJsonObject& request) {
+    qint64 id = request.value("id").toInteger();
+    QString op = request.value("op").toString();
+
+    if (op == "ops") {
+        runOps(id, request);
+    } else if (op == "spawn" && request.contains("netns")) {
+        spawnInNetns(id, request);
+    } else if (op == "spawn") {
+        spawnOpenVpn(id, request);
+    } else if (op == "signal") {
+        signalProcess(id, request);
+    } else if (op == "untail") {
+        // GUI подключился к management-интерфейсу: строки лога больше не нужны
+        if (LogTail* tail = logTails.take(request.value("pid").toInteger())) {
+            tail->stop();
+        }
+        reply(id, true, QString());
+    } else {
+        reply(id, false, QString("неизвестная операция: %1").arg(op));
+    }
+}
+
+QString HelperServer::resolveProgram(const QString& name) {
+    if (!allowedPrograms.contains(name)) {
+        return QString();
+    }
+    return QStandardPaths::findExecutable(name, systemPaths);
+}
+
+void HelperServer::runOps(qint64 id, const QJsonObject& request) {
+    // Команды собираются здесь же по проверенным полям: от клиента берется
+    // только описание операций, не программа и не аргументы
+    QList<QJsonObject> ops;
+    for (const QJsonValue& value : request.value("ops").toArray()) {
+        ops << value.toObject();
+    }
+    QList<PrivilegedOps::Command> commands;
+    QString error;
+    if (!PrivilegedOps::build(ops, &commands, &error)) {
+        reply(id, false, error);
+        return;
+    }
+
+    int timeoutMs = qBound(1000, request.value("timeout").toInt(5000), 30000);
+    commandsRunning++;
+    runCommands(id, commands, 0, QString(), timeoutMs);
+}
+
+void HelperServer::runCommands(qint64 id, const QList<PrivilegedOps::Command>& commands, int index,
+                               QString output, int timeoutMs) {
+    // Команды идут по порядку; ошибка одной не отменяет следующие, как в shell-скрипте
+    if (index >= commands.size()) {
+        commandsRunning--;
+        reply(id, !output.contains("\n!"), output.trimmed());
+        quitWhenIdle();
+        return;
+    }
+
+    const PrivilegedOps::Command& command = commands.at(index);
+    QString program = resolveProgram(command.program);
+    if (program.isEmpty()) {
+        output += QString("\n! %1 не найдена").arg(command.program);
+        runCommands(id, commands, index + 1, output, timeoutMs);
+        return;
+    }
+
+    SystemCommand::run(program, command.args, this,
+                       [this, id, commands, index, output, timeoutMs](bool ok, const QString& text) {
+        QString accumulated = output;
+        if (!text.isEmpty()) {
+            accumulated += "\n" + text;
+        }
+        if (!ok) {
+            accumulated += QString("\n! %1 завершилась с ошибкой").arg(commands.at(index).program);
+        }
+        runCommands(id, commands, index + 1, accumulated, timeoutMs);
+    }, command.input, timeoutMs);
+}
+
+bool HelperServer::configAllowed(const QByteArray& config, QString* error) {
+    if (config.isEmpty() || config.size() > kMaxConfigSize || config.contains('\0')) {
+        *error = "неверный размер конфига";
+        return false;
+    }
+
+    QString block;          // Открытый встроенный блок, кроме <connection>
+    bool inConnection = false;
+    int lineNumber = 0;
+    for (const QString& rawLine : QString::fromUtf8(config).split('\n')) {
+        lineNumber++;
+        QString line = rawLine.trimmed();
+
+        if (!block.isEmpty()) {
+            if (line == QString("</%1>").arg(block)) {
+                block.clear();
+            }
+            continue;
+        }
+        if (line.isEmpty() || line.startsWith('#') || line.startsWith(';')) {
+            continue;
+        }
+
+        if (line.startsWith("</")) {
+            if (line == "</connection>" && inConnection) {
+                inConnection = false;
+                continue;
+            }
+            *error = QString("строка %1: лишний %2").arg(lineNumber).arg(line);
+            return false;
+        }
+        if (line.startsWith('<') && line.endsWith('>')) {
+            QString tag = line.mid(1, line.size() - 2);
+            if (!inlineBlocks.contains(tag) || (tag == "connection" && inConnection)) {
+                *error = QString("строка %1: блок <%2> не разрешен").arg(lineNumber).arg(tag);
+                return false;
+            }
+            if (tag == "connection") {
+                inConnection = true;
+            } else {
+                block = tag;
+            }
+            continue;
+        }
+
+        QStringList parts = line.split(QRegularExpression("\\s+"), Qt::SkipEmptyParts);
+        QString directive = parts.takeFirst();
+        if (directive.startsWith("--")) {
+            directive = directive.mid(2);
+        }
+
+        bool allowed = true;
+        if (forbiddenDirectives.contains(directive) || directive.startsWith("management")) {
+            allowed = false;
+        } else if (inlineOnlyDirectives.contains(directive)) {
+            allowed = !parts.isEmpty() && parts.first() == "[inline]";
+        } else if (directive == "auth-user-pass") {
+            // Учетные данные приходят по management-интерфейсу, файл не нужен
+            allowed = parts.isEmpty();
+        } else if (directive == "http-proxy") {
+            // Третий аргумент — файл с паролем; разрешены только auto и auto-nct
+            allowed = parts.size() < 3 || parts.at(2) == "auto" || parts.at(2) == "auto-nct";
+        } else if (directive == "socks-proxy") {
+            allowed = parts.size() < 3;
+        }
+        if (!allowed) {
+            *error = QString("строка %1: директива %2 не разрешена").arg(lineNumber).arg(directive);
+            return false;
+        }
+    }
+
+    if (!block.isEmpty() || inConnection) {
+        *error = "незакрытый встроенный блок";
+        return false;
+    }
+    return true;
+}
+
+bool HelperServer::sessionDirAllowed(const QString& dir, QString* error) const {
+    // Каталог сессии GUI: <runtime>/vpngate-sessions/<секунды>-<hex>, 0700,
+    // владелец — пользователь GUI, без ссылок на пути
+    static const QRegularExpression namePattern("^\\d{1,12}-[0-9a-f]{8}$");
+    QFileInfo info(dir);
+    if (!QDir::isAbsolutePath(dir) || info.canonicalFilePath() != QDir::cleanPath(dir)
+        || !namePattern.match(info.fileName()).hasMatch()
+        || QFileInfo(info.path()).fileName() != "vpngate-sessions") {
+        *error = QString("каталог сессии отклонен: %1").arg(dir);
+        return false;
+    }
+    if (!privateDirectory(dir, clientUid) || !privateDirectory(info.path(), clientUid)) {
+        *error = QString("каталог сессии должен быть 0700 и принадлежать uid %1").arg(clientUid);
+        return false;
+    }
+    return true;
+}
+
+qint64 HelperServer::processStartTime(qint64 pid) {
+    // Поле 22 /proc/<pid>/stat; отсчет после ")", имя процесса может содержать пробелы
+    QFile stat(QString("/proc/%1/stat").arg(pid));
+    if (!stat.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+    QByteArray text = stat.readAll();
+    int close = text.lastIndexOf(')');
+    if (close < 0) {
+        return -1;
+    }
+    QList<QByteArray> fields = text.mid(close + 2).split(' ');
+    return fields.size() > 19 ? fields.at(19).toLongLong() : -1;
+}
+
+void HelperServer::pruneStateDir() {
+    // Каталоги openvpn, которых уже нет (завершены или система перезагружалась)
+    QDir root(stateDir);
+    for (const QString& name : root.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        QFile registry(root.filePath(name + "/process"));
+        qint64 pid = 0;
+        qint64 startTime = -1;
+        if (registry.open(QIODevice::ReadOnly)) {
+            QList<QByteArray> fields = registry.readAll().trimmed().split(' ');
+            pid = fields.value(0).toLongLong();
+            startTime = fields.value(1).toLongLong();
+        }
+        if (pid <= 0 || processStartTime(pid) != startTime) {
+            QDir(root.filePath(name)).removeRecursively();
+        }
+    }
+}
+
+QString HelperServer::createProcessDir(const QString& key, const QByteArray& config, QString* error) {
+    // Свой каталог на запуск: конфиг и лог лежат там, куда пользователь не пишет
+    QDir root(stateDir);
+    if (!root.exists() && !QDir().mkpath(stateDir)) {
+        *error = QString("не удалось создать %1").arg(stateDir);
+        return QString();
+    }
+    QFile::setPermissions(stateDir, QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner);
+    if (!privateDirectory(stateDir, 0)) {
+        *error = QString("%1 должен принадлежать root с правами 0700").arg(stateDir);
+        return QString();
+    }
+    if (!root.mkdir(key)) {
+        *error = QString("сессия %1 уже запущена").arg(key);
+        return QString();
+    }
+    QDir dir(root.filePath(key));
+    QFile configFile(dir.filePath("config.ovpn"));
+    if (!configFile.open(QIODevice::WriteOnly) || configFile.write(config) != config.size()) {
+        dir.removeRecursively();
+        *error = "не удалось записать конфиг";
+        return QString();
+    }
+    configFile.close();
+    configFile.setPermissions(QFile::ReadOwner | QFile::WriteOwner);
+    return dir.path();
+}
+
+void HelperServer::spawnOpenVpn(qint64 id, const QJsonObject& request) {
+    // Бинарник и командную строку выбирает помощник: от клиента — только
+    // конфиг (без скриптов и путей к файлам) и проверенные параметры
+    QString error;
+    QByteArray config = request.value("config").toString().toUtf8();
+    QString sessionDir = request.value("sessionDir").toString();
+    QString device = request.value("device").toString();
+    int connectTimeout = request.value("connectTimeout").toInt(30);
+    if (!configAllowed(config, &error) || !sessionDirAllowed(sessionDir, &error)) {
+        reply(id, false, error);
+        return;
+    }
+    if (!device.isEmpty() && !PrivilegedOps::isTunDevice(device)) {
+        reply(id, false, QString("устройство отклонено: %1").arg(device));
+        return;
+    }
+    if (connectTimeout < 1 || connectTimeout > 3600) {
+        reply(id, false, "неверный таймаут подключения");
+        return;
+    }
+    struct passwd* pw = getpwuid(clientUid);
+    if (!pw) {
+        reply(id, false, QString("пользователь uid %1 не найден").arg(clientUid));
+        return;
+    }
+
+    QString processDir = createProcessDir(QFileInfo(sessionDir).fileName(), config, &error);
+    if (processDir.isEmpty()) {
+        reply(id, false, error);
+        return;
+    }
+    QDir dir(processDir);
+
+    // Опции после --config переопределяют конфиг: скрипты запрещены в любом случае
+    QStringList args = {
+        "--config", dir.filePath("config.ovpn"),
+        "--script-security", "1",
+        "--verb", "3",
+        "--suppress-timestamps",
+        "--connect-timeout", QString::number(connectTimeout),
+        "--management", QDir(sessionDir).filePath("management.sock"), "unix",
+        "--management-query-passwords",
+        "--management-hold",
+        "--management-client-user", QString::fromLocal8Bit(pw->pw_name),
+        "--log", dir.filePath("openvpn.log")
+    };
+    if (!device.isEmpty()) {
+        args << "--dev" << device << "--dev-type" << "tun";
+    }
+    if (request.value("routeNoExec").toBool()) {
+        args << "--route-noexec";
+    }
+
+    launchOpenVpn(id, args, processDir, QString());
+}
+
+void HelperServer::spawnInNetns(qint64 id, const QJsonObject& request) {
+    // Проверка туннеля в namespace: tun переносит туда up-скрипт помощника
+    // (0700 в его каталоге), а не файл пользователя. Namespace помощник создает
+    // перед запуском и удаляет после завершения openvpn сам
+    static const QRegularExpression netnsPattern("^vpngate-t\\d{1,2}$");
+    static const QRegularExpression devicePattern("^vgt\\d{1,2}$");
+    static const QRegularExpression credentialPattern("^[^\\r\\n\\x00]{1,256}$");
+
+    QString error;
+    QByteArray config = request.value("config").toString().toUtf8();
+    QString netns = request.value("netns").toString();
+    QString device = request.value("device").toString();
+    QString username = request.value("username").toString();
+    QString password = request.value("password").toString();
+    int connectTimeout = request.value("connectTimeout").toInt(10);
+    if (!configAllowed(config, &error)) {
+        reply(id, false, error);
+        return;
+    }
+    // Со скриптом setenv мог бы подменить его окружение
+    for (const QString& line : QString::fromUtf8(config).split('\n')) {
+        QString trimmed = line.trimmed();
+        if (trimmed.startsWith("setenv ") || trimmed.startsWith("--setenv ")) {
+            reply(id, false, "директива setenv не разрешена при проверке в namespace");
+            return;
+        }
+    }
+    if (!netnsPattern.match(netns).hasMatch() || !devicePattern.match(device).hasMatch()) {
+        reply(id, false, QString("namespace или устройство отклонены: %1 %2").arg(netns, device));
+        return;
+    }
+    if (!credentialPattern.match(username).hasMatch() || !credentialPattern.match(password).hasMatch()) {
+        reply(id, false, "неверные учетные данные");
+        return;
+    }
+    if (connectTimeout < 1 || connectTimeout > 600) {
+        reply(id, false, "неверный таймаут подключения");
+        return;
+    }
+
+    QString key = QString("%1-%2").arg(netns).arg(QDateTime::currentMSecsSinceEpoch());
+    QString processDir = createProcessDir(key, config, &error);
+    if (processDir.isEmpty()) {
+        reply(id, false, error);
+        return;
+    }
+    QDir dir(processDir);
+
+    QFile auth(dir.filePath("auth"));
+    QFile upScript(dir.filePath("netns-up.sh"));
+    QByteArray credentials = (username + "\n" + password + "\n").toUtf8();
+    if (!auth.open(QIODevice::WriteOnly) || auth.write(credentials) != credentials.size()
+        || !upScript.open(QIODevice::WriteOnly) || upScript.write(PrivilegedOps::netnsUpScript()) < 0) {
+        dir.removeRecursively();
+        reply(id, false, "не удалось подготовить каталог проверки");
+        return;
+    }
+    auth.close();
+    upScript.close();
+    auth.setPermissions(QFile::ReadOwner | QFile::WriteOwner);
+    upScript.setPermissions(QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner);
+
+    // Маршруты и адрес tun настраивает только up-скрипт внутри namespace
+    QStringList args = {
+        "--config", dir.filePath("config.ovpn"),
+        "--script-security", "2",
+        "--up", QString("/bin/sh %1 %2").arg(upScript.fileName(), netns),
+        "--dev", device,
+        "--dev-type", "tun",
+        "--route-noexec",
+        "--ifconfig-noexec",
+        "--auth-user-pass", auth.fileName(),
+        "--verb", "3",
+        "--suppress-timestamps",
+        "--connect-timeout", QString::number(connectTimeout),
+        "--log", dir.filePath("openvpn.log")
+    };
+
+    // Namespace мог остаться от прошлого аварийного завершения; ошибку
+    // удаления не проверяем — его обычно нет
+    QString ip = resolveProgram("ip");
+    commandsRunning++;
+    SystemCommand::run(ip, QStringList() << "netns" << "del" << netns, this,
+                       [this, id, ip, netns, args, processDir](bool, const QString&) {
+        SystemCommand::run(ip, QStringList() << "netns" << "add" << netns, this,
+                           [this, id, netns, args, processDir](bool ok, const QString& output) {
+            commandsRunning--;
+            if (!ok) {
+                QDir(processDir).removeRecursively();
+                reply(id, false, QString("Не удалось создать namespace %1: %2").arg(netns, output));
+                quitWhenIdle();
+                return;
+            }
+            launchOpenVpn(id, args, processDir, netns);
+        }, QByteArray(), 3000);
+    }, QByteArray(), 1000);
+}
+
+void HelperServer::launchOpenVpn(qint64 id, const QStringList& args, const QString& processDir,
+                                 const QString& netns) {
+    OpenVpnCapabilities openvpn = OpenVpnBinary::resolve();
+    if (!openvpn.isValid()) {
+        QDir(processDir).removeRecursively();
+        if (!netns.isEmpty()) {
+            SystemCommand::run(resolveProgram("ip"), QStringList() << "netns" << "del" << netns, this);
+        }
+        reply(id, false, "OpenVPN не найден");
+        return;
+    }
+
+    QProcess* process = new QProcess(this);
+    process->setProcessChannelMode(QProcess::MergedChannels);
+    if (!netns.isEmpty()) {
+        netnsProcesses.insert(process);
+    }
+
+    connect(process, &QProcess::readyRead, this, [this, process]() {
+        while (process->canReadLine()) {
+            QJsonObject event;
+            event["event"] = "output";
+            event["pid"] = process->processId();
+            event["line"] = QString::fromUtf8(process->readLine().trimmed());
+            send(event);
+        }
+    });
+
+    connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this,
+            [this, process, netns](int exitCode, QProcess::ExitStatus status) {
+        qint64 pid = openvpnProcesses.key(process, 0);
+        openvpnProcesses.remove(pid);
+        netnsProcesses.remove(process);
+        // Последние строки лога — обычно причина завершения, до события exit
+        if (LogTail* tail = logTails.take(pid)) {
+            tail->stop();
+        }
+        QDir(processDirs.take(pid)).removeRecursively();
+        process->deleteLater();
+
+        QJsonObject event;
+        event["event"] = "exit";
+        event["pid"] = pid;
+        event["code"] = exitCode;
+        event["crashed"] = status == QProcess::CrashExit;
+        if (netns.isEmpty()) {
+            send(event);
+            quitWhenIdle();
+            return;
+        }
+        // exit уходит после удаления namespace: следующий запуск в этом
+        // слоте не столкнется с ним
+        commandsRunning++;
+        SystemCommand::run(resolveProgram("ip"), QStringList() << "netns" << "del" << netns, this,
+                           [this, event](bool, const QString&) {
+            commandsRunning--;
+            send(event);
+            quitWhenIdle();
+        }, QByteArray(), 3000);
+    });
+
+    connect(process, &QProcess::started, this, [this, process, id, processDir]() {
+        qint64 pid = process->processId();
+        openvpnProcesses.insert(pid, process);
+        processDirs.insert(pid, processDir);
+
+        // Реестр для следующего экземпляра помощника: pid и время старта,
+        // чтобы сигнал не ушел процессу, получившему тот же pid позже
+        QFile registry(QDir(processDir).filePath("process"));
+        if (registry.open(QIODevice::WriteOnly)) {
+            registry.write(QString("%1 %2\n").arg(pid).arg(processStartTime(pid)).toLatin1());
+        }
+
+        // openvpn пишет в --log: ранние ошибки GUI видит только так
+        LogTail* tail = new LogTail(QDir(processDir).filePath("openvpn.log"), process);
+        connect(tail, &LogTail::lineRead, this, [this, pid](const QByteArray& line) {
+            QJsonObject event;
+            event["event"] = "output";
+            event["pid"] = pid;
+            event["line"] = QString::fromUtf8(line);
+            send(event);
+        });
+        logTails.insert(pid, tail);
+        tail->start();
+
+        QJsonObject extra;
+        extra["pid"] = pid;
+        reply(id, true, QString(), extra);
+    });
+
+    connect(process, &QProcess::errorOccurred, this,
+            [this, process, id, processDir, netns](QProcess::ProcessError error) {
+        if (error != QProcess::FailedToStart) {
+            return;
+        }
+        QDir(processDir).removeRecursively();
+        netnsProcesses.remove(process);
+        if (!netns.isEmpty()) {
+            SystemCommand::run(resolveProgram("ip"), QStringList() << "netns" << "del" << netns, this);
+        }
+        reply(id, false, process->errorString());
+        process->deleteLater();
+    });
+
+    process->start(openvpn.path, args);
+}
+
+void HelperServer::signalProcess(qint64 id, const QJsonObject& request) {
+    // Сигналы — только своим openvpn, произвольный pid не принимается
+    qint64 pid = request.value("pid").toInteger();
+    bool forceKill = request.value("signal").toString() == "KILL";
+
+    if (QProcess* process = openvpnProcesses.value(pid)) {
+        if (forceKill) {
+            process->kill();
+        } else {
+            process->terminate();
+        }
+        reply(id, true, QString());
+        return;
+    }
+
+    // openvpn прежнего экземпляра помощника (GUI перезапускался): ищем в реестре
+    QDir root(stateDir);
+    for (const QString& name : root.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        QFile registry(root.filePath(name + "/process"));
+        if (!registry.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+        QList<QByteArray> fields = registry.readAll().trimmed().split(' ');
+        if (pid <= 0 || fields.value(0).toLongLong() != pid) {
+            continue;
+        }
+        if (processStartTime(pid) != fields.value(1).toLongLong()) {
+            QDir(root.filePath(name)).removeRecursively();
+            break;
+        }
+        if (::kill(static_cast<pid_t>(pid), forceKill ? SIGKILL : SIGTERM) != 0) {
+            reply(id, false, QString("kill %1: %2").arg(pid).arg(QString::fromLocal8Bit(strerror(errno))));
+            return;
+        }
+        reply(id, true, QString());
+        return;
+    }
+    reply(id, false, "процесс не найден");
+}
+
+void HelperServer::send(const QJsonObject& message) {
+    if (!client || client->state() != QLocalSocket::ConnectedState) {
+        return;
+    }
+    client->write(QJsonDocument(message).toJson(QJsonDocument::Compact) + "\n");
+    client->flush();
+}
+
+void HelperServer::reply(qint64 id, bool ok, const QString& text, QJsonObject extra) {
+    extra["id"] = id;
+    extra["ok"] = ok;
+    if (ok) {
+        extra["output"] = text;
+    } else {
+        extra["error"] = text;
+        extra["output"] = text;
+    }
+    send(extra);
+}
+
+void HelperServer::onClientDisconnected() {
+    // Ненужные туннели GUI завершает сам перед выходом. Оставшиеся продолжают
+    // работать: их подхватит следующий запуск, поэтому ждем их завершения.
+    // Проверки туннелей никто не подхватит — их завершаем (namespace снимет finished)
+    closing = true;
+    for (QProcess* process : netnsProcesses) {
+        process->terminate();
+    }
+    quitWhenIdle();
+}
+
+void HelperServer::quitWhenIdle() {
+    // Уже принятые команды (например, снятие правил шлюза при выходе) доделываются
+    if (closing && commandsRunning == 0 && openvpnProcesses.isEmpty()) {
+        QCoreApplication::quit();
+    }
+}
+
+int HelperServer::run(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    if (geteuid() != 0 || argc < 4) {
+        std::cerr << "--privileged-helper: нужен root и аргументы <сокет> <uid>" << std::endl;
+        return 2;
+    }
+    QString socketPath = QString::fromLocal8Bit(argv[2]);
+    bool uidOk = false;
+    uid_t uid = static_cast<uid_t>(QString::fromLatin1(argv[3]).toUInt(&uidOk));
+
+    std::string line;
+    std::getline(std::cin, line);
+    QByteArray token = QByteArray::fromStdString(line).trimmed();
+    if (!uidOk || token.size() < 32) {
+        std::cerr << "--privileged-helper: неверный uid или токен" << std::endl;
+        return 2;
+    }
+
+    pruneStateDir();
+    HelperServer helper(socketPath, uid, token);
+    QString error;
+    if (!helper.listen(&error)) {
+        std::cerr << "--privileged-helper: " << error.toStdString() << std::endl;
+        return 1;
+    }
+
+    // Клиент так и не подключился — не висим в фоне
+    QTimer::singleShot(30000, &app, [&helper]() {
+        if (!helper.client) {
+            QCoreApplication::quit();
+        }
+    });
+
+    return app.exec();
+}
@@ -0,0 +1,85 @@
+#ifndef HELPERSERVER_H
+#define HELPERSERVER_H
+
+#include <QObject>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QHash>
+#include <QSet>
+#include <QByteArray>
+#include "privilegedops.h"
+#include <sys/types.h>
+
+class QLocalServer;
+class QLocalSocket;
+class QProcess;
+class LogTail;
+
+// Сторона root привилегированного помощника (режим --privileged-helper).
+// Принимает одно подключение: собеседник должен быть процессом пользователя,
+// запустившего помощника (SO_PEERCRED), и первой строкой прислать токен,
+// полученный помощником через stdin. Запросы — JSON по строке:
+//   ops    — операции PrivilegedOps (маршруты, sysctl, DNS, шлюз, namespace);
+//            произвольные программы и аргументы не принимаются
+//   spawn  — openvpn с конфигом и каталогом сессии; командную строку помощник
+//            собирает сам, вывод и завершение приходят событиями. С полем
+//            netns — проверка туннеля в namespace vpngate-tN (TunnelTester)
+//   signal — TERM/KILL только openvpn, запущенному помощником (в том числе
+//            прежним его экземпляром — по реестру в /run/vpngate-helper)
+//   untail — перестать присылать строки лога openvpn событиями output
+// После закрытия подключения помощник доделывает принятые команды и выходит,
+// когда завершатся его openvpn: туннели переживают перезапуск GUI, а новый
+// экземпляр находит их по журналу сессий.
+class HelperServer : public QObject {
+    Q_OBJECT
+
+public:
+    HelperServer(const QString& socketPath, uid_t clientUid, const QByteArray& token, QObject *parent = nullptr);
+    ~HelperServer();
+
+    bool listen(QString* error);
+
+    // Точка входа режима помощника: argv = <app> --privileged-helper <сокет> <uid>
+    static int run(int argc, char *argv[]);
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+    void onClientDisconnected();
+
+private:
+    QLocalServer* server;
+    QLocalSocket* client;
+    QString socketPath;
+    uid_t clientUid;
+    QByteArray token;
+    bool authenticated;
+    int commandsRunning;                       // Выход ждет незавершенные команды
+    bool closing;
+    QHash<qint64, QProcess*> openvpnProcesses;
+    QHash<qint64, QString> processDirs;        // pid -> каталог помощника для этого openvpn
+    QHash<qint64, LogTail*> logTails;          // Лог openvpn, пока GUI не подключился к management
+    QSet<QProcess*> netnsProcesses;            // Проверки туннелей: без GUI они не нужны
+
+    void handleRequest(const QJsonObject& request);
+    void runOps(qint64 id, const QJsonObject& request);
+    void runCommands(qint64 id, const QList<PrivilegedOps::Command>& commands, int index, QString output,
+                     int timeoutMs);
+    void spawnOpenVpn(qint64 id, const QJsonObject& request);
+    void spawnInNetns(qint64 id, const QJsonObject& request);
+    void launchOpenVpn(qint64 id, const QStringList& args, const QString& processDir, const QString& netns);
+    QString createProcessDir(const QString& key, const QByteArray& config, QString* error);
+    void signalProcess(qint64 id, const QJsonObject& request);
+    bool sessionDirAllowed(const QString& dir, QString* error) const;
+    void send(const QJsonObject& message);
+    void reply(qint64 id, bool ok, const QString& text, QJsonObject extra = QJsonObject());
+    void quitWhenIdle();
+
+    static QString resolveProgram(const QString& name);
+    static bool peerAllowed(qintptr descriptor, uid_t uid);
+    static bool configAllowed(const QByteArray& config, QString* error);
+    static qint64 processStartTime(qint64 pid);
+    static void pruneStateDir();
+};
+
+#endif // HELPERSERVER_H
@@ -0,0 +1,110 @@
+#ifndef LATENCYSTATS_H
+#define LATENCYSTATS_H
+
+#include <QDateTime>
+#include <QVarLengthArray>
+#include <algorithm>
+#include <cmath>
+
+// Сводка по задержкам сервера
+struct LatencyStats {
+    int samples;       // Сколько проб учтено (включая потерянные)
+    double minMs;
+    double p50Ms;
+    double p95Ms;
+    double jitterMs;   // Среднее |RTT[i] - RTT[i-1]| по успешным пробам
+    double lossRate;   // 0.0 .. 1.0
+
+    LatencyStats()
+    : samples(0), minMs(-1.0), p50Ms(-1.0), p95Ms(-1.0), jitterMs(0.0), lossRate(0.0) {
+    }
+
+    bool isValid() const { return samples > 0; }
+};
+
+// Компактный скетч фиксированного размера: кольцевой буфер последних проб.
+// Пробы старше maxAgeMs при расчете статистики не учитываются.
+class LatencySketch {
+public:
+    static constexpr int Capacity = 32;
+    static constexpr qint64 DefaultMaxAgeMs = 30 * 60 * 1000;
+
+    LatencySketch() : ring(), head(0), count(0) {}
+
+    void addSample(double rttMs) { push(static_cast<float>(rttMs)); }
+    void addLoss() { push(-1.0f); }
+    void clear() { head = 0; count = 0; }
+    bool isEmpty() const { return count == 0; }
+
+    LatencyStats stats(qint64 maxAgeMs = DefaultMaxAgeMs) const {
+        LatencyStats result;
+        qint64 cutoff = QDateTime::currentMSecsSinceEpoch() - maxAgeMs;
+
+        QVarLengthArray<float, Capacity> rtts;
+        int lost = 0;
+        double jitterSum = 0.0;
+        int jitterPairs = 0;
+        float previous = -1.0f;
+
+        // Обходим от старых проб к новым, чтобы джиттер считался по порядку
+        for (int i = 0; i < count; ++i) {
+            const Sample& sample = ring[(head - count + i + Capacity) % Capacity];
+            if (sample.timestampMs < cutoff) {
+                continue;
+            }
+            result.samples++;
+            if (sample.rttMs < 0.0f) {
+                lost++;
+                continue;
+            }
+            if (previous >= 0.0f) {
+                jitterSum += std::fabs(sample.rttMs - previous);
+                jitterPairs++;
+            }
+            previous = sample.rttMs;
+            rtts.append(sample.rttMs);
+        }
+
+        if (result.samples == 0) {
+            return result;
+        }
+
+        result.lossRate = static_cast<double>(lost) / result.samples;
+        if (rtts.isEmpty()) {
+            return result;
+        }
+
+        std::sort(rtts.begin(), rtts.end());
+        result.minMs = rtts.first();
+        result.p50Ms = percentile(rtts, 0.50);
+        result.p95Ms = percentile(rtts, 0.95);
+        result.jitterMs = jitterPairs > 0 ? jitterSum / jitterPairs : 0.0;
+        return result;
+    }
+
+private:
+    struct Sample {
+        qint64 timestampMs;
+        float rttMs;   // < 0 — проба потеряна
+    };
+
+    Sample ring[Capacity];
+    int head;
+    int count;
+
+    void push(float rttMs) {
+        ring[head].timestampMs = QDateTime::currentMSecsSinceEpoch();
+        ring[head].rttMs = rttMs;
+        head = (head + 1) % Capacity;
+        if (count < Capacity) {
+            count++;
+        }
+    }
+
+    static double percentile(const QVarLengthArray<float, Capacity>& sorted, double q) {
+        int rank = static_cast<int>(std::ceil(q * sorted.size())) - 1;
+        return sorted[qBound(0, rank, static_cast<int>(sorted.size()) - 1)];
+    }
+};
+
+#endif // LATENCYSTATS_H
@@ -0,0 +1,148 @@
+#include "logclassifier.h"
+#include <QQueue>
+#include <algorithm>
+
+namespace {
+struct LogPattern {
+    const char* text;
+    LogEvent event;
+};
+
+// Порядок важен: при нескольких совпадениях в строке побеждает шаблон выше
+const LogPattern kPatterns[] = {
+    { "Initialization Sequence Completed",               LogEvent::Connected },
+    { "AUTH_FAILED",                                     LogEvent::AuthFailed },
+    { "WARNING: Failed running command (--up",           LogEvent::UpScriptFailed },
+    { "failed to negotiate cipher",                      LogEvent::CipherError },   // Выше "Options error"
+    { "Options error",                                   LogEvent::ConfigError },
+    { "Error reading username from Auth authfile",       LogEvent::ConfigError },
+    { "Cannot open TUN/TAP dev",                         LogEvent::ConfigError },
+    { "Cannot allocate TUN/TAP dev dynamically",         LogEvent::ConfigError },
+    { "Cannot ioctl TUNSETIFF",                          LogEvent::ConfigError },
+    { "TLS Error",                                       LogEvent::TlsError },
+    { "TLS key negotiation failed",                      LogEvent::TlsError },
+    { "Fatal TLS error",                                 LogEvent::TlsError },
+    { "connection failed",                               LogEvent::NetworkError },
+    { "Connection reset",                                LogEvent::NetworkError },
+    { "write UDP: Operation not permitted",              LogEvent::NetworkError },
+    { "Bad encapsulated packet length",                  LogEvent::NetworkError },
+    { "Bad compression stub decompression header byte",  LogEvent::CompressionError },
+    { "Decompress error",                                LogEvent::CompressionError },
+    { "AEAD Decrypt error",                              LogEvent::CipherError },
+    { "cipher final failed",                             LogEvent::CipherError },
+    { "FRAG_IN error",                                   LogEvent::FragmentError },
+    { "EMSGSIZE",                                        LogEvent::PathMtuError },
+    { "ROUTE: route addition failed",                    LogEvent::RouteError },
+    { "route gateway is not reachable",                  LogEvent::RouteError },
+    { "Exiting due to fatal error",                      LogEvent::FatalExit },
+    { "process exiting",                                 LogEvent::Exiting },
+    { "SIGUSR1[",                                        LogEvent::SoftRestart },
+    { "SIGHUP[",                                         LogEvent::SoftRestart },
+    { "deprecated",                                      LogEvent::Warning },
+    { "WARNING:",                                        LogEvent::Warning }
+};
+
+unsigned char foldCase(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<unsigned char>(c - 'A' + 'a') : c;
+}
+}
+
+const LogClassifier& LogClassifier::instance() {
+    static const LogClassifier classifier;
+    return classifier;
+}
+
+LogClassifier::LogClassifier()
+: classCount(1) {
+    // Сжимаем алфавит: отдельный класс только у байтов, встречающихся в шаблонах
+    for (int i = 0; i < 256; ++i) {
+        byteClass[i] = 0;
+    }
+    for (const LogPattern& pattern : kPatterns) {
+        for (const char* p = pattern.text; *p; ++p) {
+            unsigned char c = foldCase(static_cast<unsigned char>(*p));
+            if (byteClass[c] == 0) {
+                byteClass[c] = static_cast<unsigned char>(classCount++);
+            }
+        }
+    }
+    for (int c = 'A'; c <= 'Z'; ++c) {
+        byteClass[c] = byteClass[foldCase(static_cast<unsigned char>(c))];
+    }
+
+    // Бор
+    transitions.fill(-1, classCount);
+    bestMatch.append(-1);
+
+    for (const LogPattern& pattern : kPatterns) {
+        int state = 0;
+        for (const char* p = pattern.text; *p; ++p) {
+            int cls = byteClass[static_cast<unsigned char>(*p)];
+            int& next = transitions[state * classCount + cls];
+            if (next < 0) {
+                next = bestMatch.size();
+                bestMatch.append(-1);
+                transitions.resize(transitions.size() + classCount);
+                std::fill(transitions.end() - classCount, transitions.end(), -1);
+            }
+            state = transitions[state * classCount + cls];
+        }
+        if (bestMatch[state] < 0) {
+            bestMatch[state] = patternEvents.size();
+        }
+        patternEvents.append(pattern.event);
+    }
+
+    // Суффиксные ссылки в порядке BFS и достройка до полного автомата
+    QVector<int> fail(bestMatch.size(), 0);
+    QQueue<int> queue;
+    for (int cls = 0; cls < classCount; ++cls) {
+        int& next = transitions[cls];
+        if (next < 0) {
+            next = 0;
+        } else {
+            fail[next] = 0;
+            queue.enqueue(next);
+        }
+    }
+
+    while (!queue.isEmpty()) {
+        int state = queue.dequeue();
+        int fallback = bestMatch[fail[state]];
+        if (fallback >= 0 && (bestMatch[state] < 0 || fallback < bestMatch[state])) {
+            bestMatch[state] = fallback;
+        }
+
+        for (int cls = 0; cls < classCount; ++cls) {
+            int& next = transitions[state * classCount + cls];
+            int viaFail = transitions[fail[state] * classCount + cls];
+            if (next < 0) {
+                next = viaFail;
+            } else {
+                fail[next] = viaFail;
+                queue.enqueue(next);
+            }
+        }
+    }
+}
+
+LogEvent LogClassifier::classify(const char* data, int size) const {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+    const int* delta = transitions.constData();
+    const int* best = bestMatch.constData();
+
+    int state = 0;
+    int found = -1;
+    for (int i = 0; i < size; ++i) {
+        state = delta[state * classCount + byteClass[bytes[i]]];
+        int match = best[state];
+        if (match >= 0 && (found < 0 || match < found)) {
+            found = match;
+            if (found == 0) {
+                break;   // Выше по приоритету ничего нет
+            }
+        }
+    }
+
+    return found >= 0 ? patternEvents[found] : LogEvent::None;
+}
@@ -0,0 +1,51 @@
+#ifndef LOGCLASSIFIER_H
+#define LOGCLASSIFIER_H
+
+#include <QByteArray>
+#include <QVector>
+
+// Что означает строка лога OpenVPN
+enum class LogEvent {
+    None,
+    Connected,         // Initialization Sequence Completed
+    AuthFailed,
+    UpScriptFailed,    // Не отработал --up скрипт
+    ConfigError,       // Ошибки опций и TUN/TAP
+    TlsError,
+    NetworkError,
+    CompressionError,
+    CipherError,       // Шифр данных не согласован или пакеты не расшифровываются
+    FragmentError,     // fragment включен только у одной стороны
+    PathMtuError,      // EMSGSIZE: пакет больше MTU пути
+    RouteError,
+    FatalExit,
+    Exiting,
+    SoftRestart,       // SIGUSR1/SIGHUP
+    Warning
+};
+
+// Классификатор строк лога OpenVPN.
+// Таблица шаблонов компилируется один раз в автомат Ахо–Корасик над байтами
+// (без учета регистра ASCII), строка классифицируется за один проход.
+// Если совпало несколько шаблонов, побеждает стоящий выше в таблице.
+class LogClassifier {
+public:
+    static const LogClassifier& instance();
+
+    LogEvent classify(const char* data, int size) const;
+    LogEvent classify(const QByteArray& line) const { return classify(line.constData(), line.size()); }
+
+private:
+    LogClassifier();
+
+    int classCount;                  // Размер алфавита после сжатия
+    unsigned char byteClass[256];    // Байт -> класс (0 — не встречается в шаблонах)
+    QVector<int> transitions;        // Полный автомат: state * classCount + class
+    QVector<int> bestMatch;          // Индекс лучшего шаблона, оканчивающегося в состоянии (-1 — нет)
+    QVector<LogEvent> patternEvents;
+
+    LogClassifier(const LogClassifier&) = delete;
+    LogClassifier& operator=(const LogClassifier&) = delete;
+};
+
+#endif // LOGCLASSIFIER_H
@@ -0,0 +1,59 @@
+#include "logtail.h"
+#include <QFile>
+#include <QTimer>
+
+LogTail::LogTail(const QString& filePath, QObject *parent)
+: QObject(parent), timer(new QTimer(this)), path(filePath), offset(0) {
+    connect(timer, &QTimer::timeout, this, &LogTail::poll);
+}
+
+void LogTail::start(int intervalMs) {
+    timer->start(intervalMs);
+}
+
+bool LogTail::isActive() const {
+    return timer->isActive();
+}
+
+void LogTail::stop() {
+    if (!timer->isActive()) {
+        return;
+    }
+    timer->stop();
+    poll();
+    QByteArray rest = partial.trimmed();
+    partial.clear();
+    if (!rest.isEmpty()) {
+        emit lineRead(rest);
+    }
+}
+
+void LogTail::poll() {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;   // openvpn еще не открыл лог
+    }
+    // openvpn открывает лог с O_TRUNC: файл короче прочитанного — начат заново
+    if (file.size() < offset) {
+        offset = 0;
+        partial.clear();
+    }
+    if (file.size() == offset || !file.seek(offset)) {
+        return;
+    }
+
+    QByteArray data = file.readAll();
+    offset += data.size();
+    partial += data;
+
+    int start = 0;
+    int end;
+    while ((end = partial.indexOf('\n', start)) >= 0) {
+        QByteArray line = partial.mid(start, end - start).trimmed();
+        start = end + 1;
+        if (!line.isEmpty()) {
+            emit lineRead(line);
+        }
+    }
+    partial.remove(0, start);
+}
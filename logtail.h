@@ -0,0 +1,37 @@
+#ifndef LOGTAIL_H
+#define LOGTAIL_H
+
+#include <QObject>
+#include <QByteArray>
+
+class QTimer;
+
+// Чтение растущего лог-файла openvpn. openvpn пишет в --log, а не в pipe,
+// чтобы пережить выход приложения, — поэтому ранние ошибки (до подключения к
+// management-интерфейсу) видны только в файле. Новые полные строки приходят
+// сигналом lineRead, как вывод процесса.
+class LogTail : public QObject {
+    Q_OBJECT
+
+public:
+    explicit LogTail(const QString& path, QObject *parent = nullptr);
+
+    void start(int intervalMs = 200);
+    // Дочитывает файл до конца и останавливается
+    void stop();
+    bool isActive() const;
+
+signals:
+    void lineRead(const QByteArray& line);
+
+private slots:
+    void poll();
+
+private:
+    QTimer* timer;
+    QString path;
+    qint64 offset;
+    QByteArray partial;          // Последняя строка без перевода строки
+};
+
+#endif // LOGTAIL_H
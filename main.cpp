@@ -1,4 +1,6 @@
 #include "mainwindow.h"
+#include "openvpnbinary.h"
+#include "helperserver.h"
 #include <QApplication>
 #include <QStyleFactory>
 #include <QDir>
@@ -12,70 +14,14 @@
 bool checkDependencies() {
     qDebug() << "Проверка зависимостей...";
 
-    // Проверяем наличие openvpn
-    QProcess process;
-
-    // Пробуем разные способы найти openvpn
-    QStringList possiblePaths = {
-        "openvpn",
-        "/usr/sbin/openvpn",
-        "/usr/bin/openvpn",
-        "/sbin/openvpn",
-        "/usr/local/sbin/openvpn",
-        "/usr/local/bin/openvpn"
-    };
-
-    bool openvpnFound = false;
-    QString openvpnPath;
-
-    for (const QString& path : possiblePaths) {
-        QProcess testProcess;
-        testProcess.start(path, QStringList() << "--version");
-        testProcess.waitForFinished(1000);
-
-        if (testProcess.exitCode() == 0) {
-            openvpnFound = true;
-            openvpnPath = path;
-            qDebug() << "✅ Найден OpenVPN по пути:" << path;
-            break;
-        }
-    }
+    // Тот же поиск, что и при подключении: результат кэшируется по пути и mtime
+    OpenVpnCapabilities openvpn = OpenVpnBinary::resolve();
+    bool openvpnFound = openvpn.isValid();
 
-    // Пробуем через which
-    if (!openvpnFound) {
-        QProcess whichProcess;
-        whichProcess.start("which", QStringList() << "openvpn");
-        whichProcess.waitForFinished(1000);
-
-        if (whichProcess.exitCode() == 0) {
-            openvpnPath = QString::fromUtf8(whichProcess.readAllStandardOutput()).trimmed();
-            if (!openvpnPath.isEmpty() && QFile::exists(openvpnPath)) {
-                openvpnFound = true;
-                qDebug() << "✅ Найден OpenVPN через which:" << openvpnPath;
-            }
-        }
-    }
-
-    // Пробуем через whereis
-    if (!openvpnFound) {
-        QProcess whereisProcess;
-        whereisProcess.start("whereis", QStringList() << "-b" << "openvpn");
-        whereisProcess.waitForFinished(1000);
-
-        QString output = QString::fromUtf8(whereisProcess.readAllStandardOutput());
-        if (output.contains("openvpn:")) {
-            QStringList parts = output.split(':');
-            if (parts.size() > 1) {
-                QStringList bins = parts[1].trimmed().split(' ');
-                for (const QString& bin : bins) {
-                    if (QFile::exists(bin)) {
-                        openvpnFound = true;
-                        openvpnPath = bin;
-                        qDebug() << "✅ Найден OpenVPN через whereis:" << bin;
-                        break;
-                    }
-                }
-            }
+    if (openvpnFound) {
+        qDebug() << "✅ Найден OpenVPN" << openvpn.version << "по пути:" << openvpn.path;
+        if (!openvpn.management) {
+            qDebug() << "⚠️ OpenVPN собран без management-интерфейса";
         }
     }
 
@@ -177,6 +123,11 @@ int main(int argc, char *argv[]) {
     // Включаем логирование для отладки
     qSetMessagePattern("[%{time yyyy-MM-dd hh:mm:ss}] %{type}: %{message}");
 
+    // Режим привилегированного помощника: без GUI, запускается самим приложением через sudo
+    if (argc > 1 && QString::fromLatin1(argv[1]) == "--privileged-helper") {
+        return HelperServer::run(argc, argv);
+    }
+
     QApplication app(argc, argv);
 
     // Настройка для Wayland/X11
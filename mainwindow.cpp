@@ -2,6 +2,16 @@
 #include "ui_mainwindow.h"
 #include "serverdownloader.h"
 #include "vpnmanager.h"
+#include "tunneltester.h"
+#include "servertester.h"
+#include "probecache.h"
+#include "udpprober.h"
+#include "warmprober.h"
+#include "connecttiming.h"
+#include "serverprofiles.h"
+#include "systemcommand.h"
+#include "privilegedops.h"
+#include "privilegedhelper.h"
 
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
@@ -33,7 +43,11 @@
 #include <QPushButton>
 #include <QListWidget>
 #include <QLabel>
+#include <QTextBrowser>
+#include <QLocale>
 #include <QLinearGradient>
+#include <QtConcurrent>
+#include <QFutureWatcher>
 
 #include <QDebug>
 
@@ -47,13 +61,39 @@ MainWindow::MainWindow(QWidget *parent)
 , ui(new Ui::MainWindow)
 , downloaderThread(nullptr)
 , vpnManager(nullptr)
+, tunnelTester(nullptr)
+, warmProber(nullptr)
 , settings(nullptr)
+, probeCacheSettings(nullptr)
+, probeCache(nullptr)
+, connectTimingSettings(nullptr)
+, connectTimings(nullptr)
+, serverProfileSettings(nullptr)
+, serverProfiles(nullptr)
 , countryFilterMenu(nullptr)
 , serverContextMenu(nullptr)
 , autoReconnectEnabled(false)
 , autoRefreshEnabled(false)
 , connectionTimeout(45)
 , refreshIntervalMinutes(30)
+, parallelTunnelTests(4)
+, parallelTestLimit(50)
+, throughputTestEnabled(true)
+, latencyProbesRunning(0)
+, udpProbeRunning(false)
+, warmProbeCount(3)
+, warmProbeIntervalSec(15)
+, hotStandbyEnabled(false)
+, raceConnectEnabled(false)
+, raceWidth(3)
+, raceStaggerMs(250)
+, aggregateEnabled(false)
+, aggregateTunnels(3)
+, multiRemoteEnabled(false)
+, multiRemoteServers(3)
+, socketBufferMinKb(128)
+, socketBufferMaxKb(4096)
+, keepTunnelOnExit(false)
 , reconnectTimer(nullptr)
 , autoRefreshTimer(nullptr)
 , connectionUpdateTimer(nullptr)
@@ -65,9 +105,8 @@ MainWindow::MainWindow(QWidget *parent)
 , reconnectAttempts(0)
 , isAutoReconnecting(false)
 , autoConnectIndex(-1)
-, gatewayProcess(nullptr)
 , vpnGatewayEnabled(false)
-, gatewayInterface("tun0")
+, gatewayUplink("eth0")
 , localIPAddress("")
 , logMessageCount(0)
 , currentSortType("speed")
@@ -76,10 +115,19 @@ MainWindow::MainWindow(QWidget *parent)
         ui->setupUi(this);
 
         settings = new QSettings("VPNGateManager", "Pro", this);
+        probeCacheSettings = new QSettings("VPNGateManager", "ProbeCache", this);
+        probeCache = new ProbeCache(probeCacheSettings);
+        connectTimingSettings = new QSettings("VPNGateManager", "ConnectTiming", this);
+        connectTimings = new ConnectTimingStats(connectTimingSettings);
         vpnManager = new VpnManager(this);
+        serverProfileSettings = new QSettings("VPNGateManager", "ServerProfiles", this);
+        serverProfiles = new ServerProfiles(serverProfileSettings);
+        vpnManager->setConnectTimings(connectTimings);
+        vpnManager->setServerProfiles(serverProfiles);
+        tunnelTester = new TunnelTester(this);
+        warmProber = new WarmProber(this);
         reconnectTimer = new QTimer(this);
         autoRefreshTimer = new QTimer(this);
-        gatewayProcess = new QProcess(this);
 
         // Создаем новые таймеры
         connectionUpdateTimer = new QTimer(this);
@@ -90,7 +138,24 @@ MainWindow::MainWindow(QWidget *parent)
         loadSettings();
         loadBlockedCountries();
         initCountryFilterMenu();
-        cleanupOldProcesses();
+
+        // Помощник запускается один раз через sudo -n; пока его нет или он
+        // недоступен, привилегированные команды идут через sudo, как раньше
+        PrivilegedHelper* helper = PrivilegedHelper::instance();
+        connect(helper, &PrivilegedHelper::ready, this, [this]() {
+            addLog("🛡️ Привилегированный помощник запущен: sudo на каждую операцию больше не нужен", "SUCCESS");
+            recoverPreviousSessions();
+        });
+        connect(helper, &PrivilegedHelper::unavailable, this, [this](const QString& reason) {
+            if (!SystemCommand::isRoot()) {
+                addLog(QString("Помощник недоступен (%1), команды пойдут через sudo").arg(reason), "WARNING");
+            }
+            recoverPreviousSessions();
+        });
+        connect(helper, &PrivilegedHelper::disconnected, this, [this]() {
+            addLog("Привилегированный помощник отключился, команды пойдут через sudo", "WARNING");
+        });
+        helper->start();
 
         QTimer::singleShot(1000, this, &MainWindow::on_refreshButton_clicked);
     } catch (const std::exception& e) {
@@ -112,6 +177,11 @@ MainWindow::~MainWindow() {
 
     saveSettings();
 
+    if (probeCache) {
+        probeCache->save();
+        delete probeCache;
+    }
+
     // Останавливаем и удаляем таймеры
     if (connectionUpdateTimer) {
         connectionUpdateTimer->stop();
@@ -141,18 +211,40 @@ MainWindow::~MainWindow() {
     delete connectShortcut;
     delete disconnectShortcut;
 
-    // Останавливаем VPN Gateway если запущен
+    // Останавливаем VPN Gateway если запущен. Помощник доделает принятые
+    // команды и после нашего выхода; без него правила снимаем синхронно
     if (vpnGatewayEnabled) {
-        stopVPNGateway();
-    }
-
-    if (gatewayProcess) {
-        delete gatewayProcess;
+        if (PrivilegedHelper::instance()->isReady() || SystemCommand::isRoot()) {
+            stopVPNGateway();
+        } else {
+            QProcess cleanupProcess;
+            cleanupProcess.start("sudo", QStringList() << "-n" << "sh" << "-s");
+            cleanupProcess.write(SystemCommand::shellScript(gatewayCommands(false)));
+            cleanupProcess.closeWriteChannel();
+            cleanupProcess.waitForFinished(5000);
+        }
     }
 
     delete autoRefreshTimer;
     delete reconnectTimer;
+    if (keepTunnelOnExit) {
+        vpnManager->releaseActive();
+    }
     delete vpnManager;
+
+    // После VpnManager: закрывающиеся сессии еще записывают в профили скорость,
+    // а в хронометраж — traceFinished
+    if (serverProfiles) {
+        serverProfiles->save();
+        delete serverProfiles;
+    }
+    if (connectTimings) {
+        connectTimings->save();
+        delete connectTimings;
+    }
+    delete serverProfileSettings;
+    delete probeCacheSettings;
+    delete connectTimingSettings;
     delete settings;
     delete ui;
 }
@@ -173,7 +265,8 @@ void MainWindow::initUI() {
     ui->timeoutSpinBox->setValue(45);
     ui->timeoutSpinBox->setSuffix(" сек");
     ui->timeoutSpinBox->setEnabled(false);
-    ui->timeoutSpinBox->setToolTip("Время ожидания подключения к серверу");
+    ui->timeoutSpinBox->setToolTip("Наибольшее время ожидания подключения к серверу.\n"
+                                   "Серверам с историей подключений дается свой срок: p99 × 1.5, не меньше 10 сек");
 
     ui->autoRefreshIntervalSpinBox->setRange(5, 360);
     ui->autoRefreshIntervalSpinBox->setValue(30);
@@ -181,6 +274,16 @@ void MainWindow::initUI() {
     ui->autoRefreshIntervalSpinBox->setEnabled(false);
     ui->autoRefreshIntervalSpinBox->setToolTip("Интервал автоматического обновления списка серверов");
 
+    ui->warmProbeCountSpinBox->setRange(1, 16);
+    ui->warmProbeCountSpinBox->setValue(3);
+    ui->warmProbeCountSpinBox->setToolTip("Сколько запасных серверов фоновая проверка держит готовыми\n"
+                                          "к быстрому переключению (пока VPN подключен)");
+
+    ui->warmProbeIntervalSpinBox->setRange(5, 600);
+    ui->warmProbeIntervalSpinBox->setValue(15);
+    ui->warmProbeIntervalSpinBox->setSuffix(" сек");
+    ui->warmProbeIntervalSpinBox->setToolTip("Период фоновой проверки запасных серверов");
+
     // Настройка кнопок
     ui->connectButton->setEnabled(false);
     ui->disconnectButton->setEnabled(false);
@@ -265,6 +368,79 @@ void MainWindow::initUI() {
     connect(vpnManager, &VpnManager::connectionLog, this, &MainWindow::onVpnLog);
     connect(vpnManager, &VpnManager::connected, this, &MainWindow::onVpnConnected);
     connect(vpnManager, &VpnManager::disconnected, this, &MainWindow::onVpnDisconnected);
+    connect(vpnManager, &VpnManager::connectionStateChanged, this, [this](VpnState state) {
+        updateConnectionButtons(state, ui->serverList->count());
+    });
+    connect(vpnManager, &VpnManager::connectTraceFinished, this, [this](const ConnectTrace& trace) {
+        connectTimings->record(trace);
+        connectTimings->save();
+    });
+    connect(vpnManager, &VpnManager::standbyChanged, this, [this](const QString& serverName) {
+        if (!serverName.isEmpty()) {
+            addLog(QString("🛡️ Горячий резерв готов: %1").arg(serverName), "INFO");
+        }
+    });
+    connect(vpnManager, &VpnManager::standbyFailed, this, [this](const VpnServer& server) {
+        standbyRejected.insert(server.identity());
+        addLog(QString("🛡️ Резерв %1 не удержался, выбираю другой").arg(server.name), "WARNING");
+        QTimer::singleShot(10000, this, [this]() {
+            if (hotStandbyEnabled && vpnManager->isConnected()) {
+                refreshWarmCandidates();
+            }
+        });
+    });
+    connect(vpnManager, &VpnManager::raceFinished, this, [this](const QString& winner, const QList<VpnServer>& failed) {
+        for (const VpnServer& server : failed) {
+            failedServers.insert(server.name);
+        }
+        if (!failed.isEmpty()) {
+            updateServerList();
+        }
+        if (isAutoReconnecting) {
+            // Победа — tryAutoConnect увидит Connected и завершит авто-подключение
+            QTimer::singleShot(winner.isEmpty() ? 2000 : 0, this, &MainWindow::tryAutoConnect);
+        }
+    });
+    connect(vpnManager, &VpnManager::aggregateChanged, this, [this](int tunnels) {
+        addLog(QString("🔗 Трафик идет через %1 туннелей").arg(tunnels), "INFO");
+    });
+    connect(vpnManager, &VpnManager::aggregateMemberFailed, this, [this](const VpnServer& server) {
+        aggregateRejected.insert(server.identity());
+        addLog(QString("🔗 %1 выбыл из объединения, подбираю замену").arg(server.name), "WARNING");
+        QTimer::singleShot(10000, this, [this]() {
+            if (aggregateEnabled && vpnManager->isConnected()) {
+                refreshWarmCandidates();
+            }
+        });
+    });
+    connect(vpnManager, &VpnManager::trafficUpdated, this, [this](qint64 bytesIn, qint64 bytesOut) {
+        QVariantMap info = vpnManager->getConnectionInfo();
+        if (info.isEmpty()) {
+            return;
+        }
+        QLocale locale;
+        ui->vpnInfoLabel->setText(QString("🔗 %1 | 🌍 %2 | 🌐 %3 | ⬇️ %4 ⬆️ %5")
+        .arg(info["server"].toString())
+        .arg(info["country"].toString())
+        .arg(info["ip"].toString())
+        .arg(locale.formattedDataSize(bytesIn))
+        .arg(locale.formattedDataSize(bytesOut)));
+    });
+
+    // Подключение сигналов параллельной проверки туннелей
+    if (tunnelTester) {
+        connect(tunnelTester, &TunnelTester::tunnelResult, this, &MainWindow::onTunnelTestResult);
+        connect(tunnelTester, &TunnelTester::testProgress, this, &MainWindow::onVpnLog);
+        connect(tunnelTester, &TunnelTester::finished, this, &MainWindow::onTunnelTestsFinished);
+    }
+
+    // Фоновая проверка запасных серверов
+    if (warmProber) {
+        connect(warmProber, &WarmProber::candidateProbed, this, &MainWindow::onWarmCandidateProbed);
+        connect(warmProber, &WarmProber::probeWarning, this, [this](const QString& message) {
+            addLog(QString("🔥 %1").arg(message), "WARNING");
+        });
+    }
 
     // Подключение стандартных кнопок UI (исправлено для Qt6)
     connect(ui->refreshButton, &QPushButton::clicked, this, &MainWindow::on_refreshButton_clicked);
@@ -284,6 +460,8 @@ void MainWindow::initUI() {
     connect(ui->timeoutSpinBox, QOverload<int>::of(&QSpinBox::valueChanged), this, &MainWindow::on_timeoutSpinBox_valueChanged);
     connect(ui->autoRefreshCheckbox, &QCheckBox::checkStateChanged, this, &MainWindow::on_autoRefreshCheckbox_stateChanged);
     connect(ui->autoRefreshIntervalSpinBox, QOverload<int>::of(&QSpinBox::valueChanged), this, &MainWindow::on_autoRefreshIntervalSpinBox_valueChanged);
+    connect(ui->warmProbeCountSpinBox, QOverload<int>::of(&QSpinBox::valueChanged), this, &MainWindow::on_warmProbeCountSpinBox_valueChanged);
+    connect(ui->warmProbeIntervalSpinBox, QOverload<int>::of(&QSpinBox::valueChanged), this, &MainWindow::on_warmProbeIntervalSpinBox_valueChanged);
 
     // Подключение новых кнопок
     connect(ui->resetFailedButton, &QPushButton::clicked, this, &MainWindow::on_resetFailedButton_clicked);
@@ -321,11 +499,6 @@ void MainWindow::initUI() {
         delete menu;
     });
 
-    // Подключение завершения процесса шлюза
-    if (gatewayProcess) {
-        connect(gatewayProcess, &QProcess::finished, this, &MainWindow::onGatewayProcessFinished);
-    }
-
     // Инициализация таймеров
     if (!reconnectTimer) {
         reconnectTimer = new QTimer(this);
@@ -491,6 +664,7 @@ void MainWindow::on_timeoutSpinBox_valueChanged(int value) {
     connectionTimeout = value;
 
     vpnManager->setConnectionTimeout(connectionTimeout);
+    tunnelTester->setHandshakeTimeout(connectionTimeout);
 
     addLog(QString("Таймаут подключения установлен: %1 секунд").arg(connectionTimeout), "INFO");
     saveSettings();
@@ -524,6 +698,27 @@ void MainWindow::on_autoRefreshIntervalSpinBox_valueChanged(int value) {
     saveSettings();
 }
 
+void MainWindow::on_warmProbeCountSpinBox_valueChanged(int value) {
+    warmProbeCount = value;
+    warmProber->setCount(warmProbeCount);
+
+    // Новый набор кандидатов — сразу, а не с очередным обновлением списка
+    if (vpnManager->isConnected()) {
+        refreshWarmCandidates();
+    }
+
+    addLog(QString("Фоновая проверка: %1 запасных серверов").arg(warmProbeCount), "INFO");
+    saveSettings();
+}
+
+void MainWindow::on_warmProbeIntervalSpinBox_valueChanged(int value) {
+    warmProbeIntervalSec = value;
+    warmProber->setIntervalSec(warmProbeIntervalSec);
+
+    addLog(QString("Фоновая проверка запасных серверов каждые %1 сек").arg(warmProbeIntervalSec), "INFO");
+    saveSettings();
+}
+
 void MainWindow::on_exportConfigButton_clicked() {
     int row = ui->serverList->currentRow();
     if (row < 0 || row >= servers.size()) {
@@ -558,18 +753,6 @@ void MainWindow::on_gatewayStopButton_clicked() {
     stopVPNGateway();
 }
 
-void MainWindow::onGatewayProcessFinished(int exitCode, QProcess::ExitStatus exitStatus) {
-    Q_UNUSED(exitStatus);
-
-    if (exitCode != 0) {
-        addLog(QString("VPN Gateway завершился с ошибкой (код: %1)").arg(exitCode), "ERROR");
-        vpnGatewayEnabled = false;
-        ui->gatewayStartButton->setEnabled(true);
-        ui->gatewayStopButton->setEnabled(false);
-        ui->gatewayStatusLabel->setText("Статус: Ошибка");
-    }
-}
-
 void MainWindow::onDownloadError(const QString& error) {
     addLog(error, "ERROR");
     ui->testLogArea->append(QString("\n❌ Ошибка: %1").arg(error));
@@ -642,9 +825,7 @@ void MainWindow::startAutoReconnect() {
 void MainWindow::checkConnectionAndReconnect() {
     if (!autoReconnectEnabled || isAutoReconnecting) return;
 
-    auto status = vpnManager->getStatus();
-
-    if (status.first == "disconnected" &&
+    if (vpnManager->isIdle() &&
         ui->disconnectButton->isEnabled() == false) {
 
         addLog("Обнаружен обрыв соединения, запускаю авто-подключение...", "WARNING");
@@ -658,17 +839,17 @@ void MainWindow::tryAutoConnect() {
         return;
     }
 
-    auto status = vpnManager->getStatus();
-    addLog(QString("Текущий статус VPN: %1 - %2").arg(status.first).arg(status.second), "DEBUG");
+    VpnState state = vpnManager->state();
+    addLog(QString("Текущий статус VPN: %1").arg(VpnManager::stateName(state)), "DEBUG");
 
-    if (status.first == "connecting") {
+    if (state == VpnState::Spawning || state == VpnState::Handshaking || state == VpnState::Draining) {
         addLog("Уже идет подключение, жду 5 секунд...", "INFO");
         QTimer::singleShot(5000, this, &MainWindow::tryAutoConnect);
         return;
     }
 
-    if (status.first == "connected") {
-        addLog(QString("✅ Успешное авто-подключение к %1").arg(status.second), "SUCCESS");
+    if (state == VpnState::Connected) {
+        addLog(QString("✅ Успешное авто-подключение к %1").arg(vpnManager->serverName()), "SUCCESS");
 
         isAutoReconnecting = false;
         reconnectAttempts = 0;
@@ -702,12 +883,36 @@ void MainWindow::tryAutoConnect() {
         return;
     }
 
-    if (autoConnectIndex < 0 || autoConnectIndex >= servers.size()) {
+    if (raceConnectEnabled && startRaceConnect()) {
+        return;
+    }
+
+    VpnServer selectedServer;
+    bool found = false;
+    int attempts = 0;
+    int startIndex = autoConnectIndex;
+
+    // Сначала — запасной сервер, ответивший фоновой проверке несколько секунд назад
+    for (const VpnServer& candidate : servers) {
+        if (failedServers.contains(candidate.name) || blockedCountries.contains(candidate.country)) {
+            continue;
+        }
+        if (warmProber->isWarm(candidate.identity(), warmProber->freshnessMs())) {
+            selectedServer = candidate;
+            found = true;
+            addLog(QString("🔥 Выбран проверенный в фоне сервер: %1 (%2)")
+            .arg(candidate.name)
+            .arg(candidate.country), "INFO");
+            break;
+        }
+    }
+
+    if (!found && (autoConnectIndex < 0 || autoConnectIndex >= servers.size())) {
         autoConnectIndex = servers.size() - 1;
         addLog(QString("Начинаю авто-подключение с конца списка (индекс: %1)").arg(autoConnectIndex), "INFO");
     }
 
-    if (autoConnectIndex < 0) {
+    if (!found && autoConnectIndex < 0) {
         addLog("❌ Все серверы в списке помечены как недоступные", "ERROR");
 
         isAutoReconnecting = false;
@@ -726,12 +931,7 @@ void MainWindow::tryAutoConnect() {
         return;
     }
 
-    VpnServer selectedServer;
-    bool found = false;
-    int attempts = 0;
-    int startIndex = autoConnectIndex;
-
-    while (autoConnectIndex >= 0 && attempts < servers.size()) {
+    while (!found && autoConnectIndex >= 0 && attempts < servers.size()) {
         VpnServer candidate = servers[autoConnectIndex];
 
         if (!failedServers.contains(candidate.name)) {
@@ -795,27 +995,26 @@ void MainWindow::tryAutoConnect() {
     }
 
     QTimer::singleShot(2000, this, [this, selectedServer, startIndex]() {
-        auto currentStatus = vpnManager->getStatus();
-        if (currentStatus.first == "connecting" || currentStatus.first == "connected") {
+        if (!vpnManager->isIdle()) {
             addLog("Уже идет подключение или подключено, отменяю...", "INFO");
             return;
         }
 
         vpnManager->connectToServer(selectedServer);
 
-        int checkTimeout = (connectionTimeout + 20) * 1000;
+        // Срок — по истории подключений к серверу, а не общий таймаут:
+        // явно мертвый сервер отбрасывается сразу после своего окна
+        int waitSeconds = (multiRemoteEnabled ? connectionTimeout : vpnManager->connectDeadline(selectedServer)) + 5;
 
-        QTimer::singleShot(checkTimeout, this, [this, selectedServer, startIndex]() {
+        QTimer::singleShot(waitSeconds * 1000, this, [this, selectedServer, startIndex, waitSeconds]() {
             if (!isAutoReconnecting) {
                 return;
             }
 
-            auto currentStatus = vpnManager->getStatus();
-
-            if (currentStatus.first != "connected") {
+            if (!vpnManager->isConnected()) {
                 addLog(QString("❌ Не удалось подключиться к %1 за %2 секунд")
                 .arg(selectedServer.name)
-                .arg(connectionTimeout + 20), "WARNING");
+                .arg(waitSeconds), "WARNING");
 
                 failedServers.insert(selectedServer.name);
                 updateServerList();
@@ -842,8 +1041,7 @@ void MainWindow::tryAutoConnect() {
                 return;
             }
 
-            auto currentStatus = vpnManager->getStatus();
-            if (currentStatus.first == "connected") {
+            if (vpnManager->isConnected()) {
                 addLog(QString("✅ Стабильное подключение к %1 (60+ секунд)")
                 .arg(selectedServer.name), "SUCCESS");
                 isAutoReconnecting = false;
@@ -856,8 +1054,18 @@ void MainWindow::tryAutoConnect() {
 
 void MainWindow::onServersDownloaded(const QList<VpnServer>& downloadedServers) {
     QList<VpnServer> filteredServers;
+    int restoredFromCache = 0;
+
+    for (VpnServer server : downloadedServers) {
+        // Свежие результаты проверок переживают обновление списка и перезапуск
+        probeCache->applyTo(server);
+        if (server.tested) {
+            restoredFromCache++;
+        }
+        if (server.realConnectionTested && !server.available) {
+            failedServers.insert(server.name);
+        }
 
-    for (const VpnServer& server : downloadedServers) {
         if (blockedCountries.contains(server.country)) {
             addLog(QString("Пропущен сервер %1: страна %2 заблокирована")
             .arg(server.name).arg(server.country), "DEBUG");
@@ -873,12 +1081,19 @@ void MainWindow::onServersDownloaded(const QList<VpnServer>& downloadedServers)
 
     this->servers = filteredServers;
 
+    if (restoredFromCache > 0) {
+        addLog(QString("♻️ Из кэша проверок восстановлено %1 серверов").arg(restoredFromCache), "INFO");
+    }
+
     std::sort(this->servers.begin(), this->servers.end(),
               [](const VpnServer& a, const VpnServer& b) {
-                  return a.speedMbps > b.speedMbps;
+                  return a.effectiveSpeedMbps() > b.effectiveSpeedMbps();
               });
 
+    // Конфиги серверов могли смениться вместе с каталогом
+    vpnManager->invalidateConfigs();
     updateServerList();
+    refreshWarmCandidates();
 
     QSet<QString> countries;
     for (const VpnServer& s : filteredServers) {
@@ -971,7 +1186,8 @@ void MainWindow::onVpnLog(const QString& message) {
 }
 
 void MainWindow::onVpnConnected(const QString& serverName) {
-    ui->connectButton->setEnabled(false);
+    // При активном подключении кнопка переключает на выбранный сервер без разрыва
+    ui->connectButton->setEnabled(true);
     ui->disconnectButton->setEnabled(true);
     ui->vpnStatusFrame->setVisible(true);
 
@@ -1025,6 +1241,11 @@ void MainWindow::onVpnConnected(const QString& serverName) {
         ui->gatewayStatusLabel->setText("Статус: VPN подключен + Gateway активен");
     }
 
+    refreshWarmCandidates();
+    warmProber->start();
+    addLog(QString("🔥 Фоновая проверка %1 запасных серверов каждые %2 сек")
+    .arg(warmProber->count()).arg(warmProber->intervalSec()), "INFO");
+
     updateServerList();
 }
 
@@ -1033,6 +1254,11 @@ void MainWindow::onVpnDisconnected() {
     ui->disconnectButton->setEnabled(false);
     ui->vpnInfoLabel->setText("");
 
+    // Результаты последних проверок остаются в силе для выбора сервера при переподключении
+    warmProber->stop();
+    standbyRejected.clear();
+    aggregateRejected.clear();
+
     if (isAutoReconnecting && !currentAutoConnectServer.isEmpty()) {
         addLog(QString("❌ Авто-подключение к %1 разорвано")
         .arg(currentAutoConnectServer), "WARNING");
@@ -1070,8 +1296,8 @@ void MainWindow::updateStats() {
 void MainWindow::updateServerList() {
     ui->serverList->clear();
 
-    auto status = vpnManager->getStatus();
-    QString currentVpnServer = status.first == "connected" ? status.second : QString();
+    VpnState state = vpnManager->state();
+    QString currentVpnServer = state == VpnState::Connected ? vpnManager->serverName() : QString();
 
     int totalDisplayed = 0;
     int failedCount = 0;
@@ -1179,6 +1405,35 @@ void MainWindow::updateServerList() {
             }
         }
 
+        LatencyStats latencyStats = server.latency.stats();
+        if (latencyStats.isValid()) {
+            if (latencyStats.p50Ms >= 0.0) {
+                tooltip += QString("\n📶 RTT: мин %1 / p50 %2 / p95 %3 ms, джиттер %4 ms")
+                .arg(latencyStats.minMs, 0, 'f', 1)
+                .arg(latencyStats.p50Ms, 0, 'f', 1)
+                .arg(latencyStats.p95Ms, 0, 'f', 1)
+                .arg(latencyStats.jitterMs, 0, 'f', 1);
+            }
+            tooltip += QString("\n📉 Потери: %1% (%2 проб)")
+            .arg(latencyStats.lossRate * 100.0, 0, 'f', 0)
+            .arg(latencyStats.samples);
+        }
+
+        if (server.realConnectionTested && server.handshakeMs >= 0) {
+            tooltip += QString("\n🧪 Туннель проверен: %1 ms").arg(server.handshakeMs);
+        }
+
+        if (server.estimatedMbps > 0.0) {
+            tooltip += QString("\n📐 Оценка по серии пакетов: ~%1 Mbps")
+            .arg(server.estimatedMbps, 0, 'f', 1);
+        }
+
+        if (server.measuredMbps > 0.0) {
+            tooltip += QString("\n📏 Измерено через туннель: %1 Mbps (TTFB %2 ms)")
+            .arg(server.measuredMbps, 0, 'f', 1)
+            .arg(server.ttfbMs);
+        }
+
         if (isAutoConnecting) {
             tooltip += QString("\n\n🔄 Авто-подключение: попытка #%1")
             .arg(reconnectAttempts + 1);
@@ -1235,7 +1490,7 @@ void MainWindow::updateServerList() {
     ui->infoText->clear();
 
     updateStatusLabel(totalDisplayed, totalServers, failedCount, blockedCountryCount);
-    updateConnectionButtons(status.first, totalDisplayed);
+    updateConnectionButtons(state, totalDisplayed);
     showEmptyListMessage(totalDisplayed, totalServers, failedCount, blockedCountryCount);
     updateCountryStats();
 }
@@ -1253,8 +1508,8 @@ void MainWindow::updateStatusLabel(int displayed, int total, int failed, int blo
         statsParts << QString("🚫 %1").arg(blocked);
     }
 
-    auto status = vpnManager->getStatus();
-    if (status.first == "connected") {
+    VpnState state = vpnManager->state();
+    if (state == VpnState::Connected) {
         QString timeStr = "";
         if (connectionTimer.isValid()) {
             int seconds = connectionTimer.elapsed() / 1000;
@@ -1262,9 +1517,9 @@ void MainWindow::updateStatusLabel(int displayed, int total, int failed, int blo
             seconds %= 60;
             timeStr = QString(" (%1:%2)").arg(minutes, 2, 10, QChar('0')).arg(seconds, 2, 10, QChar('0'));
         }
-        statsParts << QString("🔗 %1%2").arg(status.second).arg(timeStr);
-    } else if (status.first == "connecting") {
-        statsParts << "🔄 Подключение...";
+        statsParts << QString("🔗 %1%2").arg(vpnManager->serverName()).arg(timeStr);
+    } else if (state != VpnState::Idle) {
+        statsParts << QString("🔄 %1").arg(VpnManager::stateName(state));
     }
 
     if (isAutoReconnecting) {
@@ -1274,14 +1529,14 @@ void MainWindow::updateStatusLabel(int displayed, int total, int failed, int blo
     ui->statsLabel->setText(QString("Статус: %1").arg(statsParts.join(" | ")));
 }
 
-void MainWindow::updateConnectionButtons(const QString& status, int displayed) {
-    if (status == "connected") {
-        ui->connectButton->setEnabled(false);
+void MainWindow::updateConnectionButtons(VpnState state, int displayed) {
+    if (state == VpnState::Connected) {
+        ui->connectButton->setEnabled(displayed > 0 && !vpnManager->isSwitching());
         ui->disconnectButton->setEnabled(true);
-    } else if (status == "disconnected" && displayed > 0) {
+    } else if (state == VpnState::Idle && displayed > 0) {
         ui->connectButton->setEnabled(true);
         ui->disconnectButton->setEnabled(false);
-    } else if (status == "connecting") {
+    } else if (state == VpnState::Spawning || state == VpnState::Handshaking) {
         ui->connectButton->setEnabled(false);
         ui->disconnectButton->setEnabled(true);
     } else {
@@ -1364,8 +1619,7 @@ void MainWindow::updateSelection() {
         .arg(server.sessions)
         .arg(server.uptime);
 
-        auto status = vpnManager->getStatus();
-        if (status.first == "connected" && server.name == status.second) {
+        if (vpnManager->isConnected() && server.name == vpnManager->serverName()) {
             infoText += "<div style='margin-top: 10px; padding: 8px; background-color: #d4edda; border: 1px solid #c3e6cb; border-radius: 4px;'>"
             "✅ <span class='connected'>Подключен к этому серверу</span>"
             "</div>";
@@ -1373,7 +1627,7 @@ void MainWindow::updateSelection() {
 
         ui->infoText->setHtml(infoText);
 
-        if (status.first == "disconnected") {
+        if (vpnManager->isIdle() || (vpnManager->isConnected() && !vpnManager->isSwitching())) {
             ui->connectButton->setEnabled(true);
         }
     } else {
@@ -1384,16 +1638,12 @@ void MainWindow::updateSelection() {
     }
 }
 
-void MainWindow::cleanupOldProcesses() {
-    QProcess process;
-    #ifdef Q_OS_LINUX
-    process.start("sudo", QStringList() << "pkill" << "-f" << "openvpn.*tun999");
-    process.waitForFinished(1000);
-    process.start("sudo", QStringList() << "pkill" << "-f" << "openvpn.*vpngate");
-    process.waitForFinished(1000);
-    process.start("sudo", QStringList() << "pkill" << "-9" << "-f" << "openvpn");
-    process.waitForFinished(1000);
-    #endif
+void MainWindow::recoverPreviousSessions() {
+    // Вместо pkill всех openvpn — только свои процессы по журналу сессий:
+    // живой туннель прошлого запуска подхватывается, брошенные завершаются
+    if (vpnManager->recoverSessions()) {
+        addLog("♻️ Подхватываю туннель, оставшийся от прошлого запуска", "INFO");
+    }
 }
 
 void MainWindow::addLog(const QString& message, const QString& level) {
@@ -1493,6 +1743,26 @@ void MainWindow::saveSettings() {
     settings->setValue("autoRefresh", autoRefreshEnabled);
     settings->setValue("refreshInterval", refreshIntervalMinutes);
     settings->setValue("lastConnectedServer", lastConnectedServerName);
+    settings->setValue("parallelTunnelTests", parallelTunnelTests);
+    settings->setValue("parallelTestLimit", parallelTestLimit);
+    settings->setValue("throughputTestEnabled", throughputTestEnabled);
+    settings->setValue("throughputUrl", throughputEndpoint.url.toString());
+    settings->setValue("throughputBytes", throughputEndpoint.byteBudget);
+    settings->setValue("throughputSeconds", throughputEndpoint.timeBudgetMs / 1000);
+    settings->setValue("throughputStreams", throughputEndpoint.streams);
+    settings->setValue("warmProbeCount", warmProbeCount);
+    settings->setValue("warmProbeIntervalSec", warmProbeIntervalSec);
+    settings->setValue("hotStandby", hotStandbyEnabled);
+    settings->setValue("raceConnect", raceConnectEnabled);
+    settings->setValue("raceWidth", raceWidth);
+    settings->setValue("raceStaggerMs", raceStaggerMs);
+    settings->setValue("aggregateEnabled", aggregateEnabled);
+    settings->setValue("aggregateTunnels", aggregateTunnels);
+    settings->setValue("multiRemote", multiRemoteEnabled);
+    settings->setValue("multiRemoteServers", multiRemoteServers);
+    settings->setValue("socketBufferMinKb", socketBufferMinKb);
+    settings->setValue("socketBufferMaxKb", socketBufferMaxKb);
+    settings->setValue("keepTunnelOnExit", keepTunnelOnExit);
     settings->sync();
 }
 
@@ -1502,6 +1772,35 @@ void MainWindow::loadSettings() {
     autoRefreshEnabled = settings->value("autoRefresh", false).toBool();
     refreshIntervalMinutes = settings->value("refreshInterval", 30).toInt();
     lastConnectedServerName = settings->value("lastConnectedServer", "").toString();
+    parallelTunnelTests = settings->value("parallelTunnelTests", 4).toInt();
+    parallelTestLimit = settings->value("parallelTestLimit", 50).toInt();
+
+    ThroughputEndpoint defaults;
+    throughputTestEnabled = settings->value("throughputTestEnabled", true).toBool();
+    throughputEndpoint.url = QUrl(settings->value("throughputUrl", defaults.url.toString()).toString());
+    // Прежнее значение по умолчанию было по plain HTTP — переводим на HTTPS,
+    // а адрес с чужой схемой curl все равно не скачает
+    if (throughputEndpoint.url.toString() == "http://speed.cloudflare.com/__down?bytes={bytes}" ||
+        !throughputEndpoint.url.isValid() ||
+        (throughputEndpoint.url.scheme() != "https" && throughputEndpoint.url.scheme() != "http")) {
+        throughputEndpoint.url = defaults.url;
+    }
+    throughputEndpoint.byteBudget = settings->value("throughputBytes", defaults.byteBudget).toLongLong();
+    throughputEndpoint.timeBudgetMs = settings->value("throughputSeconds", defaults.timeBudgetMs / 1000).toInt() * 1000;
+    throughputEndpoint.streams = settings->value("throughputStreams", defaults.streams).toInt();
+    warmProbeCount = qBound(1, settings->value("warmProbeCount", 3).toInt(), 16);
+    warmProbeIntervalSec = qBound(5, settings->value("warmProbeIntervalSec", 15).toInt(), 600);
+    hotStandbyEnabled = settings->value("hotStandby", false).toBool();
+    raceConnectEnabled = settings->value("raceConnect", false).toBool();
+    raceWidth = qBound(1, settings->value("raceWidth", 3).toInt(), 8);
+    raceStaggerMs = qBound(50, settings->value("raceStaggerMs", 250).toInt(), 5000);
+    aggregateEnabled = settings->value("aggregateEnabled", false).toBool();
+    aggregateTunnels = qBound(2, settings->value("aggregateTunnels", 3).toInt(), 8);
+    multiRemoteEnabled = settings->value("multiRemote", false).toBool();
+    multiRemoteServers = qBound(2, settings->value("multiRemoteServers", 3).toInt(), 8);
+    socketBufferMinKb = qBound(16, settings->value("socketBufferMinKb", 128).toInt(), 65536);
+    socketBufferMaxKb = qBound(socketBufferMinKb, settings->value("socketBufferMaxKb", 4096).toInt(), 65536);
+    keepTunnelOnExit = settings->value("keepTunnelOnExit", false).toBool();
 
     ui->autoReconnectCheckbox->setChecked(autoReconnectEnabled);
     ui->timeoutSpinBox->setValue(connectionTimeout);
@@ -1511,7 +1810,18 @@ void MainWindow::loadSettings() {
     ui->autoRefreshIntervalSpinBox->setValue(refreshIntervalMinutes);
     ui->autoRefreshIntervalSpinBox->setEnabled(autoRefreshEnabled);
 
+    ui->warmProbeCountSpinBox->setValue(warmProbeCount);
+    ui->warmProbeIntervalSpinBox->setValue(warmProbeIntervalSec);
+
     vpnManager->setConnectionTimeout(connectionTimeout);
+    tunnelTester->setHandshakeTimeout(connectionTimeout);
+    vpnManager->setMultiRemote(multiRemoteEnabled ? multiRemoteServers : 1);
+    vpnManager->setSocketBufferBounds(socketBufferMinKb * 1024, socketBufferMaxKb * 1024);
+    tunnelTester->setParallelism(parallelTunnelTests);
+    tunnelTester->setThroughputEnabled(throughputTestEnabled);
+    tunnelTester->setThroughputEndpoint(throughputEndpoint);
+    warmProber->setCount(warmProbeCount);
+    warmProber->setIntervalSec(warmProbeIntervalSec);
 
     if (autoReconnectEnabled) {
         reconnectTimer->start(15000);
@@ -2220,8 +2530,7 @@ void MainWindow::startVPNGateway() {
 
     addLog("🚀 Запуск VPN Gateway...", "INFO");
 
-    auto status = vpnManager->getStatus();
-    if (status.first != "connected") {
+    if (!vpnManager->isConnected()) {
         addLog("Нет активного VPN подключения", "ERROR");
         return;
     }
@@ -2243,32 +2552,21 @@ void MainWindow::startVPNGateway() {
         addLog(QString("Используем интерфейс по умолчанию: %1").arg(defaultInterface), "WARNING");
     }
 
-    QString script = QString(
-        "#!/bin/bash\n"
-        "# Включаем IP forwarding\n"
-        "echo 1 > /proc/sys/net/ipv4/ip_forward\n"
-        "echo 1 > /proc/sys/net/ipv6/conf/all/forwarding\n"
-        "\n"
-        "# Настраиваем iptables для NAT\n"
-        "iptables -t nat -A POSTROUTING -o %1 -j MASQUERADE\n"
-        "iptables -A FORWARD -i %1 -o %2 -m state --state RELATED,ESTABLISHED -j ACCEPT\n"
-        "iptables -A FORWARD -i %2 -o %1 -j ACCEPT\n"
-        "\n"
-        "echo 'Настройка завершена. Подключите устройства к сети.'\n"
-    ).arg(gatewayInterface).arg(defaultInterface);
-
-    QString scriptPath = QDir::tempPath() + "/vpngateway_setup.sh";
-    QFile scriptFile(scriptPath);
-    if (scriptFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        QTextStream stream(&scriptFile);
-        stream << script;
-        scriptFile.close();
-        scriptFile.setPermissions(QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner);
-    }
-
-    gatewayProcess->start("sudo", QStringList() << "bash" << scriptPath);
-
-    if (gatewayProcess->waitForStarted(3000)) {
+    gatewayUplink = defaultInterface;
+    ui->gatewayStartButton->setEnabled(false);
+    ui->gatewayStatusLabel->setText("Статус: Запуск...");
+
+    // Без временного скрипта и bash: те же команды одним запросом к помощнику
+    SystemCommand::runPrivileged(gatewayCommands(true), this,
+                                 [this, defaultInterface](bool ok, const QString& output) {
+        if (!ok) {
+            addLog(QString("❌ Не удалось запустить VPN Gateway: %1").arg(output), "ERROR");
+            ui->gatewayStartButton->setEnabled(true);
+            ui->gatewayStopButton->setEnabled(false);
+            ui->gatewayStatusLabel->setText("Статус: Ошибка");
+            return;
+        }
+
         vpnGatewayEnabled = true;
         ui->gatewayStartButton->setEnabled(false);
         ui->gatewayStopButton->setEnabled(true);
@@ -2285,9 +2583,20 @@ void MainWindow::startVPNGateway() {
                                  "• Шлюз по умолчанию: тот же IP\n"
                                  "• DNS: 8.8.8.8 или используйте системные\n\n"
                                  "Для остановки нажмите 'Остановить шлюз'");
-    } else {
-        addLog("❌ Не удалось запустить VPN Gateway", "ERROR");
-    }
+    });
+}
+
+QList<QJsonObject> MainWindow::gatewayCommands(bool enable) const {
+    // Правила NAT на tun+ собирает PrivilegedOps: они верны для любого туннеля
+    QList<QJsonObject> nat;
+    nat << PrivilegedOps::gatewayRules(enable, gatewayUplink);
+
+    QList<QJsonObject> forwarding;
+    forwarding << PrivilegedOps::sysctl("net.ipv4.ip_forward", enable)
+               << PrivilegedOps::sysctl("net.ipv6.conf.all.forwarding", enable);
+
+    // Включаем forwarding до правил, выключаем — после их снятия
+    return enable ? forwarding + nat : nat + forwarding;
 }
 
 void MainWindow::stopVPNGateway() {
@@ -2298,32 +2607,12 @@ void MainWindow::stopVPNGateway() {
 
     addLog("🛑 Остановка VPN Gateway...", "INFO");
 
-    QString cleanupScript = QString(
-        "#!/bin/bash\n"
-        "# Очищаем iptables правила\n"
-        "iptables -t nat -D POSTROUTING -o %1 -j MASQUERADE 2>/dev/null\n"
-        "iptables -D FORWARD -i eth0 -o %1 -m state --state RELATED,ESTABLISHED -j ACCEPT 2>/dev/null\n"
-        "iptables -D FORWARD -i %1 -o eth0 -j ACCEPT 2>/dev/null\n"
-        "\n"
-        "# Выключаем IP forwarding\n"
-        "echo 0 > /proc/sys/net/ipv4/ip_forward\n"
-        "echo 0 > /proc/sys/net/ipv6/conf/all/forwarding\n"
-        "\n"
-        "echo 'VPN Gateway остановлен'\n"
-    ).arg(gatewayInterface);
-
-    QString scriptPath = QDir::tempPath() + "/vpngateway_cleanup.sh";
-    QFile scriptFile(scriptPath);
-    if (scriptFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        QTextStream stream(&scriptFile);
-        stream << cleanupScript;
-        scriptFile.close();
-        scriptFile.setPermissions(QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner);
-    }
-
-    QProcess cleanupProcess;
-    cleanupProcess.start("sudo", QStringList() << "bash" << scriptPath);
-    cleanupProcess.waitForFinished(5000);
+    // Правила снимаются с тем же внешним интерфейсом, с которым были добавлены
+    SystemCommand::runPrivileged(gatewayCommands(false), this, [this](bool ok, const QString& output) {
+        if (!ok) {
+            addLog(QString("Часть правил VPN Gateway не снята: %1").arg(output), "WARNING");
+        }
+    });
 
     vpnGatewayEnabled = false;
     ui->gatewayStartButton->setEnabled(true);
@@ -2332,8 +2621,6 @@ void MainWindow::stopVPNGateway() {
     ui->gatewayInfoLabel->setText("IP: Не настроен");
 
     addLog("✅ VPN Gateway остановлен", "SUCCESS");
-
-    QFile::remove(scriptPath);
 }
 
 bool MainWindow::isVPNGatewayRunning() const {
@@ -2363,7 +2650,49 @@ void MainWindow::onServerListContextMenu(const QPoint& pos) {
 
     QAction* toggleCountryAction = new QAction(countryActionText, &menu);
 
+    bool testsRunning = tunnelTester && tunnelTester->isRunning();
+    QAction* parallelTestAction = new QAction(testsRunning ?
+    QString("⏹️ Остановить параллельную проверку") :
+    QString("🧪 Проверить туннели параллельно (%1 одновременно)").arg(parallelTunnelTests), &menu);
+
+    QAction* latencyProbeAction = new QAction("📶 Измерить задержку и потери", &menu);
+    latencyProbeAction->setEnabled(latencyProbeQueue.isEmpty() && latencyProbesRunning == 0);
+
+    QAction* udpProbeAction = new QAction("📡 Пакетная UDP-проверка серверов", &menu);
+    udpProbeAction->setEnabled(!udpProbeRunning);
+
+    QAction* timingStatsAction = new QAction("⏱️ Время подключения по фазам", &menu);
+
+    QAction* hotStandbyAction = new QAction("🛡️ Горячий резерв (второй туннель)", &menu);
+    hotStandbyAction->setCheckable(true);
+    hotStandbyAction->setChecked(hotStandbyEnabled);
+
+    QAction* raceConnectAction = new QAction(QString("🏁 Авто-подключение гонкой (%1 сервера)").arg(raceWidth), &menu);
+    raceConnectAction->setCheckable(true);
+    raceConnectAction->setChecked(raceConnectEnabled);
+
+    QAction* aggregateAction = new QAction(QString("🔗 Объединение туннелей (%1)").arg(aggregateTunnels), &menu);
+    aggregateAction->setCheckable(true);
+    aggregateAction->setChecked(aggregateEnabled);
+
+    QAction* keepTunnelAction = new QAction("🔓 Не закрывать туннель при выходе", &menu);
+    keepTunnelAction->setCheckable(true);
+    keepTunnelAction->setChecked(keepTunnelOnExit);
+
+    QAction* multiRemoteAction = new QAction(QString("🔁 Запасные серверы в одном процессе (%1)").arg(multiRemoteServers), &menu);
+    multiRemoteAction->setCheckable(true);
+    multiRemoteAction->setChecked(multiRemoteEnabled);
+
     menu.addAction(connectAction);
+    menu.addAction(parallelTestAction);
+    menu.addAction(latencyProbeAction);
+    menu.addAction(udpProbeAction);
+    menu.addAction(timingStatsAction);
+    menu.addAction(hotStandbyAction);
+    menu.addAction(raceConnectAction);
+    menu.addAction(aggregateAction);
+    menu.addAction(multiRemoteAction);
+    menu.addAction(keepTunnelAction);
     menu.addSeparator();
     menu.addAction(copyIPAction);
     menu.addAction(copyConfigAction);
@@ -2377,6 +2706,62 @@ void MainWindow::onServerListContextMenu(const QPoint& pos) {
         on_connectButton_clicked();
     });
 
+    connect(parallelTestAction, &QAction::triggered, [this, testsRunning]() {
+        if (testsRunning) {
+            tunnelTester->cancel();
+        } else {
+            startParallelTunnelTests();
+        }
+    });
+
+    connect(latencyProbeAction, &QAction::triggered, [this]() {
+        startLatencyProbes();
+    });
+
+    connect(udpProbeAction, &QAction::triggered, [this]() {
+        startUdpHandshakeProbes();
+    });
+
+    connect(timingStatsAction, &QAction::triggered, [this, server]() {
+        showConnectTimingStats(server);
+    });
+
+    connect(hotStandbyAction, &QAction::toggled, [this](bool enabled) {
+        hotStandbyEnabled = enabled;
+        saveSettings();
+        addLog(enabled ? "🛡️ Горячий резерв включен" : "🛡️ Горячий резерв выключен", "INFO");
+        refreshWarmCandidates();
+    });
+
+    connect(raceConnectAction, &QAction::toggled, [this](bool enabled) {
+        raceConnectEnabled = enabled;
+        saveSettings();
+        addLog(enabled ? "🏁 Авто-подключение гонкой включено" : "🏁 Авто-подключение гонкой выключено", "INFO");
+    });
+
+    connect(aggregateAction, &QAction::toggled, [this](bool enabled) {
+        aggregateEnabled = enabled;
+        saveSettings();
+        addLog(enabled ? QString("🔗 Объединение %1 туннелей включено").arg(aggregateTunnels)
+                       : QString("🔗 Объединение туннелей выключено"), "INFO");
+        refreshWarmCandidates();
+    });
+
+    connect(keepTunnelAction, &QAction::toggled, [this](bool enabled) {
+        keepTunnelOnExit = enabled;
+        saveSettings();
+        addLog(enabled ? "🔓 Туннель будет работать после выхода и подхватится при следующем запуске"
+                       : "🔓 Туннель закрывается вместе с приложением", "INFO");
+    });
+
+    connect(multiRemoteAction, &QAction::toggled, [this](bool enabled) {
+        multiRemoteEnabled = enabled;
+        vpnManager->setMultiRemote(enabled ? multiRemoteServers : 1);
+        saveSettings();
+        addLog(enabled ? QString("🔁 В конфиг вписывается до %1 совместимых серверов").arg(multiRemoteServers)
+                       : QString("🔁 Один сервер на процесс openvpn"), "INFO");
+    });
+
     connect(toggleCountryAction, &QAction::triggered, [this, server, isCountryBlocked]() {
         if (isCountryBlocked) {
             unblockCountry(server.country);
@@ -2613,6 +2998,465 @@ void MainWindow::showServerTestDialog(const VpnServer& server) {
                              .arg(server.ping));
 }
 
+void MainWindow::startParallelTunnelTests() {
+    if (!tunnelTester || tunnelTester->isRunning()) {
+        return;
+    }
+
+    QList<VpnServer> candidates;
+    int skippedFresh = 0;
+    for (const VpnServer& server : servers) {
+        if (failedServers.contains(server.name) || blockedCountries.contains(server.country)) {
+            continue;
+        }
+        if (probeCache->isFresh(server.identity(), ProbeType::FullTunnel)) {
+            skippedFresh++;
+            continue;
+        }
+        candidates.append(server);
+    }
+
+    // Предварительный отбор: сначала серверы с лучшей оценкой по серии пакетов,
+    // не ответившие на UDP-проверку — в конец. Полная проверка дорогая
+    auto preselectionScore = [this](const VpnServer& server) {
+        ProbeEntry entry;
+        if (probeCache->lookup(server.identity(), ProbeType::Handshake, &entry) && !entry.success) {
+            return -1.0;
+        }
+        return server.estimatedMbps;
+    };
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [&preselectionScore](const VpnServer& a, const VpnServer& b) {
+                         return preselectionScore(a) > preselectionScore(b);
+                     });
+    if (candidates.size() > parallelTestLimit) {
+        candidates = candidates.mid(0, parallelTestLimit);
+    }
+
+    if (skippedFresh > 0) {
+        addLog(QString("♻️ Пропущено %1 серверов со свежим результатом проверки").arg(skippedFresh), "INFO");
+    }
+
+    if (candidates.isEmpty()) {
+        addLog("Нет серверов для параллельной проверки", "WARNING");
+        return;
+    }
+
+    addLog(QString("🧪 Запуск параллельной проверки %1 серверов (%2 одновременно)")
+    .arg(candidates.size()).arg(parallelTunnelTests), "INFO");
+    ui->tabWidget->setCurrentIndex(0);
+    tunnelTester->start(candidates);
+}
+
+void MainWindow::onTunnelTestResult(const VpnServer& server, bool success, const QString& message, int handshakeMs) {
+    probeCache->record(server.identity(), ProbeType::FullTunnel, success, handshakeMs, server.measuredMbps);
+
+    for (VpnServer& s : servers) {
+        if (s == server) {
+            s.tested = true;
+            s.realConnectionTested = true;
+            s.available = success;
+            s.handshakeMs = handshakeMs;
+            if (server.measuredMbps > 0.0) {
+                s.measuredMbps = server.measuredMbps;
+                s.ttfbMs = server.ttfbMs;
+            }
+            break;
+        }
+    }
+
+    if (success) {
+        addLog(QString("✅ Туннель к %1 поднят за %2 ms").arg(server.name).arg(handshakeMs), "SUCCESS");
+    } else {
+        failedServers.insert(server.name);
+        addLog(QString("❌ %1: %2").arg(server.name).arg(message), "WARNING");
+    }
+
+    updateServerList();
+}
+
+void MainWindow::onTunnelTestsFinished() {
+    addLog("🧪 Параллельная проверка туннелей завершена", "INFO");
+    probeCache->save();
+    updateStats();
+}
+
+void MainWindow::startLatencyProbes() {
+    if (!latencyProbeQueue.isEmpty() || latencyProbesRunning > 0) {
+        return;
+    }
+
+    for (const VpnServer& server : servers) {
+        if (failedServers.contains(server.name) || blockedCountries.contains(server.country)) {
+            continue;
+        }
+        if (probeCache->isFresh(server.identity(), ProbeType::Icmp)) {
+            continue;
+        }
+        latencyProbeQueue.enqueue(server);
+        if (latencyProbeQueue.size() >= parallelTestLimit) {
+            break;
+        }
+    }
+
+    addLog(QString("📶 Замер задержки и потерь для %1 серверов").arg(latencyProbeQueue.size()), "INFO");
+
+    // Одновременно держим не больше 8 процессов ping
+    for (int i = 0; i < 8; ++i) {
+        launchNextLatencyProbe();
+    }
+}
+
+void MainWindow::launchNextLatencyProbe() {
+    if (latencyProbeQueue.isEmpty()) {
+        if (latencyProbesRunning == 0) {
+            probeCache->save();
+            serverProfiles->save();
+            vpnManager->applyServerProfiles();   // Новые MTU пути попадут в конфиги
+            updateServerList();
+        }
+        return;
+    }
+
+    VpnServer server = latencyProbeQueue.dequeue();
+    ServerTesterThread* tester = new ServerTesterThread(server.ip, server.name, this);
+    tester->setPathMtuProbe(serverProfiles->needsPathMtuProbe(server.identity()));
+    latencyProbesRunning++;
+
+    connect(tester, &ServerTesterThread::latencySamples, this,
+            [this, server](const QList<double>& rttMs, int lost) {
+                applyLatencySamples(server, rttMs, lost);
+            });
+    connect(tester, &ServerTesterThread::pathMtuMeasured, this, [this, server](int pathMtu) {
+        serverProfiles->recordPathMtu(server, pathMtu);
+        if (pathMtu < 1500) {
+            addLog(QString("📏 %1: MTU пути %2 байт, fragment/mssfix подобраны под него")
+                   .arg(server.name).arg(pathMtu), "INFO");
+        }
+    });
+    connect(tester, &QThread::finished, this, [this, tester]() {
+        tester->deleteLater();
+        latencyProbesRunning--;
+        launchNextLatencyProbe();
+    });
+
+    tester->start();
+}
+
+void MainWindow::applyLatencySamples(const VpnServer& server, const QList<double>& rttMs, int lost,
+                                     ProbeType type, double estimatedMbps) {
+    for (VpnServer& s : servers) {
+        if (s == server) {
+            for (double rtt : rttMs) {
+                s.latency.addSample(rtt);
+            }
+            for (int i = 0; i < lost; ++i) {
+                s.latency.addLoss();
+            }
+
+            LatencyStats stats = s.latency.stats();
+            s.tested = true;
+            if (stats.p50Ms >= 0.0) {
+                s.testPing = static_cast<int>(stats.p50Ms);
+            }
+            if (estimatedMbps > 0.0) {
+                s.estimatedMbps = estimatedMbps;
+            }
+            probeCache->record(s.identity(), type, !rttMs.isEmpty(), s.testPing, estimatedMbps);
+            break;
+        }
+    }
+}
+
+// Первые кандидаты списка: для них заранее готовятся конфиги,
+// а при активном подключении они же проверяются в фоне
+void MainWindow::refreshWarmCandidates() {
+    QString currentServer = vpnManager->getConnectionInfo().value("server").toString();
+    QList<VpnServer> candidates;
+    for (const VpnServer& server : servers) {
+        if (server.name == currentServer ||
+            failedServers.contains(server.name) || blockedCountries.contains(server.country)) {
+            continue;
+        }
+        candidates.append(server);
+    }
+
+    vpnManager->prepareConfigs(candidates);
+    if (vpnManager->isConnected()) {
+        warmProber->setCandidates(candidates);
+        vpnManager->setStandbyServer(hotStandbyEnabled ? pickStandbyServer(candidates) : VpnServer());
+        vpnManager->setAggregateServers(aggregateEnabled ? pickAggregateServers(candidates) : QList<VpnServer>());
+    }
+}
+
+// Туннели объединения: сначала проверенные в фоне, без сервера резерва
+QList<VpnServer> MainWindow::pickAggregateServers(const QList<VpnServer>& candidates) const {
+    QList<VpnServer> picked;
+    QString standbyServer = vpnManager->standbyName();
+    int wanted = aggregateTunnels - 1;
+
+    for (int pass = 0; pass < 2 && picked.size() < wanted; ++pass) {
+        for (const VpnServer& server : candidates) {
+            if (picked.size() >= wanted) {
+                break;
+            }
+            if (server.name == standbyServer || aggregateRejected.contains(server.identity())) {
+                continue;
+            }
+            bool warm = warmProber->isWarm(server.identity(), warmProber->freshnessMs());
+            if ((pass == 0) != warm) {
+                continue;
+            }
+            picked.append(server);
+        }
+    }
+    return picked;
+}
+
+// Кандидаты гонки: проверенные в фоне, затем в порядке последовательного перебора.
+// false — подходящих серверов нет, решает обычный перебор
+bool MainWindow::startRaceConnect() {
+    QList<VpnServer> candidates;
+    auto eligible = [this, &candidates](const VpnServer& server) {
+        if (failedServers.contains(server.name) || blockedCountries.contains(server.country)) {
+            return false;
+        }
+        for (const VpnServer& added : candidates) {
+            if (added.identity() == server.identity()) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    for (const VpnServer& server : servers) {
+        if (candidates.size() < raceWidth && eligible(server) &&
+            warmProber->isWarm(server.identity(), warmProber->freshnessMs())) {
+            candidates.append(server);
+        }
+    }
+    for (int i = servers.size() - 1; i >= 0 && candidates.size() < raceWidth; --i) {
+        if (eligible(servers[i])) {
+            candidates.append(servers[i]);
+        }
+    }
+    if (candidates.isEmpty()) {
+        return false;
+    }
+
+    reconnectAttempts++;
+    QStringList names;
+    for (const VpnServer& server : candidates) {
+        names << server.name;
+    }
+    addLog(QString("🏁 Попытка авто-подключения #%1: гонка %2").arg(reconnectAttempts).arg(names.join(", ")), "INFO");
+
+    vpnManager->raceConnect(candidates, raceStaggerMs);
+    return true;
+}
+
+// Резерв — лучший кандидат, недавно ответивший фоновой проверке, иначе просто лучший
+VpnServer MainWindow::pickStandbyServer(const QList<VpnServer>& candidates) const {
+    const VpnServer* fallback = nullptr;
+    for (const VpnServer& server : candidates) {
+        if (standbyRejected.contains(server.identity())) {
+            continue;
+        }
+        if (warmProber->isWarm(server.identity(), warmProber->freshnessMs())) {
+            return server;
+        }
+        if (!fallback) {
+            fallback = &server;
+        }
+    }
+    return fallback ? *fallback : VpnServer();
+}
+
+void MainWindow::onWarmCandidateProbed(const QString& identity, bool replied, const QList<double>& rttMs, int lost) {
+    for (const VpnServer& server : servers) {
+        if (server.identity() == identity) {
+            applyLatencySamples(server, rttMs, lost, ProbeType::Handshake);
+            if (!replied) {
+                addLog(QString("🔥 Запасной сервер %1 не ответил на фоновую проверку").arg(server.name), "DEBUG");
+            }
+            break;
+        }
+    }
+}
+
+void MainWindow::showConnectTimingStats(const VpnServer& server) {
+    const ConnectTimingStats::ServerTimings& global = connectTimings->global();
+    ConnectTimingStats::ServerTimings own;
+    bool hasOwn = connectTimings->lookup(server.identity(), &own);
+
+    auto cell = [](const LatencyHistogram& histogram, double q) {
+        qint64 ms = histogram.percentileMs(q);
+        return ms < 0 ? QString("—") : QString("≤%1").arg(ms);
+    };
+
+    QString html = QString("<h3>⏱️ %1</h3>").arg(server.name.toHtmlEscaped());
+    html += QString("<p>Этот сервер: %1 успешных, %2 неудачных попыток<br>"
+                    "Все серверы: %3 успешных, %4 неудачных попыток</p>")
+    .arg(own.successes).arg(own.failures).arg(global.successes).arg(global.failures);
+
+    html += "<table border='1' cellspacing='0' cellpadding='4'>"
+            "<tr><th>Фаза</th><th>p50, мс</th><th>p95, мс</th><th>n</th><th>Зависаний</th>"
+            "<th>Все: p50</th><th>Все: p95</th><th>Все: n</th><th>Все: зависаний</th></tr>";
+    for (int i = 0; i < ConnectPhaseCount; ++i) {
+        const LatencyHistogram& serverPhase = own.phases[i];
+        const LatencyHistogram& globalPhase = global.phases[i];
+        html += QString("<tr><td>%1</td><td>%2</td><td>%3</td><td>%4</td><td>%5</td>"
+                        "<td>%6</td><td>%7</td><td>%8</td><td>%9</td></tr>")
+        .arg(connectPhaseName(static_cast<ConnectPhase>(i)))
+        .arg(cell(serverPhase, 0.50)).arg(cell(serverPhase, 0.95)).arg(serverPhase.count()).arg(own.stalls[i])
+        .arg(cell(globalPhase, 0.50)).arg(cell(globalPhase, 0.95)).arg(globalPhase.count()).arg(global.stalls[i]);
+    }
+    html += "</table>";
+
+    // Распределение полного времени подключения
+    const LatencyHistogram& total = (hasOwn ? own : global).phases[static_cast<int>(ConnectPhase::Total)];
+    html += QString("<h4>Полное время подключения (%1)</h4><pre>").arg(hasOwn ? "этот сервер" : "все серверы");
+    quint32 peak = 1;
+    for (int b = 0; b < LatencyHistogram::BucketCount; ++b) {
+        peak = qMax(peak, total.bucket(b));
+    }
+    for (int b = 0; b < LatencyHistogram::BucketCount; ++b) {
+        int width = static_cast<int>(40.0 * total.bucket(b) / peak);
+        html += QString("%1 %2 %3\n")
+        .arg(LatencyHistogram::bucketLabel(b), 10)
+        .arg(QString(width, QChar(0x2588)))
+        .arg(total.bucket(b));
+    }
+    html += "</pre>";
+
+    QDialog dialog(this);
+    dialog.setWindowTitle("⏱️ Время подключения по фазам");
+    dialog.setMinimumSize(760, 520);
+
+    QVBoxLayout* layout = new QVBoxLayout(&dialog);
+    QTextBrowser* browser = new QTextBrowser(&dialog);
+    browser->setHtml(html);
+    layout->addWidget(browser);
+
+    QHBoxLayout* buttons = new QHBoxLayout();
+    QPushButton* exportBtn = new QPushButton("💾 Экспорт CSV", &dialog);
+    QPushButton* closeBtn = new QPushButton("Закрыть", &dialog);
+    buttons->addWidget(exportBtn);
+    buttons->addStretch();
+    buttons->addWidget(closeBtn);
+    layout->addLayout(buttons);
+
+    connect(exportBtn, &QPushButton::clicked, &dialog, [this, &dialog]() {
+        QString fileName = QFileDialog::getSaveFileName(&dialog, "Экспорт статистики подключений",
+                                                        QDir::homePath() + "/vpngate_connect_timing.csv",
+                                                        "CSV (*.csv)");
+        if (fileName.isEmpty()) {
+            return;
+        }
+        QString error;
+        if (connectTimings->exportCsv(fileName, &error)) {
+            addLog(QString("💾 Статистика подключений сохранена: %1").arg(fileName), "SUCCESS");
+        } else {
+            QMessageBox::warning(&dialog, "Ошибка", QString("Не удалось сохранить файл: %1").arg(error));
+        }
+    });
+    connect(closeBtn, &QPushButton::clicked, &dialog, &QDialog::accept);
+
+    dialog.exec();
+}
+
+void MainWindow::startUdpHandshakeProbes() {
+    if (udpProbeRunning) {
+        return;
+    }
+
+    QList<VpnServer> probed;
+    QList<UdpProbeTarget> targets;
+    for (const VpnServer& server : servers) {
+        if (server.protocol.toLower() != "udp" ||
+            failedServers.contains(server.name) || blockedCountries.contains(server.country)) {
+            continue;
+        }
+        if (probeCache->isFresh(server.identity(), ProbeType::Handshake)) {
+            continue;
+        }
+
+        QHostAddress address(server.ip);
+        if (address.protocol() != QAbstractSocket::IPv4Protocol) {
+            continue;
+        }
+
+        UdpProbeTarget target;
+        target.identity = server.identity();
+        target.address = address;
+        target.port = static_cast<quint16>(server.port);
+        targets.append(target);
+        probed.append(server);
+    }
+
+    if (targets.isEmpty()) {
+        addLog("📡 Нет UDP серверов для проверки (результаты в кэше актуальны)", "INFO");
+        return;
+    }
+
+    udpProbeRunning = true;
+    addLog(QString("📡 Пакетная UDP-проверка %1 серверов").arg(targets.size()), "INFO");
+
+    QFutureWatcher<UdpProbeBatch>* watcher = new QFutureWatcher<UdpProbeBatch>(this);
+    connect(watcher, &QFutureWatcher<UdpProbeBatch>::finished, this, [this, watcher, probed]() {
+        UdpProbeBatch batch = watcher->result();
+        watcher->deleteLater();
+        udpProbeRunning = false;
+
+        if (!batch.error.isEmpty()) {
+            addLog(QString("❌ UDP-проверка недоступна: %1").arg(batch.error), "ERROR");
+            return;
+        }
+
+        int replied = 0;
+        for (int i = 0; i < batch.results.size() && i < probed.size(); ++i) {
+            const UdpProbeResult& result = batch.results[i];
+            if (result.replied()) {
+                replied++;
+            }
+            applyLatencySamples(probed[i], result.rttMs, result.lost, ProbeType::Handshake,
+                                result.estimatedMbps);
+        }
+
+        const UdpProber::Stats& stats = batch.stats;
+        addLog(QString("📡 UDP-проверка: ответили %1 из %2 серверов, ответов %3/%4")
+        .arg(replied).arg(probed.size()).arg(stats.replies).arg(stats.probes), "SUCCESS");
+        addLog(QString("📊 Системных вызовов: %1 (по одному на пакет было бы ~%2)")
+        .arg(stats.syscalls).arg(stats.naiveSyscalls), "INFO");
+        if (stats.estimates > 0) {
+            addLog(QString("📐 Оценка пропускной способности получена для %1 серверов").arg(stats.estimates), "INFO");
+        } else if (!stats.trainsAvailable) {
+            addLog("📐 ICMP-сокет недоступен (net.ipv4.ping_group_range), пропускная способность не оценивается", "WARNING");
+        }
+        if (stats.kernelTimestamps) {
+            addLog(QString("⏱️ Метки времени ядра: средняя погрешность пользовательского замера %1 мкс")
+            .arg(stats.meanUserErrorUs, 0, 'f', 1), "INFO");
+        } else {
+            addLog("⏱️ Метки времени ядра недоступны, RTT измерен в пользовательском пространстве", "WARNING");
+        }
+
+        probeCache->save();
+        updateServerList();
+    });
+
+    watcher->setFuture(QtConcurrent::run([targets]() {
+        UdpProbeBatch batch;
+        UdpProber prober;
+        prober.setTrainLength(8);
+        if (!prober.open(&batch.error)) {
+            return batch;
+        }
+        batch.results = prober.probe(targets);
+        batch.stats = prober.lastStats();
+        return batch;
+    }));
+}
+
 void MainWindow::exportServerConfig(const VpnServer& server) {
     QString fileName = QFileDialog::getSaveFileName(this,
                                                     "Экспорт конфигурации",
@@ -2671,7 +3515,7 @@ void MainWindow::loadBlockedCountries() {
 void MainWindow::sortServersBySpeed() {
     std::sort(servers.begin(), servers.end(),
               [](const VpnServer& a, const VpnServer& b) {
-                  return a.speedMbps > b.speedMbps;
+                  return a.effectiveSpeedMbps() > b.effectiveSpeedMbps();
               });
     updateServerList();
     addLog("Серверы отсортированы по скорости", "INFO");
@@ -2680,7 +3524,7 @@ void MainWindow::sortServersBySpeed() {
 void MainWindow::sortServersByPing() {
     std::sort(servers.begin(), servers.end(),
               [](const VpnServer& a, const VpnServer& b) {
-                  return a.ping < b.ping;
+                  return a.latencyRankMs() < b.latencyRankMs();
               });
     updateServerList();
     addLog("Серверы отсортированы по пингу", "INFO");
@@ -2960,7 +3804,7 @@ void MainWindow::on_quickConnectFastButton_clicked() {
     }
 
     addLog(QString("Быстрое подключение к самому быстрому серверу: %1 (%2 Mbps)")
-    .arg(fastestServer.name).arg(fastestServer.speedMbps, 0, 'f', 1), "INFO");
+    .arg(fastestServer.name).arg(fastestServer.effectiveSpeedMbps(), 0, 'f', 1), "INFO");
 
     // Находим и выделяем сервер в списке
     for (int i = 0; i < servers.size(); ++i) {
@@ -3121,8 +3965,8 @@ VpnServer MainWindow::findFastestServer() const {
     for (const VpnServer& server : servers) {
         if (!failedServers.contains(server.name) &&
             !blockedCountries.contains(server.country) &&
-            server.speedMbps > maxSpeed) {
-            maxSpeed = server.speedMbps;
+            server.effectiveSpeedMbps() * (1.0 - server.lossRate()) > maxSpeed) {
+            maxSpeed = server.effectiveSpeedMbps() * (1.0 - server.lossRate());
         fastest = server;
             }
     }
@@ -3132,13 +3976,13 @@ VpnServer MainWindow::findFastestServer() const {
 
 VpnServer MainWindow::findMostStableServer() const {
     VpnServer mostStable;
-    int maxScore = -1;
+    double maxScore = -1.0;
 
     for (const VpnServer& server : servers) {
         if (!failedServers.contains(server.name) &&
             !blockedCountries.contains(server.country) &&
-            server.score > maxScore) {
-            maxScore = server.score;
+            server.score * (1.0 - server.lossRate()) > maxScore) {
+            maxScore = server.score * (1.0 - server.lossRate());
         mostStable = server;
             }
     }
@@ -13,21 +13,31 @@
 #include <QSet>
 #include <QElapsedTimer>
 #include <QMap>
+#include <QQueue>
 #include <QPair>
 #include <QScreen>
 #include <QShortcut>
 #include <QGuiApplication>
 #include <QDesktopServices>
+#include <QJsonObject>
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
 QT_END_NAMESPACE
 
 #include "vpntypes.h"
+#include "throughputprobe.h"
+#include "probecache.h"
 
 // Предварительные объявления классов
 class ServerDownloaderThread;
 class VpnManager;
+enum class VpnState;
+class TunnelTester;
+class WarmProber;
+class ConnectTimingStats;
+class ServerProfiles;
+class ServerTesterThread;
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
@@ -48,6 +58,8 @@ private slots:
     void on_timeoutSpinBox_valueChanged(int value);
     void on_autoRefreshCheckbox_stateChanged(int state);
     void on_autoRefreshIntervalSpinBox_valueChanged(int value);
+    void on_warmProbeCountSpinBox_valueChanged(int value);
+    void on_warmProbeIntervalSpinBox_valueChanged(int value);
     void on_exportConfigButton_clicked();
     void on_shareVPNButton_clicked();
     void on_gatewayStartButton_clicked();
@@ -101,7 +113,10 @@ private slots:
     void on_countryFilterButton_clicked();
 
     // Слоты для VPN Gateway
-    void onGatewayProcessFinished(int exitCode, QProcess::ExitStatus exitStatus);
+
+    // Слоты параллельной проверки туннелей
+    void onTunnelTestResult(const VpnServer& server, bool success, const QString& message, int handshakeMs);
+    void onTunnelTestsFinished();
 
 private:
     Ui::MainWindow *ui;
@@ -116,9 +131,17 @@ private:
     // Потоки и менеджеры
     ServerDownloaderThread* downloaderThread;
     VpnManager* vpnManager;
+    TunnelTester* tunnelTester;
+    WarmProber* warmProber;        // Фоновая проверка запасных серверов
 
     // Настройки и логи
     QSettings* settings;
+    QSettings* probeCacheSettings;
+    ProbeCache* probeCache;       // Результаты проверок с TTL
+    QSettings* connectTimingSettings;
+    ConnectTimingStats* connectTimings;   // Гистограммы фаз подключения
+    QSettings* serverProfileSettings;
+    ServerProfiles* serverProfiles;       // Выученные поправки конфигов серверов
     QStringList logMessages;
     int logMessageCount;
 
@@ -136,6 +159,28 @@ private:
     bool autoRefreshEnabled;
     int connectionTimeout;
     int refreshIntervalMinutes;
+    int parallelTunnelTests;       // Число одновременных проверок в namespace
+    int parallelTestLimit;         // Сколько серверов проверять за один проход
+    bool throughputTestEnabled;    // Замерять скорость через поднятый туннель
+    ThroughputEndpoint throughputEndpoint;
+    QQueue<VpnServer> latencyProbeQueue; // Серверы, ожидающие замера задержки
+    int latencyProbesRunning;
+    bool udpProbeRunning;          // Идет пакетная UDP-проверка
+    int warmProbeCount;            // Сколько запасных серверов держать проверенными
+    int warmProbeIntervalSec;      // Период фоновой проверки
+    bool hotStandbyEnabled;        // Держать второй туннель к запасному серверу
+    QSet<QString> standbyRejected; // Серверы, на которых резерв не поднялся
+    bool raceConnectEnabled;       // Авто-подключение гонкой нескольких серверов
+    int raceWidth;                 // Сколько серверов участвуют в гонке
+    int raceStaggerMs;             // Шаг между стартами участников
+    bool aggregateEnabled;         // Объединение нескольких туннелей
+    int aggregateTunnels;          // Сколько туннелей держать вместе с основным
+    QSet<QString> aggregateRejected; // Серверы, выбывшие из объединения
+    bool multiRemoteEnabled;       // Запасные серверы в том же процессе openvpn
+    int multiRemoteServers;        // Сколько серверов вписывать в конфиг
+    int socketBufferMinKb;         // Пределы sndbuf/rcvbuf, подбираемых по BDP
+    int socketBufferMaxKb;
+    bool keepTunnelOnExit;         // Не закрывать туннель при выходе: подхватится при запуске
     QTimer* reconnectTimer;
     QTimer* autoRefreshTimer;
     QTimer* connectionUpdateTimer; // Для обновления времени подключения
@@ -151,9 +196,8 @@ private:
     QShortcut* disconnectShortcut;
 
     // VPN Gateway
-    QProcess* gatewayProcess;
     bool vpnGatewayEnabled;
-    QString gatewayInterface;
+    QString gatewayUplink;           // Внешний интерфейс, на который настроен NAT
     QString localIPAddress;
 
     void generateRealVPNGateConfig();
@@ -162,7 +206,7 @@ private:
 
     // Методы инициализации
     void initUI();
-    void cleanupOldProcesses();
+    void recoverPreviousSessions();
     void addLog(const QString& message, const QString& level = "INFO");
     void saveLogs();
     void saveSettings();
@@ -175,7 +219,7 @@ private:
     void updateSelection();
     void updateCountryStats();
     void updateStatusLabel(int displayed, int total, int failed, int blocked);
-    void updateConnectionButtons(const QString& status, int displayed);
+    void updateConnectionButtons(VpnState state, int displayed);
     void showEmptyListMessage(int displayed, int total, int failed, int blocked);
     void updateGatewayInfo();
     void updateLocalIP();
@@ -198,6 +242,18 @@ private:
     void showConnectionInfo(const VpnServer& server);
     void copyToClipboard(const QString& text, const QString& logMessage);
     void showServerTestDialog(const VpnServer& server);
+    void startParallelTunnelTests();
+    void startLatencyProbes();
+    void launchNextLatencyProbe();
+    void applyLatencySamples(const VpnServer& server, const QList<double>& rttMs, int lost,
+                             ProbeType type = ProbeType::Icmp, double estimatedMbps = 0.0);
+    void startUdpHandshakeProbes();
+    void refreshWarmCandidates();
+    VpnServer pickStandbyServer(const QList<VpnServer>& candidates) const;
+    bool startRaceConnect();
+    QList<VpnServer> pickAggregateServers(const QList<VpnServer>& candidates) const;
+    void onWarmCandidateProbed(const QString& identity, bool replied, const QList<double>& rttMs, int lost);
+    void showConnectTimingStats(const VpnServer& server);
 
     // Методы для работы с конфигурациями
     void exportServerConfig(const VpnServer& server);
@@ -222,6 +278,7 @@ private:
     void setupVPNGateway();
     void startVPNGateway();
     void stopVPNGateway();
+    QList<QJsonObject> gatewayCommands(bool enable) const;
     bool isVPNGatewayRunning() const;
 
     // Методы для сортировки и фильтрации
@@ -0,0 +1,176 @@
+#include "managementclient.h"
+#include <QDateTime>
+
+ManagementClient::ManagementClient(QObject *parent)
+: QObject(parent)
+, socket(new QLocalSocket(this))
+, retryTimer(new QTimer(this))
+, connectTimeoutMs(5000)
+, readySent(false)
+, stateQueryPending(false) {
+    retryTimer->setSingleShot(true);
+    retryTimer->setInterval(100);
+
+    connect(retryTimer, &QTimer::timeout, this, &ManagementClient::tryConnect);
+    connect(socket, &QLocalSocket::connected, this, &ManagementClient::onConnected);
+    connect(socket, &QLocalSocket::readyRead, this, &ManagementClient::onReadyRead);
+    connect(socket, &QLocalSocket::errorOccurred, this, &ManagementClient::onSocketError);
+    connect(socket, &QLocalSocket::disconnected, this, [this]() {
+        if (readySent) {
+            readySent = false;
+            emit closed();
+        }
+    });
+}
+
+ManagementClient::~ManagementClient() {
+    close();
+}
+
+void ManagementClient::connectToSocket(const QString& path, int timeoutMs) {
+    close();
+    socketPath = path;
+    connectTimeoutMs = timeoutMs;
+    connectTimer.start();
+    tryConnect();
+}
+
+void ManagementClient::close() {
+    retryTimer->stop();
+    readySent = false;
+    stateQueryPending = false;
+    socket->abort();
+}
+
+bool ManagementClient::isConnected() const {
+    return readySent && socket->state() == QLocalSocket::ConnectedState;
+}
+
+void ManagementClient::setCredentials(const QString& user, const QString& pass) {
+    username = user;
+    password = pass;
+}
+
+void ManagementClient::sendCommand(const QString& command) {
+    if (socket->state() != QLocalSocket::ConnectedState) {
+        return;
+    }
+    socket->write(command.toUtf8() + "\n");
+    socket->flush();
+}
+
+void ManagementClient::requestState() {
+    stateQueryPending = true;
+    sendCommand("state");
+}
+
+void ManagementClient::tryConnect() {
+    socket->abort();
+    socket->connectToServer(socketPath);
+}
+
+void ManagementClient::onConnected() {
+    retryTimer->stop();
+
+    // Включаем события до hold release, чтобы не пропустить ранние состояния
+    sendCommand("state on");
+    sendCommand("bytecount 1");
+    sendCommand("log on");
+
+    readySent = true;
+    emit ready();
+}
+
+void ManagementClient::onSocketError(QLocalSocket::LocalSocketError error) {
+    if (readySent) {
+        return;   // Обрыв после подключения обрабатывается в disconnected
+    }
+
+    bool notYetListening = error == QLocalSocket::ServerNotFoundError ||
+    error == QLocalSocket::ConnectionRefusedError;
+    if (notYetListening && connectTimer.elapsed() < connectTimeoutMs) {
+        retryTimer->start();
+        return;
+    }
+
+    emit connectFailed(socket->errorString());
+}
+
+void ManagementClient::onReadyRead() {
+    while (socket->canReadLine()) {
+        QByteArray line = socket->readLine().trimmed();
+        if (!line.isEmpty()) {
+            handleLine(line);
+        }
+    }
+}
+
+void ManagementClient::handleLine(const QByteArray& line) {
+    bool commandReply = line.startsWith(">") || line.startsWith("SUCCESS:") || line.startsWith("ERROR:");
+    if (stateQueryPending && !commandReply) {
+        // Ответ на state: строка состояния в том же формате, затем END
+        if (line == "END") {
+            stateQueryPending = false;
+        } else {
+            emitState(line);
+        }
+        return;
+    }
+
+    if (line.startsWith(">STATE:")) {
+        emitState(line.mid(7));
+    } else if (line.startsWith(">BYTECOUNT:")) {
+        QList<QByteArray> fields = line.mid(11).split(',');
+        emit byteCount(fields.value(0).toLongLong(), fields.value(1).toLongLong());
+    } else if (line.startsWith(">PASSWORD:")) {
+        handlePasswordRequest(QString::fromUtf8(line.mid(10)));
+    } else if (line.startsWith(">LOG:")) {
+        // >LOG:<unix time>,<флаги>,<сообщение> — в сообщении могут быть запятые
+        QByteArray payload = line.mid(5);
+        int first = payload.indexOf(',');
+        int second = first >= 0 ? payload.indexOf(',', first + 1) : -1;
+        emit logLine(second >= 0 ? payload.mid(second + 1) : payload);
+    } else if (line.startsWith(">HOLD:")) {
+        emit holdWaiting();
+    } else if (line.startsWith(">FATAL:")) {
+        emit fatalError(QString::fromUtf8(line.mid(7)));
+    } else if (line.startsWith("ERROR:")) {
+        emit commandError(QString::fromUtf8(line.mid(6)).trimmed());
+    }
+}
+
+void ManagementClient::emitState(const QByteArray& fieldsLine) {
+    // <unix time>,<state>,<описание>,<локальный IP>,<удаленный IP>,...
+    QStringList fields = QString::fromUtf8(fieldsLine).split(',');
+    ManagementState state;
+    state.receivedMs = QDateTime::currentMSecsSinceEpoch();
+    state.timestamp = fields.value(0).toLongLong();
+    state.name = fields.value(1);
+    state.description = fields.value(2);
+    state.localIp = fields.value(3);
+    state.remoteIp = fields.value(4);
+    emit stateChanged(state);
+}
+
+void ManagementClient::handlePasswordRequest(const QString& payload) {
+    if (payload.startsWith("Verification Failed")) {
+        emit authFailed(payload);
+        return;
+    }
+
+    // >PASSWORD:Need 'Auth' username/password
+    if (payload.startsWith("Need 'Auth'")) {
+        sendCommand(QString("username \"Auth\" %1").arg(quote(username)));
+        sendCommand(QString("password \"Auth\" %1").arg(quote(password)));
+        return;
+    }
+
+    emit commandError(QString("Неподдерживаемый запрос пароля: %1").arg(payload));
+}
+
+QString ManagementClient::quote(const QString& value) {
+    QString escaped = value;
+    escaped.replace("\\", "\\\\");
+    escaped.replace("\"", "\\\"");
+    return QString("\"%1\"").arg(escaped);
+}
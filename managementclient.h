@@ -0,0 +1,82 @@
+#ifndef MANAGEMENTCLIENT_H
+#define MANAGEMENTCLIENT_H
+
+#include <QObject>
+#include <QLocalSocket>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QStringList>
+
+// Событие >STATE: от OpenVPN
+struct ManagementState {
+    qint64 timestamp;    // unix time из события (секунды, время OpenVPN)
+    qint64 receivedMs;   // Момент получения события (мс с начала эпохи)
+    QString name;        // CONNECTING, WAIT, AUTH, GET_CONFIG, ASSIGN_IP, ADD_ROUTES, CONNECTED, RECONNECTING, EXITING
+    QString description; // Причина/уточнение (SUCCESS, tls-error, ping-restart, ...)
+    QString localIp;
+    QString remoteIp;
+
+    ManagementState() : timestamp(0), receivedMs(0) {}
+};
+
+// Клиент management-интерфейса OpenVPN на Unix-сокете.
+// Вместо разбора текстового лога получает структурированные события
+// (>STATE, >BYTECOUNT, >PASSWORD, >LOG) и отправляет настоящие команды.
+class ManagementClient : public QObject {
+    Q_OBJECT
+
+public:
+    explicit ManagementClient(QObject *parent = nullptr);
+    ~ManagementClient();
+
+    // Сокет появляется не сразу после запуска openvpn, поэтому подключение повторяется до timeoutMs
+    void connectToSocket(const QString& path, int timeoutMs = 5000);
+    void close();
+    bool isConnected() const;
+
+    void setCredentials(const QString& user, const QString& pass);
+
+    void holdRelease() { sendCommand("hold release"); }
+    void sendSignal(const QString& signalName) { sendCommand(QString("signal %1").arg(signalName)); }
+    void sendCommand(const QString& command);
+    // Текущее состояние одной строкой (команда state) — для подхваченного процесса,
+    // который уже прошел все >STATE. Ответ приходит через stateChanged
+    void requestState();
+
+signals:
+    void ready();
+    void connectFailed(const QString& error);
+    void closed();
+    void stateChanged(const ManagementState& state);
+    void byteCount(qint64 bytesIn, qint64 bytesOut);
+    void logLine(const QByteArray& message);   // Сырые байты, для LogClassifier
+    void holdWaiting();
+    void authFailed(const QString& message);
+    void fatalError(const QString& message);
+    void commandError(const QString& message);
+
+private slots:
+    void onConnected();
+    void onReadyRead();
+    void onSocketError(QLocalSocket::LocalSocketError error);
+    void tryConnect();
+
+private:
+    QLocalSocket* socket;
+    QTimer* retryTimer;
+    QElapsedTimer connectTimer;
+    QString socketPath;
+    int connectTimeoutMs;
+    QString username;
+    QString password;
+    bool readySent;
+    bool stateQueryPending;         // Ждем ответ на state: строки без префикса >STATE:
+
+    void handleLine(const QByteArray& line);
+    void handlePasswordRequest(const QString& payload);
+    void emitState(const QByteArray& fieldsLine);
+
+    static QString quote(const QString& value);
+};
+
+#endif // MANAGEMENTCLIENT_H
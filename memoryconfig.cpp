@@ -0,0 +1,131 @@
+#include "memoryconfig.h"
+#include <QFile>
+#include <QDir>
+
+#ifdef Q_OS_LINUX
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+MemoryConfig::MemoryConfig()
+: fd(-1) {
+}
+
+MemoryConfig::~MemoryConfig() {
+    close();
+}
+
+bool MemoryConfig::open(const QByteArray& data, QString* error) {
+    close();
+
+    if (data.isEmpty()) {
+        if (error) {
+            *error = "Пустой конфиг";
+        }
+        return false;
+    }
+
+#ifdef Q_OS_LINUX
+    fd = memfd_create("vpngate-config", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd >= 0) {
+        qint64 written = 0;
+        while (written < data.size()) {
+            ssize_t n = ::write(fd, data.constData() + written, data.size() - written);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                break;
+            }
+            written += n;
+        }
+
+        if (written == data.size()) {
+            // После запечатывания конфиг не изменить даже через /proc
+            fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+            return true;
+        }
+
+        ::close(fd);
+        fd = -1;
+    }
+#endif
+
+    // Без memfd конфиг попадет на диск только через persist()
+    content = data;
+    return true;
+}
+
+QString MemoryConfig::stdinSource() const {
+    // Открытие /proc/self/fd/N дает новое описание файла с позиции 0:
+    // QProcess отдаст его дочернему процессу как stdin, sudo его не закрывает
+    return fd >= 0 ? QString("/proc/self/fd/%1").arg(fd) : QString();
+}
+
+bool MemoryConfig::persist(const QString& dir, QString* error) {
+    QByteArray data = content;
+#ifdef Q_OS_LINUX
+    if (fd >= 0) {
+        struct stat st;
+        if (fstat(fd, &st) == 0) {
+            data.resize(static_cast<int>(st.st_size));
+            if (pread(fd, data.data(), data.size(), 0) != data.size()) {
+                data.clear();
+            }
+        }
+    }
+#endif
+    if (data.isEmpty()) {
+        if (error) {
+            *error = "Конфиг не открыт";
+        }
+        return false;
+    }
+
+    QString target = QDir(dir).filePath("config.ovpn");
+#ifdef Q_OS_LINUX
+    // Права 0600 с момента создания, а не после записи
+    int fileFd = ::open(QFile::encodeName(target).constData(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fileFd < 0) {
+        if (error) {
+            *error = QString::fromLocal8Bit(strerror(errno));
+        }
+        return false;
+    }
+    QFile file;
+    bool ok = file.open(fileFd, QIODevice::WriteOnly, QFileDevice::AutoCloseHandle);
+#else
+    QFile file(target);
+    bool ok = file.open(QIODevice::WriteOnly | QIODevice::NewOnly);
+    file.setPermissions(QFile::ReadOwner | QFile::WriteOwner);
+#endif
+    ok = ok && file.write(data) == data.size() && file.flush();
+    if (!ok) {
+        if (error) {
+            *error = file.errorString();
+        }
+        file.close();
+        QFile::remove(target);
+        return false;
+    }
+    file.close();
+
+    filePath = target;
+    return true;
+}
+
+void MemoryConfig::close() {
+#ifdef Q_OS_LINUX
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+#endif
+
+    content.clear();
+    filePath.clear();
+}
@@ -0,0 +1,40 @@
+#ifndef MEMORYCONFIG_H
+#define MEMORYCONFIG_H
+
+#include <QString>
+#include <QByteArray>
+
+// Конфиг openvpn без записи на диск.
+// На Linux содержимое лежит в анонимном memfd, запечатанном от изменений.
+// Дочерний openvpn получает его стандартным вводом и читает --config /dev/stdin:
+// дескриптор принадлежит самому openvpn, поэтому конфиг переживает выход
+// приложения и перечитывается по SIGHUP, а путь не ведет в /proc нашего процесса.
+// Если openvpn запускает помощник или memfd недоступен, persist() кладет копию
+// с правами 0600 в каталог сессии — она живет столько же, сколько сессия.
+class MemoryConfig {
+public:
+    MemoryConfig();
+    ~MemoryConfig();
+
+    bool open(const QByteArray& content, QString* error = nullptr);
+    // Копия в файл <dir>/config.ovpn (0600); не удаляется при close(),
+    // ее убирает вместе с каталогом сессия
+    bool persist(const QString& dir, QString* error = nullptr);
+    void close();
+
+    bool isOpen() const { return fd >= 0 || !content.isEmpty(); }
+    bool inMemory() const { return fd >= 0; }
+    // Открыть в нашем процессе, чтобы передать дочернему как stdin
+    QString stdinSource() const;
+    QString path() const { return filePath; }   // Файл после persist()
+
+private:
+    int fd;
+    QByteArray content;    // Только если memfd недоступен
+    QString filePath;
+
+    MemoryConfig(const MemoryConfig&) = delete;
+    MemoryConfig& operator=(const MemoryConfig&) = delete;
+};
+
+#endif // MEMORYCONFIG_H
@@ -0,0 +1,184 @@
+#include "openvpnbinary.h"
+#include <QProcess>
+#include <QFileInfo>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QRegularExpression>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QDebug>
+
+namespace {
+QMutex cacheMutex;
+OpenVpnCapabilities cached;
+
+// openvpn часто лежит в sbin, которого нет в PATH обычного пользователя
+const QStringList kSearchDirs = {
+    "/usr/sbin",
+    "/usr/bin",
+    "/sbin",
+    "/bin",
+    "/usr/local/sbin",
+    "/usr/local/bin",
+    "/opt/local/sbin",
+    "/opt/local/bin"
+};
+
+// Шифры канала данных в порядке предпочтения
+const QStringList kAeadCiphers = {
+    "AES-256-GCM",
+    "AES-128-GCM",
+    "CHACHA20-POLY1305"
+};
+
+QString runAndRead(const QString& program, const QStringList& args) {
+    QProcess process;
+    process.setProcessChannelMode(QProcess::MergedChannels);
+    process.start(program, args);
+    if (!process.waitForFinished(3000)) {
+        process.kill();
+        process.waitForFinished(500);
+        return QString();
+    }
+    // openvpn --version завершается с кодом 1, поэтому код возврата не проверяем
+    return QString::fromUtf8(process.readAll());
+}
+
+// DCO зависит от загруженного модуля, а не от бинарника — проверяем при каждом запросе
+bool dcoModuleLoaded() {
+    return QFileInfo::exists("/sys/module/ovpn_dco_v2") || QFileInfo::exists("/sys/module/ovpn");
+}
+}
+
+QStringList OpenVpnCapabilities::cipherDirectives(const QString& serverCipher) const {
+    QStringList preferred;
+    for (const QString& cipher : kAeadCiphers) {
+        if (ciphers.isEmpty() || ciphers.contains(cipher, Qt::CaseInsensitive)) {
+            preferred.append(cipher);
+        }
+    }
+
+    QStringList directives;
+    if (atLeast(2, 5)) {
+        // С 2.6 cipher больше не участвует в согласовании — старые серверы VPNGate
+        // (AES-128-CBC) доступны только через data-ciphers-fallback
+        QStringList dataCiphers = preferred;
+        if (!serverCipher.isEmpty() && !dataCiphers.contains(serverCipher, Qt::CaseInsensitive)) {
+            dataCiphers.append(serverCipher);
+        }
+        directives.append(QString("data-ciphers %1").arg(dataCiphers.join(':')));
+        if (!serverCipher.isEmpty()) {
+            directives.append(QString("data-ciphers-fallback %1").arg(serverCipher));
+        }
+    } else {
+        if (!serverCipher.isEmpty()) {
+            directives.append(QString("cipher %1").arg(serverCipher));
+        }
+        if (atLeast(2, 4) && !preferred.isEmpty()) {
+            directives.append(QString("ncp-ciphers %1").arg(preferred.join(':')));
+        }
+    }
+    return directives;
+}
+
+QString OpenVpnBinary::locate() {
+    QString path = QStandardPaths::findExecutable("openvpn");
+    if (path.isEmpty()) {
+        path = QStandardPaths::findExecutable("openvpn", kSearchDirs);
+    }
+    return path.isEmpty() ? QString() : QFileInfo(path).canonicalFilePath();
+}
+
+OpenVpnCapabilities OpenVpnBinary::resolve() {
+    QMutexLocker locker(&cacheMutex);
+
+    // Быстрый путь: бинарник уже проверен в этом процессе и не менялся
+    if (cached.isValid()) {
+        QFileInfo info(cached.path);
+        if (info.exists() && info.lastModified() == cached.modified) {
+            cached.dcoAvailable = cached.dcoBuilt && dcoModuleLoaded();
+            return cached;
+        }
+        cached = OpenVpnCapabilities();
+    }
+
+    QString path = locate();
+    if (path.isEmpty()) {
+        return OpenVpnCapabilities();
+    }
+    QDateTime modified = QFileInfo(path).lastModified();
+
+    QSettings store("VPNGateManager", "OpenVPN");
+    if (store.value("path").toString() == path &&
+        store.value("mtime").toLongLong() == modified.toMSecsSinceEpoch()) {
+        cached.path = path;
+        cached.modified = modified;
+        cached.version = store.value("version").toString();
+        cached.versionMajor = store.value("versionMajor").toInt();
+        cached.versionMinor = store.value("versionMinor").toInt();
+        cached.dcoBuilt = store.value("dco").toBool();
+        cached.management = store.value("management").toBool();
+        cached.ciphers = store.value("ciphers").toStringList();
+    } else {
+        cached = probe(path, modified);
+        if (!cached.isValid()) {
+            return cached;
+        }
+
+        store.setValue("path", cached.path);
+        store.setValue("mtime", modified.toMSecsSinceEpoch());
+        store.setValue("version", cached.version);
+        store.setValue("versionMajor", cached.versionMajor);
+        store.setValue("versionMinor", cached.versionMinor);
+        store.setValue("dco", cached.dcoBuilt);
+        store.setValue("management", cached.management);
+        store.setValue("ciphers", cached.ciphers);
+        store.sync();
+    }
+
+    cached.dcoAvailable = cached.dcoBuilt && dcoModuleLoaded();
+    return cached;
+}
+
+void OpenVpnBinary::invalidate() {
+    QMutexLocker locker(&cacheMutex);
+    cached = OpenVpnCapabilities();
+
+    QSettings store("VPNGateManager", "OpenVPN");
+    store.clear();
+}
+
+OpenVpnCapabilities OpenVpnBinary::probe(const QString& path, const QDateTime& modified) {
+    OpenVpnCapabilities caps;
+
+    QString versionOutput = runAndRead(path, QStringList() << "--version");
+    QRegularExpressionMatch match = QRegularExpression("^OpenVPN (\\d+)\\.(\\d+)(\\.\\d+)?")
+    .match(versionOutput);
+    if (!match.hasMatch()) {
+        qDebug() << "⚠️ Не удалось определить версию OpenVPN:" << path;
+        return caps;
+    }
+
+    caps.path = path;
+    caps.modified = modified;
+    caps.version = match.captured(0).mid(8);
+    caps.versionMajor = match.captured(1).toInt();
+    caps.versionMinor = match.captured(2).toInt();
+    caps.dcoBuilt = versionOutput.contains("[DCO]");
+
+    // В сборках без списка defines management есть всегда
+    caps.management = versionOutput.contains("enable_management=yes") ||
+    !versionOutput.contains("Compile time defines");
+
+    // AES-128-CBC  (128 bit key, 128 bit block)
+    QString ciphersOutput = runAndRead(path, QStringList() << "--show-ciphers");
+    QRegularExpression cipherLine("^([A-Za-z0-9-]+)\\s+\\(\\d+ bit key", QRegularExpression::MultilineOption);
+    QRegularExpressionMatchIterator it = cipherLine.globalMatch(ciphersOutput);
+    while (it.hasNext()) {
+        caps.ciphers.append(it.next().captured(1).toUpper());
+    }
+
+    qDebug() << "✅ OpenVPN" << caps.version << "по пути" << path
+    << "DCO:" << caps.dcoBuilt << "шифров:" << caps.ciphers.size();
+    return caps;
+}
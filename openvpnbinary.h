@@ -0,0 +1,46 @@
+#ifndef OPENVPNBINARY_H
+#define OPENVPNBINARY_H
+
+#include <QString>
+#include <QStringList>
+#include <QDateTime>
+
+// Что умеет найденный бинарник openvpn
+struct OpenVpnCapabilities {
+    QString path;
+    QDateTime modified;      // mtime бинарника — ключ кэша вместе с путем
+    QString version;         // Например "2.6.12"
+    int versionMajor;
+    int versionMinor;
+    bool dcoBuilt;           // Собран с Data Channel Offload ([DCO] в --version)
+    bool dcoAvailable;       // Модуль ядра DCO загружен
+    bool management;         // Поддержка --management (enable_management=yes)
+    QStringList ciphers;     // Шифры из --show-ciphers
+
+    OpenVpnCapabilities()
+    : versionMajor(0), versionMinor(0), dcoBuilt(false), dcoAvailable(false), management(false) {
+    }
+
+    bool isValid() const { return !path.isEmpty(); }
+    bool atLeast(int major, int minor) const {
+        return versionMajor > major || (versionMajor == major && versionMinor >= minor);
+    }
+
+    // Директивы шифрования под версию: data-ciphers с 2.5, ncp-ciphers в 2.4, иначе только cipher
+    QStringList cipherDirectives(const QString& serverCipher) const;
+};
+
+// Поиск openvpn и проверка его возможностей — один раз на процесс.
+// Результат хранится в QSettings с ключом путь+mtime: после обновления
+// пакета openvpn проверка повторяется автоматически. Потокобезопасно.
+class OpenVpnBinary {
+public:
+    static OpenVpnCapabilities resolve();
+    static void invalidate();
+
+private:
+    static QString locate();
+    static OpenVpnCapabilities probe(const QString& path, const QDateTime& modified);
+};
+
+#endif // OPENVPNBINARY_H
@@ -0,0 +1,210 @@
+#include "openvpnprocess.h"
+#include "privilegedhelper.h"
+#include "systemcommand.h"
+#include "logtail.h"
+#include <QProcess>
+#include <QTimer>
+#include <QFileInfo>
+#include <QFile>
+
+OpenVpnProcess::OpenVpnProcess(QObject *parent)
+: QObject(parent), local(nullptr), watchTimer(nullptr), logTail(nullptr), pid(0), running(false),
+helperMode(false), attached(false) {
+}
+
+void OpenVpnProcess::start(const QString& program, const QStringList& args) {
+    local = new QProcess(this);
+    local->setProcessChannelMode(QProcess::MergedChannels);
+
+    connect(local, &QProcess::readyRead, this, [this]() {
+        while (local->canReadLine()) {
+            QByteArray line = local->readLine().trimmed();
+            if (!line.isEmpty()) {
+                emit lineRead(line);
+            }
+        }
+    });
+    connect(local, &QProcess::started, this, [this]() {
+        running = true;
+        pid = local->processId();
+        if (!logFile.isEmpty()) {
+            logTail = new LogTail(logFile, this);
+            connect(logTail, &LogTail::lineRead, this, &OpenVpnProcess::lineRead);
+            logTail->start();
+        }
+        emit started();
+    });
+    connect(local, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this,
+            [this](int exitCode, QProcess::ExitStatus status) {
+        Q_UNUSED(status);
+        running = false;
+        // Последние строки лога — обычно причина завершения
+        if (logTail) {
+            logTail->stop();
+        }
+        emit finished(exitCode);
+    });
+    // После FailedToStart сигнала finished не будет
+    connect(local, &QProcess::errorOccurred, this, [this](QProcess::ProcessError error) {
+        if (error == QProcess::FailedToStart) {
+            emit failedToStart(local->errorString());
+        }
+    });
+
+    if (!inputFile.isEmpty()) {
+        local->setStandardInputFile(inputFile);
+    }
+
+    if (SystemCommand::isRoot()) {
+        local->start(program, args);
+    } else {
+        local->start("sudo", QStringList() << program << args);
+    }
+}
+
+void OpenVpnProcess::startViaHelper(const QJsonObject& spawnRequest) {
+    helperMode = true;
+    PrivilegedHelper* helper = PrivilegedHelper::instance();
+
+    connect(helper, &PrivilegedHelper::processOutput, this, [this](qint64 processPid, const QByteArray& line) {
+        if (processPid == pid && !line.isEmpty()) {
+            emit lineRead(line);
+        }
+    });
+    connect(helper, &PrivilegedHelper::processExited, this, [this](qint64 processPid, int exitCode, bool crashed) {
+        if (processPid != pid || !running) {
+            return;
+        }
+        running = false;
+        emit finished(crashed ? -1 : exitCode);
+    });
+    // Связь с помощником потеряна, но его openvpn продолжает работать: лог идет
+    // в файл, а не в pipe. Дальше следим за процессом по /proc, как за
+    // подхваченным, — иначе сессия удалила бы журнал и каталог живого туннеля
+    connect(helper, &PrivilegedHelper::disconnected, this, [this]() {
+        if (running) {
+            helperMode = false;
+            PrivilegedHelper::instance()->disconnect(this);
+            attach(pid);
+        }
+    });
+
+    QJsonObject request = spawnRequest;
+    request["op"] = "spawn";
+    helper->request(request, this, [this](const QJsonObject& reply) {
+        if (!reply.value("ok").toBool()) {
+            emit failedToStart(reply.value("error").toString());
+            return;
+        }
+        pid = reply.value("pid").toInteger();
+        running = true;
+        emit started();
+    });
+}
+
+void OpenVpnProcess::attach(qint64 processId) {
+    attached = true;
+    pid = processId;
+    running = true;   // Если процесса уже нет, это покажет первая же проверка
+
+    watchTimer = new QTimer(this);
+    watchTimer->setInterval(1000);
+    connect(watchTimer, &QTimer::timeout, this, [this]() {
+        if (running && !QFileInfo::exists(QString("/proc/%1").arg(pid))) {
+            running = false;
+            watchTimer->stop();
+            emit finished(-1);   // Код завершения чужого для нас процесса неизвестен
+        }
+    });
+    watchTimer->start();
+}
+
+void OpenVpnProcess::stopLogTail() {
+    if (logTail) {
+        logTail->stop();
+    } else if (helperMode && running) {
+        QJsonObject request;
+        request["op"] = "untail";
+        request["pid"] = pid;
+        PrivilegedHelper::instance()->request(request, this);
+    }
+}
+
+void OpenVpnProcess::release() {
+    // Отвязываемся от сигналов помощника и не убиваем процесс при удалении.
+    // Локальный sudo завершится вместе с приложением, openvpn останется
+    running = false;
+    if (logTail) {
+        logTail->disconnect(this);
+        logTail->stop();
+    }
+    PrivilegedHelper::instance()->disconnect(this);
+    if (watchTimer) {
+        watchTimer->stop();
+    }
+    if (local) {
+        local->disconnect(this);
+    }
+}
+
+void OpenVpnProcess::sendSignal(const QString& signalName) {
+    // Сигнал получает сам openvpn, а не sudo. Подхваченный процесс мог быть
+    // запущен прежним помощником — новый найдет его по своему реестру
+    SystemCommand::signalOpenVpn(pid, signalName, this);
+}
+
+qint64 OpenVpnProcess::openVpnPid() const {
+    if (pidFile.isEmpty()) {
+        return 0;
+    }
+    QFile file(pidFile);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return 0;   // openvpn еще не записал pid
+    }
+    qint64 openvpnPid = file.readAll().trimmed().toLongLong();
+    // Файл мог остаться от прошлого запуска, а pid — достаться другому процессу
+    QFile comm(QString("/proc/%1/comm").arg(openvpnPid));
+    if (openvpnPid <= 0 || !comm.open(QIODevice::ReadOnly) || !comm.readAll().startsWith("openvpn")) {
+        return 0;
+    }
+    return openvpnPid;
+}
+
+void OpenVpnProcess::terminate() {
+    if (!running) {
+        return;
+    }
+    if (attached || helperMode) {
+        sendSignal("TERM");
+    } else {
+        local->terminate();
+    }
+}
+
+void OpenVpnProcess::kill() {
+    if (!running) {
+        return;
+    }
+    if (attached || helperMode) {
+        sendSignal("KILL");
+        return;
+    }
+
+    qint64 openvpnPid = openVpnPid();
+    if (openvpnPid <= 0) {
+        local->kill();
+        return;
+    }
+    // sudo завершится сам вслед за openvpn; если kill не разрешен — хотя бы sudo
+    SystemCommand::signalOpenVpn(openvpnPid, "KILL", this, [this](bool ok, const QString&) {
+        if (!ok && running) {
+            local->kill();
+        }
+    });
+}
+
+void OpenVpnProcess::waitForFinished(int msecs) {
+    if (local && running) {
+        local->waitForFinished(msecs);
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef OPENVPNPROCESS_H
+#define OPENVPNPROCESS_H
+
+#include <QObject>
+#include <QStringList>
+#include <QJsonObject>
+
+class QProcess;
+class QTimer;
+class LogTail;
+
+// Процесс openvpn сессии. Если привилегированный помощник запущен, openvpn
+// стартует у него (без sudo на каждое подключение), иначе — как раньше,
+// дочерним процессом через sudo. Сигналы и события для VpnSession одинаковы.
+// Третий режим — подхваченный после перезапуска приложения процесс: он нам не
+// дочерний, завершение отслеживается по /proc, сигналы идут через kill.
+// В него же переходит openvpn помощника, если связь с помощником потеряна.
+class OpenVpnProcess : public QObject {
+    Q_OBJECT
+
+public:
+    explicit OpenVpnProcess(QObject *parent = nullptr);
+
+    // Дочерний openvpn через sudo (или напрямую от root)
+    void start(const QString& program, const QStringList& args);
+    // openvpn у помощника: запрос spawn с конфигом и параметрами сессии,
+    // командную строку помощник собирает сам
+    void startViaHelper(const QJsonObject& spawnRequest);
+    // Стандартный ввод дочернего openvpn (только без помощника)
+    void setStandardInputFile(const QString& path) { inputFile = path; }
+    // Лог из --log дочернего openvpn: строки идут в lineRead, как вывод процесса.
+    // У помощника лог свой, его строки он присылает событиями сам
+    void setLogFile(const QString& path) { logFile = path; }
+    // Файл --writepid дочернего openvpn: под sudo processId() — это sudo,
+    // а KILL sudo не передает дальше, и openvpn остался бы без родителя
+    void setPidFile(const QString& path) { pidFile = path; }
+    // Строки лога больше не нужны (подключен management-интерфейс)
+    void stopLogTail();
+    // Уже работающий openvpn из журнала сессий
+    void attach(qint64 processId);
+    // Перестать управлять процессом, не завершая его (туннель переживет выход)
+    void release();
+    void terminate();
+    void kill();
+    // Только для дочернего процесса: дождаться выхода при закрытии приложения
+    void waitForFinished(int msecs);
+    bool isRunning() const { return running; }
+    qint64 processId() const { return pid; }
+    bool viaHelper() const { return helperMode; }
+
+signals:
+    void started();
+    void lineRead(const QByteArray& line);
+    void finished(int exitCode);
+    void failedToStart(const QString& error);
+
+private:
+    QProcess* local;
+    QTimer* watchTimer;              // Проверка /proc для подхваченного процесса
+    LogTail* logTail;
+    QString inputFile;
+    QString logFile;
+    QString pidFile;
+    qint64 pid;
+    bool running;
+    bool helperMode;
+    bool attached;
+
+    void sendSignal(const QString& signalName);
+    qint64 openVpnPid() const;
+};
+
+#endif // OPENVPNPROCESS_H
@@ -0,0 +1,199 @@
+#include "privilegedhelper.h"
+#include "systemcommand.h"
+#include <QCoreApplication>
+#include <QLocalSocket>
+#include <QProcess>
+#include <QTimer>
+#include <QTemporaryDir>
+#include <QDir>
+#include <QJsonDocument>
+#include <QRandomGenerator>
+#include <unistd.h>
+
+PrivilegedHelper* PrivilegedHelper::instance() {
+    static PrivilegedHelper* helper = new PrivilegedHelper();
+    return helper;
+}
+
+PrivilegedHelper::PrivilegedHelper(QObject *parent)
+: QObject(parent), helperProcess(nullptr), socket(new QLocalSocket(this)), retryTimer(new QTimer(this)),
+socketDir(nullptr), started(false), authenticated(false), gaveUp(false), nextId(0) {
+    retryTimer->setSingleShot(true);
+    retryTimer->setInterval(100);
+    connect(retryTimer, &QTimer::timeout, this, &PrivilegedHelper::tryConnect);
+
+    connect(socket, &QLocalSocket::connected, this, &PrivilegedHelper::onConnected);
+    connect(socket, &QLocalSocket::readyRead, this, &PrivilegedHelper::onReadyRead);
+    connect(socket, &QLocalSocket::disconnected, this, &PrivilegedHelper::onDisconnected);
+    connect(socket, &QLocalSocket::errorOccurred, this, [this](QLocalSocket::LocalSocketError error) {
+        Q_UNUSED(error);
+        if (authenticated) {
+            return;   // Обрыв после подключения обрабатывается в onDisconnected
+        }
+        // Помощник еще не создал сокет — повторяем, пока жив его процесс
+        if (connectClock.elapsed() < 10000 && helperProcess && helperProcess->state() != QProcess::NotRunning) {
+            retryTimer->start();
+        } else {
+            fail(QString("нет связи с помощником: %1").arg(socket->errorString()));
+        }
+    });
+}
+
+void PrivilegedHelper::start() {
+    if (started) {
+        return;
+    }
+    started = true;
+
+    // Под root помощник ничего не ускоряет
+    if (SystemCommand::isRoot()) {
+        QTimer::singleShot(0, this, [this]() { fail("приложение уже запущено от root"); });
+        return;
+    }
+
+    socketDir = new QTemporaryDir(QDir(QDir::tempPath()).filePath("vpngate-helper-XXXXXX"));
+    if (!socketDir->isValid()) {
+        QTimer::singleShot(0, this, [this]() { fail("не удалось создать каталог для сокета"); });
+        return;
+    }
+    socketPath = socketDir->filePath("helper.sock");
+
+    QByteArray random(32, Qt::Uninitialized);
+    QRandomGenerator::system()->generate(reinterpret_cast<quint32*>(random.data()),
+                                         reinterpret_cast<quint32*>(random.data() + random.size()));
+    token = random.toHex();
+
+    helperProcess = new QProcess(this);
+    helperProcess->setProcessChannelMode(QProcess::ForwardedChannels);
+
+    connect(helperProcess, &QProcess::started, this, [this]() {
+        helperProcess->write(token + "\n");
+        helperProcess->closeWriteChannel();
+        connectClock.start();
+        retryTimer->start();
+    });
+    connect(helperProcess, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this,
+            [this](int exitCode, QProcess::ExitStatus status) {
+        Q_UNUSED(status);
+        if (!authenticated) {
+            retryTimer->stop();
+            fail(QString("помощник не запустился (код %1), нужен sudo без пароля").arg(exitCode));
+        }
+    });
+    connect(helperProcess, &QProcess::errorOccurred, this, [this](QProcess::ProcessError error) {
+        if (error == QProcess::FailedToStart) {
+            fail(QString("не удалось запустить sudo: %1").arg(helperProcess->errorString()));
+        }
+    });
+
+    // -n: без пароля сразу ошибка, а не зависание на запросе в терминале
+    helperProcess->start("sudo", QStringList()
+    << "-n" << QCoreApplication::applicationFilePath()
+    << "--privileged-helper" << socketPath << QString::number(getuid()));
+}
+
+void PrivilegedHelper::tryConnect() {
+    socket->abort();
+    socket->connectToServer(socketPath);
+}
+
+void PrivilegedHelper::onConnected() {
+    socket->write("AUTH " + token + "\n");
+    socket->flush();
+}
+
+void PrivilegedHelper::onReadyRead() {
+    while (socket->canReadLine()) {
+        QByteArray line = socket->readLine().trimmed();
+        if (line.isEmpty()) {
+            continue;
+        }
+
+        if (!authenticated) {
+            if (line == "OK") {
+                authenticated = true;
+                emit ready();
+            } else {
+                fail(QString("помощник отклонил подключение: %1").arg(QString::fromUtf8(line)));
+                socket->abort();
+            }
+            continue;
+        }
+
+        QJsonDocument document = QJsonDocument::fromJson(line);
+        if (document.isObject()) {
+            handleMessage(document.object());
+        }
+    }
+}
+
+void PrivilegedHelper::handleMessage(const QJsonObject& message) {
+    if (message.contains("event")) {
+        QString event = message.value("event").toString();
+        qint64 pid = message.value("pid").toInteger();
+        if (event == "output") {
+            emit processOutput(pid, message.value("line").toString().toUtf8());
+        } else if (event == "exit") {
+            emit processExited(pid, message.value("code").toInt(), message.value("crashed").toBool());
+        }
+        return;
+    }
+
+    PendingReply pending = pendingReplies.take(static_cast<quint64>(message.value("id").toInteger()));
+    if (pending.context && pending.done) {
+        pending.done(message);
+    }
+}
+
+void PrivilegedHelper::request(QJsonObject message, QObject* context, Reply done) {
+    if (!authenticated) {
+        if (done) {
+            QJsonObject reply;
+            reply["ok"] = false;
+            reply["error"] = "помощник недоступен";
+            done(reply);
+        }
+        return;
+    }
+
+    quint64 id = ++nextId;
+    message["id"] = static_cast<qint64>(id);
+    pendingReplies.insert(id, PendingReply{QPointer<QObject>(context), done});
+    socket->write(QJsonDocument(message).toJson(QJsonDocument::Compact) + "\n");
+    socket->flush();
+}
+
+void PrivilegedHelper::onDisconnected() {
+    if (!authenticated) {
+        return;
+    }
+    authenticated = false;
+    failPending("помощник отключился");
+    emit disconnected();
+}
+
+void PrivilegedHelper::failPending(const QString& error) {
+    QHash<quint64, PendingReply> pending;
+    pending.swap(pendingReplies);
+    QJsonObject reply;
+    reply["ok"] = false;
+    reply["error"] = error;
+    for (const PendingReply& item : pending) {
+        if (item.context && item.done) {
+            item.done(reply);
+        }
+    }
+}
+
+void PrivilegedHelper::fail(const QString& reason) {
+    // unavailable выдается один раз: дальше все идет через sudo
+    if (authenticated || gaveUp) {
+        return;
+    }
+    gaveUp = true;
+    retryTimer->stop();
+    if (helperProcess && helperProcess->state() != QProcess::NotRunning) {
+        helperProcess->kill();
+    }
+    emit unavailable(reason);
+}
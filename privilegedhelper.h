@@ -0,0 +1,76 @@
+#ifndef PRIVILEGEDHELPER_H
+#define PRIVILEGEDHELPER_H
+
+#include <QObject>
+#include <QJsonObject>
+#include <QHash>
+#include <QPointer>
+#include <QElapsedTimer>
+#include <functional>
+
+class QLocalSocket;
+class QProcess;
+class QTimer;
+class QTemporaryDir;
+
+// Клиент привилегированного помощника.
+// Помощник — этот же исполняемый файл в режиме --privileged-helper, запущенный
+// один раз через sudo. GUI работает без root и отправляет ему запросы по
+// Unix-сокету: запуск и остановка openvpn, операции PrivilegedOps.
+// Пока помощник недоступен, SystemCommand и OpenVpnProcess работают через sudo.
+class PrivilegedHelper : public QObject {
+    Q_OBJECT
+
+public:
+    using Reply = std::function<void(const QJsonObject& reply)>;
+
+    static PrivilegedHelper* instance();
+
+    // Запуск помощника; результат — ready() или unavailable()
+    void start();
+    bool isReady() const { return authenticated; }
+
+    // Ответ приходит в done, если context еще жив. Без помощника —
+    // сразу {"ok": false, "error": ...}
+    void request(QJsonObject message, QObject* context, Reply done = Reply());
+
+signals:
+    void ready();
+    void unavailable(const QString& reason);
+    void disconnected();
+    void processOutput(qint64 pid, const QByteArray& line);
+    void processExited(qint64 pid, int exitCode, bool crashed);
+
+private slots:
+    void tryConnect();
+    void onConnected();
+    void onReadyRead();
+    void onDisconnected();
+
+private:
+    explicit PrivilegedHelper(QObject *parent = nullptr);
+
+    QProcess* helperProcess;
+    QLocalSocket* socket;
+    QTimer* retryTimer;
+    QTemporaryDir* socketDir;        // 0700, владелец — пользователь GUI
+    QElapsedTimer connectClock;
+    QString socketPath;
+    QByteArray token;                // Передается помощнику через stdin, в аргументах не виден
+    bool started;
+    bool authenticated;
+    bool gaveUp;                     // unavailable уже выдан
+    quint64 nextId;
+
+    struct PendingReply {
+        QPointer<QObject> context;
+        Reply done;
+    };
+    QHash<quint64, PendingReply> pendingReplies;
+
+    void fail(const QString& reason);
+    void handleMessage(const QJsonObject& message);
+    void failPending(const QString& error);
+};
+
+#endif // PRIVILEGEDHELPER_H
@@ -0,0 +1,323 @@
+#include "privilegedops.h"
+#include <QJsonArray>
+#include <QHostAddress>
+#include <QFileInfo>
+#include <QRegularExpression>
+
+namespace {
+// Половины адресного пространства: точнее маршрута по умолчанию и перекрывают его
+const QStringList tunnelPrefixes = { "0.0.0.0/1", "128.0.0.0/1" };
+// Все, что GUI меняет через sysctl
+const QStringList sysctlKeys = {
+    "net.ipv4.fib_multipath_hash_policy",
+    "net.ipv4.ip_forward",
+    "net.ipv6.conf.all.forwarding"
+};
+const int kMaxDnsServers = 8;
+const int kMaxNexthops = 16;
+
+// up-скрипт вызывается openvpn как: <script> <netns> <dev> <tun_mtu> <link_mtu> <local_ip> <remote_ip|netmask> <init|restart>
+const char* kNetnsUpScript =
+    "#!/bin/sh\n"
+    "# Переносим tun в namespace проверки и настраиваем его там\n"
+    "PATH=/usr/sbin:/usr/bin:/sbin:/bin; export PATH\n"
+    "ns=\"$1\"; dev=\"$2\"; mtu=\"$3\"; local_ip=\"$5\"\n"
+    "ip link set dev \"$dev\" netns \"$ns\" || exit 1\n"
+    "ip -n \"$ns\" link set dev lo up\n"
+    "ip -n \"$ns\" link set dev \"$dev\" mtu \"$mtu\" up || exit 1\n"
+    "if [ -n \"$ifconfig_netmask\" ]; then\n"
+    "    ip -n \"$ns\" addr add \"$local_ip/$ifconfig_netmask\" dev \"$dev\" || exit 1\n"
+    "else\n"
+    "    ip -n \"$ns\" addr add \"$local_ip\" peer \"$ifconfig_remote\" dev \"$dev\" || exit 1\n"
+    "fi\n"
+    "ip -n \"$ns\" route add default dev \"$dev\"\n"
+    "exit 0\n";
+
+bool isHostPrefix(const QString& prefix) {
+    if (!prefix.endsWith("/32")) {
+        return false;
+    }
+    QHostAddress address(prefix.chopped(3));
+    return address.protocol() == QHostAddress::IPv4Protocol;
+}
+
+bool isIpv4(const QString& text) {
+    QHostAddress address(text);
+    return address.protocol() == QHostAddress::IPv4Protocol;
+}
+
+// Строка для ip -batch; пустая — операция отклонена
+QString routeLine(const QJsonObject& op, QString* error) {
+    QString action = op.value("action").toString();
+    QString prefix = op.value("prefix").toString();
+
+    if (action == "del") {
+        if (!isHostPrefix(prefix) && !tunnelPrefixes.contains(prefix)) {
+            *error = QString("удаление маршрута %1 не разрешено").arg(prefix);
+            return QString();
+        }
+        return QString("route del %1").arg(prefix);
+    }
+    if (action != "replace") {
+        *error = QString("неизвестное действие с маршрутом: %1").arg(action);
+        return QString();
+    }
+
+    if (op.contains("gateway")) {
+        QString gateway = op.value("gateway").toString();
+        QString device = op.value("device").toString();
+        if (!isHostPrefix(prefix) || !isIpv4(gateway) || !PrivilegedOps::isPhysicalDevice(device)) {
+            *error = QString("маршрут до сервера отклонен: %1 via %2 dev %3").arg(prefix, gateway, device);
+            return QString();
+        }
+        return QString("route replace %1 via %2 dev %3").arg(prefix, gateway, device);
+    }
+
+    if (!tunnelPrefixes.contains(prefix)) {
+        *error = QString("маршрут %1 через туннель не разрешен").arg(prefix);
+        return QString();
+    }
+
+    if (op.contains("nexthops")) {
+        QJsonArray nexthops = op.value("nexthops").toArray();
+        if (nexthops.isEmpty() || nexthops.size() > kMaxNexthops) {
+            *error = "неверное число туннелей в multipath-маршруте";
+            return QString();
+        }
+        QStringList parts;
+        for (const QJsonValue& value : nexthops) {
+            QJsonObject nexthop = value.toObject();
+            QString device = nexthop.value("device").toString();
+            int weight = nexthop.value("weight").toInt();
+            if (!PrivilegedOps::isTunDevice(device) || weight < 1 || weight > 256) {
+                *error = QString("неверный nexthop: %1 weight %2").arg(device).arg(weight);
+                return QString();
+            }
+            parts << QString("nexthop dev %1 weight %2").arg(device).arg(weight);
+        }
+        return QString("route replace %1 %2").arg(prefix, parts.join(' '));
+    }
+
+    QString device = op.value("device").toString();
+    if (!PrivilegedOps::isTunDevice(device)) {
+        *error = QString("маршрут через %1 не разрешен").arg(device);
+        return QString();
+    }
+    return QString("route replace %1 dev %2").arg(prefix, device);
+}
+}
+
+QByteArray PrivilegedOps::netnsUpScript() {
+    return QByteArray(kNetnsUpScript);
+}
+
+bool PrivilegedOps::isTunDevice(const QString& name) {
+    static const QRegularExpression pattern("^tun\\d{1,3}$");
+    return pattern.match(name).hasMatch();
+}
+
+bool PrivilegedOps::isPhysicalDevice(const QString& name) {
+    // Имя интерфейса ядра: до 15 символов; должен существовать сейчас
+    static const QRegularExpression pattern("^[A-Za-z0-9_.-]{1,15}$");
+    return pattern.match(name).hasMatch() && !isTunDevice(name) && name != "." && name != ".."
+    && QFileInfo::exists(QString("/sys/class/net/%1").arg(name));
+}
+
+QJsonObject PrivilegedOps::tunnelRoute(const QString& prefix, const QString& device) {
+    QJsonObject op;
+    op["type"] = "route";
+    op["action"] = "replace";
+    op["prefix"] = prefix;
+    op["device"] = device;
+    return op;
+}
+
+QJsonObject PrivilegedOps::multipathRoute(const QString& prefix, const QList<QPair<QString, int>>& nexthops) {
+    QJsonArray list;
+    for (const auto& nexthop : nexthops) {
+        QJsonObject item;
+        item["device"] = nexthop.first;
+        item["weight"] = nexthop.second;
+        list.append(item);
+    }
+    QJsonObject op;
+    op["type"] = "route";
+    op["action"] = "replace";
+    op["prefix"] = prefix;
+    op["nexthops"] = list;
+    return op;
+}
+
+QJsonObject PrivilegedOps::hostRoute(const QString& prefix, const QString& gateway, const QString& device) {
+    QJsonObject op = tunnelRoute(prefix, device);
+    op["gateway"] = gateway;
+    return op;
+}
+
+QJsonObject PrivilegedOps::routeDelete(const QString& prefix) {
+    QJsonObject op;
+    op["type"] = "route";
+    op["action"] = "del";
+    op["prefix"] = prefix;
+    return op;
+}
+
+QJsonObject PrivilegedOps::sysctl(const QString& key, int value) {
+    QJsonObject op;
+    op["type"] = "sysctl";
+    op["key"] = key;
+    op["value"] = value;
+    return op;
+}
+
+QJsonObject PrivilegedOps::tunnelDns(const QString& device, const QStringList& servers) {
+    QJsonObject op;
+    op["type"] = "dns";
+    op["device"] = device;
+    op["servers"] = QJsonArray::fromStringList(servers);
+    return op;
+}
+
+QJsonObject PrivilegedOps::gatewayRules(bool enable, const QString& uplink) {
+    QJsonObject op;
+    op["type"] = "gateway";
+    op["enable"] = enable;
+    op["uplink"] = uplink;
+    return op;
+}
+
+QJsonObject PrivilegedOps::netns(bool add, const QString& name) {
+    QJsonObject op;
+    op["type"] = "netns";
+    op["action"] = add ? "add" : "del";
+    op["name"] = name;
+    return op;
+}
+
+bool PrivilegedOps::build(const QList<QJsonObject>& ops, QList<Command>* commands, QString* error) {
+    QList<Command> result;
+    QStringList routeLines;
+
+    // Маршруты подряд копятся и уходят одним ip -batch; -force: ошибка
+    // в одной строке не отменяет остальные
+    auto flushRoutes = [&result, &routeLines]() {
+        if (routeLines.isEmpty()) {
+            return;
+        }
+        result << Command{ "ip", QStringList() << "-force" << "-batch" << "-", routeLines.join('\n').toUtf8() + "\n" };
+        routeLines.clear();
+    };
+
+    for (const QJsonObject& op : ops) {
+        QString type = op.value("type").toString();
+
+        if (type == "route") {
+            QString line = routeLine(op, error);
+            if (line.isEmpty()) {
+                return false;
+            }
+            routeLines << line;
+            continue;
+        }
+        flushRoutes();
+
+        if (type == "sysctl") {
+            QString key = op.value("key").toString();
+            if (!sysctlKeys.contains(key)) {
+                *error = QString("ключ sysctl не разрешен: %1").arg(key);
+                return false;
+            }
+            int value = op.value("value").toInt(-1);
+            int maxValue = key == "net.ipv4.fib_multipath_hash_policy" ? 3 : 1;
+            if (value < 0 || value > maxValue) {
+                *error = QString("недопустимое значение %1 для %2").arg(value).arg(key);
+                return false;
+            }
+            result << Command{ "sysctl", QStringList() << "-w" << QString("%1=%2").arg(key).arg(value), QByteArray() };
+        } else if (type == "dns") {
+            QString device = op.value("device").toString();
+            QStringList servers;
+            for (const QJsonValue& value : op.value("servers").toArray()) {
+                servers << value.toString();
+            }
+            if (!isTunDevice(device)) {
+                *error = QString("DNS разрешено менять только для tun, а не %1").arg(device);
+                return false;
+            }
+            if (servers.isEmpty() || servers.size() > kMaxDnsServers) {
+                *error = "неверное число DNS-серверов";
+                return false;
+            }
+            for (const QString& server : servers) {
+                if (QHostAddress(server).isNull()) {
+                    *error = QString("неверный адрес DNS: %1").arg(server);
+                    return false;
+                }
+            }
+            result << Command{ "resolvectl", QStringList() << "dns" << device << servers, QByteArray() };
+            // "~." — этот интерфейс обслуживает все домены
+            result << Command{ "resolvectl", QStringList() << "domain" << device << "~.", QByteArray() };
+        } else if (type == "gateway") {
+            QString uplink = op.value("uplink").toString();
+            if (!isPhysicalDevice(uplink)) {
+                *error = QString("внешний интерфейс шлюза отклонен: %1").arg(uplink);
+                return false;
+            }
+            // Переключение без разрыва, резерв и объединение меняют набор tun, пока
+            // шлюз включен; правила на tun+ остаются верными для любого из них
+            QString action = op.value("enable").toBool() ? "-A" : "-D";
+            result << Command{ "iptables", QStringList() << "-t" << "nat" << action << "POSTROUTING"
+                               << "-o" << "tun+" << "-j" << "MASQUERADE", QByteArray() }
+                   << Command{ "iptables", QStringList() << action << "FORWARD" << "-i" << "tun+" << "-o" << uplink
+                               << "-m" << "state" << "--state" << "RELATED,ESTABLISHED" << "-j" << "ACCEPT", QByteArray() }
+                   << Command{ "iptables", QStringList() << action << "FORWARD" << "-i" << uplink << "-o" << "tun+"
+                               << "-j" << "ACCEPT", QByteArray() };
+        } else if (type == "netns") {
+            static const QRegularExpression namePattern("^vpngate-t\\d{1,2}$");
+            QString action = op.value("action").toString();
+            QString name = op.value("name").toString();
+            if ((action != "add" && action != "del") || !namePattern.match(name).hasMatch()) {
+                *error = QString("namespace отклонен: %1 %2").arg(action, name);
+                return false;
+            }
+            result << Command{ "ip", QStringList() << "netns" << action << name, QByteArray() };
+        } else {
+            *error = QString("неизвестная операция: %1").arg(type);
+            return false;
+        }
+    }
+    flushRoutes();
+
+    if (result.isEmpty()) {
+        *error = "нет операций";
+        return false;
+    }
+    *commands = result;
+    return true;
+}
+
+QByteArray PrivilegedOps::shellScript(const QList<Command>& commands) {
+    auto quote = [](QString text) {
+        return "'" + text.replace("'", "'\\''") + "'";
+    };
+
+    QStringList lines;
+    for (const Command& command : commands) {
+        QStringList quoted;
+        quoted << quote(command.program);
+        for (const QString& arg : command.args) {
+            quoted << quote(arg);
+        }
+        QString line = quoted.join(' ');
+        if (!command.input.isEmpty()) {
+            // Ввод ip -batch — построчно через printf, без временных файлов
+            QStringList inputLines;
+            for (const QString& inputLine : QString::fromUtf8(command.input).split('\n', Qt::SkipEmptyParts)) {
+                inputLines << quote(inputLine);
+            }
+            line = QString("printf '%s\\n' %1 | %2").arg(inputLines.join(' '), line);
+        }
+        lines << line + " 2>&1 || failed=1";
+    }
+    return ("failed=0\n" + lines.join('\n') + "\nexit $failed\n").toUtf8();
+}
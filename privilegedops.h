@@ -0,0 +1,54 @@
+#ifndef PRIVILEGEDOPS_H
+#define PRIVILEGEDOPS_H
+
+#include <QJsonObject>
+#include <QList>
+#include <QPair>
+#include <QStringList>
+#include <QByteArray>
+
+// Закрытый набор действий от root. GUI описывает, что сделать (маршрут через
+// tun, ключ sysctl, DNS туннеля), а не какую программу запустить: build()
+// проверяет поля и сам собирает командную строку. Помощник выполняет только
+// такие операции; без помощника те же команды идут через sudo.
+class PrivilegedOps {
+public:
+    struct Command {
+        QString program;
+        QStringList args;
+        QByteArray input;
+    };
+
+    // 0.0.0.0/1 или 128.0.0.0/1 через одно tun-устройство
+    static QJsonObject tunnelRoute(const QString& prefix, const QString& device);
+    // Те же половины через несколько tun с весами (объединение туннелей)
+    static QJsonObject multipathRoute(const QString& prefix, const QList<QPair<QString, int>>& nexthops);
+    // Адрес сервера /32 мимо туннеля: через шлюз физического интерфейса
+    static QJsonObject hostRoute(const QString& prefix, const QString& gateway, const QString& device);
+    // Снятие маршрута /32 или половины 0/1, 128/1
+    static QJsonObject routeDelete(const QString& prefix);
+    // Только ключи из белого списка: переключатели 0/1, политика хэша multipath 0–3
+    static QJsonObject sysctl(const QString& key, int value);
+    // resolvectl dns и domain "~." для tun-устройства
+    static QJsonObject tunnelDns(const QString& device, const QStringList& servers);
+    // Правила NAT и FORWARD шлюза между tun+ и внешним интерфейсом
+    static QJsonObject gatewayRules(bool enable, const QString& uplink);
+    // Namespace проверки туннелей (vpngate-tN)
+    static QJsonObject netns(bool add, const QString& name);
+
+    // Проверка всех операций и сборка команд; соседние маршруты идут одним
+    // ip -batch. false — хотя бы одна операция отклонена, не выполняется ничего
+    static bool build(const QList<QJsonObject>& ops, QList<Command>* commands, QString* error);
+
+    // Команды одним shell-скриптом для sudo sh -s; ошибка одной не отменяет следующие
+    static QByteArray shellScript(const QList<Command>& commands);
+
+    // up-скрипт openvpn для проверки туннеля: переносит tun в namespace
+    // (первый аргумент) и настраивает там адрес и маршрут по умолчанию
+    static QByteArray netnsUpScript();
+
+    static bool isTunDevice(const QString& name);
+    static bool isPhysicalDevice(const QString& name);
+};
+
+#endif // PRIVILEGEDOPS_H
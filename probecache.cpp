@@ -0,0 +1,152 @@
+#include "probecache.h"
+#include <QSettings>
+#include <QDateTime>
+
+namespace {
+// Во сколько раз TTL может вырасти для стабильно отвечающего сервера
+const int kMaxTtlGrowthShift = 4;
+}
+
+ProbeCache::ProbeCache(QSettings* storage)
+: storage(storage), dirty(false) {
+    load();
+}
+
+int ProbeCache::baseTtlSec(ProbeType type) {
+    switch (type) {
+        case ProbeType::Icmp:       return 5 * 60;
+        case ProbeType::Tcp:        return 5 * 60;
+        case ProbeType::Handshake:  return 10 * 60;
+        case ProbeType::FullTunnel: return 30 * 60;
+    }
+    return 5 * 60;
+}
+
+QString ProbeCache::entryKey(const QString& identity, ProbeType type) {
+    return QString("%1#%2").arg(static_cast<int>(type)).arg(identity);
+}
+
+void ProbeCache::record(const QString& identity, ProbeType type, bool success, int valueMs, double measuredMbps) {
+    QString key = entryKey(identity, type);
+    ProbeEntry entry = entries.value(key);
+    int base = baseTtlSec(type);
+
+    if (entry.timestampMs > 0 && entry.success == success) {
+        entry.streak = qMin(entry.streak + 1, kMaxTtlGrowthShift);
+        entry.ttlSec = base << entry.streak;
+    } else if (entry.timestampMs > 0) {
+        // Результат сменился — сервер нестабилен, проверяем его чаще
+        entry.streak = 0;
+        entry.ttlSec = qMax(60, base / 4);
+    } else {
+        entry.streak = 0;
+        entry.ttlSec = success ? base : base / 2;
+    }
+
+    entry.success = success;
+    entry.valueMs = valueMs;
+    if (measuredMbps > 0.0 || !success) {
+        entry.measuredMbps = measuredMbps;
+    }
+    entry.timestampMs = QDateTime::currentMSecsSinceEpoch();
+
+    entries.insert(key, entry);
+    dirty = true;
+}
+
+bool ProbeCache::lookup(const QString& identity, ProbeType type, ProbeEntry* entry) const {
+    auto it = entries.constFind(entryKey(identity, type));
+    if (it == entries.constEnd() || !it->isFresh(QDateTime::currentMSecsSinceEpoch())) {
+        return false;
+    }
+    if (entry) {
+        *entry = it.value();
+    }
+    return true;
+}
+
+void ProbeCache::applyTo(VpnServer& server) const {
+    ProbeEntry entry;
+    QString identity = server.identity();
+
+    if (lookup(identity, ProbeType::Icmp, &entry)) {
+        server.tested = true;
+        if (entry.success && entry.valueMs >= 0) {
+            server.testPing = entry.valueMs;
+        }
+    }
+
+    if (lookup(identity, ProbeType::Handshake, &entry)) {
+        server.tested = true;
+        if (entry.success && entry.valueMs >= 0) {
+            server.testPing = entry.valueMs;
+        }
+        server.estimatedMbps = entry.measuredMbps;
+    }
+
+    if (lookup(identity, ProbeType::FullTunnel, &entry)) {
+        server.tested = true;
+        server.realConnectionTested = true;
+        server.available = entry.success;
+        server.handshakeMs = entry.success ? entry.valueMs : -1;
+        if (entry.measuredMbps > 0.0) {
+            server.measuredMbps = entry.measuredMbps;
+        }
+    }
+}
+
+void ProbeCache::load() {
+    entries.clear();
+    if (!storage) {
+        return;
+    }
+
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    int size = storage->beginReadArray("probes");
+    for (int i = 0; i < size; ++i) {
+        storage->setArrayIndex(i);
+        ProbeEntry entry;
+        entry.success = storage->value("success").toBool();
+        entry.valueMs = storage->value("valueMs", -1).toInt();
+        entry.measuredMbps = storage->value("mbps", 0.0).toDouble();
+        entry.timestampMs = storage->value("timestamp").toLongLong();
+        entry.ttlSec = storage->value("ttl").toInt();
+        entry.streak = storage->value("streak").toInt();
+
+        // Давно устаревшие записи не нужны даже для расчета стабильности
+        if (now > entry.timestampMs + static_cast<qint64>(entry.ttlSec) * 4000) {
+            continue;
+        }
+        entries.insert(storage->value("key").toString(), entry);
+    }
+    storage->endArray();
+    dirty = false;
+}
+
+void ProbeCache::save() {
+    if (!storage || !dirty) {
+        return;
+    }
+
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    storage->remove("probes");
+    storage->beginWriteArray("probes");
+    int index = 0;
+    for (auto it = entries.constBegin(); it != entries.constEnd(); ++it) {
+        const ProbeEntry& entry = it.value();
+        if (now > entry.timestampMs + static_cast<qint64>(entry.ttlSec) * 4000) {
+            continue;
+        }
+        storage->setArrayIndex(index++);
+        storage->setValue("key", it.key());
+        storage->setValue("success", entry.success);
+        storage->setValue("valueMs", entry.valueMs);
+        storage->setValue("mbps", entry.measuredMbps);
+        storage->setValue("timestamp", entry.timestampMs);
+        storage->setValue("ttl", entry.ttlSec);
+        storage->setValue("streak", entry.streak);
+    }
+    storage->endArray();
+    storage->sync();
+    dirty = false;
+}
@@ -0,0 +1,62 @@
+#ifndef PROBECACHE_H
+#define PROBECACHE_H
+
+#include <QString>
+#include <QHash>
+#include "vpntypes.h"
+
+class QSettings;
+
+// Тип проверки, результат которой кэшируется
+enum class ProbeType {
+    Icmp,        // ping
+    Tcp,         // TCP connect до порта сервера
+    Handshake,   // Ответ OpenVPN на HARD_RESET (UDP)
+    FullTunnel   // Полное подключение в отдельном namespace
+};
+
+struct ProbeEntry {
+    bool success;
+    int valueMs;          // RTT / время рукопожатия
+    double measuredMbps;  // FullTunnel — скорость через туннель, Handshake — оценка по серии пакетов
+    qint64 timestampMs;
+    int ttlSec;
+    int streak;           // Сколько раз подряд результат не менялся
+
+    ProbeEntry()
+    : success(false), valueMs(-1), measuredMbps(0.0), timestampMs(0), ttlSec(0), streak(0) {
+    }
+
+    bool isFresh(qint64 nowMs) const {
+        return timestampMs > 0 && nowMs < timestampMs + static_cast<qint64>(ttlSec) * 1000;
+    }
+};
+
+// Кэш результатов проверок, общий для обновлений списка и перезапусков.
+// TTL адаптивный: стабильные серверы перепроверяются редко, нестабильные — часто.
+class ProbeCache {
+public:
+    explicit ProbeCache(QSettings* storage);
+
+    void record(const QString& identity, ProbeType type, bool success, int valueMs, double measuredMbps = 0.0);
+    bool lookup(const QString& identity, ProbeType type, ProbeEntry* entry = nullptr) const;
+    bool isFresh(const QString& identity, ProbeType type) const { return lookup(identity, type); }
+
+    // Восстанавливает флаги проверок сервера после загрузки нового списка
+    void applyTo(VpnServer& server) const;
+
+    void load();
+    void save();
+    int size() const { return entries.size(); }
+
+    static int baseTtlSec(ProbeType type);
+
+private:
+    QSettings* storage;
+    QHash<QString, ProbeEntry> entries;
+    bool dirty;
+
+    static QString entryKey(const QString& identity, ProbeType type);
+};
+
+#endif // PROBECACHE_H
@@ -0,0 +1,226 @@
+#include "serverprofiles.h"
+#include <QSettings>
+#include <QStringList>
+#include <QDateTime>
+
+namespace {
+const double kThroughputDecay = 0.75;   // Доля прежнего значения, если новая сессия была медленнее
+// Варианты по порядку; "none" — убрать сжатие из конфига совсем
+const QStringList kCompressionFixes = { "comp-lzo yes", "comp-lzo no", "none" };
+// Старые серверы VPNGate работают на CBC-шифрах без согласования
+const QStringList kCipherFixes = { "AES-128-CBC", "AES-256-CBC", "BF-CBC" };
+
+// Пусто — варианты кончились
+QString nextFix(const QStringList& fixes, const QString& current) {
+    if (current.isEmpty()) {
+        return fixes.value(0);
+    }
+    int index = fixes.indexOf(current);
+    return index >= 0 ? fixes.value(index + 1) : QString();
+}
+}
+
+QString configProblemName(ConfigProblem problem) {
+    switch (problem) {
+    case ConfigProblem::Compression: return "сжатие";
+    case ConfigProblem::Cipher:      return "шифр";
+    case ConfigProblem::Fragment:    return "fragment";
+    case ConfigProblem::PathMtu:     return "MTU";
+    }
+    return QString();
+}
+
+QString ConfigOverrides::summary() const {
+    QStringList parts;
+    if (!compression.isEmpty()) {
+        parts << (compression == "none" ? QString("без сжатия") : compression);
+    }
+    if (!cipher.isEmpty()) {
+        parts << QString("шифр %1").arg(cipher);
+    }
+    if (noFragment) {
+        parts << "без fragment";
+    }
+    if (pathMtu > 0) {
+        parts << QString("путь %1 байт").arg(pathMtu);
+    }
+    return parts.join(", ");
+}
+
+ConfigOverrides ServerProfiles::Profile::effective() const {
+    ConfigOverrides result = overrides;
+    if (measuredMtu > 0 && (result.pathMtu == 0 || measuredMtu < result.pathMtu)) {
+        result.pathMtu = measuredMtu;
+    }
+    return result;
+}
+
+ServerProfiles::ServerProfiles(QSettings* storage)
+: storage(storage), dirty(false) {
+    load();
+}
+
+ConfigOverrides ServerProfiles::overrides(const QString& identity) const {
+    return profiles.value(identity).effective();
+}
+
+bool ServerProfiles::learn(const VpnServer& server, ConfigProblem problem, const QString& detail, QString* change) {
+    Profile& profile = profiles[server.identity()];
+    profile.name = server.name;
+    profile.lastProblem = configProblemName(problem);
+    profile.failures++;
+    profile.updatedMs = QDateTime::currentMSecsSinceEpoch();
+    dirty = true;
+
+    ConfigOverrides& overrides = profile.overrides;
+    bool applied = true;
+    switch (problem) {
+    case ConfigProblem::Compression:
+        // Текущая поправка не помогла (или ее не было) — берем следующую
+        overrides.compression = nextFix(kCompressionFixes, overrides.compression);
+        applied = !overrides.compression.isEmpty();
+        *change = applied ? QString("сжатие: %1").arg(overrides.compression) : QString("сжатие как в конфиге");
+        break;
+    case ConfigProblem::Cipher:
+        overrides.cipher = nextFix(kCipherFixes, overrides.cipher);
+        applied = !overrides.cipher.isEmpty();
+        *change = applied ? QString("шифр: %1").arg(overrides.cipher) : QString("шифр как в конфиге");
+        break;
+    case ConfigProblem::Fragment:
+        applied = !overrides.noFragment;
+        overrides.noFragment = true;
+        *change = "без fragment";
+        break;
+    case ConfigProblem::PathMtu: {
+        int pathMtu = detail.toInt();
+        applied = pathMtu >= 576 && (overrides.pathMtu == 0 || pathMtu < overrides.pathMtu);
+        if (applied) {
+            overrides.pathMtu = pathMtu;
+        }
+        *change = QString("пакеты до %1 байт").arg(overrides.pathMtu);
+        break;
+    }
+    }
+
+    if (profiles.size() > MaxServers) {
+        dropOldest();
+    }
+    return applied;
+}
+
+void ServerProfiles::recordSuccess(const QString& identity) {
+    auto it = profiles.find(identity);
+    if (it == profiles.end()) {
+        return;   // Профиль заводится только после ошибки или замера
+    }
+    it->successes++;
+    it->updatedMs = QDateTime::currentMSecsSinceEpoch();
+    dirty = true;
+}
+
+void ServerProfiles::recordPathMtu(const VpnServer& server, int pathMtu) {
+    Profile& profile = profiles[server.identity()];
+    profile.name = server.name;
+    profile.measuredMtu = pathMtu;
+    profile.measuredMs = QDateTime::currentMSecsSinceEpoch();
+    profile.updatedMs = profile.measuredMs;
+    dirty = true;
+
+    if (profiles.size() > MaxServers) {
+        dropOldest();
+    }
+}
+
+void ServerProfiles::recordThroughput(const VpnServer& server, double peakMbps) {
+    if (peakMbps <= 0.0) {
+        return;
+    }
+    Profile& profile = profiles[server.identity()];
+    profile.name = server.name;
+    profile.achievedMbps = qMax(peakMbps, profile.achievedMbps * kThroughputDecay);
+    profile.updatedMs = QDateTime::currentMSecsSinceEpoch();
+    dirty = true;
+
+    if (profiles.size() > MaxServers) {
+        dropOldest();
+    }
+}
+
+double ServerProfiles::achievedMbps(const QString& identity) const {
+    return profiles.value(identity).achievedMbps;
+}
+
+bool ServerProfiles::needsPathMtuProbe(const QString& identity) const {
+    auto it = profiles.constFind(identity);
+    if (it == profiles.constEnd() || it->measuredMs == 0) {
+        return true;
+    }
+    return QDateTime::currentMSecsSinceEpoch() >= it->measuredMs + static_cast<qint64>(PathMtuTtlSec) * 1000;
+}
+
+void ServerProfiles::dropOldest() {
+    auto oldest = profiles.begin();
+    for (auto it = profiles.begin(); it != profiles.end(); ++it) {
+        if (it->updatedMs < oldest->updatedMs) {
+            oldest = it;
+        }
+    }
+    profiles.erase(oldest);
+}
+
+void ServerProfiles::load() {
+    profiles.clear();
+    if (!storage) {
+        return;
+    }
+
+    int size = storage->beginReadArray("servers");
+    for (int i = 0; i < size; ++i) {
+        storage->setArrayIndex(i);
+        Profile profile;
+        profile.name = storage->value("name").toString();
+        profile.overrides.compression = storage->value("compression").toString();
+        profile.overrides.cipher = storage->value("cipher").toString();
+        profile.overrides.noFragment = storage->value("noFragment").toBool();
+        profile.overrides.pathMtu = storage->value("pathMtu").toInt();
+        profile.lastProblem = storage->value("lastProblem").toString();
+        profile.failures = storage->value("failures").toInt();
+        profile.successes = storage->value("successes").toInt();
+        profile.measuredMtu = storage->value("measuredMtu").toInt();
+        profile.measuredMs = storage->value("measured").toLongLong();
+        profile.achievedMbps = storage->value("achievedMbps").toDouble();
+        profile.updatedMs = storage->value("updated").toLongLong();
+        profiles.insert(storage->value("identity").toString(), profile);
+    }
+    storage->endArray();
+    dirty = false;
+}
+
+void ServerProfiles::save() {
+    if (!storage || !dirty) {
+        return;
+    }
+
+    storage->remove("servers");
+    storage->beginWriteArray("servers");
+    int index = 0;
+    for (auto it = profiles.constBegin(); it != profiles.constEnd(); ++it) {
+        storage->setArrayIndex(index++);
+        storage->setValue("identity", it.key());
+        storage->setValue("name", it->name);
+        storage->setValue("compression", it->overrides.compression);
+        storage->setValue("cipher", it->overrides.cipher);
+        storage->setValue("noFragment", it->overrides.noFragment);
+        storage->setValue("pathMtu", it->overrides.pathMtu);
+        storage->setValue("lastProblem", it->lastProblem);
+        storage->setValue("failures", it->failures);
+        storage->setValue("successes", it->successes);
+        storage->setValue("measuredMtu", it->measuredMtu);
+        storage->setValue("measured", it->measuredMs);
+        storage->setValue("achievedMbps", it->achievedMbps);
+        storage->setValue("updated", it->updatedMs);
+    }
+    storage->endArray();
+    storage->sync();
+    dirty = false;
+}
@@ -0,0 +1,102 @@
+#ifndef SERVERPROFILES_H
+#define SERVERPROFILES_H
+
+#include <QString>
+#include <QHash>
+#include "vpntypes.h"
+
+class QSettings;
+
+// Несовместимость с сервером, замеченная по логу OpenVPN
+enum class ConfigProblem {
+    Compression,   // Сжатие на сервере настроено не так, как в конфиге
+    Cipher,        // Не удалось согласовать или расшифровать шифр данных
+    Fragment,      // Сервер не использует fragment
+    PathMtu        // Пакеты не проходят по размеру (EMSGSIZE)
+};
+
+QString configProblemName(ConfigProblem problem);
+
+// Поправки к конфигу сервера, которые применяет enhanceConfigForConnection
+struct ConfigOverrides {
+    QString compression;   // Директива сжатия вместо указанной в конфиге
+    QString cipher;        // Шифр данных вместо указанного в конфиге
+    bool noFragment;       // Не добавлять fragment
+    int pathMtu;           // Наибольший пакет на пути к серверу (0 — неизвестен)
+    // Подбираются VpnManager по BDP при каждом подключении, в профиле не хранятся
+    int socketBuffer;      // sndbuf/rcvbuf в байтах (0 — по умолчанию)
+    int txQueueLen;        // Очередь tun-устройства в пакетах (0 — по умолчанию)
+
+    ConfigOverrides() : noFragment(false), pathMtu(0), socketBuffer(0), txQueueLen(0) {}
+
+    // Только выученные поправки; буферы на это не влияют
+    bool isEmpty() const { return compression.isEmpty() && cipher.isEmpty() && !noFragment && pathMtu == 0; }
+    QString summary() const;
+
+    bool operator==(const ConfigOverrides& other) const {
+        return compression == other.compression && cipher == other.cipher &&
+        noFragment == other.noFragment && pathMtu == other.pathMtu &&
+        socketBuffer == other.socketBuffer && txQueueLen == other.txQueueLen;
+    }
+    bool operator!=(const ConfigOverrides& other) const { return !(*this == other); }
+};
+
+// Поправки конфигов по серверам, выученные на неудачных подключениях.
+// После ошибки сервер получает следующую поправку из списка для этого вида
+// ошибки; сработавшая остается в профиле и применяется с первой попытки.
+// Сюда же пишется MTU пути, измеренный проверкой сервера: в поправки
+// попадает меньшее из измеренного и выученного по EMSGSIZE.
+// Хранится в QSettings, только недавние серверы.
+class ServerProfiles {
+public:
+    static constexpr int MaxServers = 300;
+    static constexpr int PathMtuTtlSec = 24 * 3600;   // Маршруты меняются, замер устаревает
+
+    explicit ServerProfiles(QSettings* storage);
+
+    ConfigOverrides overrides(const QString& identity) const;
+
+    // Перейти к следующей поправке после ошибки. change — что изменилось, для лога.
+    // false — варианты для этой ошибки кончились, поправка снята
+    bool learn(const VpnServer& server, ConfigProblem problem, const QString& detail, QString* change);
+    void recordSuccess(const QString& identity);
+
+    // Результат проверки MTU пути (ping с DF)
+    void recordPathMtu(const VpnServer& server, int pathMtu);
+    bool needsPathMtuProbe(const QString& identity) const;
+
+    // Скорость, достигнутая в сессии. Хранится с затуханием, чтобы буферы
+    // не оставались завышенными после того, как путь стал медленнее
+    void recordThroughput(const VpnServer& server, double peakMbps);
+    double achievedMbps(const QString& identity) const;
+
+    void load();
+    void save();
+
+private:
+    struct Profile {
+        QString name;
+        ConfigOverrides overrides;   // pathMtu здесь — выученный по EMSGSIZE
+        QString lastProblem;
+        int failures;
+        int successes;
+        int measuredMtu;             // Измеренный проверкой, 0 — не измерялся
+        qint64 measuredMs;
+        double achievedMbps;
+        qint64 updatedMs;
+
+        Profile()
+        : failures(0), successes(0), measuredMtu(0), measuredMs(0), achievedMbps(0.0), updatedMs(0) {
+        }
+
+        ConfigOverrides effective() const;
+    };
+
+    QSettings* storage;
+    QHash<QString, Profile> profiles;
+    bool dirty;
+
+    void dropOldest();
+};
+
+#endif // SERVERPROFILES_H
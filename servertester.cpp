@@ -1,4 +1,6 @@
 #include "servertester.h"
+#include "logclassifier.h"
+#include "openvpnbinary.h"
 #include <QTemporaryFile>
 #include <QTextStream>
 #include <QRegularExpression>
@@ -7,9 +9,19 @@
 #include <QTimer>
 #include <QElapsedTimer>
 #include <QProcess>
+#include <algorithm>
+
+namespace {
+const int kPingSamples = 5;
+const int kMinPathMtu = 576;    // Меньше IPv4 не гарантирует
+const int kMaxPathMtu = 1500;
+const int kIpIcmpHeaderSize = 28;
+const int kDfAttempts = 3;        // Пакетов на каждый размер при поиске MTU пути
+}
 
 ServerTesterThread::ServerTesterThread(const QString& serverIp, const QString& serverName, QObject *parent)
-: QThread(parent), serverIp(serverIp), serverName(serverName), cancelled(false) {
+: QThread(parent), serverIp(serverIp), serverName(serverName), cancelled(false),
+pathMtuProbe(false) {
 }
 
 void ServerTesterThread::setOvpnConfig(const QString& configBase64) {
@@ -37,6 +49,13 @@ void ServerTesterThread::run() {
         return;
     }
 
+    if (pathMtuProbe && !cancelled) {
+        int pathMtu = testPathMtu();
+        if (pathMtu > 0) {
+            emit pathMtuMeasured(pathMtu);
+        }
+    }
+
     // Если есть конфигурация, проверяем реальное подключение
     if (!ovpnConfigBase64.isEmpty()) {
         if (cancelled) {
@@ -61,10 +80,11 @@ bool ServerTesterThread::testPing() {
     QProcess pingProcess;
     QStringList args;
 
+    // Несколько проб, чтобы получить медиану, джиттер и потери
     #ifdef Q_OS_WINDOWS
-    args << "-n" << "2" << "-w" << "3000" << serverIp;
+    args << "-n" << QString::number(kPingSamples) << "-w" << "2000" << serverIp;
     #else
-    args << "-c" << "2" << "-W" << "3" << serverIp;
+    args << "-c" << QString::number(kPingSamples) << "-i" << "0.2" << "-W" << "2" << serverIp;
     #endif
 
     pingProcess.start("ping", args);
@@ -74,8 +94,9 @@ bool ServerTesterThread::testPing() {
         return false;
     }
 
-    if (!pingProcess.waitForFinished(5000)) {
+    if (!pingProcess.waitForFinished(kPingSamples * 2000 + 3000)) {
         pingProcess.kill();
+        emit latencySamples(QList<double>(), kPingSamples);
         emit testProgress("⏰ Таймаут ping");
         return false;
     }
@@ -83,14 +104,31 @@ bool ServerTesterThread::testPing() {
     QString output = QString::fromLocal8Bit(pingProcess.readAllStandardOutput());
     int exitCode = pingProcess.exitCode();
 
-    if (exitCode == 0) {
-        // Парсим время пинга
-        QRegularExpression re("time[=<](\\d+\\.?\\d*)");
-        QRegularExpressionMatch match = re.match(output);
+    // Собираем все замеры, а не только первый
+    QList<double> samples;
+    QRegularExpression re("time[=<](\\d+\\.?\\d*)");
+    QRegularExpressionMatchIterator it = re.globalMatch(output);
+    while (it.hasNext()) {
+        samples.append(it.next().captured(1).toDouble());
+    }
 
-        if (match.hasMatch()) {
-            float pingTime = match.captured(1).toFloat();
-            emit testProgress(QString("✅ Ping успешен: %1 ms").arg(pingTime));
+    int sent = kPingSamples;
+    QRegularExpression summary("(\\d+) packets transmitted, (\\d+) (packets )?received");
+    QRegularExpressionMatch summaryMatch = summary.match(output);
+    if (summaryMatch.hasMatch()) {
+        sent = summaryMatch.captured(1).toInt();
+    }
+    int lost = qMax(0, sent - static_cast<int>(samples.size()));
+    emit latencySamples(samples, lost);
+
+    if (exitCode == 0) {
+        if (!samples.isEmpty()) {
+            QList<double> sorted = samples;
+            std::sort(sorted.begin(), sorted.end());
+            emit testProgress(QString("✅ Ping успешен: медиана %1 ms, потери %2/%3")
+            .arg(sorted[sorted.size() / 2], 0, 'f', 1)
+            .arg(lost)
+            .arg(sent));
             return true;
         } else {
             emit testProgress("✅ Ping успешен (время не получено)");
@@ -102,6 +140,94 @@ bool ServerTesterThread::testPing() {
     }
 }
 
+// Двоичный поиск наибольшего пакета, который проходит до сервера с запретом фрагментации.
+// Обычно хватает одной пробы: путь пропускает 1500 байт
+int ServerTesterThread::testPathMtu() {
+    int reportedMtu = 0;
+    if (pingWithDontFragment(kMaxPathMtu, &reportedMtu) == DfResult::Passed) {
+        emit testProgress(QString("✅ MTU пути: %1 байт").arg(kMaxPathMtu));
+        return kMaxPathMtu;
+    }
+    // Без явной ошибки 1500 байт тоже ищем дальше: ping до сервера только что
+    // прошел, а путь, молча отбрасывающий большие пакеты, — как раз наш случай.
+    // Неопределенным MTU считается, только если не проходит и самый малый размер
+
+    int good = kMinPathMtu - 1;
+    int bad = kMaxPathMtu;
+    // Ядро уже знает MTU пути (ICMP fragmentation needed) — начинаем с него
+    if (reportedMtu >= kMinPathMtu && reportedMtu < kMaxPathMtu) {
+        if (pingWithDontFragment(reportedMtu, nullptr) == DfResult::Passed) {
+            good = reportedMtu;
+        } else {
+            bad = reportedMtu;
+        }
+    }
+
+    while (bad - good > 8 && !cancelled) {
+        int size = (good + bad) / 2;
+        if (pingWithDontFragment(size, nullptr) == DfResult::Passed) {
+            good = size;
+        } else {
+            bad = size;
+        }
+    }
+
+    if (good < kMinPathMtu && !cancelled && pingWithDontFragment(kMinPathMtu, nullptr) == DfResult::Passed) {
+        good = kMinPathMtu;
+    }
+    if (good < kMinPathMtu) {
+        emit testProgress("⚠️ MTU пути не определен: пакеты с DF не проходят");
+        return 0;
+    }
+    emit testProgress(QString("📏 MTU пути: %1 байт").arg(good));
+    return good;
+}
+
+ServerTesterThread::DfResult ServerTesterThread::pingWithDontFragment(int packetSize, int* reportedMtu) {
+    QProcess pingProcess;
+    QStringList args;
+    int payload = packetSize - kIpIcmpHeaderSize;
+
+    // Несколько попыток на размер: одна потерянная не должна уменьшать MTU пути
+    #ifdef Q_OS_WINDOWS
+    args << "-n" << QString::number(kDfAttempts) << "-w" << "1000" << "-f" << "-l" << QString::number(payload)
+         << serverIp;
+    #else
+    args << "-c" << QString::number(kDfAttempts) << "-i" << "0.2" << "-W" << "1" << "-M" << "do"
+         << "-s" << QString::number(payload) << serverIp;
+    #endif
+
+    pingProcess.setProcessChannelMode(QProcess::MergedChannels);   // "local error" идет в stderr
+    pingProcess.start("ping", args);
+    if (!pingProcess.waitForStarted(3000)) {
+        return DfResult::Lost;
+    }
+    if (!pingProcess.waitForFinished(kDfAttempts * 1000 + 3000)) {
+        pingProcess.kill();
+        return DfResult::Lost;
+    }
+    if (pingProcess.exitCode() == 0) {
+        return DfResult::Passed;   // ping завершается с 0, если пришел хоть один ответ
+    }
+
+    // "local error: message too long, mtu=1400" / "Frag needed and DF set (mtu = 1400)" /
+    // Windows: "Packet needs to be fragmented but DF set."
+    QString output = QString::fromLocal8Bit(pingProcess.readAll());
+    static const QRegularExpression tooBigRe("message too long|frag needed|needs to be fragmented",
+                                             QRegularExpression::CaseInsensitiveOption);
+    if (!tooBigRe.match(output).hasMatch()) {
+        return DfResult::Lost;
+    }
+    if (reportedMtu) {
+        QRegularExpression mtuRe("mtu ?= ?(\\d+)");
+        QRegularExpressionMatch match = mtuRe.match(output);
+        if (match.hasMatch()) {
+            *reportedMtu = match.captured(1).toInt();
+        }
+    }
+    return DfResult::TooBig;
+}
+
 bool ServerTesterThread::testRealConnection() {
     if (ovpnConfigBase64.isEmpty()) {
         emit testProgress("❌ Нет конфигурации OpenVPN для тестирования");
@@ -126,8 +252,9 @@ bool ServerTesterThread::testRealConnection() {
 
         emit testProgress("📄 Создан временный конфиг OpenVPN");
 
+        QString openvpnPath = OpenVpnBinary::resolve().path;
         QStringList args = {
-            "openvpn",
+            openvpnPath.isEmpty() ? QString("openvpn") : openvpnPath,
             "--config", tempFile.fileName(),
             "--auth-user-pass", "/dev/stdin",
             "--verb", "0",
@@ -154,31 +281,32 @@ bool ServerTesterThread::testRealConnection() {
         openvpnProcess.closeWriteChannel();
 
         bool connected = false;
-        QString output;
+        bool failed = false;
 
         // Ждем не более 15 секунд
-        while (timer.elapsed() < 15000) {
+        while (timer.elapsed() < 15000 && !connected && !failed) {
             if (!openvpnProcess.waitForReadyRead(100)) {
                 continue;
             }
 
-            output += QString::fromUtf8(openvpnProcess.readAll());
-
-            if (output.contains("Initialization Sequence Completed")) {
-                connected = true;
-                int connectionTime = timer.elapsed();
-                emit testProgress(QString("✅ VPN подключение успешно установлено за %1 ms").arg(connectionTime));
-                break;
-            }
+            while (openvpnProcess.canReadLine()) {
+                LogEvent event = LogClassifier::instance().classify(openvpnProcess.readLine());
 
-            if (output.contains("AUTH_FAILED") ||
-                output.contains("TLS Error") ||
-                output.contains("connection failed")) {
-                emit testProgress("❌ Ошибка аутентификации/подключения");
-            break;
+                if (event == LogEvent::Connected) {
+                    connected = true;
+                    int connectionTime = timer.elapsed();
+                    emit testProgress(QString("✅ VPN подключение успешно установлено за %1 ms").arg(connectionTime));
+                    break;
                 }
 
-                QThread::msleep(100);
+                if (event == LogEvent::AuthFailed ||
+                    event == LogEvent::TlsError ||
+                    event == LogEvent::NetworkError) {
+                    emit testProgress("❌ Ошибка аутентификации/подключения");
+                    failed = true;
+                    break;
+                }
+            }
         }
 
         if (openvpnProcess.state() == QProcess::Running) {
@@ -215,8 +343,7 @@ QString ServerTesterThread::enhanceConfigForTest(const QString& configContent) {
         if (trimmed.startsWith("cipher ")) {
             QString cipher = trimmed.split(' ')[1];
             enhancedLines.append(QString("# %1").arg(trimmed));
-            enhancedLines.append(QString("data-ciphers AES-256-GCM:AES-128-GCM:CHACHA20-POLY1305:%1").arg(cipher));
-            enhancedLines.append(QString("data-ciphers-fallback %1").arg(cipher));
+            enhancedLines.append(OpenVpnBinary::resolve().cipherDirectives(cipher));
         } else if (trimmed.contains("fragment") || trimmed.contains("mssfix")) {
             // Пропускаем проблемные настройки
             enhancedLines.append(QString("# %1  # Отключено для теста").arg(trimmed));
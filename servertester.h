@@ -13,11 +13,18 @@ class ServerTesterThread : public QThread
 public:
     explicit ServerTesterThread(const QString& serverIp, const QString& serverName, QObject *parent = nullptr);
     void setOvpnConfig(const QString& configBase64);
+    // После успешного ping измерить MTU пути к серверу
+    void setPathMtuProbe(bool enabled) { pathMtuProbe = enabled; }
     void cancel();
 
+    // Общая подготовка конфига для тестовых подключений (используется и TunnelTester)
+    static QString enhanceConfigForTest(const QString& configContent);
+
 signals:
     void testFinished(bool success, const QString& message, int pingMs);
     void testProgress(const QString& message);
+    void latencySamples(const QList<double>& rttMs, int lost);
+    void pathMtuMeasured(int pathMtu);
     void realConnectionTestFinished(bool success, const QString& message);
 
 protected:
@@ -28,10 +35,19 @@ private:
     QString serverName;
     QString ovpnConfigBase64;
     bool cancelled;
+    bool pathMtuProbe;
 
     bool testPing();
+    // Итог проверки одного размера с запретом фрагментации
+    enum class DfResult {
+        Passed,     // Ответ пришел хотя бы на одну попытку
+        TooBig,     // Явная ошибка: message too long / Frag needed
+        Lost        // Все попытки без ответа — причина неизвестна
+    };
+
+    int testPathMtu();
+    DfResult pingWithDontFragment(int packetSize, int* reportedMtu);
     bool testRealConnection();
-    QString enhanceConfigForTest(const QString& configContent);
     void cleanup();
 };
 
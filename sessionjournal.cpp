@@ -0,0 +1,135 @@
+#include "sessionjournal.h"
+#include <QSettings>
+#include <QStandardPaths>
+#include <QDir>
+#include <QFile>
+#include <QRandomGenerator>
+
+SessionJournal& SessionJournal::instance() {
+    static SessionJournal journal;
+    return journal;
+}
+
+SessionJournal::SessionJournal()
+: storage(new QSettings("VPNGateManager", "Sessions")) {
+}
+
+QString SessionJournal::createSessionDir(QString* error) {
+    QString base = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation);
+    if (base.isEmpty()) {
+        base = QDir::tempPath();
+    }
+    QDir root(QDir(base).filePath("vpngate-sessions"));
+    if (!root.mkpath(".")) {
+        *error = QString("не удалось создать %1").arg(root.path());
+        return QString();
+    }
+    QFile::setPermissions(root.path(), QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner);
+
+    QString name = QString("%1-%2").arg(QDateTime::currentSecsSinceEpoch())
+    .arg(QRandomGenerator::global()->generate(), 8, 16, QChar('0'));
+    QString dir = root.filePath(name);
+    if (!root.mkdir(name)) {
+        *error = QString("не удалось создать %1").arg(dir);
+        return QString();
+    }
+    QFile::setPermissions(dir, QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner);
+    return dir;
+}
+
+void SessionJournal::removeSessionDir(const QString& dir) {
+    if (!dir.isEmpty()) {
+        QDir(dir).removeRecursively();
+    }
+}
+
+void SessionJournal::record(const JournalEntry& entry) {
+    storage->beginGroup(entry.id);
+    storage->setValue("dir", entry.sessionDir);
+    storage->setValue("socket", entry.socketPath);
+    storage->setValue("pid", entry.pid);
+    storage->setValue("name", entry.server.name);
+    storage->setValue("ip", entry.server.ip);
+    storage->setValue("port", entry.server.port);
+    storage->setValue("protocol", entry.server.protocol);
+    storage->setValue("country", entry.server.country);
+    storage->setValue("device", entry.device);
+    storage->setValue("dns", entry.dns);
+    storage->setValue("redirectGateway", entry.redirectGateway);
+    storage->setValue("routeNoExec", entry.routeNoExec);
+    storage->setValue("hostRoute", entry.hostRoute);
+    storage->setValue("active", entry.active);
+    storage->setValue("startedAt", entry.startedAt);
+    storage->endGroup();
+    storage->sync();
+}
+
+void SessionJournal::setPid(const QString& id, qint64 pid) {
+    if (!storage->childGroups().contains(id)) {
+        return;
+    }
+    storage->setValue(id + "/pid", pid);
+    storage->sync();
+}
+
+void SessionJournal::setTunnel(const QString& id, const QString& device, const QStringList& dns, bool redirectGateway) {
+    if (!storage->childGroups().contains(id)) {
+        return;
+    }
+    storage->setValue(id + "/device", device);
+    storage->setValue(id + "/dns", dns);
+    storage->setValue(id + "/redirectGateway", redirectGateway);
+    storage->sync();
+}
+
+void SessionJournal::markActive(const QString& id) {
+    for (const QString& group : storage->childGroups()) {
+        storage->setValue(group + "/active", group == id);
+    }
+    storage->sync();
+}
+
+void SessionJournal::remove(const QString& id) {
+    storage->remove(id);
+    storage->sync();
+}
+
+QList<JournalEntry> SessionJournal::entries() const {
+    QList<JournalEntry> result;
+    for (const QString& group : storage->childGroups()) {
+        storage->beginGroup(group);
+        JournalEntry entry;
+        entry.id = group;
+        entry.sessionDir = storage->value("dir").toString();
+        entry.socketPath = storage->value("socket").toString();
+        entry.pid = storage->value("pid").toLongLong();
+        entry.server.name = storage->value("name").toString();
+        entry.server.ip = storage->value("ip").toString();
+        entry.server.port = storage->value("port", 1194).toInt();
+        entry.server.protocol = storage->value("protocol").toString();
+        entry.server.country = storage->value("country").toString();
+        entry.device = storage->value("device").toString();
+        entry.dns = storage->value("dns").toStringList();
+        entry.redirectGateway = storage->value("redirectGateway").toBool();
+        entry.routeNoExec = storage->value("routeNoExec").toBool();
+        entry.hostRoute = storage->value("hostRoute").toString();
+        entry.active = storage->value("active").toBool();
+        entry.startedAt = storage->value("startedAt").toDateTime();
+        storage->endGroup();
+        result.append(entry);
+    }
+    return result;
+}
+
+bool SessionJournal::isAlive(const JournalEntry& entry) {
+    if (entry.pid <= 0 || entry.socketPath.isEmpty()) {
+        return false;
+    }
+    // cmdline доступен на чтение и для процессов root; аргументы разделены нулями
+    QFile cmdline(QString("/proc/%1/cmdline").arg(entry.pid));
+    if (!cmdline.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QList<QByteArray> args = cmdline.readAll().split('\0');
+    return args.contains(QFile::encodeName(entry.socketPath));
+}
@@ -0,0 +1,60 @@
+#ifndef SESSIONJOURNAL_H
+#define SESSIONJOURNAL_H
+
+#include <QString>
+#include <QStringList>
+#include <QDateTime>
+#include <QList>
+#include "vpntypes.h"
+
+class QSettings;
+
+// Запись о запущенном нами процессе openvpn
+struct JournalEntry {
+    QString id;              // Имя каталога сессии
+    QString sessionDir;      // Каталог с management-сокетом, pid и логом openvpn
+    QString socketPath;
+    qint64 pid;
+    VpnServer server;        // Имя, адрес, порт, протокол, страна
+    QString device;
+    QStringList dns;
+    bool redirectGateway;
+    bool routeNoExec;        // Маршруты ставил VpnManager, а не openvpn
+    QString hostRoute;       // Маршрут до сервера через физический шлюз
+    bool active;             // Через эту сессию шел трафик
+    QDateTime startedAt;
+
+    JournalEntry() : pid(0), redirectGateway(false), routeNoExec(false), active(false) {}
+};
+
+// Журнал сессий на диске. Пишется при каждом изменении и сразу сбрасывается,
+// поэтому переживает падение приложения. При запуске по нему находим свои
+// процессы openvpn: живой активный туннель подхватываем через management-сокет,
+// остальные свои завершаем. Чужие openvpn не трогаем.
+class SessionJournal {
+public:
+    static SessionJournal& instance();
+
+    // Каталог для новой сессии (0700). Лежит в XDG_RUNTIME_DIR, а не во временном
+    // каталоге процесса, чтобы сокет пережил перезапуск приложения
+    static QString createSessionDir(QString* error);
+    static void removeSessionDir(const QString& dir);
+
+    void record(const JournalEntry& entry);
+    void setPid(const QString& id, qint64 pid);
+    void setTunnel(const QString& id, const QString& device, const QStringList& dns, bool redirectGateway);
+    void markActive(const QString& id);   // Остальные записи перестают быть активными
+    void remove(const QString& id);
+    QList<JournalEntry> entries() const;
+
+    // Процесс жив и это тот самый openvpn: в его командной строке наш сокет.
+    // Защищает от переиспользования pid после перезагрузки
+    static bool isAlive(const JournalEntry& entry);
+
+private:
+    SessionJournal();
+
+    QSettings* storage;
+};
+
+#endif // SESSIONJOURNAL_H
@@ -0,0 +1,147 @@
+#include "systemcommand.h"
+#include "privilegedhelper.h"
+#include "privilegedops.h"
+#include <QProcess>
+#include <QJsonArray>
+#include <QTimer>
+#include <QPointer>
+#include <unistd.h>
+
+bool SystemCommand::isRoot() {
+    return getuid() == 0;
+}
+
+void SystemCommand::run(const QString& program, const QStringList& args, QObject* context,
+                        Callback done, const QByteArray& input, int timeoutMs) {
+    QProcess* process = new QProcess();
+    process->setProcessChannelMode(QProcess::MergedChannels);
+
+    QPointer<QObject> guard(context);
+    QTimer* timer = new QTimer(process);
+    timer->setSingleShot(true);
+    QObject::connect(timer, &QTimer::timeout, process, [process]() {
+        process->kill();
+    });
+
+    QObject::connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), process,
+                     [process, guard, done](int exitCode, QProcess::ExitStatus status) {
+        QString output = QString::fromUtf8(process->readAll()).trimmed();
+        process->deleteLater();
+        if (guard && done) {
+            done(status == QProcess::NormalExit && exitCode == 0, output);
+        }
+    });
+
+    QObject::connect(process, &QProcess::errorOccurred, process,
+                     [process, guard, done](QProcess::ProcessError error) {
+        // После FailedToStart сигнала finished не будет
+        if (error != QProcess::FailedToStart) {
+            return;
+        }
+        QString message = process->errorString();
+        process->deleteLater();
+        if (guard && done) {
+            done(false, message);
+        }
+    });
+
+    QObject::connect(process, &QProcess::started, process, [process, input, timer, timeoutMs]() {
+        if (!input.isEmpty()) {
+            process->write(input);
+        }
+        process->closeWriteChannel();
+        timer->start(timeoutMs);
+    });
+
+    process->start(program, args);
+}
+
+void SystemCommand::runPrivileged(const QList<QJsonObject>& ops, QObject* context, Callback done, int timeoutMs) {
+    QList<PrivilegedOps::Command> commands;
+    QString error;
+    if (!PrivilegedOps::build(ops, &commands, &error)) {
+        if (done) {
+            QPointer<QObject> guard(context);
+            QTimer::singleShot(0, [guard, done, error]() {
+                if (guard) {
+                    done(false, error);
+                }
+            });
+        }
+        return;
+    }
+
+    PrivilegedHelper* helper = PrivilegedHelper::instance();
+    if (!isRoot() && helper->isReady()) {
+        // Помощнику уходят сами операции: он проверяет и собирает команды заново
+        QJsonArray list;
+        for (const QJsonObject& op : ops) {
+            list.append(op);
+        }
+        QJsonObject request;
+        request["op"] = "ops";
+        request["ops"] = list;
+        request["timeout"] = timeoutMs;
+        helper->request(request, context, [done](const QJsonObject& reply) {
+            if (done) {
+                done(reply.value("ok").toBool(), reply.value("output").toString());
+            }
+        });
+        return;
+    }
+
+    if (commands.size() == 1) {
+        const PrivilegedOps::Command& command = commands.first();
+        if (isRoot()) {
+            run(command.program, command.args, context, done, command.input, timeoutMs);
+        } else {
+            // -n: без пароля сразу ошибка, а не зависание на запросе в терминале
+            run("sudo", QStringList() << "-n" << command.program << command.args, context, done,
+                command.input, timeoutMs);
+        }
+        return;
+    }
+
+    // Без помощника — одним sh под sudo вместо sudo на каждую команду
+    QByteArray script = PrivilegedOps::shellScript(commands);
+    if (isRoot()) {
+        run("sh", QStringList() << "-s", context, done, script, 15000);
+    } else {
+        run("sudo", QStringList() << "-n" << "sh" << "-s", context, done, script, 15000);
+    }
+}
+
+void SystemCommand::signalOpenVpn(qint64 pid, const QString& signalName, QObject* context, Callback done) {
+    QString name = signalName == "KILL" ? "KILL" : "TERM";
+
+    PrivilegedHelper* helper = PrivilegedHelper::instance();
+    if (!isRoot() && helper->isReady()) {
+        // Помощник проверит, что pid — его openvpn, а не произвольный процесс
+        QJsonObject request;
+        request["op"] = "signal";
+        request["pid"] = pid;
+        request["signal"] = name;
+        helper->request(request, context, [done](const QJsonObject& reply) {
+            if (done) {
+                done(reply.value("ok").toBool(), reply.value("output").toString());
+            }
+        });
+        return;
+    }
+
+    QStringList args = QStringList() << "-" + name << QString::number(pid);
+    if (isRoot()) {
+        run("kill", args, context, done);
+    } else {
+        run("sudo", QStringList() << "-n" << "kill" << args, context, done);
+    }
+}
+
+QByteArray SystemCommand::shellScript(const QList<QJsonObject>& ops) {
+    QList<PrivilegedOps::Command> commands;
+    QString error;
+    if (!PrivilegedOps::build(ops, &commands, &error)) {
+        return QByteArray("exit 1\n");
+    }
+    return PrivilegedOps::shellScript(commands);
+}
@@ -0,0 +1,38 @@
+#ifndef SYSTEMCOMMAND_H
+#define SYSTEMCOMMAND_H
+
+#include <QObject>
+#include <QStringList>
+#include <QByteArray>
+#include <QList>
+#include <QJsonObject>
+#include <functional>
+
+// Асинхронный запуск системных команд без ожидания в GUI-потоке.
+// Результат приходит в колбэк в потоке context; если context удален раньше,
+// колбэк не вызывается.
+class SystemCommand {
+public:
+    using Callback = std::function<void(bool ok, const QString& output)>;
+
+    static void run(const QString& program, const QStringList& args, QObject* context,
+                    Callback done = Callback(), const QByteArray& input = QByteArray(), int timeoutMs = 5000);
+
+    // От root — только закрытый набор операций PrivilegedOps. Через помощника,
+    // если он запущен; иначе собранные команды идут через sudo (одна — сама,
+    // несколько — одним sh -s). Ошибка одной не отменяет следующие, ok — если
+    // успешны все; отклоненная проверкой операция не выполняет ничего
+    static void runPrivileged(const QList<QJsonObject>& ops, QObject* context,
+                              Callback done = Callback(), int timeoutMs = 5000);
+
+    // TERM/KILL openvpn, запущенному помощником (в том числе прежним его экземпляром)
+    static void signalOpenVpn(qint64 pid, const QString& signalName, QObject* context,
+                              Callback done = Callback());
+
+    // Те же операции одним shell-скриптом — для синхронной очистки через sudo sh -s
+    static QByteArray shellScript(const QList<QJsonObject>& ops);
+
+    static bool isRoot();
+};
+
+#endif // SYSTEMCOMMAND_H
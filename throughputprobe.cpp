@@ -0,0 +1,199 @@
+#include "throughputprobe.h"
+#include <QHostAddress>
+#include <QDebug>
+#include <unistd.h>
+
+ThroughputProbe::ThroughputProbe(QObject *parent)
+: QObject(parent), lookupId(-1), running(false) {
+}
+
+ThroughputProbe::~ThroughputProbe() {
+    abort();
+}
+
+void ThroughputProbe::setEndpoint(const ThroughputEndpoint& value) {
+    endpoint = value;
+    endpoint.streams = qBound(1, endpoint.streams, 16);
+}
+
+void ThroughputProbe::setNetns(const QString& value) {
+    netns = value;
+}
+
+void ThroughputProbe::start() {
+    if (running) {
+        return;
+    }
+    running = true;
+    resolvedAddress.clear();
+
+    // Внутри namespace системный резолвер (127.0.0.53) недоступен,
+    // поэтому имя разрешаем на стороне хоста и передаем через --resolve
+    QString host = endpoint.url.host();
+    if (!netns.isEmpty() && !host.isEmpty() && QHostAddress(host).isNull()) {
+        lookupId = QHostInfo::lookupHost(host, this, &ThroughputProbe::onHostResolved);
+        return;
+    }
+
+    launchStreams();
+}
+
+void ThroughputProbe::onHostResolved(const QHostInfo& info) {
+    lookupId = -1;
+    if (!running) {
+        return;
+    }
+
+    for (const QHostAddress& address : info.addresses()) {
+        if (address.protocol() == QAbstractSocket::IPv4Protocol) {
+            resolvedAddress = address.toString();
+            break;
+        }
+    }
+
+    if (resolvedAddress.isEmpty()) {
+        running = false;
+        emit measured(false, 0.0, -1, 0);
+        return;
+    }
+
+    launchStreams();
+}
+
+QString ThroughputProbe::streamUrl(qint64 bytesPerStream) const {
+    QString url = endpoint.url.toString();
+    url.replace("{bytes}", QString::number(bytesPerStream));
+    return url;
+}
+
+void ThroughputProbe::launchStreams() {
+    qint64 perStream = qMax<qint64>(1, endpoint.byteBudget / endpoint.streams);
+    QString maxTime = QString::number(endpoint.timeBudgetMs / 1000.0, 'f', 1);
+    QString url = streamUrl(perStream);
+
+    QStringList curlArgs = {
+        "curl", "-s", "-o", "/dev/null",
+        "--max-time", maxTime,
+        "--range", QString("0-%1").arg(perStream - 1),
+        "-w", "%{time_starttransfer} %{size_download} %{time_total}\\n"
+    };
+
+    if (!resolvedAddress.isEmpty()) {
+        int port = endpoint.url.port(endpoint.url.scheme() == "https" ? 443 : 80);
+        curlArgs << "--resolve" << QString("%1:%2:%3").arg(endpoint.url.host()).arg(port).arg(resolvedAddress);
+    }
+    curlArgs << url;
+
+    QStringList cmd;
+    if (!netns.isEmpty()) {
+        if (getuid() != 0) {
+            cmd << "sudo";
+        }
+        cmd << "ip" << "netns" << "exec" << netns;
+    }
+    cmd << curlArgs;
+
+    for (int i = 0; i < endpoint.streams; ++i) {
+        Stream* stream = new Stream;
+        QProcess* process = new QProcess(this);
+        stream->process = process;
+        streams.append(stream);
+
+        connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+                this, [this, stream](int, QProcess::ExitStatus) {
+                    onStreamFinished(stream);
+                });
+        connect(process, &QProcess::errorOccurred, this, [this, stream](QProcess::ProcessError error) {
+            if (error == QProcess::FailedToStart) {
+                onStreamFinished(stream);
+            }
+        });
+
+        process->start(cmd[0], cmd.mid(1));
+    }
+}
+
+void ThroughputProbe::onStreamFinished(Stream* stream) {
+    if (stream->done) {
+        return;
+    }
+    stream->done = true;
+
+    if (stream->process) {
+        stream->output = stream->process->readAllStandardOutput();
+    }
+
+    for (const Stream* s : streams) {
+        if (!s->done) {
+            return;
+        }
+    }
+
+    finish();
+}
+
+void ThroughputProbe::finish() {
+    qint64 totalBytes = 0;
+    double firstByte = -1.0;
+    double lastDone = 0.0;
+
+    // curl печатает write-out и при таймауте (код 28), поэтому учитываем все потоки
+    for (const Stream* stream : streams) {
+        QStringList parts = QString::fromUtf8(stream->output).trimmed().split(' ', Qt::SkipEmptyParts);
+        if (parts.size() < 3) {
+            continue;
+        }
+
+        double ttfb = parts[0].toDouble();
+        qint64 bytes = parts[1].toLongLong();
+        double total = parts[2].toDouble();
+        if (bytes <= 0) {
+            continue;
+        }
+
+        totalBytes += bytes;
+        if (firstByte < 0 || ttfb < firstByte) {
+            firstByte = ttfb;
+        }
+        lastDone = qMax(lastDone, total);
+    }
+
+    for (Stream* stream : streams) {
+        if (stream->process) {
+            stream->process->deleteLater();
+        }
+        delete stream;
+    }
+    streams.clear();
+    running = false;
+
+    double transferTime = lastDone - qMax(0.0, firstByte);
+    if (totalBytes <= 0 || transferTime <= 0.0) {
+        emit measured(false, 0.0, -1, totalBytes);
+        return;
+    }
+
+    double mbps = (totalBytes * 8.0) / (transferTime * 1000000.0);
+    emit measured(true, mbps, static_cast<int>(firstByte * 1000.0), totalBytes);
+}
+
+void ThroughputProbe::abort() {
+    if (lookupId >= 0) {
+        QHostInfo::abortHostLookup(lookupId);
+        lookupId = -1;
+    }
+
+    for (Stream* stream : streams) {
+        if (stream->process) {
+            QObject::disconnect(stream->process, nullptr, this, nullptr);
+            if (stream->process->state() != QProcess::NotRunning) {
+                stream->process->kill();
+                stream->process->waitForFinished(200);
+            }
+            stream->process->deleteLater();
+        }
+        delete stream;
+    }
+    streams.clear();
+    running = false;
+}
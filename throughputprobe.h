@@ -0,0 +1,69 @@
+#ifndef THROUGHPUTPROBE_H
+#define THROUGHPUTPROBE_H
+
+#include <QObject>
+#include <QProcess>
+#include <QPointer>
+#include <QHostInfo>
+#include <QUrl>
+#include <QList>
+
+// Точка загрузки для замера скорости (настройка throughputUrl). В URL можно
+// указать {bytes} — туда подставляется объем на один поток (например, для
+// speed.cloudflare.com). По умолчанию HTTPS: промежуточный узел туннеля не
+// подменит и не закэширует ответ, исказив замер
+struct ThroughputEndpoint {
+    QUrl url;
+    qint64 byteBudget;   // Суммарный лимит по всем потокам
+    int timeBudgetMs;    // Лимит времени на замер
+    int streams;         // Количество параллельных потоков
+
+    ThroughputEndpoint()
+    : url(QUrl(defaultUrl())),
+    byteBudget(20 * 1024 * 1024), timeBudgetMs(8000), streams(4) {
+    }
+
+    static QString defaultUrl() { return "https://speed.cloudflare.com/__down?bytes={bytes}"; }
+};
+
+// Замер пропускной способности через curl.
+// Если задан namespace, загрузка идет через его tun (ip netns exec),
+// иначе напрямую — так замер можно направить на локальную HTTP-заглушку.
+class ThroughputProbe : public QObject {
+    Q_OBJECT
+
+public:
+    explicit ThroughputProbe(QObject *parent = nullptr);
+    ~ThroughputProbe();
+
+    void setEndpoint(const ThroughputEndpoint& endpoint);
+    void setNetns(const QString& netns);
+    void start();
+    void abort();
+    bool isRunning() const { return running; }
+
+signals:
+    void measured(bool success, double mbps, int ttfbMs, qint64 bytes);
+
+private:
+    struct Stream {
+        QPointer<QProcess> process;
+        QByteArray output;
+        bool done = false;
+    };
+
+    ThroughputEndpoint endpoint;
+    QString netns;
+    QString resolvedAddress;
+    QList<Stream*> streams;
+    int lookupId;
+    bool running;
+
+    void onHostResolved(const QHostInfo& info);
+    void launchStreams();
+    void onStreamFinished(Stream* stream);
+    void finish();
+    QString streamUrl(qint64 bytesPerStream) const;
+};
+
+#endif // THROUGHPUTPROBE_H
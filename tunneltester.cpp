@@ -0,0 +1,467 @@
+#include "tunneltester.h"
+#include "servertester.h"
+#include "logclassifier.h"
+#include "openvpnbinary.h"
+#include "systemcommand.h"
+#include "privilegedops.h"
+#include "privilegedhelper.h"
+#include <QTextStream>
+#include <QByteArray>
+#include <QDir>
+#include <QFile>
+#include <QJsonObject>
+#include <QDebug>
+
+TunnelTester::TunnelTester(QObject *parent)
+: QObject(parent), localDir(nullptr), openvpnPath("openvpn"),
+maxParallel(4), handshakeTimeout(15), cancelled(false), throughputEnabled(false) {
+}
+
+TunnelTester::~TunnelTester() {
+    QList<QJsonObject> cleanup;
+    for (Slot* slot : testSlots) {
+        if (slot->process && slot->process->isRunning()) {
+            QObject::disconnect(slot->process, nullptr, this, nullptr);
+            // openvpn помощника он сам завершит при нашем отключении и снимет
+            // его namespace; sudo передаст TERM своему openvpn
+            slot->process->terminate();
+            slot->process->waitForFinished(1000);
+        }
+        if (slot->busy && !slot->viaHelper) {
+            cleanup << PrivilegedOps::netns(false, slot->netns);
+        }
+        delete slot->configFile;
+        delete slot->credentialsFile;
+        delete slot;
+    }
+    testSlots.clear();
+    delete localDir;
+
+    if (cleanup.isEmpty()) {
+        return;
+    }
+
+    // Помощник доделает принятые команды и после нашего выхода;
+    // без него namespace снимаем синхронно, иначе sudo умрет вместе с нами
+    if (PrivilegedHelper::instance()->isReady() || SystemCommand::isRoot()) {
+        SystemCommand::runPrivileged(cleanup, nullptr);
+    } else {
+        QProcess cleanupProcess;
+        cleanupProcess.start("sudo", QStringList() << "-n" << "sh" << "-s");
+        cleanupProcess.write(SystemCommand::shellScript(cleanup));
+        cleanupProcess.closeWriteChannel();
+        cleanupProcess.waitForFinished(3000);
+    }
+}
+
+void TunnelTester::setParallelism(int count) {
+    if (isRunning()) {
+        return;
+    }
+    maxParallel = qBound(1, count, 16);
+}
+
+void TunnelTester::setHandshakeTimeout(int seconds) {
+    handshakeTimeout = qBound(5, seconds, 120);
+}
+
+bool TunnelTester::isRunning() const {
+    if (!pending.isEmpty()) {
+        return true;
+    }
+    for (const Slot* slot : testSlots) {
+        if (slot->busy) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void TunnelTester::start(const QList<VpnServer>& candidates) {
+    if (isRunning()) {
+        emit testProgress("⚠️ Параллельная проверка уже выполняется");
+        return;
+    }
+
+    OpenVpnCapabilities openvpn = OpenVpnBinary::resolve();
+    if (!openvpn.isValid()) {
+        emit testProgress("❌ OpenVPN не найден в системе");
+        emit finished();
+        return;
+    }
+    openvpnPath = openvpn.path;
+
+    cancelled = false;
+    pending.clear();
+    for (const VpnServer& server : candidates) {
+        if (!server.configBase64.isEmpty()) {
+            pending.enqueue(server);
+        }
+    }
+
+    while (testSlots.size() < maxParallel) {
+        Slot* slot = new Slot;
+        slot->index = testSlots.size();
+        slot->netns = QString("vpngate-t%1").arg(slot->index);
+        slot->device = QString("vgt%1").arg(slot->index);
+        testSlots.append(slot);
+    }
+
+    emit testProgress(QString("🧪 Параллельная проверка: %1 серверов, до %2 одновременно")
+    .arg(pending.size()).arg(maxParallel));
+
+    fillSlots();
+}
+
+void TunnelTester::cancel() {
+    cancelled = true;
+    pending.clear();
+
+    for (Slot* slot : testSlots) {
+        if (slot->busy && !slot->reported) {
+            finishSlot(slot, false, "Проверка отменена");
+        }
+    }
+}
+
+bool TunnelTester::prepareUpScript() {
+    if (localDir && QFile::exists(upScriptPath())) {
+        return true;
+    }
+
+    delete localDir;
+    localDir = new QTemporaryDir(QDir(QDir::tempPath()).filePath("vpngate_tunnel_XXXXXX"));
+    if (!localDir->isValid()) {
+        delete localDir;
+        localDir = nullptr;
+        return false;
+    }
+
+    QFile script(upScriptPath());
+    if (!script.open(QIODevice::WriteOnly) || script.write(PrivilegedOps::netnsUpScript()) < 0) {
+        return false;
+    }
+    script.close();
+    script.setPermissions(QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner);
+    return true;
+}
+
+QString TunnelTester::upScriptPath() const {
+    return localDir ? localDir->filePath("netns-up.sh") : QString();
+}
+
+void TunnelTester::fillSlots() {
+    int busyCount = 0;
+
+    for (Slot* slot : testSlots) {
+        if (slot->index >= maxParallel) {
+            continue;
+        }
+        if (!slot->busy && !cancelled && !pending.isEmpty()) {
+            launch(slot, pending.dequeue());
+        }
+        if (slot->busy) {
+            busyCount++;
+        }
+    }
+
+    if (busyCount == 0 && pending.isEmpty()) {
+        emit finished();
+    }
+}
+
+void TunnelTester::launch(Slot* slot, const VpnServer& server) {
+    slot->server = server;
+    slot->busy = true;
+    slot->reported = false;
+    slot->releasing = false;
+    slot->handshakeMs = -1;
+    slot->viaHelper = PrivilegedHelper::instance()->isReady();
+
+    // Namespace помощник создает сам в запросе spawn
+    if (slot->viaHelper) {
+        startOpenVpn(slot);
+        return;
+    }
+
+    // Namespace мог остаться от прошлого аварийного завершения; ошибку
+    // удаления не проверяем — его обычно нет
+    SystemCommand::runPrivileged({ PrivilegedOps::netns(false, slot->netns) }, this,
+                                 [this, slot](bool, const QString&) {
+        SystemCommand::runPrivileged({ PrivilegedOps::netns(true, slot->netns) }, this,
+                                     [this, slot](bool ok, const QString& output) {
+            // Проверку отменили, пока создавался namespace
+            if (slot->reported) {
+                releaseSlot(slot);
+                return;
+            }
+            if (!ok) {
+                finishSlot(slot, false, QString("Не удалось создать namespace %1: %2")
+                .arg(slot->netns, output));
+                releaseSlot(slot);
+                return;
+            }
+            startOpenVpn(slot);
+        }, 3000);
+    }, 1000);
+}
+
+void TunnelTester::startOpenVpn(Slot* slot) {
+    const VpnServer& server = slot->server;
+
+    QByteArray configData = QByteArray::fromBase64(server.configBase64.toLatin1());
+    QString enhancedConfig = ServerTesterThread::enhanceConfigForTest(QString::fromUtf8(configData));
+
+    OpenVpnProcess* process = new OpenVpnProcess(this);
+    slot->process = process;
+
+    connect(process, &OpenVpnProcess::lineRead, this, [this, slot](const QByteArray& line) {
+        handleSlotLine(slot, line);
+    });
+
+    connect(process, &OpenVpnProcess::started, this, [this, slot]() {
+        // Стандартный ввод sudo уже открыт: файл с паролем больше не нужен
+        delete slot->credentialsFile;
+        slot->credentialsFile = nullptr;
+        // Проверку отменили, пока помощник готовил namespace
+        if (slot->reported) {
+            stopSlotProcess(slot);
+        }
+    });
+
+    connect(process, &OpenVpnProcess::failedToStart, this, [this, slot](const QString& error) {
+        if (!slot->reported) {
+            finishSlot(slot, false, QString("Не удалось запустить OpenVPN: %1").arg(error));
+        }
+        QTimer::singleShot(0, this, [this, slot]() { releaseSlot(slot); });
+    });
+
+    connect(process, &OpenVpnProcess::finished, this, [this, slot](int exitCode) {
+        if (!slot->reported) {
+            finishSlot(slot, false, QString("OpenVPN завершился (код: %1)").arg(exitCode));
+        }
+        releaseSlot(slot);
+    });
+
+    if (!slot->deadline) {
+        slot->deadline = new QTimer(this);
+        slot->deadline->setSingleShot(true);
+        connect(slot->deadline, &QTimer::timeout, this, [this, slot]() {
+            if (!slot->busy || slot->reported) {
+                return;
+            }
+            if (slot->handshakeMs >= 0) {
+                finishSlot(slot, true, "Туннель поднят, замер скорости не уложился в лимит");
+            } else {
+                finishSlot(slot, false, QString("Таймаут рукопожатия (%1 с)").arg(handshakeTimeout));
+            }
+        });
+    }
+
+    emit testProgress(QString("🔧 [%1] Запускаю %2").arg(slot->netns).arg(server.name));
+
+    slot->timer.start();
+    slot->deadline->start(handshakeTimeout * 1000);
+
+    if (slot->viaHelper) {
+        // Конфиг проверит помощник; tun, адрес и маршрут в namespace — его up-скрипт
+        QJsonObject spawn;
+        spawn["config"] = enhancedConfig;
+        spawn["netns"] = slot->netns;
+        spawn["device"] = slot->device;
+        spawn["username"] = server.username;
+        spawn["password"] = server.password;
+        spawn["connectTimeout"] = 10;
+        process->startViaHelper(spawn);
+    } else {
+        startLocalOpenVpn(slot, enhancedConfig);
+    }
+}
+
+void TunnelTester::startLocalOpenVpn(Slot* slot, const QString& config) {
+    if (!prepareUpScript()) {
+        finishSlot(slot, false, "Не удалось подготовить up-скрипт для namespace");
+        QTimer::singleShot(0, this, [this, slot]() { releaseSlot(slot); });
+        return;
+    }
+
+    delete slot->configFile;
+    slot->configFile = new QTemporaryFile(QDir(QDir::tempPath()).filePath("vpngate_tunnel_XXXXXX.ovpn"));
+    delete slot->credentialsFile;
+    slot->credentialsFile = new QTemporaryFile(localDir->filePath("auth_XXXXXX"));
+    if (!slot->configFile->open() || !slot->credentialsFile->open()) {
+        finishSlot(slot, false, "Не удалось создать временный конфиг");
+        QTimer::singleShot(0, this, [this, slot]() { releaseSlot(slot); });
+        return;
+    }
+
+    {
+        QTextStream stream(slot->configFile);
+        stream << config;
+    }
+    slot->configFile->flush();
+    slot->credentialsFile->write((slot->server.username + "\n" + slot->server.password + "\n").toUtf8());
+    slot->credentialsFile->flush();
+
+    // Под sudo processId() — это sudo: настоящий pid для сигналов openvpn запишет сам
+    QString pidPath = localDir->filePath(slot->netns + ".pid");
+    QFile::remove(pidPath);
+
+    // Маршруты и адрес tun настраивает только up-скрипт внутри namespace
+    QStringList args = {
+        "--config", slot->configFile->fileName(),
+        "--dev", slot->device,
+        "--dev-type", "tun",
+        "--route-noexec",
+        "--ifconfig-noexec",
+        "--script-security", "2",
+        "--up", QString("/bin/sh %1 %2").arg(upScriptPath()).arg(slot->netns),
+        "--auth-user-pass", "/dev/stdin",
+        "--writepid", pidPath,
+        "--verb", "3",
+        "--connect-timeout", "10"
+    };
+
+    slot->process->setStandardInputFile(slot->credentialsFile->fileName());
+    slot->process->setPidFile(pidPath);
+    slot->process->start(openvpnPath, args);
+}
+
+void TunnelTester::handleSlotLine(Slot* slot, const QByteArray& line) {
+    // Туннель уже поднят и идет замер скорости — вывод не разбираем
+    if (!slot->process || slot->reported || slot->handshakeMs >= 0) {
+        return;
+    }
+
+    LogEvent event = LogClassifier::instance().classify(line);
+    if (event == LogEvent::Connected) {
+        slot->handshakeMs = static_cast<int>(slot->timer.elapsed());
+        slot->process->stopLogTail();
+        if (throughputEnabled) {
+            startThroughput(slot);
+        } else {
+            finishSlot(slot, true, QString("Туннель поднят за %1 ms").arg(slot->handshakeMs));
+        }
+        return;
+    }
+
+    if (event == LogEvent::AuthFailed ||
+        event == LogEvent::TlsError ||
+        event == LogEvent::NetworkError ||
+        event == LogEvent::FatalExit ||
+        event == LogEvent::UpScriptFailed) {
+        finishSlot(slot, false, QString::fromUtf8(line));
+    }
+}
+
+void TunnelTester::startThroughput(Slot* slot) {
+    if (!slot->probe) {
+        slot->probe = new ThroughputProbe(this);
+        connect(slot->probe, &ThroughputProbe::measured, this,
+                [this, slot](bool success, double mbps, int ttfbMs, qint64 bytes) {
+                    if (!slot->busy || slot->reported) {
+                        return;
+                    }
+                    if (success) {
+                        slot->server.measuredMbps = mbps;
+                        slot->server.ttfbMs = ttfbMs;
+                        finishSlot(slot, true, QString("Туннель поднят за %1 ms, %2 Mbps, TTFB %3 ms (%4 KB)")
+                        .arg(slot->handshakeMs)
+                        .arg(mbps, 0, 'f', 1)
+                        .arg(ttfbMs)
+                        .arg(bytes / 1024));
+                    } else {
+                        finishSlot(slot, true, QString("Туннель поднят за %1 ms, замер скорости не удался")
+                        .arg(slot->handshakeMs));
+                    }
+                });
+    }
+
+    emit testProgress(QString("📶 [%1] %2: замер скорости через туннель...").arg(slot->netns).arg(slot->server.name));
+
+    slot->probe->setEndpoint(throughputEndpoint);
+    slot->probe->setNetns(slot->netns);
+    slot->deadline->start(throughputEndpoint.timeBudgetMs + 10000);
+    slot->probe->start();
+}
+
+void TunnelTester::finishSlot(Slot* slot, bool success, const QString& message) {
+    if (slot->reported) {
+        return;
+    }
+    slot->reported = true;
+
+    if (slot->deadline) {
+        slot->deadline->stop();
+    }
+    if (slot->probe && slot->probe->isRunning()) {
+        slot->probe->abort();
+    }
+
+    int handshakeMs = success ? slot->handshakeMs : -1;
+    slot->server.handshakeMs = handshakeMs;
+    emit testProgress(QString("%1 [%2] %3: %4")
+    .arg(success ? "✅" : "❌")
+    .arg(slot->netns)
+    .arg(slot->server.name)
+    .arg(message));
+    emit tunnelResult(slot->server, success, message, handshakeMs);
+
+    // Слот освобождается обработчиком finished после завершения процесса
+    stopSlotProcess(slot);
+}
+
+void TunnelTester::stopSlotProcess(Slot* slot) {
+    // Сигналы получает сам openvpn (у помощника или по --writepid), а не sudo:
+    // KILL, посланный sudo, оставил бы openvpn от root без родителя
+    if (!slot->process || !slot->process->isRunning()) {
+        return;
+    }
+    QPointer<OpenVpnProcess> process = slot->process;
+    process->terminate();
+    QTimer::singleShot(2000, this, [process]() {
+        if (process && process->isRunning()) {
+            process->kill();
+        }
+    });
+}
+
+void TunnelTester::releaseSlot(Slot* slot) {
+    if (!slot->busy || slot->releasing) {
+        return;
+    }
+    slot->releasing = true;
+
+    if (slot->process) {
+        QObject::disconnect(slot->process, nullptr, this, nullptr);
+        slot->process->deleteLater();
+        slot->process.clear();
+    }
+
+    delete slot->configFile;
+    slot->configFile = nullptr;
+    delete slot->credentialsFile;
+    slot->credentialsFile = nullptr;
+
+    // Помощник удаляет namespace до события exit
+    if (slot->viaHelper) {
+        QTimer::singleShot(0, this, [this, slot]() {
+            slot->releasing = false;
+            slot->busy = false;
+            fillSlots();
+        });
+        return;
+    }
+    if (localDir) {
+        QFile::remove(localDir->filePath(slot->netns + ".pid"));
+    }
+
+    // Слот снова свободен только после удаления namespace, иначе следующий
+    // launch() столкнется с ним на netns add
+    SystemCommand::runPrivileged({ PrivilegedOps::netns(false, slot->netns) }, this,
+                                 [this, slot](bool, const QString&) {
+        slot->releasing = false;
+        slot->busy = false;
+        fillSlots();
+    }, 3000);
+}
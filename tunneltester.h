@@ -0,0 +1,87 @@
+#ifndef TUNNELTESTER_H
+#define TUNNELTESTER_H
+
+#include <QObject>
+#include <QProcess>
+#include <QPointer>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QTemporaryFile>
+#include <QTemporaryDir>
+#include <QList>
+#include <QQueue>
+#include "vpntypes.h"
+#include "throughputprobe.h"
+#include "openvpnprocess.h"
+
+// Параллельная проверка реальных подключений.
+// Каждый экземпляр openvpn работает с собственным tun, который up-скрипт
+// переносит в отдельный сетевой namespace. Сокет openvpn остается в
+// namespace хоста, поэтому маршруты и DNS хоста не затрагиваются.
+// С помощником namespace, up-скрипт и openvpn целиком на его стороне
+// (spawn с полем netns); без него — sudo openvpn и namespace через sudo.
+class TunnelTester : public QObject {
+    Q_OBJECT
+
+public:
+    explicit TunnelTester(QObject *parent = nullptr);
+    ~TunnelTester();
+
+    void setParallelism(int count);
+    void setHandshakeTimeout(int seconds);
+    void setThroughputEnabled(bool enabled) { throughputEnabled = enabled; }
+    void setThroughputEndpoint(const ThroughputEndpoint& endpoint) { throughputEndpoint = endpoint; }
+    int parallelism() const { return maxParallel; }
+
+    void start(const QList<VpnServer>& candidates);
+    void cancel();
+    bool isRunning() const;
+
+signals:
+    void tunnelResult(const VpnServer& server, bool success, const QString& message, int handshakeMs);
+    void testProgress(const QString& message);
+    void finished();
+
+private:
+    struct Slot {
+        int index = 0;
+        QString netns;
+        QString device;
+        QPointer<OpenVpnProcess> process;
+        QTemporaryFile* configFile = nullptr;
+        QTemporaryFile* credentialsFile = nullptr;
+        QTimer* deadline = nullptr;
+        ThroughputProbe* probe = nullptr;
+        QElapsedTimer timer;
+        int handshakeMs = -1;
+        VpnServer server;
+        bool busy = false;
+        bool reported = false;
+        bool releasing = false;
+        bool viaHelper = false;
+    };
+
+    QList<Slot*> testSlots;
+    QQueue<VpnServer> pending;
+    QTemporaryDir* localDir;        // up-скрипт и pid-файлы запусков без помощника
+    QString openvpnPath;
+    int maxParallel;
+    int handshakeTimeout;
+    bool cancelled;
+    bool throughputEnabled;
+    ThroughputEndpoint throughputEndpoint;
+
+    bool prepareUpScript();
+    void fillSlots();
+    void launch(Slot* slot, const VpnServer& server);
+    void startOpenVpn(Slot* slot);
+    void startLocalOpenVpn(Slot* slot, const QString& config);
+    void handleSlotLine(Slot* slot, const QByteArray& line);
+    void startThroughput(Slot* slot);
+    void finishSlot(Slot* slot, bool success, const QString& message);
+    void stopSlotProcess(Slot* slot);
+    void releaseSlot(Slot* slot);
+    QString upScriptPath() const;
+};
+
+#endif // TUNNELTESTER_H
@@ -0,0 +1,627 @@
+#include "udpprober.h"
+#include <QRandomGenerator>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QVector>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#ifdef Q_OS_LINUX
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/net_tstamp.h>
+#include <linux/errqueue.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+namespace {
+const int kBatchSize = 64;
+const int kReplyBufferSize = 1536;
+const int kControlBufferSize = 256;
+
+// Опкоды управляющего канала OpenVPN (без tls-auth, как у VPNGate)
+const quint8 kHardResetClientV2 = 7;
+const quint8 kHardResetServerV2 = 8;
+const int kResetPacketSize = 14;   // opcode + session id + пустой ack + packet-id
+
+// Серия для оценки пропускной способности: ICMP echo во весь MTU, чтобы
+// интервал между ответами задавало узкое место канала, а не обработка на сервере
+const int kTrainPacketSize = 1480;   // ICMP-заголовок + данные, IP-пакет 1500 байт
+const int kIpHeaderSize = 20;
+const int kMaxTrainLength = 16;
+const int kMaxTrainTargets = 8;      // Серии идут по одной, поэтому только лучшим по RTT
+
+#ifdef Q_OS_LINUX
+qint64 timespecToNs(const struct timespec& ts) {
+    return static_cast<qint64>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+qint64 realtimeNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return timespecToNs(ts);
+}
+
+struct PendingProbe {
+    int target;
+    quint64 sessionId;
+    qint64 userTxNs;
+    qint64 kernelTxNs;
+    qint64 userRxNs;
+    qint64 kernelRxNs;
+    bool answered;
+};
+
+void buildResetPacket(quint8* packet, quint64 sessionId) {
+    packet[0] = static_cast<quint8>(kHardResetClientV2 << 3);   // key_id = 0
+    std::memcpy(packet + 1, &sessionId, sizeof(sessionId));
+    packet[9] = 0;                                             // ack array пустой
+    std::memset(packet + 10, 0, 4);                            // message packet-id = 0
+}
+
+// Сервер подтверждает наш пакет и возвращает наш session id — по нему сопоставляем ответ
+bool parseResetReply(const quint8* data, int length, quint64* ackedSessionId) {
+    if (length < 10 || (data[0] >> 3) != kHardResetServerV2) {
+        return false;
+    }
+    int acks = data[9];
+    int offset = 10 + acks * 4;
+    if (acks == 0 || length < offset + 8) {
+        return false;
+    }
+    std::memcpy(ackedSessionId, data + offset, sizeof(quint64));
+    return true;
+}
+
+// Программная метка времени из SCM_TIMESTAMPING (ts[0])
+qint64 softwareTimestamp(struct msghdr* msg) {
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPING) {
+            struct scm_timestamping stamps;
+            std::memcpy(&stamps, CMSG_DATA(cmsg), sizeof(stamps));
+            return timespecToNs(stamps.ts[0]);
+        }
+    }
+    return 0;
+}
+
+// Идентификатор датаграммы (SOF_TIMESTAMPING_OPT_ID) из очереди ошибок
+qint64 timestampKey(struct msghdr* msg) {
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) {
+            struct sock_extended_err err;
+            std::memcpy(&err, CMSG_DATA(cmsg), sizeof(err));
+            if (err.ee_errno == ENOMSG && err.ee_origin == SO_EE_ORIGIN_TIMESTAMPING) {
+                return err.ee_data;
+            }
+        }
+    }
+    return -1;
+}
+
+// Оценка по серии: (n - 1) пакетов прошли узкое место за время между первым
+// и последним ответом. Без отбрасывания малых интервалов: если метки слились
+// (например, из-за объединения прерываний сетевой картой), оценки нет
+double estimateTrainMbps(QVector<qint64> arrivals) {
+    if (arrivals.size() < 2) {
+        return 0.0;
+    }
+    std::sort(arrivals.begin(), arrivals.end());
+    qint64 spanNs = arrivals.last() - arrivals.first();
+    if (spanNs <= 0) {
+        return 0.0;
+    }
+    double bits = (arrivals.size() - 1) * (kTrainPacketSize + kIpHeaderSize) * 8.0;
+    return bits * 1000.0 / spanNs;   // бит/нс * 1000 = Мбит/с
+}
+
+// Сбрасывает POLLERR: очередь ошибок и отложенную ошибку сокета
+void clearSocketErrors(int fd) {
+    char buffer[kReplyBufferSize];
+    char control[kControlBufferSize];
+    for (;;) {
+        struct iovec iov = { buffer, sizeof(buffer) };
+        struct msghdr msg;
+        std::memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            break;
+        }
+    }
+    int pendingError = 0;
+    socklen_t length = sizeof(pendingError);
+    getsockopt(fd, SOL_SOCKET, SO_ERROR, &pendingError, &length);
+}
+#endif
+}
+
+UdpProber::UdpProber()
+: fd(-1), icmpFd(-1), txCounter(0), trainSequence(0), timestampsEnabled(false), trainLength(0) {
+}
+
+UdpProber::~UdpProber() {
+    close();
+}
+
+bool UdpProber::open(QString* error) {
+#ifdef Q_OS_LINUX
+    close();
+
+    fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        if (error) {
+            *error = QString("socket: %1").arg(QString::fromLocal8Bit(strerror(errno)));
+        }
+        return false;
+    }
+
+    if (!bindInterface.isEmpty()) {
+        QByteArray name = bindInterface.toLocal8Bit();
+        if (setsockopt(fd, SOL_SOCKET, SO_BINDTODEVICE, name.constData(), name.size()) < 0) {
+            if (error) {
+                *error = QString("SO_BINDTODEVICE %1: %2").arg(bindInterface, QString::fromLocal8Bit(strerror(errno)));
+            }
+            close();
+            return false;
+        }
+    }
+
+    int rcvbuf = 1 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    // Метки отправки без копии пакета (OPT_TSONLY), сопоставление по счетчику (OPT_ID)
+    int flags = SOF_TIMESTAMPING_SOFTWARE |
+                SOF_TIMESTAMPING_RX_SOFTWARE |
+                SOF_TIMESTAMPING_TX_SOFTWARE |
+                SOF_TIMESTAMPING_OPT_ID |
+                SOF_TIMESTAMPING_OPT_TSONLY;
+    timestampsEnabled = setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == 0;
+    txCounter = 0;
+
+    if (trainLength > 1) {
+        openTrainSocket();
+    }
+    return true;
+#else
+    if (error) {
+        *error = "Пакетная UDP-проверка поддерживается только на Linux";
+    }
+    return false;
+#endif
+}
+
+// Непривилегированный ICMP-сокет (net.ipv4.ping_group_range). Если он
+// недоступен, серии не отправляются и оценки пропускной способности нет
+bool UdpProber::openTrainSocket() {
+#ifdef Q_OS_LINUX
+    icmpFd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_ICMP);
+    if (icmpFd < 0) {
+        return false;
+    }
+
+    bool ok = true;
+    if (!bindInterface.isEmpty()) {
+        QByteArray name = bindInterface.toLocal8Bit();
+        ok = setsockopt(icmpFd, SOL_SOCKET, SO_BINDTODEVICE, name.constData(), name.size()) == 0;
+    }
+
+    // Только метки приема: серия оценивается по разбросу ответов у нас
+    int flags = SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_RX_SOFTWARE;
+    ok = ok && setsockopt(icmpFd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == 0;
+
+    // На пути с меньшим MTU пакет фрагментируется, а не отбрасывается
+    int pmtu = IP_PMTUDISC_DONT;
+    setsockopt(icmpFd, IPPROTO_IP, IP_MTU_DISCOVER, &pmtu, sizeof(pmtu));
+
+    int rcvbuf = kMaxTrainLength * 4096;
+    setsockopt(icmpFd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    if (!ok) {
+        ::close(icmpFd);
+        icmpFd = -1;
+    }
+    return ok;
+#else
+    return false;
+#endif
+}
+
+void UdpProber::close() {
+#ifdef Q_OS_LINUX
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    if (icmpFd >= 0) {
+        ::close(icmpFd);
+    }
+#endif
+    fd = -1;
+    icmpFd = -1;
+    timestampsEnabled = false;
+}
+
+double UdpProber::measureTrain(const QHostAddress& address, int timeoutMs) {
+#ifdef Q_OS_LINUX
+    int length = qMin(trainLength, kMaxTrainLength);
+    if (icmpFd < 0 || length < 2 || address.protocol() != QAbstractSocket::IPv4Protocol) {
+        return 0.0;
+    }
+
+    struct sockaddr_in to;
+    std::memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_addr.s_addr = htonl(address.toIPv4Address());
+
+    // Идентификатор echo ядро подставляет само по сокету; серию отличаем
+    // по номерам и случайной метке в данных
+    quint64 token = QRandomGenerator::global()->generate64();
+    quint16 firstSequence = trainSequence;
+    trainSequence = static_cast<quint16>(trainSequence + length);
+
+    QVector<quint8> packets(length * kTrainPacketSize, 0);
+    struct mmsghdr messages[kMaxTrainLength];
+    struct iovec iovecs[kMaxTrainLength];
+    std::memset(messages, 0, sizeof(messages));
+    for (int i = 0; i < length; ++i) {
+        quint8* packet = packets.data() + i * kTrainPacketSize;
+        packet[0] = 8;   // ICMP_ECHO, контрольную сумму считает ядро
+        quint16 sequence = htons(static_cast<quint16>(firstSequence + i));
+        std::memcpy(packet + 6, &sequence, sizeof(sequence));
+        std::memcpy(packet + 8, &token, sizeof(token));
+
+        iovecs[i].iov_base = packet;
+        iovecs[i].iov_len = kTrainPacketSize;
+        messages[i].msg_hdr.msg_name = &to;
+        messages[i].msg_hdr.msg_namelen = sizeof(to);
+        messages[i].msg_hdr.msg_iov = &iovecs[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    // Старые ответы и ошибки прошлой серии не должны попасть в эту
+    clearSocketErrors(icmpFd);
+    char discard[kReplyBufferSize];
+    while (recv(icmpFd, discard, sizeof(discard), MSG_DONTWAIT) > 0) {
+    }
+
+    int sent = sendmmsg(icmpFd, messages, length, 0);
+    stats.syscalls++;
+    if (sent < 2) {
+        return 0.0;
+    }
+
+    QVector<quint8> replyBuffers(kMaxTrainLength * kReplyBufferSize);
+    QVector<char> controlBuffers(kMaxTrainLength * kControlBufferSize);
+    QVector<qint64> arrivals;
+    QVector<bool> seen(sent, false);
+
+    QElapsedTimer timer;
+    timer.start();
+    while (arrivals.size() < sent && timer.elapsed() < timeoutMs) {
+        struct pollfd pfd;
+        pfd.fd = icmpFd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        int ready = poll(&pfd, 1, static_cast<int>(qMax<qint64>(1, timeoutMs - timer.elapsed())));
+        stats.syscalls++;
+        if (ready <= 0) {
+            continue;
+        }
+        if (pfd.revents & POLLERR) {
+            clearSocketErrors(icmpFd);
+        }
+        if (!(pfd.revents & POLLIN)) {
+            continue;
+        }
+
+        std::memset(messages, 0, sizeof(messages));
+        for (int i = 0; i < kMaxTrainLength; ++i) {
+            iovecs[i].iov_base = replyBuffers.data() + i * kReplyBufferSize;
+            iovecs[i].iov_len = kReplyBufferSize;
+            messages[i].msg_hdr.msg_iov = &iovecs[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+            messages[i].msg_hdr.msg_control = controlBuffers.data() + i * kControlBufferSize;
+            messages[i].msg_hdr.msg_controllen = kControlBufferSize;
+        }
+        int received = recvmmsg(icmpFd, messages, kMaxTrainLength, MSG_DONTWAIT, nullptr);
+        stats.syscalls++;
+
+        for (int i = 0; i < received; ++i) {
+            const quint8* data = replyBuffers.constData() + i * kReplyBufferSize;
+            if (messages[i].msg_len < 16 || data[0] != 0) {   // ICMP_ECHOREPLY
+                continue;
+            }
+            quint16 sequence;
+            quint64 replyToken;
+            std::memcpy(&sequence, data + 6, sizeof(sequence));
+            std::memcpy(&replyToken, data + 8, sizeof(replyToken));
+            int index = static_cast<quint16>(ntohs(sequence) - firstSequence);
+            if (replyToken != token || index >= sent || seen[index]) {
+                continue;
+            }
+            qint64 stamp = softwareTimestamp(&messages[i].msg_hdr);
+            if (stamp <= 0) {
+                continue;   // Без метки ядра разброс по времени пользователя бессмыслен
+            }
+            seen[index] = true;
+            arrivals.append(stamp);
+        }
+    }
+
+    return estimateTrainMbps(arrivals);
+#else
+    Q_UNUSED(address);
+    Q_UNUSED(timeoutMs);
+    return 0.0;
+#endif
+}
+
+QList<UdpProbeResult> UdpProber::probe(const QList<UdpProbeTarget>& targets, int attempts,
+                                       int timeoutMs, int waveIntervalMs) {
+    stats = Stats();
+    stats.trainsAvailable = icmpFd >= 0;
+    attempts = qMax(1, attempts);
+
+    QList<UdpProbeResult> results;
+    for (const UdpProbeTarget& target : targets) {
+        UdpProbeResult result;
+        result.identity = target.identity;
+        results.append(result);
+    }
+
+#ifdef Q_OS_LINUX
+    if (fd < 0 || targets.isEmpty()) {
+        for (UdpProbeResult& result : results) {
+            result.lost = attempts;
+        }
+        return results;
+    }
+
+    QVector<PendingProbe> probes;
+    probes.reserve(targets.size() * attempts);
+    QHash<quint64, int> bySession;
+    QHash<quint32, int> byTxKey;
+
+    // Буферы под одну пачку recvmmsg
+    QVector<quint8> replyBuffers(kBatchSize * kReplyBufferSize);
+    QVector<char> controlBuffers(kBatchSize * kControlBufferSize);
+
+    auto sendWave = [&]() {
+        for (int first = 0; first < targets.size(); first += kBatchSize) {
+            int count = qMin(kBatchSize, static_cast<int>(targets.size()) - first);
+
+            struct mmsghdr messages[kBatchSize];
+            struct iovec iovecs[kBatchSize];
+            struct sockaddr_in addresses[kBatchSize];
+            quint8 packets[kBatchSize][kResetPacketSize];
+            quint64 sessions[kBatchSize];
+            std::memset(messages, 0, sizeof(messages));
+            std::memset(addresses, 0, sizeof(addresses));
+
+            for (int i = 0; i < count; ++i) {
+                const UdpProbeTarget& target = targets[first + i];
+                addresses[i].sin_family = AF_INET;
+                addresses[i].sin_port = htons(target.port);
+                addresses[i].sin_addr.s_addr = htonl(target.address.toIPv4Address());
+
+                sessions[i] = QRandomGenerator::global()->generate64();
+                buildResetPacket(packets[i], sessions[i]);
+
+                iovecs[i].iov_base = packets[i];
+                iovecs[i].iov_len = kResetPacketSize;
+                messages[i].msg_hdr.msg_name = &addresses[i];
+                messages[i].msg_hdr.msg_namelen = sizeof(addresses[i]);
+                messages[i].msg_hdr.msg_iov = &iovecs[i];
+                messages[i].msg_hdr.msg_iovlen = 1;
+            }
+
+            qint64 userTx = realtimeNs();
+            int sent = sendmmsg(fd, messages, count, 0);
+            stats.syscalls++;
+            stats.naiveSyscalls += count;   // по одному sendto на пакет
+            if (sent <= 0) {
+                continue;
+            }
+
+            for (int i = 0; i < sent; ++i) {
+                PendingProbe probe;
+                probe.target = first + i;
+                probe.sessionId = sessions[i];
+                probe.userTxNs = userTx;
+                probe.kernelTxNs = 0;
+                probe.userRxNs = 0;
+                probe.kernelRxNs = 0;
+                probe.answered = false;
+
+                bySession.insert(probe.sessionId, probes.size());
+                byTxKey.insert(txCounter++, probes.size());
+                probes.append(probe);
+            }
+            stats.probes += sent;
+        }
+    };
+
+    auto prepareBatch = [&](struct mmsghdr* messages, struct iovec* iovecs) {
+        std::memset(messages, 0, sizeof(struct mmsghdr) * kBatchSize);
+        for (int i = 0; i < kBatchSize; ++i) {
+            iovecs[i].iov_base = replyBuffers.data() + i * kReplyBufferSize;
+            iovecs[i].iov_len = kReplyBufferSize;
+            messages[i].msg_hdr.msg_iov = &iovecs[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+            messages[i].msg_hdr.msg_control = controlBuffers.data() + i * kControlBufferSize;
+            messages[i].msg_hdr.msg_controllen = kControlBufferSize;
+        }
+    };
+
+    // Очередь ошибок читаем всегда: кроме меток отправки там бывают ICMP-ошибки,
+    // и пока она не пуста, poll сразу возвращает POLLERR и цикл крутится вхолостую
+    auto drainErrorQueue = [&]() {
+        struct mmsghdr messages[kBatchSize];
+        struct iovec iovecs[kBatchSize];
+        for (;;) {
+            prepareBatch(messages, iovecs);
+            int received = recvmmsg(fd, messages, kBatchSize, MSG_ERRQUEUE | MSG_DONTWAIT, nullptr);
+            stats.syscalls++;
+            if (received <= 0) {
+                break;
+            }
+            for (int i = 0; timestampsEnabled && i < received; ++i) {
+                qint64 key = timestampKey(&messages[i].msg_hdr);
+                qint64 stamp = softwareTimestamp(&messages[i].msg_hdr);
+                int index = key >= 0 ? byTxKey.value(static_cast<quint32>(key), -1) : -1;
+                if (index >= 0 && stamp > 0) {
+                    probes[index].kernelTxNs = stamp;
+                }
+            }
+            if (received < kBatchSize) {
+                break;
+            }
+        }
+
+        // Отложенная ошибка сокета (sk_err) тоже держит POLLERR; чтение SO_ERROR ее сбрасывает
+        int pendingError = 0;
+        socklen_t length = sizeof(pendingError);
+        getsockopt(fd, SOL_SOCKET, SO_ERROR, &pendingError, &length);
+    };
+
+    int answered = 0;
+    auto drainReplies = [&]() {
+        struct mmsghdr messages[kBatchSize];
+        struct iovec iovecs[kBatchSize];
+        for (;;) {
+            prepareBatch(messages, iovecs);
+            int received = recvmmsg(fd, messages, kBatchSize, MSG_DONTWAIT, nullptr);
+            qint64 userRx = realtimeNs();
+            stats.syscalls++;
+            if (received <= 0) {
+                break;
+            }
+            stats.naiveSyscalls += received * 2;   // poll + recvfrom на каждый ответ
+
+            for (int i = 0; i < received; ++i) {
+                quint64 sessionId = 0;
+                const quint8* data = replyBuffers.constData() + i * kReplyBufferSize;
+                if (!parseResetReply(data, static_cast<int>(messages[i].msg_len), &sessionId)) {
+                    continue;
+                }
+                int index = bySession.value(sessionId, -1);
+                if (index < 0 || probes[index].answered) {
+                    continue;   // Повторная отправка сервером
+                }
+                probes[index].answered = true;
+                probes[index].userRxNs = userRx;
+                probes[index].kernelRxNs = softwareTimestamp(&messages[i].msg_hdr);
+                answered++;
+            }
+            if (received < kBatchSize) {
+                break;
+            }
+        }
+    };
+
+    QElapsedTimer timer;
+    timer.start();
+
+    int wave = 0;
+    const int waves = attempts;
+    const qint64 finalDeadline = static_cast<qint64>(waves - 1) * waveIntervalMs + timeoutMs;
+
+    for (;;) {
+        qint64 elapsed = timer.elapsed();
+
+        if (wave < waves && elapsed >= static_cast<qint64>(wave) * waveIntervalMs) {
+            sendWave();
+            wave++;
+            continue;
+        }
+
+        if (elapsed >= finalDeadline || (wave >= waves && answered >= probes.size())) {
+            break;
+        }
+
+        qint64 waitMs = wave < waves ?
+        static_cast<qint64>(wave) * waveIntervalMs - elapsed :
+        finalDeadline - elapsed;
+
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        int ready = poll(&pfd, 1, static_cast<int>(qMax<qint64>(1, waitMs)));
+        stats.syscalls++;
+        if (ready <= 0) {
+            continue;
+        }
+
+        if (pfd.revents & POLLERR) {
+            drainErrorQueue();
+        }
+        if (pfd.revents & POLLIN) {
+            drainReplies();
+        }
+    }
+
+    // Метки отправки могут прийти позже ответов
+    drainErrorQueue();
+
+    double errorSumUs = 0.0;
+    int errorCount = 0;
+
+    for (const PendingProbe& probe : probes) {
+        if (!probe.answered) {
+            continue;
+        }
+
+        qint64 userRtt = probe.userRxNs - probe.userTxNs;
+        qint64 rtt = userRtt;
+        if (probe.kernelTxNs > 0 && probe.kernelRxNs > 0) {
+            rtt = probe.kernelRxNs - probe.kernelTxNs;
+            errorSumUs += std::fabs(static_cast<double>(userRtt - rtt)) / 1000.0;
+            errorCount++;
+        } else if (probe.kernelRxNs > 0) {
+            // Обе метки в CLOCK_REALTIME, поэтому их можно смешивать
+            rtt = probe.kernelRxNs - probe.userTxNs;
+        }
+
+        results[probe.target].rttMs.append(rtt / 1000000.0);
+        stats.replies++;
+    }
+
+    QVector<QPair<double, int>> trainOrder;
+    for (int i = 0; i < results.size(); ++i) {
+        UdpProbeResult& result = results[i];
+        result.lost = qMax(0, attempts - static_cast<int>(result.rttMs.size()));
+        if (result.replied()) {
+            trainOrder.append(qMakePair(*std::min_element(result.rttMs.begin(), result.rttMs.end()), i));
+        }
+    }
+
+    // Серии после замеров RTT и по одной, чтобы они не делили канал между собой
+    if (icmpFd >= 0 && trainLength > 1) {
+        std::sort(trainOrder.begin(), trainOrder.end());
+        for (int k = 0; k < trainOrder.size() && k < kMaxTrainTargets; ++k) {
+            int index = trainOrder[k].second;
+            int waitMs = qBound(200, static_cast<int>(trainOrder[k].first * 2) + 200, 1500);
+            results[index].estimatedMbps = measureTrain(targets[index].address, waitMs);
+            if (results[index].estimatedMbps > 0.0) {
+                stats.estimates++;
+            }
+        }
+    }
+
+    stats.kernelTimestamps = errorCount > 0;
+    stats.meanUserErrorUs = errorCount > 0 ? errorSumUs / errorCount : 0.0;
+#else
+    for (UdpProbeResult& result : results) {
+        result.lost = attempts;
+    }
+#endif
+
+    return results;
+}
@@ -0,0 +1,98 @@
+#ifndef UDPPROBER_H
+#define UDPPROBER_H
+
+#include <QString>
+#include <QList>
+#include <QHostAddress>
+
+// Цель UDP-проверки: OpenVPN сервер, принимающий HARD_RESET_CLIENT_V2
+struct UdpProbeTarget {
+    QString identity;
+    QHostAddress address;
+    quint16 port;
+
+    UdpProbeTarget() : port(1194) {}
+};
+
+struct UdpProbeResult {
+    QString identity;
+    QList<double> rttMs;   // RTT по каждой успешной попытке
+    int lost;              // Попытки без ответа
+    double estimatedMbps;  // Оценка пропускной способности по серии ICMP (0 — нет оценки)
+
+    UdpProbeResult() : lost(0), estimatedMbps(0.0) {}
+    bool replied() const { return !rttMs.isEmpty(); }
+};
+
+// Пакетная UDP-проверка OpenVPN серверов.
+// Запросы уходят пачками через sendmmsg, ответы читаются через recvmmsg,
+// RTT считается по программным меткам времени ядра (SO_TIMESTAMPING):
+// метка отправки берется из очереди ошибок сокета, метка приема — из cmsg.
+// Дополнительно серия ICMP echo во весь MTU дает оценку узкого места канала.
+// Блокирующий вызов, запускать вне GUI потока.
+class UdpProber {
+public:
+    struct Stats {
+        int probes;              // Отправлено запросов
+        int replies;             // Получено ответов
+        int syscalls;            // sendmmsg/recvmmsg/poll фактически
+        int naiveSyscalls;       // Оценка для sendto/recvfrom/poll на каждый пакет
+        bool kernelTimestamps;   // Метки ядра были доступны
+        double meanUserErrorUs;  // Среднее |RTT пользователя - RTT ядра|
+        int estimates;           // Серверов с оценкой пропускной способности
+        bool trainsAvailable;    // ICMP-сокет для серий открылся
+
+        Stats()
+        : probes(0), replies(0), syscalls(0), naiveSyscalls(0),
+        kernelTimestamps(false), meanUserErrorUs(0.0), estimates(0), trainsAvailable(false) {
+        }
+    };
+
+    UdpProber();
+    ~UdpProber();
+
+    bool open(QString* error = nullptr);
+    void close();
+
+    // Привязка к интерфейсу (SO_BINDTODEVICE), чтобы пробы шли мимо туннеля
+    void setBindInterface(const QString& interfaceName) { bindInterface = interfaceName; }
+
+    // После замеров RTT лучшим по задержке серверам по очереди уходит серия из
+    // trainLength ICMP echo по 1500 байт подряд. По разбросу меток приема ответов
+    // оценивается узкое место канала (packet train). Нужен непривилегированный
+    // ICMP-сокет (net.ipv4.ping_group_range), иначе оценки нет.
+    // 0 — серии не отправляются; задается до open()
+    void setTrainLength(int length) { trainLength = qBound(0, length, 16); }
+
+    // Одна серия к адресу, Мбит/с (0 — оценить не удалось)
+    double measureTrain(const QHostAddress& address, int timeoutMs = 1000);
+
+    QList<UdpProbeResult> probe(const QList<UdpProbeTarget>& targets, int attempts = 3,
+                                int timeoutMs = 2000, int waveIntervalMs = 100);
+
+    const Stats& lastStats() const { return stats; }
+
+private:
+    int fd;
+    int icmpFd;          // Сокет серий (ping socket), -1 — серии недоступны
+    quint32 txCounter;   // Счетчик SOF_TIMESTAMPING_OPT_ID для отправленных датаграмм
+    quint16 trainSequence;
+    bool timestampsEnabled;
+    int trainLength;
+    QString bindInterface;
+    Stats stats;
+
+    bool openTrainSocket();
+
+    UdpProber(const UdpProber&) = delete;
+    UdpProber& operator=(const UdpProber&) = delete;
+};
+
+// Результат одного прохода вместе со статистикой, для передачи из фонового потока
+struct UdpProbeBatch {
+    QList<UdpProbeResult> results;
+    UdpProber::Stats stats;
+    QString error;
+};
+
+#endif // UDPPROBER_H
@@ -1,493 +1,1236 @@
 #include "vpnmanager.h"
-#include <QTemporaryFile>
-#include <QTextStream>
-#include <QRegularExpression>
-#include <QByteArray>
-#include <QFile>
+#include "openvpnbinary.h"
+#include "configcache.h"
+#include "systemcommand.h"
+#include "privilegedops.h"
+#include "sessionjournal.h"
+#include "connecttiming.h"
+#include "privilegedhelper.h"
 #include <QTimer>
-#include <QDir>
+#include <QProcess>
+#include <QFile>
 #include <QDateTime>
-#include <QCoreApplication>
+#include <QHostAddress>
+#include <QStandardPaths>
+#include <QPointer>
+#include <QSet>
+#include <QCryptographicHash>
 #include <QDebug>
 #include <csignal>
-#include <sys/types.h>
-#include <sys/wait.h>
-#include <unistd.h>
+
+namespace {
+const int kFullPathMtu = 1500;      // Путь пропускает пакеты Ethernet целиком
+const int kIpUdpOverhead = 28;      // Заголовки IPv4 + UDP вокруг пакета openvpn
+const int kTunnelOverhead = 80;     // С запасом: заголовки, HMAC/тег, IV, выравнивание CBC
+const int kDefaultSocketBuffer = 393216;   // Без замеров RTT и скорости
+const int kMinTxQueueLen = 100;     // Значение openvpn по умолчанию
+const int kMaxTxQueueLen = 2000;
+const char* kHashPolicyKey = "net.ipv4.fib_multipath_hash_policy";
+
+// Степени двойки: мелкие колебания RTT не меняют конфиг и не сбрасывают кэш
+int roundUpPowerOfTwo(qint64 value) {
+    qint64 result = 4096;
+    while (result < value && result < (1 << 30)) {
+        result <<= 1;
+    }
+    return static_cast<int>(result);
+}
+}
 
 VpnManager::VpnManager(QObject *parent)
-: QObject(parent), process(nullptr), m_isConnected(false), connectionTimeout(45) {
+: QObject(parent), session(nullptr), pending(nullptr), retiring(nullptr), standby(nullptr),
+configCache(new ConfigCache(this)), gapMonitor(new GapMonitor(this)), raceTimer(new QTimer(this)),
+connectionTimeout(45), connectTimings(nullptr), profiles(nullptr), socketBufferMin(128 * 1024),
+socketBufferMax(4 * 1024 * 1024), savedHashPolicy(-1), multiRemoteCount(1), raceStartMs(0) {
+    configCache->setConnectTimeout(connectionTimeout);
+    connect(raceTimer, &QTimer::timeout, this, &VpnManager::launchNextRacer);
+
     // Игнорируем SIGPIPE для предотвращения крашей при записи в закрытый pipe
     std::signal(SIGPIPE, SIG_IGN);
-}
-
-QString VpnManager::findOpenVPN() {
-    QStringList possiblePaths = {
-        "openvpn",
-        "/usr/sbin/openvpn",
-        "/usr/bin/openvpn",
-        "/sbin/openvpn",
-        "/bin/openvpn",
-        "/usr/local/sbin/openvpn",
-        "/usr/local/bin/openvpn",
-        "/opt/local/sbin/openvpn",
-        "/opt/local/bin/openvpn"
-    };
 
-    QProcess whichProcess;
-    whichProcess.start("which", QStringList() << "openvpn");
-    whichProcess.waitForFinished(1000);
+    connect(gapMonitor, &GapMonitor::finished, this, [this](const GapMonitor::Result& gap) {
+        QString toServer = serverName();
+        emit connectionLog(QString("📉 Переключение %1 → %2: потеряно %3 из %4 запросов, наибольший разрыв %5 мс")
+        .arg(switchFrom, toServer)
+        .arg(gap.lost())
+        .arg(gap.sent)
+        .arg(gap.maxGapMs));
+        emit switchCompleted(switchFrom, toServer, gap);
+    });
+}
 
-    if (whichProcess.exitCode() == 0) {
-        QString path = QString::fromUtf8(whichProcess.readAllStandardOutput()).trimmed();
-        if (!path.isEmpty() && QFile::exists(path)) {
-            return path;
-        }
+VpnManager::~VpnManager() {
+    if (savedHashPolicy < 0) {
+        return;
     }
+    // Помощник доделает команду и после нашего выхода; без него
+    // возвращаем политику синхронно, иначе sudo умрет вместе с нами
+    QList<QJsonObject> restore = { PrivilegedOps::sysctl(kHashPolicyKey, savedHashPolicy) };
+    savedHashPolicy = -1;
+    if (PrivilegedHelper::instance()->isReady() || SystemCommand::isRoot()) {
+        SystemCommand::runPrivileged(restore, nullptr);
+    } else {
+        QProcess restoreProcess;
+        restoreProcess.start("sudo", QStringList() << "-n" << "sh" << "-s");
+        restoreProcess.write(SystemCommand::shellScript(restore));
+        restoreProcess.closeWriteChannel();
+        restoreProcess.waitForFinished(3000);
+    }
+}
 
-    for (const QString& path : possiblePaths) {
-        QProcess testProcess;
-        testProcess.start(path, QStringList() << "--version");
-        testProcess.waitForFinished(1000);
-
-        if (testProcess.exitCode() == 0) {
-            return path;
-        }
+VpnSession* VpnManager::createSession(const VpnServer& server, const QString& device, bool routeNoExec) {
+    VpnSession* s = new VpnSession(this);
+    QString basis;
+    int deadline = connectDeadline(server, &basis);
+    s->setConnectTimeout(deadline);
+    if (deadline < connectionTimeout) {
+        emit connectionLog(QString("⏱️ Срок подключения к %1: %2 с вместо %3 с (%4)")
+        .arg(server.name).arg(deadline).arg(connectionTimeout).arg(basis));
+    }
+    s->setDevice(device);
+    s->setRouteNoExec(routeNoExec);
+    ConfigOverrides buffers;
+    QString bufferBasis;
+    tuneBuffers(server, &buffers, &bufferBasis);
+    if (buffers.socketBuffer > 0) {
+        emit connectionLog(QString("📦 Буферы сокета %1: %2 КБ, txqueuelen %3 (%4)")
+        .arg(server.name).arg(buffers.socketBuffer / 1024).arg(buffers.txQueueLen).arg(bufferBasis));
     }
 
-    QProcess whereisProcess;
-    whereisProcess.start("whereis", QStringList() << "-b" << "openvpn");
-    whereisProcess.waitForFinished(1000);
+    // Сообщения второстепенных сессий (новой при переключении и закрывающейся старой)
+    // идут только в лог, с именем сервера
+    connect(s, &VpnSession::connectionLog, this, [this, s, server](const QString& message) {
+        emit connectionLog(s == session ? message : QString("[%1] %2").arg(server.name, message));
+    });
+    connect(s, &VpnSession::connectionStatus, this, [this, s, server](const QString& type, const QString& message) {
+        if (s == session) {
+            emit connectionStatus(type, message);
+        } else {
+            emit connectionLog(QString("[%1] %2").arg(server.name, message));
+        }
+    });
+    connect(s, &VpnSession::traceFinished, this, &VpnManager::connectTraceFinished);
+    connect(s, &VpnSession::configProblem, this, [this, s](ConfigProblem problem, const QString& detail) {
+        onConfigProblem(s, problem, detail);
+    });
+
+    connect(s, &VpnSession::stateChanged, this, [this, s](VpnState state) {
+        if (s == session) {
+            emit connectionStateChanged(state);
+        }
+    });
+    connect(s, &VpnSession::managementState, this, [this, s](const ManagementState& state) {
+        if (s == session) {
+            emit stateChanged(state);
+        }
+    });
+    connect(s, &VpnSession::trafficUpdated, this, [this, s](qint64 in, qint64 out) {
+        if (s == session) {
+            emit trafficUpdated(in, out);
+        }
+    });
 
-    QString output = QString::fromUtf8(whereisProcess.readAllStandardOutput());
-    if (output.contains("openvpn:")) {
-        QStringList parts = output.split(':');
-        if (parts.size() > 1) {
-            QStringList bins = parts[1].trimmed().split(' ');
-            for (const QString& bin : bins) {
-                if (QFile::exists(bin) && QFileInfo(bin).isExecutable()) {
-                    return bin;
-                }
+    connect(s, &VpnSession::established, this, [this, s]() {
+        if (profiles) {
+            profiles->recordSuccess(s->server().identity());
+        }
+        if (s == session) {
+            SessionJournal::instance().markActive(s->journalId());
+            emit connectionEstablished();
+            emit connectionStatus("success", QString("✅ Подключено к %1").arg(s->server().name));
+            emit connectionLog("🎉 VPN подключение установлено!");
+            emit connected(s->server().name);
+            if (!aggregate.isEmpty()) {
+                rebalance();   // Основной туннель восстановился после переподключения
             }
+        } else if (s == pending) {
+            onPendingEstablished();
+        } else if (racers.contains(s)) {
+            onRacerEstablished(s);
+        } else if (aggregate.contains(s)) {
+            emit connectionLog(QString("🔗 Туннель %1 на %2 готов к объединению").arg(s->server().name, s->device()));
+            rebalance();
+        } else if (s == standby) {
+            emit connectionLog(QString("🛡️ Резерв %1 готов на %2").arg(s->server().name, s->device()));
+            emit standbyChanged(s->server().name);
         }
-    }
+    });
+    connect(s, &VpnSession::lost, this, [this, s]() {
+        if (aggregate.contains(s)) {
+            rebalance();   // Деградировавший туннель выходит из набора до восстановления
+            return;
+        }
+        if (s != session) {
+            return;
+        }
+        if (hasReadyStandby() && !pending) {
+            promoteStandby("Соединение потеряно");
+        } else if (readyAggregateCount() > 0) {
+            rebalance();
+            emit connectionLost();
+        } else {
+            emit connectionLost();
+        }
+    });
+
+    connect(s, &VpnSession::finished, this, [this, s](VpnState finishedIn, bool wasConnected, int exitCode) {
+        removeHostRoute(s);
+        if (wasConnected && s->peakMbps() > 0.0) {
+            // Достигнутая скорость: по ней видно, хватает ли подобранных буферов
+            ConfigOverrides buffers;
+            tuneBuffers(s->server(), &buffers);
+            emit connectionLog(QString("📈 %1: пик %2 Мбит/с при буферах %3 КБ")
+            .arg(s->server().name).arg(s->peakMbps(), 0, 'f', 1)
+            .arg(buffers.socketBuffer > 0 ? buffers.socketBuffer / 1024 : kDefaultSocketBuffer / 1024));
+            if (profiles) {
+                profiles->recordThroughput(s->server(), s->peakMbps());
+                profiles->save();
+            }
+        }
+        s->deleteLater();
+
+        if (s == session) {
+            session = nullptr;
+            lastServerName = s->server().name;
+            if (finishedIn != VpnState::Draining && hasReadyStandby() && !pending) {
+                promoteStandby("Туннель закрылся");
+            } else if (finishedIn != VpnState::Draining && readyAggregateCount() > 0 && !pending) {
+                promoteAggregateMember();
+            } else {
+                onActiveFinished(finishedIn, wasConnected, exitCode);
+            }
+        } else if (aggregate.contains(s)) {
+            aggregate.removeOne(s);
+            emit connectionLog(QString("⚠️ Туннель %1 выбыл из объединения").arg(s->server().name));
+            rebalance();
+            emit aggregateMemberFailed(s->server());
+        } else if (racers.contains(s)) {
+            racers.removeOne(s);
+            raceFailures.append(s->server());
+            emit connectionLog(QString("🏁 %1 выбыл из гонки").arg(s->server().name));
+            if (!raceQueue.isEmpty()) {
+                // Упавший участник не ждет шага: следующий стартует сразу
+                launchNextRacer();
+                raceTimer->start();
+            } else if (racers.isEmpty()) {
+                finishRace(nullptr);
+            }
+        } else if (s == standby) {
+            standby = nullptr;
+            emit connectionLog(QString("⚠️ Резерв %1 отключился").arg(s->server().name));
+            emit standbyChanged(QString());
+            emit standbyFailed(s->server());
+        } else if (s == pending) {
+            pending = nullptr;
+            abortSwitch("новый туннель не поднялся");
+        } else if (s == retiring) {
+            retiring = nullptr;
+            emit connectionLog(QString("🧹 Старый туннель %1 закрыт").arg(s->server().name));
+            // Еще секунду считаем потери: хвост старого туннеля тоже часть переключения
+            QTimer::singleShot(1000, gapMonitor, [this]() { gapMonitor->stop(); });
+        }
+    });
 
-    return QString();
+    return s;
 }
 
 void VpnManager::connectToServer(const VpnServer& server) {
-    if (m_isConnected) {
-        emit connectionStatus("warning", "Уже подключено к VPN");
+    if (isRacing()) {
+        emit connectionStatus("warning", "Подключение уже выполняется");
+        return;
+    }
+    if (pending) {
+        emit connectionStatus("warning", "Переключение уже выполняется");
+        return;
+    }
+    if (isConnected()) {
+        switchToServer(server);
+        return;
+    }
+    if (session) {
+        emit connectionStatus("warning", "Подключение уже выполняется");
         return;
     }
 
     try {
-        currentServer = server;
         emit connectionStatus("info", QString("Подключаюсь к %1...").arg(server.name));
         emit connectionLog(QString("🚀 Начинаю подключение к %1").arg(server.name));
 
-        QByteArray configData = QByteArray::fromBase64(server.configBase64.toLatin1());
-        QString configContent = QString::fromUtf8(configData);
-
-        QString tempDir = QDir::tempPath();
-        QString safeServerName = server.name;
-        safeServerName.replace(QRegularExpression("[^a-zA-Z0-9]"), "_");
+        qint64 clickMs = QDateTime::currentMSecsSinceEpoch();
 
-        QString tempFileName = QString("vpngate_%1_%2.ovpn")
-        .arg(safeServerName)
-        .arg(QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss"));
-        configPath = QDir(tempDir).filePath(tempFileName);
+        // Обычно конфиг уже подготовлен в фоне, иначе собираем его здесь.
+        // С запасными серверами конфиг свой для каждого набора — собираем сразу
+        QList<VpnServer> fallbacks = pickFallbacks(server);
+        QByteArray configBytes = fallbacks.isEmpty() ? configCache->lookup(server) : QByteArray();
+        bool precomputed = !configBytes.isEmpty();
+        if (!precomputed) {
+            configBytes = ConfigCache::render(server, connectionTimeout, fallbacks, overridesFor(server));
+        }
+        if (!fallbacks.isEmpty()) {
+            QStringList names;
+            for (const VpnServer& fallback : fallbacks) {
+                names << fallback.name;
+            }
+            emit connectionLog(QString("🔁 Запасные серверы в том же процессе: %1").arg(names.join(", ")));
+        }
 
-        QFile configFile(configPath);
-        if (!configFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
-            emit connectionStatus("error", "Не удалось создать конфиг");
-            emit connectionLog(QString("❌ Ошибка создания файла: %1").arg(configFile.errorString()));
-            return;
+        // Первая сессия ставит маршруты сама, как обычный openvpn
+        session = createSession(server, QString(), false);
+        session->setFallbacks(fallbacks);
+        if (!fallbacks.isEmpty()) {
+            // openvpn сам перебирает несколько серверов — им нужен общий срок
+            session->setConnectTimeout(connectionTimeout);
+        }
+        if (!session->start(server, configBytes, precomputed, clickMs)) {
+            session->deleteLater();
+            session = nullptr;
         }
 
-        QString enhancedConfig = enhanceConfigForConnection(configContent, server);
-        QTextStream stream(&configFile);
-        stream << enhancedConfig;
-        configFile.close();
+    } catch (const std::exception& e) {
+        emit connectionStatus("error", QString("Ошибка подключения: %1").arg(e.what()));
+        disconnect();
+    } catch (...) {
+        emit connectionStatus("error", "Неизвестная ошибка подключения");
+        disconnect();
+    }
+}
 
-        emit connectionLog(QString("📄 Конфиг сохранен: %1").arg(configPath));
+void VpnManager::switchToServer(const VpnServer& server) {
+    if (!isConnected()) {
+        connectToServer(server);
+        return;
+    }
+    if (pending) {
+        emit connectionStatus("warning", "Переключение уже выполняется");
+        return;
+    }
+    if (server.identity() == session->server().identity()) {
+        emit connectionStatus("info", QString("Уже подключено к %1").arg(server.name));
+        return;
+    }
 
-        if (!QFile::exists(configPath)) {
-            emit connectionStatus("error", "Файл конфигурации не найден");
-            emit connectionLog("❌ Файл конфигурации был удален");
-            return;
+    // Резерв на этот сервер уже поднят — достаточно перенести маршруты
+    if (standby && standby->state() == VpnState::Connected && standby->server().identity() == server.identity()) {
+        promoteStandby("Переключение на резервный сервер");
+        return;
+    }
+
+    beginSwitch(server);
+}
+
+void VpnManager::beginSwitch(const VpnServer& server) {
+    switchFrom = session->server().name;
+    qint64 clickMs = QDateTime::currentMSecsSinceEpoch();
+
+    // Новый туннель на собственном tun и без маршрутов: трафик пока идет через старый
+    QString device = nextTunDevice();
+    pending = createSession(server, device, true);
+
+    emit connectionStatus("info", QString("Переключаюсь на %1...").arg(server.name));
+    emit connectionLog(QString("🔀 Поднимаю %1 на %2, трафик пока идет через %3")
+    .arg(server.name, device, switchFrom));
+
+    if (device.isEmpty() || QHostAddress(server.ip).isNull()) {
+        abortSwitch(device.isEmpty() ? "нет свободного tun-устройства" : "у сервера нет IP-адреса");
+        return;
+    }
+
+    VpnSession* target = pending;
+    startDetached(target, server, clickMs, [this, target](const QString& error) {
+        if (pending == target) {
+            abortSwitch(error);
         }
+    });
+}
 
-        QString openvpnPath = findOpenVPN();
-        if (openvpnPath.isEmpty()) {
-            emit connectionStatus("error", "OpenVPN не найден");
-            emit connectionLog("❌ OpenVPN не найден в системе");
+void VpnManager::startDetached(VpnSession* target, const VpnServer& server, qint64 clickMs,
+                               const std::function<void(const QString& error)>& failed) {
+    // Пакеты нового openvpn должны идти к серверу напрямую, а не через текущий туннель
+    SystemCommand::run("ip", QStringList() << "-4" << "-o" << "route" << "show" << "default", this,
+                       [this, target, server, clickMs, failed](bool ok, const QString& output) {
+        if (!isDetachedTarget(target)) {
+            return;
+        }
+        QString gateway;
+        QString physicalDevice;
+        if (!ok || !parseDefaultRoute(output, &gateway, &physicalDevice)) {
+            failed("не найден маршрут по умолчанию физического интерфейса");
             return;
         }
 
-        emit connectionLog(QString("✅ Найден OpenVPN: %1").arg(openvpnPath));
-
-        QStringList cmd;
-        if (getuid() == 0) {
-            cmd = {
-                openvpnPath,
-                "--config", configPath,
-                "--auth-user-pass", "/dev/stdin",
-                "--verb", "3",
-                "--connect-timeout", QString::number(connectionTimeout)
-            };
-        } else {
-            cmd = {
-                "sudo",
-                openvpnPath,
-                "--config", configPath,
-                "--auth-user-pass", "/dev/stdin",
-                "--verb", "3",
-                "--connect-timeout", QString::number(connectionTimeout)
-            };
-        }
-
-        emit connectionLog("🔧 Запускаю OpenVPN...");
-
-        // Создаем новый процесс
-        process = new QProcess(this);
-        process->setProcessChannelMode(QProcess::MergedChannels);
-
-        // Используем лямбду для безопасного чтения вывода
-        connect(process, &QProcess::readyRead, this, [this]() {
-            // QPointer автоматически проверяет, жив ли объект
-            if (!process) {
+        QString hostRoute = QString("%1/32").arg(server.ip);
+        QList<QJsonObject> ops = { PrivilegedOps::hostRoute(hostRoute, gateway, physicalDevice) };
+        SystemCommand::runPrivileged(ops, this, [this, target, server, clickMs, hostRoute, failed](bool ok, const QString& output) {
+            if (!isDetachedTarget(target)) {
                 return;
             }
-
-            QProcess* currentProcess = process.data();
-            if (!currentProcess || currentProcess->state() == QProcess::NotRunning) {
+            if (!ok) {
+                failed(QString("не удалось добавить маршрут до сервера (%1)").arg(output));
                 return;
             }
+            hostRoutes.insert(target, hostRoute);
+            target->setHostRoute(hostRoute);
 
-            try {
-                while (currentProcess->canReadLine()) {
-                    QByteArray data = currentProcess->readLine();
-                    if (data.isEmpty()) break;
-
-                    QString line = QString::fromUtf8(data).trimmed();
-                    if (!line.isEmpty()) {
-                        emit connectionLog(QString("🔍 %1").arg(line));
-
-                        if (line.contains("Initialization Sequence Completed")) {
-                            m_isConnected = true;
-                            emit connectionStatus("success", QString("✅ Подключено к %1").arg(currentServer.name));
-                            emit connectionLog("🎉 VPN подключение установлено!");
-                            emit connected(currentServer.name);
-                        } else if (line.contains("AUTH_FAILED")) {
-                            emit connectionStatus("error", "Ошибка аутентификации");
-                            emit connectionLog("❌ Неверный логин/пароль");
-                            QTimer::singleShot(0, this, &VpnManager::disconnect);
-                        } else if (line.contains("TLS Error")) {
-                            emit connectionStatus("error", "Ошибка TLS");
-                            emit connectionLog("❌ Ошибка TLS handshake");
-                            QTimer::singleShot(0, this, &VpnManager::disconnect);
-                        } else if (line.contains("SIGTERM") || line.contains("process exiting")) {
-                            if (m_isConnected) {
-                                m_isConnected = false;
-                                emit disconnected();
-                            }
-                        } else if (line.contains("Error reading username from Auth authfile: /dev/stdin")) {
-                            emit connectionStatus("error", "Ошибка переподключения");
-                            emit connectionLog("❌ OpenVPN пытается перечитать учетные данные");
-                            QTimer::singleShot(0, this, &VpnManager::disconnect);
-                        } else if (line.contains("Options error: --keepalive conflicts with --ping")) {
-                            emit connectionStatus("error", "Ошибка конфигурации OpenVPN");
-                            emit connectionLog("❌ Конфликт опций keepalive и ping");
-                            QTimer::singleShot(0, this, &VpnManager::disconnect);
-                        }
-                    }
-                }
-            } catch (const std::exception& e) {
-                qDebug() << "Exception in readVpnOutput lambda:" << e.what();
-            } catch (...) {
-                qDebug() << "Unknown exception in readVpnOutput lambda";
+            QByteArray configBytes = configCache->lookup(server);
+            bool precomputed = !configBytes.isEmpty();
+            if (!precomputed) {
+                configBytes = ConfigCache::render(server, connectionTimeout, QList<VpnServer>(), overridesFor(server));
+            }
+            if (!target->start(server, configBytes, precomputed, clickMs)) {
+                failed("не удалось запустить OpenVPN");
             }
         });
+    });
+}
 
-        // Обработка завершения процесса
-        connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
-                this, &VpnManager::vpnProcessFinished);
+QList<QJsonObject> VpnManager::defaultRouteCommands(const QString& device) {
+    // Обе половины 0/1 и 128/1 меняются одним вызовом ip: они точнее исходного
+    // маршрута по умолчанию и перекрывают маршруты прежнего туннеля
+    return QList<QJsonObject>()
+    << PrivilegedOps::tunnelRoute("0.0.0.0/1", device)
+    << PrivilegedOps::tunnelRoute("128.0.0.0/1", device);
+}
 
-        // Обработка ошибок запуска
-        connect(process, &QProcess::errorOccurred, this, [this](QProcess::ProcessError error) {
-            if (error == QProcess::FailedToStart) {
-                emit connectionStatus("error", "Не удалось запустить OpenVPN");
-                emit connectionLog("❌ Ошибка запуска OpenVPN");
-                cleanup();
-            }
-        });
+QString VpnManager::nextTunDevice() const {
+    QStringList reserved;
+    QList<VpnSession*> sessions = racers + aggregate;
+    sessions << session << pending << retiring << standby;
+    for (VpnSession* s : sessions) {
+        if (s && !s->requestedDeviceName().isEmpty()) {
+            reserved << s->requestedDeviceName();
+        }
+    }
+    return VpnSession::freeTunDevice(reserved);
+}
 
-        // Запускаем процесс
-        process->start(cmd[0], cmd.mid(1));
+void VpnManager::onPendingEstablished() {
+    VpnSession* target = pending;
+    QString device = target->device();
+    if (device.isEmpty()) {
+        abortSwitch("не удалось определить tun-устройство нового туннеля");
+        return;
+    }
+    if (!target->redirectsGateway()) {
+        emit connectionLog(QString("ℹ️ %1 не прислал redirect-gateway, маршрут по умолчанию переносится все равно")
+        .arg(target->server().name));
+    }
 
-        if (!process->waitForStarted(3000)) {
-            emit connectionStatus("error", "Не удалось запустить OpenVPN");
-            emit connectionLog(QString("❌ Ошибка запуска: %1").arg(process->errorString()));
-            cleanup();
+    gapMonitor->start();
+    SystemCommand::runPrivileged(defaultRouteCommands(device), this, [this, target](bool ok, const QString& output) {
+        if (pending != target) {
+            gapMonitor->stop(0);
             return;
         }
+        if (!ok) {
+            gapMonitor->stop(0);
+            abortSwitch(QString("не удалось перенести маршрут по умолчанию (%1)").arg(output));
+            return;
+        }
+
+        pending = nullptr;
+        takeOver(target, QString("✅ Переключено на %1").arg(target->server().name));
+    });
+}
+
+void VpnManager::takeOver(VpnSession* target, const QString& statusMessage) {
+    applyDns(target);
+
+    VpnSession* previous = session;
+    session = target;
+    SessionJournal::instance().markActive(session->journalId());
+
+    emit connectionStateChanged(session->state());
+    emit connectionEstablished();
+    emit connectionStatus("success", statusMessage);
+    emit connectionLog(QString("🔀 Маршрут по умолчанию переведен на %1 (%2)")
+    .arg(session->device(), session->server().name));
+    emit connected(session->server().name);
+
+    if (previous) {
+        retiring = previous;
+        retiring->stop();
+    } else {
+        gapMonitor->stop();
+    }
+
+    // Вызывающий перевел весь трафик на один туннель — возвращаем остальные в набор
+    routeSignature.clear();
+    if (!aggregate.isEmpty()) {
+        rebalance();
+    }
+}
+
+bool VpnManager::recoverSessions() {
+    // Записи текущих сессий не трогаем: пользователь мог подключиться раньше
+    QSet<QString> ownIds;
+    QList<VpnSession*> own = racers + aggregate;
+    own << session << pending << retiring << standby;
+    for (VpnSession* s : own) {
+        if (s && !s->journalId().isEmpty()) {
+            ownIds.insert(s->journalId());
+        }
+    }
 
-        // Отправляем учетные данные
-        QString credentials = currentServer.username + "\n" + currentServer.password + "\n";
-        if (process->state() == QProcess::Running) {
-            process->write(credentials.toUtf8());
-            process->waitForBytesWritten(1000);
-            process->closeWriteChannel();
+    SessionJournal& journal = SessionJournal::instance();
+    JournalEntry keep;
+    QList<JournalEntry> orphans;
+    for (const JournalEntry& entry : journal.entries()) {
+        if (ownIds.contains(entry.id)) {
+            continue;
+        }
+        if (!SessionJournal::isAlive(entry)) {
+            journal.remove(entry.id);
+            SessionJournal::removeSessionDir(entry.sessionDir);
+        } else if (entry.active && keep.id.isEmpty() && !session) {
+            keep = entry;
+        } else {
+            orphans.append(entry);
         }
+    }
 
-        // Таймер для проверки подключения
-        QTimer::singleShot(connectionTimeout * 1000, this, [this]() {
-            if (!m_isConnected && process && process->state() == QProcess::Running) {
-                emit connectionStatus("error", "Таймаут подключения");
-                emit connectionLog(QString("⏰ Таймаут подключения (%1 секунд)").arg(connectionTimeout));
-                disconnect();
-            }
-        });
+    // Резерв, участники гонки и туннели объединения без нас не нужны
+    QList<QJsonObject> routes;
+    QStringList removedRoutes;
+    for (const JournalEntry& entry : orphans) {
+        emit connectionLog(QString("🧹 Завершаю оставшийся от прошлого запуска OpenVPN к %1 (pid %2)")
+        .arg(entry.server.name)
+        .arg(entry.pid));
+        SystemCommand::signalOpenVpn(entry.pid, "TERM", this);
+        journal.remove(entry.id);
+        SessionJournal::removeSessionDir(entry.sessionDir);
+        if (!entry.hostRoute.isEmpty() && entry.hostRoute != keep.hostRoute && !removedRoutes.contains(entry.hostRoute)) {
+            removedRoutes << entry.hostRoute;
+            routes << PrivilegedOps::routeDelete(entry.hostRoute);
+        }
+    }
+    if (!routes.isEmpty()) {
+        SystemCommand::runPrivileged(routes, this);
+    }
 
-    } catch (const std::exception& e) {
-        emit connectionStatus("error", QString("Ошибка подключения: %1").arg(e.what()));
-        cleanup();
-    } catch (...) {
-        emit connectionStatus("error", "Неизвестная ошибка подключения");
-        cleanup();
+    if (keep.id.isEmpty()) {
+        return false;
+    }
+
+    session = createSession(keep.server, keep.device, keep.routeNoExec);
+    if (!keep.hostRoute.isEmpty()) {
+        hostRoutes.insert(session, keep.hostRoute);
+    }
+    if (!session->attach(keep)) {
+        session->deleteLater();
+        session = nullptr;
+        return false;
     }
+    emit connectionStateChanged(session->state());
+    return true;
 }
 
-void VpnManager::disconnect() {
-    if (m_isConnected) {
-        emit connectionStatus("info", "Отключаюсь...");
-        emit connectionLog("🔌 Отключаю VPN...");
+bool VpnManager::releaseActive() {
+    // Многопутевой маршрут и незавершенное переключение без нас не поддержать
+    if (!session || session->state() != VpnState::Connected || pending || !aggregate.isEmpty()) {
+        return false;
     }
+    VpnSession* kept = session;
+    session = nullptr;
+    hostRoutes.remove(kept);   // Маршрут до сервера нужен туннелю и дальше
+    kept->release();
+    emit connectionLog(QString("🔓 Туннель к %1 оставлен работать после выхода").arg(kept->server().name));
+    return true;
+}
 
-    if (process) {
-        QProcess* currentProcess = process.data();
-        if (currentProcess && currentProcess->state() == QProcess::Running) {
-            emit connectionLog("📤 Отправляю сигнал завершения...");
+void VpnManager::abortSwitch(const QString& reason) {
+    emit connectionStatus("warning", "Переключение не удалось");
+    emit connectionLog(QString("❌ Переключение не удалось: %1. Остаюсь на %2")
+    .arg(reason, session ? session->server().name : QString("—")));
 
-            // Пробуем корректно завершить
-            currentProcess->terminate();
+    VpnSession* target = pending;
+    pending = nullptr;
+    discardSession(target);
+}
 
-            if (!currentProcess->waitForFinished(2000)) {
-                emit connectionLog("⚠️ OpenVPN не отвечает, принудительно завершаю...");
-                currentProcess->kill();
-                currentProcess->waitForFinished(500);
+void VpnManager::discardSession(VpnSession* target) {
+    if (!target) {
+        return;
+    }
+    if (target->state() == VpnState::Idle) {
+        removeHostRoute(target);
+        target->deleteLater();
+    } else {
+        target->stop();   // Маршрут и объект убираются по finished
+    }
+}
+
+void VpnManager::setStandbyServer(const VpnServer& server) {
+    if (server.name.isEmpty()) {
+        if (standby) {
+            emit connectionLog(QString("🛡️ Резерв %1 больше не нужен").arg(standby->server().name));
+            VpnSession* target = standby;
+            standby = nullptr;
+            discardSession(target);
+            emit standbyChanged(QString());
+        }
+        return;
+    }
+    if (standby && standby->server().identity() == server.identity()) {
+        return;
+    }
+    if (!isConnected() || server.identity() == session->server().identity() || QHostAddress(server.ip).isNull()) {
+        return;
+    }
+
+    if (standby) {
+        VpnSession* target = standby;
+        standby = nullptr;
+        discardSession(target);
+    }
+
+    QString device = nextTunDevice();
+    if (device.isEmpty()) {
+        emit connectionLog("⚠️ Нет свободного tun-устройства для резерва");
+        return;
+    }
+
+    standby = createSession(server, device, true);
+    emit connectionLog(QString("🛡️ Поднимаю резерв %1 на %2 без маршрутов").arg(server.name, device));
+
+    VpnSession* target = standby;
+    startDetached(target, server, QDateTime::currentMSecsSinceEpoch(), [this, target, server](const QString& error) {
+        if (standby != target) {
+            return;
+        }
+        emit connectionLog(QString("⚠️ Резерв %1 не запущен: %2").arg(server.name, error));
+        standby = nullptr;
+        discardSession(target);
+        emit standbyFailed(server);
+    });
+}
+
+void VpnManager::promoteStandby(const QString& reason) {
+    QPointer<VpnSession> target = standby;
+    standby = nullptr;
+    switchFrom = session ? session->server().name : lastServerName;
+
+    emit connectionLog(QString("⚡ %1: перевожу трафик на резерв %2 (%3)")
+    .arg(reason, target->server().name, target->device()));
+    emit standbyChanged(QString());
+
+    gapMonitor->start();
+    SystemCommand::runPrivileged(defaultRouteCommands(target->device()), this, [this, target](bool ok, const QString& output) {
+        if (!target || target->state() != VpnState::Connected || !ok) {
+            gapMonitor->stop(0);
+            emit connectionLog(QString("❌ Не удалось перейти на резерв%1")
+            .arg(ok ? QString() : QString(": %1").arg(output)));
+            if (target) {
+                discardSession(target);
+            }
+            if (!session) {
+                emit disconnected();
+                emit connectionStatus("info", "Соединение разорвано");
             }
+            return;
         }
+        takeOver(target, QString("⚡ Переключено на резерв %1").arg(target->server().name));
+    });
+}
+
+bool VpnManager::isDetachedTarget(VpnSession* target) const {
+    return target == pending || target == standby || racers.contains(target) || aggregate.contains(target);
+}
+
+void VpnManager::raceConnect(const QList<VpnServer>& candidates, int staggerMs) {
+    if (!isIdle() || isRacing()) {
+        emit connectionStatus("warning", "Подключение уже выполняется");
+        return;
     }
 
-    cleanup();
+    raceQueue.clear();
+    raceFailures.clear();
+    for (const VpnServer& server : candidates) {
+        if (!QHostAddress(server.ip).isNull()) {
+            raceQueue.append(server);
+        }
+    }
+    if (raceQueue.isEmpty()) {
+        emit connectionStatus("error", "Нет серверов для подключения");
+        emit raceFinished(QString(), QList<VpnServer>());
+        return;
+    }
 
-    if (m_isConnected) {
-        m_isConnected = false;
-        emit disconnected();
-        emit connectionStatus("info", "Отключено");
+    raceStartMs = QDateTime::currentMSecsSinceEpoch();
+    QStringList names;
+    for (const VpnServer& server : raceQueue) {
+        names << server.name;
     }
+    emit connectionStatus("info", QString("Подключаюсь к одному из %1 серверов...").arg(raceQueue.size()));
+    emit connectionLog(QString("🏁 Гонка подключений: %1 (шаг %2 мс)").arg(names.join(", ")).arg(staggerMs));
+    emit connectionStateChanged(VpnState::Handshaking);
+
+    raceTimer->setInterval(qMax(50, staggerMs));
+    launchNextRacer();
+    raceTimer->start();
 }
 
-QPair<QString, QString> VpnManager::getStatus() const {
-    if (m_isConnected) {
-        return qMakePair(QString("connected"), currentServer.name);
-    } else if (process && process->state() == QProcess::Running) {
-        return qMakePair(QString("connecting"), QString("Подключение..."));
-    } else {
-        return qMakePair(QString("disconnected"), QString("Отключено"));
+void VpnManager::launchNextRacer() {
+    if (raceQueue.isEmpty()) {
+        raceTimer->stop();
+        return;
+    }
+
+    VpnServer server = raceQueue.takeFirst();
+    QString device = nextTunDevice();
+    if (device.isEmpty()) {
+        emit connectionLog(QString("⚠️ Нет свободного tun-устройства для %1").arg(server.name));
+        raceQueue.clear();
+        raceTimer->stop();
+        if (racers.isEmpty()) {
+            finishRace(nullptr);
+        }
+        return;
     }
+
+    // Участники гонки изолированы от таблицы маршрутизации: свой tun, маршрутов нет
+    VpnSession* racer = createSession(server, device, true);
+    racers.append(racer);
+    emit connectionLog(QString("🏁 Старт %1 на %2 (+%3 мс)")
+    .arg(server.name, device)
+    .arg(QDateTime::currentMSecsSinceEpoch() - raceStartMs));
+
+    startDetached(racer, server, raceStartMs, [this, racer](const QString& error) {
+        if (!racers.contains(racer)) {
+            return;
+        }
+        emit connectionLog(QString("🏁 %1 не стартовал: %2").arg(racer->server().name, error));
+        racers.removeOne(racer);
+        raceFailures.append(racer->server());
+        discardSession(racer);
+        if (!raceQueue.isEmpty()) {
+            launchNextRacer();
+        } else if (racers.isEmpty()) {
+            finishRace(nullptr);
+        }
+    });
 }
 
-QVariantMap VpnManager::getConnectionInfo() const {
-    if (m_isConnected) {
-        QVariantMap info;
-        info["server"] = currentServer.name;
-        info["country"] = currentServer.country;
-        info["ip"] = currentServer.ip;
-        info["speed"] = currentServer.speedMbps;
-        return info;
-    }
-    return QVariantMap();
-}
-
-void VpnManager::readVpnOutput()
-{
-    if (!process || !process->isOpen()) return;
-
-    QByteArray output = process->readAllStandardOutput();
-    QByteArray errors = process->readAllStandardError();
-    QByteArray combined = output + errors;
-
-    if (combined.isEmpty()) return;
-
-    QTextStream stream(combined);
-    QString line;
-    while (stream.readLineInto(&line)) {
-        line = line.trimmed();
-        if (line.isEmpty()) continue;
-
-        emit connectionLog(QString("🔍 %1").arg(line));
-
-        // Успешное подключение
-        if (line.contains("Initialization Sequence Completed")) {
-            if (!m_isConnected) {
-                m_isConnected = true;
-                m_lastConnectionTime = QDateTime::currentDateTime();
-                emit connectionEstablished();
-                emit connectionStatus("success", "VPN подключение установлено!");
-                emit connectionLog("🎉 VPN подключение установлено!");
+void VpnManager::onRacerEstablished(VpnSession* winner) {
+    racers.removeOne(winner);
+    emit connectionLog(QString("🏁 Первым подключился %1 за %2 мс, остальные отменяются")
+    .arg(winner->server().name)
+    .arg(QDateTime::currentMSecsSinceEpoch() - raceStartMs));
+    cancelRace();
+
+    QPointer<VpnSession> target = winner;
+    SystemCommand::runPrivileged(defaultRouteCommands(winner->device()), this, [this, target](bool ok, const QString& output) {
+        if (!target || target->state() != VpnState::Connected || !ok) {
+            emit connectionLog(QString("❌ Не удалось направить трафик в туннель%1")
+            .arg(ok ? QString() : QString(": %1").arg(output)));
+            if (target) {
+                raceFailures.append(target->server());
+                discardSession(target);
             }
-            continue;
+            finishRace(nullptr);
+            return;
+        }
+        finishRace(target);
+    });
+}
+
+void VpnManager::cancelRace() {
+    raceTimer->stop();
+    raceQueue.clear();
+    QList<VpnSession*> losers = racers;
+    racers.clear();
+    for (VpnSession* racer : losers) {
+        racer->discardTrace();   // Отмененная попытка не отказ сервера
+        discardSession(racer);
+    }
+}
+
+void VpnManager::finishRace(VpnSession* winner) {
+    QList<VpnServer> failures = raceFailures;
+    raceFailures.clear();
+
+    if (winner) {
+        takeOver(winner, QString("✅ Подключено к %1").arg(winner->server().name));
+        emit raceFinished(winner->server().name, failures);
+    } else {
+        emit connectionStateChanged(state());
+        emit connectionStatus("error", "Ни один сервер не подключился");
+        emit raceFinished(QString(), failures);
+    }
+}
+
+void VpnManager::setAggregateServers(const QList<VpnServer>& servers) {
+    if (!servers.isEmpty() && !isConnected()) {
+        return;
+    }
+
+    QSet<QString> wanted;
+    for (const VpnServer& server : servers) {
+        wanted.insert(server.identity());
+    }
+
+    // Лишние туннели закрываем, трафик с них снимается до закрытия
+    bool removed = false;
+    for (VpnSession* member : QList<VpnSession*>(aggregate)) {
+        if (!wanted.contains(member->server().identity())) {
+            aggregate.removeOne(member);
+            discardSession(member);
+            removed = true;
+        }
+    }
+    if (removed) {
+        rebalance();
+    }
+
+    if (servers.isEmpty()) {
+        restoreHashPolicy();
+        return;
+    }
+    if (savedHashPolicy < 0) {
+        // Хэш по портам: каждое соединение держится одного туннеля, разные — расходятся.
+        // Прежнее значение возвращаем, когда объединение снимается
+        QFile current("/proc/sys/net/ipv4/fib_multipath_hash_policy");
+        int previous = current.open(QIODevice::ReadOnly) ? current.readAll().trimmed().toInt() : 0;
+        if (previous != 1) {
+            savedHashPolicy = previous;
+            SystemCommand::runPrivileged({ PrivilegedOps::sysctl(kHashPolicyKey, 1) }, this);
         }
+    }
 
-        // Ошибки аутентификации
-        if (line.contains("AUTH_FAILED")) {
-            emit connectionStatus("error", "Ошибка аутентификации на сервере");
-            emit connectionLog("❌ Ошибка аутентификации: сервер отклонил логин/пароль");
-            QTimer::singleShot(0, this, &VpnManager::disconnect);
+    for (const VpnServer& server : servers) {
+        bool present = server.identity() == session->server().identity();
+        for (VpnSession* member : aggregate) {
+            present = present || member->server().identity() == server.identity();
+        }
+        if (present || QHostAddress(server.ip).isNull()) {
             continue;
         }
 
-        // Критические сетевые или TLS ошибки
-        if (line.contains("TLS Error") ||
-            line.contains("Connection reset") ||
-            line.contains("TCP connection failed") ||
-            line.contains("TLS key negotiation failed") ||
-            line.contains("write UDP: Operation not permitted") ||
-            line.contains("Bad encapsulated packet length") ||
-            line.contains("Fatal TLS error")) {
-            emit connectionStatus("error", "Сетевая или TLS ошибка");
-        emit connectionLog("⚠️ Сетевая или TLS ошибка, попытка подключения прервана");
-        QTimer::singleShot(0, this, &VpnManager::disconnect);
-        continue;
+        QString device = nextTunDevice();
+        if (device.isEmpty()) {
+            emit connectionLog("⚠️ Нет свободного tun-устройства для объединения");
+            break;
+        }
+
+        VpnSession* member = createSession(server, device, true);
+        aggregate.append(member);
+        emit connectionLog(QString("🔗 Добавляю в объединение %1 на %2").arg(server.name, device));
+
+        startDetached(member, server, QDateTime::currentMSecsSinceEpoch(), [this, member, server](const QString& error) {
+            if (!aggregate.contains(member)) {
+                return;
             }
+            emit connectionLog(QString("⚠️ Туннель %1 не запущен: %2").arg(server.name, error));
+            aggregate.removeOne(member);
+            discardSession(member);
+            emit aggregateMemberFailed(server);
+        });
+    }
+}
 
-            // Ошибки конфигурации
-            if (line.contains("Error reading username from Auth authfile") ||
-                line.contains("Cannot open TUN/TAP dev") ||
-                line.contains("Cannot allocate TUN/TAP dev dynamically")) {
-                emit connectionStatus("error", "Ошибка конфигурации OpenVPN");
-            emit connectionLog("❌ Ошибка конфигурации OpenVPN");
-            QTimer::singleShot(0, this, &VpnManager::disconnect);
+void VpnManager::dropAggregate() {
+    QList<VpnSession*> members = aggregate;
+    aggregate.clear();
+    for (VpnSession* member : members) {
+        discardSession(member);
+    }
+    routeSignature.clear();
+    restoreHashPolicy();
+}
+
+void VpnManager::restoreHashPolicy() {
+    if (savedHashPolicy < 0) {
+        return;
+    }
+    int previous = savedHashPolicy;
+    savedHashPolicy = -1;
+    SystemCommand::runPrivileged({ PrivilegedOps::sysctl(kHashPolicyKey, previous) }, this,
+                                 [this, previous](bool ok, const QString& output) {
+        if (!ok) {
+            emit connectionLog(QString("⚠️ Не удалось вернуть fib_multipath_hash_policy = %1: %2")
+            .arg(previous).arg(output));
+        }
+    });
+}
+
+int VpnManager::readyAggregateCount() const {
+    int ready = 0;
+    for (VpnSession* member : aggregate) {
+        if (member->state() == VpnState::Connected) {
+            ready++;
+        }
+    }
+    return ready;
+}
+
+QStringList VpnManager::tunnelDevices() const {
+    QStringList devices;
+    if (isConnected()) {
+        devices << session->device();
+    }
+    for (VpnSession* member : aggregate) {
+        if (member->state() == VpnState::Connected) {
+            devices << member->device();
+        }
+    }
+    return devices;
+}
+
+void VpnManager::rebalance() {
+    QList<VpnSession*> ready;
+    if (isConnected()) {
+        ready << session;
+    }
+    for (VpnSession* member : aggregate) {
+        if (member->state() == VpnState::Connected && !member->device().isEmpty()) {
+            ready << member;
+        }
+    }
+    if (ready.isEmpty()) {
+        return;
+    }
+
+    // Вес — скорость туннеля: медленный получает меньше потоков. Пиковая скорость
+    // по bytecount — нижняя граница того, что туннель уже пропустил; пока трафика
+    // через него почти не было, берем оценку из каталога и замеров
+    QList<QPair<QString, int>> nexthops;
+    QStringList signature;
+    for (VpnSession* tunnel : ready) {
+        double mbps = qMax(tunnel->server().effectiveSpeedMbps(), tunnel->peakMbps());
+        int weight = qBound(1, qRound(mbps), 100);
+        nexthops << qMakePair(tunnel->device(), weight);
+        signature << QString("%1:%2").arg(tunnel->device()).arg(weight);
+    }
+    if (signature.join(' ') == routeSignature) {
+        return;
+    }
+    routeSignature = signature.join(' ');
+
+    QList<QJsonObject> commands;
+    if (ready.size() == 1) {
+        commands = defaultRouteCommands(ready.first()->device());
+    } else {
+        commands << PrivilegedOps::multipathRoute("0.0.0.0/1", nexthops)
+                 << PrivilegedOps::multipathRoute("128.0.0.0/1", nexthops);
+    }
+
+    SystemCommand::runPrivileged(commands, this, [this, signature](bool ok, const QString& output) {
+        if (!ok) {
+            routeSignature.clear();
+            emit connectionLog(QString("❌ Не удалось распределить трафик по туннелям: %1").arg(output));
+            return;
+        }
+        emit connectionLog(QString("🔗 Трафик распределен по %1 туннелям: %2")
+        .arg(signature.size()).arg(signature.join(", ")));
+        emit aggregateChanged(signature.size());
+    });
+}
+
+void VpnManager::promoteAggregateMember() {
+    VpnSession* target = nullptr;
+    for (VpnSession* member : aggregate) {
+        if (member->state() == VpnState::Connected) {
+            target = member;
+            break;
+        }
+    }
+    aggregate.removeOne(target);
+    switchFrom = lastServerName;
+    emit connectionLog(QString("⚡ Основной туннель закрылся, основным становится %1").arg(target->server().name));
+
+    takeOver(target, QString("⚡ Основной туннель: %1").arg(target->server().name));
+    rebalance();
+}
+
+void VpnManager::applyDns(VpnSession* target) {
+    QStringList dns = target->pushedDns();
+    if (dns.isEmpty()) {
+        return;
+    }
+    if (QStandardPaths::findExecutable("resolvectl").isEmpty()) {
+        emit connectionLog("ℹ️ resolvectl не найден, DNS остается системным");
+        return;
+    }
+
+    QString device = target->device();
+    SystemCommand::runPrivileged({ PrivilegedOps::tunnelDns(device, dns) }, this,
+                                 [this, device, dns](bool ok, const QString& output) {
+        if (!ok) {
+            emit connectionLog(QString("⚠️ Не удалось назначить DNS для %1: %2").arg(device, output));
+            return;
+        }
+        emit connectionLog(QString("🌐 DNS через %1: %2").arg(device, dns.join(", ")));
+    });
+}
+
+void VpnManager::removeHostRoute(VpnSession* target) {
+    QString route = hostRoutes.take(target);
+    if (route.isEmpty()) {
+        return;
+    }
+    // Маршрут нужен, пока к этому серверу идет другая наша сессия
+    for (auto it = hostRoutes.constBegin(); it != hostRoutes.constEnd(); ++it) {
+        if (it.value() == route) {
+            return;
+        }
+    }
+    SystemCommand::runPrivileged({ PrivilegedOps::routeDelete(route) }, this);
+}
+
+bool VpnManager::parseDefaultRoute(const QString& output, QString* gateway, QString* device) {
+    // default via 192.168.1.1 dev eth0 proto dhcp metric 100
+    for (const QString& line : output.split('\n', Qt::SkipEmptyParts)) {
+        QStringList parts = line.split(' ', Qt::SkipEmptyParts);
+        int viaIndex = parts.indexOf("via");
+        int devIndex = parts.indexOf("dev");
+        if (viaIndex < 0 || devIndex < 0 || viaIndex + 1 >= parts.size() || devIndex + 1 >= parts.size()) {
+            continue;
+        }
+        QString dev = parts[devIndex + 1];
+        if (dev.startsWith("tun") || dev.startsWith("tap")) {
             continue;
-                }
-
-                // Ошибки сжатия данных (новая обработка)
-                if (line.contains("Bad compression stub decompression header byte") ||
-                    line.contains("Decompress error") ||
-                    line.contains("bad compression stub decompression header")) {
-                    emit connectionStatus("warning", "Конфликт настроек сжатия");
-                emit connectionLog("⚠️ Конфликт настроек сжатия с сервером");
-
-                // Пробуем исправить настройки сжатия на лету
-                emit connectionLog("🔄 Пытаюсь исправить настройки сжатия...");
-
-                // Отправляем команду для переподключения с новыми настройками
-                if (process && process->state() == QProcess::Running) {
-                    // Отправляем SIGUSR1 для мягкого переподключения
-                    process->write("signal SIGUSR1\n");
-                    process->waitForBytesWritten(100);
-
-                    // Также отправляем команду для изменения настроек сжатия
-                    QString restartCommand = "echo \"comp-lzo adaptive\" > /dev/stdin\n";
-                    process->write(restartCommand.toUtf8());
-                    process->waitForBytesWritten(100);
-                }
-
-                // Если через 5 секунд ошибка сохраняется, переподключаемся полностью
-                QTimer::singleShot(5000, this, [this]() {
-                    if (m_isConnected && process && process->state() == QProcess::Running) {
-                        // Проверяем, сохраняется ли проблема
-                        emit connectionLog("🔄 Полное переподключение для исправления сжатия...");
-
-                        // Сохраняем текущий сервер
-                        VpnServer tempServer = currentServer;
-
-                        // Отключаемся
-                        disconnect();
-
-                        // Переподключаемся с задержкой
-                        QTimer::singleShot(2000, this, [this, tempServer]() {
-                            emit connectionLog("🔄 Переподключаюсь с исправленными настройками сжатия...");
-                            connectToServer(tempServer);
-                        });
-                    }
-                });
-
-                continue;
-                    }
-
-                    // Проблемы с маршрутизацией
-                    if (line.contains("ROUTE: route addition failed") ||
-                        line.contains("Cannot ioctl TUNSETIFF") ||
-                        line.contains("TUN/TAP device") ||
-                        line.contains("route gateway is not reachable")) {
-                        emit connectionStatus("warning", "Проблема с маршрутизацией");
-                    emit connectionLog("⚠️ Возможная проблема с маршрутами VPN");
-
-                    // Пробуем исправить, отправив команду перенастройки маршрутов
-                    if (process && process->state() == QProcess::Running) {
-                        QString routeCommand = "echo \"route-nopull\" > /dev/stdin\n";
-                        process->write(routeCommand.toUtf8());
-                        process->waitForBytesWritten(100);
-                    }
-
-                    continue;
-                        }
-
-                        // Предупреждения о deprecated опциях
-                        if (line.contains("deprecated") || line.contains("WARNING:")) {
-                            emit connectionLog(QString("ℹ️ %1").arg(line));
-                            continue;
-                        }
-
-                        // Неизвестные критические ошибки
-                        if (line.contains("Exiting due to fatal error") ||
-                            line.contains("SIGTERM[soft,") ||
-                            line.contains("Process exiting")) {
-                            if (m_isConnected) {
-                                m_isConnected = false;
-                                emit connectionLost();
-                                emit connectionStatus("info", "Соединение закрыто");
-                                emit connectionLog("🔌 Соединение с VPN завершено");
-                            }
-                            }
-
-                            // Информационные сообщения о переподключении
-                            if (line.contains("SIGUSR1") || line.contains("soft reset")) {
-                                emit connectionLog(QString("🔄 %1").arg(line));
-                                if (line.contains("connection reset")) {
-                                    emit connectionStatus("info", "Переподключение...");
-                                }
-                            }
-    }
-}
-
-void VpnManager::vpnProcessFinished(int exitCode, QProcess::ExitStatus exitStatus) {
-    Q_UNUSED(exitCode);
-    Q_UNUSED(exitStatus);
-
-    bool wasConnected = m_isConnected;
-
-    if (wasConnected) {
-        m_isConnected = false;
+        }
+        *gateway = parts[viaIndex + 1];
+        *device = dev;
+        return true;
+    }
+    return false;
+}
+
+void VpnManager::onActiveFinished(VpnState finishedIn, bool wasConnected, int exitCode) {
+    // Резерв и объединение держатся только рядом с рабочим туннелем
+    setStandbyServer(VpnServer());
+    dropAggregate();
+
+    if (finishedIn == VpnState::Draining) {
+        // Штатное завершение после disconnect()
+        if (wasConnected) {
+            emit disconnected();
+            emit connectionStatus("info", "Отключено");
+        }
+    } else if (finishedIn == VpnState::Connected) {
         emit disconnected();
         emit connectionStatus("info", "Соединение разорвано");
         emit connectionLog("🔗 VPN соединение закрыто");
-    } else if (process && process->exitCode() != 0) {
-        QString exitCodeStr = QString::number(process->exitCode());
-        emit connectionStatus("error", QString("Ошибка подключения (код: %1)").arg(exitCodeStr));
+    } else if (exitCode != 0) {
+        emit connectionStatus("error", QString("Ошибка подключения (код: %1)").arg(exitCode));
+    }
+}
+
+void VpnManager::setConnectionTimeout(int timeout) {
+    connectionTimeout = timeout;
+    configCache->setConnectTimeout(timeout);
+}
+
+void VpnManager::setServerProfiles(ServerProfiles* serverProfiles) {
+    profiles = serverProfiles;
+    applyServerProfiles();
+}
+
+void VpnManager::applyServerProfiles() {
+    configCache->setOverrides(candidateOverrides());
+    configCache->prepare(rankedCandidates);
+}
+
+void VpnManager::setSocketBufferBounds(int minBytes, int maxBytes) {
+    socketBufferMin = qMax(16 * 1024, minBytes);
+    socketBufferMax = qMax(socketBufferMin, maxBytes);
+    applyServerProfiles();
+}
+
+ConfigOverrides VpnManager::overridesFor(const VpnServer& server) const {
+    ConfigOverrides overrides = profiles ? profiles->overrides(server.identity()) : ConfigOverrides();
+    tuneBuffers(server, &overrides);
+    return overrides;
+}
+
+QHash<QString, ConfigOverrides> VpnManager::candidateOverrides() const {
+    // Только те, что попадут в кэш: RTT дальних кандидатов не должен его сбрасывать
+    QHash<QString, ConfigOverrides> result;
+    for (const VpnServer& server : rankedCandidates) {
+        if (result.size() >= ConfigCache::MaxEntries) {
+            break;
+        }
+        if (!server.configBase64.isEmpty()) {
+            result.insert(server.identity(), overridesFor(server));
+        }
+    }
+    return result;
+}
+
+// Буферы сокета openvpn по произведению скорости на задержку (BDP).
+// Маленькие буферы ограничивают скорость до дальних быстрых серверов,
+// большие впустую держат память на близких медленных
+void VpnManager::tuneBuffers(const VpnServer& server, ConfigOverrides* overrides, QString* basis) const {
+    LatencyStats latency = server.latency.stats();
+    double rttMs = latency.p50Ms > 0.0 ? latency.p50Ms : 0.0;
+    if (rttMs <= 0.0 && server.testPing > 0 && server.testPing < 999) {
+        rttMs = server.testPing;
+    }
+    if (rttMs <= 0.0 && server.ping > 0 && server.ping < 999) {
+        rttMs = server.ping;
     }
 
-    cleanup();
+    // Достигнутая и измеренная через туннель скорость точнее оценок.
+    // Берем большую: достигнутая может быть занижена самими буферами
+    double achieved = profiles ? profiles->achievedMbps(server.identity()) : 0.0;
+    double mbps = qMax(achieved, server.measuredMbps);
+    QString source = achieved >= server.measuredMbps ? "достигнуто" : "замер";
+    if (mbps <= 0.0 && server.estimatedMbps > 0.0) {
+        mbps = server.estimatedMbps;
+        source = "оценка по серии";
+    }
+    if (mbps <= 0.0 && server.speedMbps > 0.0) {
+        mbps = server.speedMbps;
+        source = "каталог";
+    }
+    if (rttMs <= 0.0 || mbps <= 0.0) {
+        return;   // Остаются значения по умолчанию
+    }
+
+    // Мбит/с * мс = 125 байт; двойной запас на всплески и рост окна
+    qint64 bdpBytes = static_cast<qint64>(mbps * rttMs * 125.0);
+    overrides->socketBuffer = qBound(socketBufferMin, roundUpPowerOfTwo(bdpBytes * 2), socketBufferMax);
+    overrides->txQueueLen = qBound<qint64>(kMinTxQueueLen, bdpBytes / kFullPathMtu + 1, kMaxTxQueueLen);
+    if (basis) {
+        *basis = QString("RTT %1 мс × %2 Мбит/с (%3), BDP %4 КБ")
+        .arg(rttMs, 0, 'f', 0).arg(mbps, 0, 'f', 1).arg(source).arg(bdpBytes / 1024);
+    }
 }
 
-QString VpnManager::enhanceConfigForConnection(const QString& configContent, const VpnServer& server) {
-    Q_UNUSED(server);
+void VpnManager::onConfigProblem(VpnSession* target, ConfigProblem problem, const QString& detail) {
+    if (!profiles) {
+        return;
+    }
+    VpnServer server = target->server();
+    QString change;
+    bool applied = profiles->learn(server, problem, detail, &change);
+    profiles->save();
+    applyServerProfiles();
+
+    if (!applied) {
+        emit connectionLog(QString("📘 %1: ошибка (%2) повторилась, известные поправки не помогли — %3")
+        .arg(server.name, configProblemName(problem), change));
+        return;
+    }
+    emit connectionLog(QString("📘 %1: ошибка (%2), запомнил поправку — %3")
+    .arg(server.name, configProblemName(problem), change));
+
+    // Туннель поднят, но данные не проходят: поднимаем рядом новый с поправкой
+    // и переводим на него трафик. Иначе поправка применится со следующей попытки
+    if (target == session && target->state() == VpnState::Connected && !pending && !isRacing()) {
+        emit connectionLog(QString("🔁 Переподключаюсь к %1 с исправленным конфигом").arg(server.name));
+        beginSwitch(server);
+    }
+}
+
+int VpnManager::connectDeadline(const VpnServer& server, QString* basis) const {
+    if (!connectTimings) {
+        return connectionTimeout;
+    }
+    return connectTimings->deadlineSeconds(server.identity(), connectionTimeout, basis);
+}
+
+void VpnManager::prepareConfigs(const QList<VpnServer>& candidates) {
+    rankedCandidates = candidates;
+    configCache->setOverrides(candidateOverrides());
+    configCache->prepare(candidates);
+}
+
+void VpnManager::invalidateConfigs() {
+    rankedCandidates.clear();
+    configCache->invalidate();
+}
+
+void VpnManager::setMultiRemote(int remotes) {
+    multiRemoteCount = qBound(1, remotes, 8);
+}
+
+QList<VpnServer> VpnManager::pickFallbacks(const VpnServer& server) const {
+    QList<VpnServer> fallbacks;
+    if (multiRemoteCount <= 1) {
+        return fallbacks;
+    }
+
+    QString key = compatibilityKey(QString::fromUtf8(QByteArray::fromBase64(server.configBase64.toLatin1())));
+    for (const VpnServer& candidate : rankedCandidates) {
+        if (fallbacks.size() >= multiRemoteCount - 1) {
+            break;
+        }
+        if (candidate.identity() == server.identity() || candidate.configBase64.isEmpty()) {
+            continue;
+        }
+        QString candidateConfig = QString::fromUtf8(QByteArray::fromBase64(candidate.configBase64.toLatin1()));
+        if (compatibilityKey(candidateConfig) == key) {
+            fallbacks.append(candidate);
+        }
+    }
+    return fallbacks;
+}
+
+void VpnManager::disconnect() {
+    setStandbyServer(VpnServer());
+    dropAggregate();
+    if (isRacing()) {
+        cancelRace();
+    }
+
+    if (pending) {
+        VpnSession* target = pending;
+        pending = nullptr;
+        target->stop();
+    }
+
+    if (!session) {
+        return;
+    }
+    if (session->state() == VpnState::Idle) {
+        session->deleteLater();
+        session = nullptr;
+        return;
+    }
+
+    if (session->state() == VpnState::Connected) {
+        emit connectionStatus("info", "Отключаюсь...");
+        emit connectionLog("🔌 Отключаю VPN...");
+    }
+    session->stop();
+}
+
+QVariantMap VpnManager::getConnectionInfo() const {
+    if (!isConnected()) {
+        return QVariantMap();
+    }
+
+    const VpnServer& server = session->server();
+    QVariantMap info;
+    info["server"] = server.name;
+    info["country"] = server.country;
+    info["ip"] = server.ip;
+    info["speed"] = server.speedMbps;
+    info["tunnelIp"] = session->tunnelIp();
+    info["device"] = session->device();
+    info["bytesIn"] = session->bytesIn();
+    info["bytesOut"] = session->bytesOut();
+    if (hasReadyStandby()) {
+        info["standby"] = standby->server().name;
+    }
+    if (!aggregate.isEmpty()) {
+        info["tunnels"] = tunnelDevices().size();
+    }
+    return info;
+}
+
+QString VpnManager::enhanceConfigForConnection(const QString& configContent, const VpnServer& server,
+                                              int connectTimeout, const QList<VpnServer>& fallbacks,
+                                              const ConfigOverrides& overrides) {
+    // Адрес из каталога уже известен — openvpn не тратит время на DNS
+    bool pinRemote = !QHostAddress(server.ip).isNull();
+    // С запасными серверами адреса задаются блоками <connection>
+    bool multiRemote = !fallbacks.isEmpty();
 
     QStringList lines = configContent.split('\n');
     QStringList enhancedLines;
+    bool cipherSeen = false;
 
     for (const QString& line : lines) {
         QString trimmed = line.trimmed();
@@ -503,10 +1246,30 @@ QString VpnManager::enhanceConfigForConnection(const QString& configContent, con
             continue;
         }
 
-        if (trimmed.startsWith("cipher ")) {
+        if (multiRemote && (trimmed.startsWith("remote ") || trimmed.startsWith("proto ") ||
+                            trimmed.startsWith("port ") || trimmed.startsWith("rport "))) {
+            enhancedLines.append(QString("# %1  # Перенесено в <connection>").arg(trimmed));
+        } else if (pinRemote && trimmed.startsWith("remote ")) {
+            QStringList parts = trimmed.split(' ', Qt::SkipEmptyParts);
+            if (parts.size() >= 2 && parts[1] != server.ip) {
+                parts[1] = server.ip;
+                enhancedLines.append(QString("# %1  # Закреплено за адресом из каталога").arg(trimmed));
+                enhancedLines.append(parts.join(' '));
+            } else {
+                enhancedLines.append(line);
+            }
+        } else if (trimmed.startsWith("cipher ")) {
             QString cipher = trimmed.split(' ', Qt::SkipEmptyParts)[1];
-            enhancedLines.append(QString("# %1  # Сохраняем оригинальную настройку").arg(trimmed));
-            enhancedLines.append(QString("cipher %1").arg(cipher)); // Используем оригинальный шифр
+            cipherSeen = true;
+            if (!overrides.cipher.isEmpty()) {
+                // С шифром из конфига сервер уже не согласился
+                cipher = overrides.cipher;
+                enhancedLines.append(QString("# %1  # Заменено выученной поправкой").arg(trimmed));
+            } else {
+                enhancedLines.append(QString("# %1  # Сохраняем оригинальную настройку").arg(trimmed));
+            }
+            // Оригинальный шифр в форме, которую понимает установленная версия openvpn
+            enhancedLines.append(OpenVpnBinary::resolve().cipherDirectives(cipher));
         } else if (trimmed.startsWith("auth ")) {
             QString auth = trimmed.split(' ', Qt::SkipEmptyParts)[1];
             enhancedLines.append(QString("# %1  # Сохраняем оригинальную настройку").arg(trimmed));
@@ -514,6 +1277,9 @@ QString VpnManager::enhanceConfigForConnection(const QString& configContent, con
         } else if (trimmed.contains("fragment") || trimmed.contains("mssfix")) {
             // Убираем эти настройки, чтобы использовать наши собственные
             enhancedLines.append(QString("# %1  # Заменено нашими настройками").arg(trimmed));
+        } else if ((trimmed.startsWith("comp-lzo") || trimmed.contains("compress")) && !overrides.compression.isEmpty()) {
+            // Сжатие из конфига не совпало с сервером, своя директива добавится ниже
+            enhancedLines.append(QString("# %1  # Заменено выученной поправкой").arg(trimmed));
         } else if (trimmed.startsWith("comp-lzo") || trimmed.contains("compress")) {
             // ВАЖНО: Не игнорируем настройки сжатия от сервера
             // Вместо этого, комментируем их и добавляем соответствующую настройку
@@ -530,27 +1296,58 @@ QString VpnManager::enhanceConfigForConnection(const QString& configContent, con
                 enhancedLines.append(trimmed); // Сохраняем оригинальную настройку
             }
         } else if (trimmed.startsWith("auth-user-pass")) {
-            // Заменяем любые существующие настройки auth-user-pass, т.к. мы передаем их через stdin
+            // Заменяем любые существующие настройки auth-user-pass, т.к. мы передаем их через management
             enhancedLines.append(QString("# %1  # Заменено нашей аутентификацией").arg(trimmed));
         } else {
             enhancedLines.append(line); // Сохраняем оригинальную строку с форматированием
         }
     }
 
+    // Поправки, выученные на прошлых подключениях к этому серверу
+    if (!overrides.isEmpty()) {
+        enhancedLines.append(QString("\n# Поправки для сервера: %1").arg(overrides.summary()));
+        if (!overrides.compression.isEmpty() && overrides.compression != "none") {
+            enhancedLines.append(overrides.compression);
+        }
+        if (!overrides.cipher.isEmpty() && !cipherSeen) {
+            enhancedLines.append(OpenVpnBinary::resolve().cipherDirectives(overrides.cipher));
+        }
+    }
+
+    // Каждый сервер получает свою долю общего таймаута: openvpn переходит к следующему
+    // <connection> сам, без перезапуска процесса и повторного чтения конфига
+    int remoteTimeout = connectTimeout;
+    if (multiRemote) {
+        remoteTimeout = qMax(5, connectTimeout / (fallbacks.size() + 1));
+        enhancedLines.append("\n# Основной и запасные серверы по порядку");
+        enhancedLines.append(connectionBlock(configContent, server, remoteTimeout));
+        for (const VpnServer& fallback : fallbacks) {
+            QString fallbackConfig = QString::fromUtf8(QByteArray::fromBase64(fallback.configBase64.toLatin1()));
+            enhancedLines.append(connectionBlock(fallbackConfig, fallback, remoteTimeout));
+        }
+    }
+
     // Добавляем наши оптимизации
     enhancedLines.append("\n# Оптимизации для VPNGate");
     enhancedLines.append("remote-cert-tls server");
     enhancedLines.append("tls-client");
     enhancedLines.append("reneg-sec 0");
-    enhancedLines.append("script-security 2");
     
     // Настройки аутентификации
-    enhancedLines.append("auth-user-pass");  // Используем stdin для аутентификации
+    enhancedLines.append("auth-user-pass");  // Запрашивается через management-интерфейс
     
     // Повтор подключения
-    enhancedLines.append("connect-retry 2");
+    if (!multiRemote) {
+        enhancedLines.append("connect-retry 2");
+    }
     enhancedLines.append("connect-retry-max 5");
-    enhancedLines.append(QString("connect-timeout %1").arg(connectionTimeout));
+    enhancedLines.append(QString("connect-timeout %1").arg(remoteTimeout));
+    if (multiRemote) {
+        enhancedLines.append("connect-retry 1");                                    // Сразу к следующему серверу
+        enhancedLines.append(QString("server-poll-timeout %1").arg(remoteTimeout)); // TCP-серверы
+        enhancedLines.append(QString("hand-window %1").arg(remoteTimeout));         // UDP: TLS не завершился
+        enhancedLines.append("auth-retry nointeract");  // AUTH_FAILED — следующий сервер, без запроса
+    }
 
     // Блокируем только настройки ping, НЕ настройки сжатия
     enhancedLines.append("pull-filter ignore \"ping\"");
@@ -565,9 +1362,28 @@ QString VpnManager::enhanceConfigForConnection(const QString& configContent, con
     // Наши собственные настройки keepalive
     enhancedLines.append("keepalive 10 60");
 
-    enhancedLines.append("tun-mtu 1500");
-    enhancedLines.append("fragment 1300");  // Уменьшаем размер фрагмента для лучшей совместимости
-    enhancedLines.append("mssfix 1200");    // Уменьшаем MSS для лучшей совместимости
+    if (overrides.pathMtu >= kFullPathMtu) {
+        // Путь чистый: без fragment, TCP ограничен только размером пакета на проводе
+        enhancedLines.append(QString("tun-mtu %1").arg(kFullPathMtu));
+        enhancedLines.append(QString("mssfix %1").arg(kFullPathMtu - kIpUdpOverhead));
+    } else if (overrides.pathMtu > 0) {
+        // MTU пути измерен или выучен по EMSGSIZE: режем по нему, а не по общим 1300/1200
+        int linkPayload = overrides.pathMtu - kIpUdpOverhead;
+        if (overrides.noFragment) {
+            // Сервер без fragment — уменьшаем сам туннель, чтобы пакеты проходили целиком
+            enhancedLines.append(QString("tun-mtu %1").arg(overrides.pathMtu - kTunnelOverhead));
+        } else {
+            enhancedLines.append(QString("tun-mtu %1").arg(kFullPathMtu));
+            enhancedLines.append(QString("fragment %1").arg(linkPayload));
+        }
+        enhancedLines.append(QString("mssfix %1").arg(linkPayload));
+    } else {
+        enhancedLines.append("tun-mtu 1500");
+        if (!overrides.noFragment) {
+            enhancedLines.append("fragment 1300");  // Уменьшаем размер фрагмента для лучшей совместимости
+        }
+        enhancedLines.append("mssfix 1200");    // Уменьшаем MSS для лучшей совместимости
+    }
     enhancedLines.append("persist-key");
     enhancedLines.append("persist-tun");
     enhancedLines.append("nobind");
@@ -579,8 +1395,13 @@ QString VpnManager::enhanceConfigForConnection(const QString& configContent, con
     // Дополнительные опции для стабильности
     enhancedLines.append("explicit-exit-notify 0");
     enhancedLines.append("fast-io");        // Улучшает производительность
-    enhancedLines.append("sndbuf 393216");  // Увеличиваем буфер отправки
-    enhancedLines.append("rcvbuf 393216");  // Увеличиваем буфер приема
+    // Буферы по BDP сервера, если известны RTT и скорость
+    int socketBuffer = overrides.socketBuffer > 0 ? overrides.socketBuffer : kDefaultSocketBuffer;
+    enhancedLines.append(QString("sndbuf %1").arg(socketBuffer));
+    enhancedLines.append(QString("rcvbuf %1").arg(socketBuffer));
+    if (overrides.txQueueLen > 0) {
+        enhancedLines.append(QString("txqueuelen %1").arg(overrides.txQueueLen));
+    }
 
     // Настройки логирования
     enhancedLines.append("verb 3");
@@ -589,30 +1410,46 @@ QString VpnManager::enhanceConfigForConnection(const QString& configContent, con
     return enhancedLines.join('\n');
 }
 
-void VpnManager::cleanup() {
-    // Отключаем все сигналы от process
-    if (process) {
-        QObject::disconnect(process, nullptr, this, nullptr);
 
-        // Если процесс еще работает, завершаем его
-        QProcess* currentProcess = process.data();
-        if (currentProcess && currentProcess->state() == QProcess::Running) {
-            currentProcess->kill();
-            currentProcess->waitForFinished(100);
-        }
+QString VpnManager::connectionBlock(const QString& configContent, const VpnServer& server, int connectTimeout) {
+    QString host = server.ip;
+    QString port = QString::number(server.port);
+    QString proto = "udp";
 
-        // QPointer автоматически управляет временем жизни
-        // Просто очищаем указатель
-        process.clear();
+    for (const QString& line : configContent.split('\n')) {
+        QStringList parts = line.trimmed().split(' ', Qt::SkipEmptyParts);
+        if (parts.size() >= 2 && parts[0] == "proto") {
+            proto = parts[1];
+        } else if (parts.size() >= 3 && parts[0] == "remote") {
+            if (QHostAddress(server.ip).isNull()) {
+                host = parts[1];
+            }
+            port = parts[2];
+        }
     }
 
-    // Удаляем временный файл конфигурации
-    if (!configPath.isEmpty() && QFile::exists(configPath)) {
-        QTimer::singleShot(5000, [configPath = this->configPath]() {
-            if (QFile::exists(configPath)) {
-                QFile::remove(configPath);
-            }
-        });
-        configPath.clear();
+    return QStringList({
+        "<connection>",
+        QString("remote %1 %2").arg(host, port),
+        QString("proto %1").arg(proto),
+        QString("connect-timeout %1").arg(connectTimeout),
+        "</connection>"
+    }).join('\n');
+}
+
+QString VpnManager::compatibilityKey(const QString& configContent) {
+    // Серверы можно объединить в один конфиг, если у них совпадает все,
+    // кроме адреса: сертификаты, ключи, шифр, устройство
+    QStringList significant;
+    for (const QString& line : configContent.split('\n')) {
+        QString trimmed = line.simplified();
+        if (trimmed.isEmpty() || trimmed.startsWith('#') || trimmed.startsWith(';') ||
+            trimmed.startsWith("remote ") || trimmed.startsWith("proto ") ||
+            trimmed.startsWith("port ") || trimmed.startsWith("rport ")) {
+            continue;
+        }
+        significant.append(trimmed);
     }
+    return QString::fromLatin1(QCryptographicHash::hash(significant.join('\n').toUtf8(),
+                                                        QCryptographicHash::Sha1).toHex());
 }
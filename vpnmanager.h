@@ -2,21 +2,103 @@
 #define VPNMANAGER_H
 
 #include <QObject>
-#include <QProcess>
-#include <QPointer>
 #include <QDateTime>
+#include <QHash>
+#include <QJsonObject>
+#include <functional>
 #include "vpntypes.h"
+#include "vpnsession.h"
+#include "gapmonitor.h"
+#include "serverprofiles.h"
+
+class ConfigCache;
+class ConnectTimingStats;
+class QTimer;
 
 class VpnManager : public QObject {
     Q_OBJECT
 public:
     explicit VpnManager(QObject *parent = nullptr);
+    ~VpnManager();
+    // При активном подключении — переключение без разрыва (switchToServer)
     void connectToServer(const VpnServer& server);
+    // Новый туннель поднимается рядом со старым, затем на него переносятся
+    // маршруты по умолчанию и DNS, и только после этого старый закрывается
+    void switchToServer(const VpnServer& server);
     void disconnect();
-    QPair<QString, QString> getStatus() const;
+
+    // Свои процессы openvpn из журнала сессий прошлого запуска: активный туннель
+    // подхватывается через management-сокет, остальные завершаются.
+    // true — туннель подхвачен
+    bool recoverSessions();
+    // Перед выходом: основной туннель продолжает работать, следующий запуск
+    // подхватит его. false — оставить нельзя (нет туннеля, идет переключение, объединение)
+    bool releaseActive();
     QVariantMap getConnectionInfo() const;
-    void setConnectionTimeout(int timeout) { connectionTimeout = timeout; }
-    bool isConnected() const { return m_isConnected; }
+    void setConnectionTimeout(int timeout);
+    // История подключений: по ней каждому серверу дается свой срок подключения,
+    // setConnectionTimeout задает потолок. Без истории — потолок
+    void setConnectTimings(const ConnectTimingStats* timings) { connectTimings = timings; }
+    int connectDeadline(const VpnServer& server, QString* basis = nullptr) const;
+    // Профили серверов: выученные поправки конфигов применяются при подключении,
+    // новые записываются после ошибок согласования
+    void setServerProfiles(ServerProfiles* serverProfiles);
+    // Профили изменились снаружи (замеры MTU пути) — пересобрать подготовленные конфиги
+    void applyServerProfiles();
+    // Пределы sndbuf/rcvbuf, подбираемых по BDP сервера
+    void setSocketBufferBounds(int minBytes, int maxBytes);
+
+    VpnState state() const {
+        if (session) {
+            return session->state();
+        }
+        return racers.isEmpty() ? VpnState::Idle : VpnState::Handshaking;
+    }
+    bool isConnected() const { return state() == VpnState::Connected; }
+    bool isIdle() const { return state() == VpnState::Idle; }
+    bool isSwitching() const { return pending != nullptr; }
+    bool isRacing() const { return !racers.isEmpty() || !raceQueue.isEmpty(); }
+    QString serverName() const { return session ? session->server().name : QString(); }
+    QString tunnelDevice() const { return session ? session->device() : QString(); }
+    static QString stateName(VpnState state) { return VpnSession::stateName(state); }
+
+    // Горячий резерв: вторая сессия к запасному серверу, полностью согласованная,
+    // на своем tun и без маршрутов. При потере основного туннеля на нее
+    // переносятся только маршруты. Пустой server — резерв не нужен
+    void setStandbyServer(const VpnServer& server);
+    bool hasReadyStandby() const { return standby && standby->state() == VpnState::Connected; }
+    QString standbyName() const { return standby ? standby->server().name : QString(); }
+
+    // Параллельное подключение: кандидаты стартуют по очереди с шагом staggerMs,
+    // каждый на своем tun без маршрутов. Маршруты получает первый поднявшийся,
+    // остальные отменяются. Упавший участник сразу запускает следующего
+    void raceConnect(const QList<VpnServer>& candidates, int staggerMs);
+
+    // Объединение туннелей: к основному добавляются туннели к servers, каждый на
+    // своем tun. Маршрут по умолчанию — многопутевой, потоки распределяются хэшем
+    // по адресам и портам. Туннель в переподключении выводится из набора.
+    // Пустой список — только основной туннель
+    void setAggregateServers(const QList<VpnServer>& servers);
+    int aggregateSize() const { return aggregate.size(); }
+    QStringList tunnelDevices() const;   // Все туннели, несущие трафик
+
+    // Заранее подготовить конфиги для первых кандидатов списка
+    void prepareConfigs(const QList<VpnServer>& candidates);
+    void invalidateConfigs();
+
+    // Сколько серверов (вместе с выбранным) вписывать в конфиг блоками <connection>.
+    // Запасные берутся из кандидатов prepareConfigs с совместимым конфигом.
+    // 1 — только выбранный сервер
+    void setMultiRemote(int remotes);
+
+    // Итоговый конфиг для openvpn. Не обращается к состоянию менеджера,
+    // поэтому вызывается и из фоновых потоков. overrides — выученные поправки сервера
+    static QString enhanceConfigForConnection(const QString& configContent, const VpnServer& server,
+                                              int connectTimeout,
+                                              const QList<VpnServer>& fallbacks = QList<VpnServer>(),
+                                              const ConfigOverrides& overrides = ConfigOverrides());
+    // Хэш конфига без адреса сервера: совпадает — серверы можно вписать в один конфиг
+    static QString compatibilityKey(const QString& configContent);
 
 signals:
     void connectionStatus(const QString& type, const QString& message);
@@ -25,22 +107,76 @@ signals:
     void disconnected();
     void connectionEstablished();
     void connectionLost();
-
-private slots:
-    void readVpnOutput();
-    void vpnProcessFinished(int exitCode, QProcess::ExitStatus exitStatus);
+    void stateChanged(const ManagementState& state);
+    void trafficUpdated(qint64 bytesIn, qint64 bytesOut);
+    void connectionStateChanged(VpnState state);
+    void connectTraceFinished(const ConnectTrace& trace);   // Хронометраж попытки: успех или отказ
+    void switchCompleted(const QString& fromServer, const QString& toServer, const GapMonitor::Result& gap);
+    void standbyChanged(const QString& serverName);   // Пусто — готового резерва нет
+    void standbyFailed(const VpnServer& server);
+    // winner пуст — не подключился никто. failed — серверы, которые отказали сами
+    // (отмененные проигравшие сюда не входят)
+    void raceFinished(const QString& winner, const QList<VpnServer>& failed);
+    void aggregateChanged(int tunnels);
+    void aggregateMemberFailed(const VpnServer& server);
 
 private:
-    QPointer<QProcess> process;
-    bool m_isConnected;
-    VpnServer currentServer;
-    QString configPath;
+    VpnSession* session;            // Активная сессия — через нее идет трафик
+    VpnSession* pending;            // Новая сессия во время переключения
+    VpnSession* retiring;           // Старая сессия, закрывающаяся после переключения
+    VpnSession* standby;            // Горячий резерв
+    ConfigCache* configCache;       // Готовые конфиги для быстрого подключения
+    GapMonitor* gapMonitor;         // Потери во время переключения
+    QTimer* raceTimer;              // Шаг между стартами участников гонки
+    QList<VpnSession*> racers;      // Участники гонки подключений
+    QList<VpnServer> raceQueue;     // Еще не стартовавшие кандидаты
+    QList<VpnServer> raceFailures;
+    QList<VpnSession*> aggregate;   // Дополнительные туннели объединения
+    QString routeSignature;         // Текущий набор маршрута по умолчанию: tun:вес
+    int savedHashPolicy;            // fib_multipath_hash_policy до объединения (-1 — не меняли)
     int connectionTimeout;
-    QDateTime m_lastConnectionTime;
+    const ConnectTimingStats* connectTimings;
+    ServerProfiles* profiles;
+    int socketBufferMin;
+    int socketBufferMax;
+    int multiRemoteCount;
+    QList<VpnServer> rankedCandidates;   // Кандидаты из prepareConfigs, по рейтингу
+    qint64 raceStartMs;
+    QString switchFrom;
+    QString lastServerName;         // Сервер сессии, закрывшейся последней
+    QHash<VpnSession*, QString> hostRoutes;   // Маршруты до серверов, поставленные нами
 
-    QString findOpenVPN();
-    QString enhanceConfigForConnection(const QString& configContent, const VpnServer& server);
-    void cleanup();
+    VpnSession* createSession(const VpnServer& server, const QString& device, bool routeNoExec);
+    void onActiveFinished(VpnState finishedIn, bool wasConnected, int exitCode);
+    void onPendingEstablished();
+    void abortSwitch(const QString& reason);
+    void startDetached(VpnSession* target, const VpnServer& server, qint64 clickMs,
+                       const std::function<void(const QString& error)>& failed);
+    void takeOver(VpnSession* target, const QString& statusMessage);
+    void promoteStandby(const QString& reason);
+    void discardSession(VpnSession* target);
+    bool isDetachedTarget(VpnSession* target) const;
+    void launchNextRacer();
+    void onRacerEstablished(VpnSession* winner);
+    void cancelRace();
+    void finishRace(VpnSession* winner);
+    void rebalance();
+    void dropAggregate();
+    void restoreHashPolicy();
+    int readyAggregateCount() const;
+    void promoteAggregateMember();
+    QString nextTunDevice() const;
+    static QList<QJsonObject> defaultRouteCommands(const QString& device);
+    QList<VpnServer> pickFallbacks(const VpnServer& server) const;
+    static QString connectionBlock(const QString& configContent, const VpnServer& server, int connectTimeout);
+    void beginSwitch(const VpnServer& server);
+    void onConfigProblem(VpnSession* target, ConfigProblem problem, const QString& detail);
+    ConfigOverrides overridesFor(const VpnServer& server) const;
+    QHash<QString, ConfigOverrides> candidateOverrides() const;
+    void tuneBuffers(const VpnServer& server, ConfigOverrides* overrides, QString* basis = nullptr) const;
+    void applyDns(VpnSession* target);
+    void removeHostRoute(VpnSession* target);
+    static bool parseDefaultRoute(const QString& output, QString* gateway, QString* device);
 };
 
 #endif // VPNMANAGER_H
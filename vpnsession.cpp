@@ -0,0 +1,653 @@
+#include "vpnsession.h"
+#include "logclassifier.h"
+#include "openvpnbinary.h"
+#include "privilegedhelper.h"
+#include "sessionjournal.h"
+#include <QTimer>
+#include <QDir>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonObject>
+#include <QRegularExpression>
+#include <unistd.h>
+#include <pwd.h>
+
+VpnSession::VpnSession(QObject *parent)
+: QObject(parent), process(nullptr), m_state(VpnState::Idle), connectTimeout(45), routeNoExec(false),
+connectTimer(new QTimer(this)), drainTimer(new QTimer(this)), management(new ManagementClient(this)),
+pushedRedirect(false), rxBytes(0), txBytes(0), windowStartMs(0), windowRxBytes(0), windowTxBytes(0),
+peakRateMbps(0.0), authFailures(0),
+drainFromConnected(false), reattached(false), released(false) {
+    connectTimer->setSingleShot(true);
+    connect(connectTimer, &QTimer::timeout, this, [this]() {
+        if (m_state == VpnState::Spawning || m_state == VpnState::Handshaking) {
+            emit connectionStatus("error", "Таймаут подключения");
+            emit connectionLog(QString("⏰ Таймаут подключения (%1 секунд)").arg(connectTimeout));
+            stop();
+        }
+    });
+
+    drainTimer->setSingleShot(true);
+    drainTimer->setInterval(2000);
+    connect(drainTimer, &QTimer::timeout, this, [this]() {
+        if (m_state == VpnState::Draining && process) {
+            emit connectionLog("⚠️ OpenVPN не отвечает, принудительно завершаю...");
+            process->kill();   // Завершение придет через finished
+        }
+    });
+
+    connect(management, &ManagementClient::stateChanged, this, &VpnSession::onManagementState);
+    connect(management, &ManagementClient::holdWaiting, management, &ManagementClient::holdRelease);
+
+    connect(management, &ManagementClient::ready, this, [this]() {
+        emit connectionLog(reattached ? "🎛️ Подключился к management-интерфейсу работающего OpenVPN"
+                                      : "🎛️ Management-интерфейс подключен");
+        if (process) {
+            process->stopLogTail();   // Дальше лог приходит через >LOG
+        }
+        if (reattached) {
+            management->requestState();
+        }
+    });
+
+    connect(management, &ManagementClient::connectFailed, this, [this](const QString& error) {
+        emit connectionStatus("error", "Нет связи с OpenVPN");
+        emit connectionLog(QString("❌ Не удалось подключиться к management-интерфейсу: %1").arg(error));
+        QTimer::singleShot(0, this, &VpnSession::stop);
+    });
+
+    connect(management, &ManagementClient::logLine, this, &VpnSession::handleLogLine);
+
+    connect(management, &ManagementClient::byteCount, this, [this](qint64 in, qint64 out) {
+        rxBytes = in;
+        txBytes = out;
+        updateThroughput(in, out);
+        emit trafficUpdated(in, out);
+    });
+
+    connect(management, &ManagementClient::authFailed, this, [this](const QString& message) {
+        Q_UNUSED(message);
+        // С запасными серверами (auth-retry nointeract) openvpn сам переходит
+        // к следующему <connection>; останавливаемся, когда отказали все
+        authFailures++;
+        if (!fallbackServers.isEmpty() && authFailures <= fallbackServers.size()) {
+            emit connectionLog(QString("⚠️ Сервер отклонил логин/пароль, OpenVPN пробует следующий (%1 из %2)")
+            .arg(authFailures).arg(fallbackServers.size() + 1));
+            return;
+        }
+        emit connectionStatus("error", "Ошибка аутентификации");
+        emit connectionLog("❌ Неверный логин/пароль");
+        QTimer::singleShot(0, this, &VpnSession::stop);
+    });
+
+    connect(management, &ManagementClient::fatalError, this, [this](const QString& message) {
+        emit connectionStatus("error", "Критическая ошибка OpenVPN");
+        emit connectionLog(QString("❌ %1").arg(message));
+    });
+
+    connect(management, &ManagementClient::commandError, this, [this](const QString& message) {
+        emit connectionLog(QString("⚠️ Management: %1").arg(message));
+    });
+}
+
+VpnSession::~VpnSession() {
+    cleanup();
+}
+
+bool VpnSession::start(const VpnServer& server, const QByteArray& configBytes, bool precomputed, qint64 clickMs) {
+    if (m_state != VpnState::Idle) {
+        return false;
+    }
+
+    currentServer = server;
+    trace.start(server.identity(), server.name, clickMs);
+
+    QString configError;
+    if (!config.open(configBytes, &configError)) {
+        emit connectionStatus("error", "Не удалось создать конфиг");
+        emit connectionLog(QString("❌ Ошибка создания файла: %1").arg(configError));
+        return false;
+    }
+
+    // Поиск и проверка бинарника закэшированы, повторные подключения их не повторяют
+    OpenVpnCapabilities openvpn = OpenVpnBinary::resolve();
+    if (!openvpn.isValid()) {
+        emit connectionStatus("error", "OpenVPN не найден");
+        emit connectionLog("❌ OpenVPN не найден в системе");
+        cleanup();
+        return false;
+    }
+    if (!openvpn.management) {
+        emit connectionStatus("error", "OpenVPN без management-интерфейса");
+        emit connectionLog(QString("❌ %1 собран без поддержки --management").arg(openvpn.path));
+        cleanup();
+        return false;
+    }
+    QString openvpnPath = openvpn.path;
+    bool viaHelper = PrivilegedHelper::instance()->isReady();
+
+    emit connectionLog(QString("✅ Найден OpenVPN %1: %2%3")
+    .arg(openvpn.version, openvpnPath, openvpn.dcoAvailable ? " (DCO)" : ""));
+
+    // Приватный каталог сессии (0700): management-сокет, pid и лог openvpn.
+    // Переживает перезапуск приложения — по нему туннель подхватывается снова
+    QString dirError;
+    sessionDir = SessionJournal::createSessionDir(&dirError);
+    if (sessionDir.isEmpty()) {
+        emit connectionStatus("error", "Не удалось создать каталог управления");
+        emit connectionLog(QString("❌ Ошибка создания каталога: %1").arg(dirError));
+        cleanup();
+        return false;
+    }
+    journalKey = QFileInfo(sessionDir).fileName();
+    QString socketPath = QDir(sessionDir).filePath("management.sock");
+
+    // Свой openvpn читает memfd со стандартного ввода. Помощник получает
+    // содержимое в запросе и хранит копию у себя. Без memfd конфиг нужен файлом —
+    // тогда копия 0600 в каталоге сессии: она живет, пока жив туннель
+    bool configViaStdin = config.inMemory() && !viaHelper;
+    QString configPath = "/dev/stdin";
+    if (viaHelper) {
+        emit connectionLog("📄 Конфиг передается помощнику, без записи в каталог сессии");
+    } else if (configViaStdin) {
+        emit connectionLog("📄 Конфиг передается через память, без записи на диск");
+    } else {
+        if (!config.persist(sessionDir, &configError)) {
+            emit connectionStatus("error", "Не удалось создать конфиг");
+            emit connectionLog(QString("❌ Ошибка создания файла: %1").arg(configError));
+            cleanup();
+            return false;
+        }
+        configPath = config.path();
+        emit connectionLog(QString("📄 Конфиг сохранен в каталоге сессии: %1").arg(configPath));
+    }
+
+    // Учетные данные передаются по запросу >PASSWORD через management-интерфейс,
+    // OpenVPN ждет hold release, пока мы не подпишемся на события.
+    // Опции после --config переопределяют значения из конфига. Помощник
+    // собирает ту же командную строку сам из полей запроса spawn.
+    // Вывод идет в --log, а не в pipe: после падения приложения openvpn
+    // не получит SIGPIPE и продолжит работать до повторного подключения.
+    // Строки лога без меток времени — в том же виде, что и через >LOG
+    QString logPath = QDir(sessionDir).filePath("openvpn.log");
+    QStringList cmd = {
+        "--config", configPath,
+        "--verb", "3",
+        "--suppress-timestamps",
+        "--connect-timeout", QString::number(connectTimeout),
+        "--management", socketPath, "unix",
+        "--management-query-passwords",
+        "--management-hold",
+        "--writepid", QDir(sessionDir).filePath("openvpn.pid"),
+        "--log", logPath
+    };
+
+    tunDevice = requestedDevice;
+    if (!requestedDevice.isEmpty()) {
+        cmd << "--dev" << requestedDevice << "--dev-type" << "tun";
+    }
+    if (routeNoExec) {
+        cmd << "--route-noexec";
+    }
+
+    if (getuid() != 0) {
+        // openvpn работает от root: разрешаем подключение к сокету только нашему пользователю
+        struct passwd* pw = getpwuid(getuid());
+        if (pw) {
+            cmd << "--management-client-user" << QString::fromLocal8Bit(pw->pw_name);
+        }
+    }
+
+    emit connectionLog(viaHelper ? "🔧 Запускаю OpenVPN через помощник..." : "🔧 Запускаю OpenVPN...");
+
+    process = new OpenVpnProcess(this);
+    if (configViaStdin) {
+        process->setStandardInputFile(config.stdinSource());
+    }
+    if (!viaHelper) {
+        // openvpn от root создал бы лог с правами 0600 на root. Файл нашего
+        // пользователя он только обрежет и допишет — и мы сможем его читать
+        QFile logFile(logPath);
+        if (logFile.open(QIODevice::WriteOnly)) {
+            logFile.setPermissions(QFile::ReadOwner | QFile::WriteOwner);
+        }
+        process->setLogFile(logPath);
+        process->setPidFile(QDir(sessionDir).filePath("openvpn.pid"));
+    }
+
+    // До подключения к management-интерфейсу показываем вывод процесса и его
+    // лог-файла (ошибки разбора опций и ранние ошибки приходят только туда),
+    // потом лог идет через >LOG
+    connect(process, &OpenVpnProcess::lineRead, this, [this](const QByteArray& line) {
+        if (!management->isConnected()) {
+            handleLogLine(line);
+        }
+    });
+
+    connect(process, &OpenVpnProcess::finished, this, &VpnSession::onProcessFinished);
+
+    // Spawning -> Handshaking: процесс запущен, подключаемся к management-сокету
+    connect(process, &OpenVpnProcess::started, this, [this, clickMs, precomputed, socketPath]() {
+        if (m_state != VpnState::Spawning) {
+            return;
+        }
+        qint64 now = QDateTime::currentMSecsSinceEpoch();
+        emit connectionLog(QString("⏱️ OpenVPN запущен через %1 мс%2")
+        .arg(now - clickMs)
+        .arg(precomputed ? " (готовый конфиг)" : ""));
+
+        trace.mark(ConnectPhase::Spawn, now);
+
+        JournalEntry entry;
+        entry.id = journalKey;
+        entry.sessionDir = sessionDir;
+        entry.socketPath = socketPath;
+        entry.pid = process->processId();
+        entry.server = currentServer;
+        entry.device = requestedDevice;
+        entry.routeNoExec = routeNoExec;
+        entry.hostRoute = hostRoute;
+        entry.startedAt = QDateTime::currentDateTime();
+        SessionJournal::instance().record(entry);
+
+        setState(VpnState::Handshaking);
+        management->connectToSocket(socketPath, 10000);
+    });
+
+    // Обработка ошибок запуска: после failedToStart сигнала finished не будет
+    connect(process, &OpenVpnProcess::failedToStart, this, [this](const QString& error) {
+        VpnState finishedIn = m_state;
+        if (finishedIn != VpnState::Draining) {
+            emit connectionStatus("error", "Не удалось запустить OpenVPN");
+            emit connectionLog(QString("❌ Ошибка запуска: %1").arg(error));
+        }
+        cleanup();
+        setState(VpnState::Idle);
+        emit finished(finishedIn, false, -1);
+    });
+
+    reattached = false;
+    rxBytes = 0;
+    txBytes = 0;
+    resetThroughput();
+    localIp.clear();
+    dnsServers.clear();
+    pushedRedirect = false;
+    reportedProblems.clear();
+    authFailures = 0;
+    drainFromConnected = false;
+    management->setCredentials(currentServer.username, currentServer.password);
+
+    setState(VpnState::Spawning);
+    if (viaHelper) {
+        QJsonObject spawn;
+        spawn["config"] = QString::fromUtf8(configBytes);
+        spawn["sessionDir"] = sessionDir;
+        spawn["connectTimeout"] = connectTimeout;
+        spawn["device"] = requestedDevice;
+        spawn["routeNoExec"] = routeNoExec;
+        process->startViaHelper(spawn);
+    } else {
+        process->start(openvpnPath, cmd);
+    }
+    connectTimer->start(connectTimeout * 1000);
+    return true;
+}
+
+bool VpnSession::attach(const JournalEntry& entry) {
+    if (m_state != VpnState::Idle) {
+        return false;
+    }
+
+    // Процесс уже прошел все фазы: хронометража нет, имя tun и DNS — из журнала
+    reattached = true;
+    currentServer = entry.server;
+    journalKey = entry.id;
+    sessionDir = entry.sessionDir;
+    routeNoExec = entry.routeNoExec;
+    hostRoute = entry.hostRoute;
+    requestedDevice = entry.device;
+    tunDevice = entry.device;
+    dnsServers = entry.dns;
+    pushedRedirect = entry.redirectGateway;
+    rxBytes = 0;
+    txBytes = 0;
+    resetThroughput();
+    reportedProblems.clear();
+    authFailures = 0;
+    drainFromConnected = false;
+    management->setCredentials(currentServer.username, currentServer.password);
+
+    process = new OpenVpnProcess(this);
+    connect(process, &OpenVpnProcess::finished, this, &VpnSession::onProcessFinished);
+    process->attach(entry.pid);
+
+    emit connectionLog(QString("♻️ Найден работающий туннель к %1 (pid %2, %3), подключаюсь")
+    .arg(currentServer.name)
+    .arg(entry.pid)
+    .arg(entry.device.isEmpty() ? QString("tun") : entry.device));
+
+    setState(VpnState::Handshaking);
+    management->connectToSocket(entry.socketPath, 3000);
+    connectTimer->start(connectTimeout * 1000);
+    return true;
+}
+
+void VpnSession::release() {
+    // Приложение закрывается, туннель остается: запись журнала и каталог
+    // сессии сохраняются для следующего запуска
+    released = true;
+    if (process) {
+        process->release();
+    }
+    cleanup();
+}
+
+void VpnSession::stop() {
+    if (m_state == VpnState::Draining) {
+        return;
+    }
+    if (m_state == VpnState::Idle) {
+        cleanup();
+        return;
+    }
+
+    drainFromConnected = m_state == VpnState::Connected;
+    connectTimer->stop();
+
+    if (process && process->isRunning()) {
+        setState(VpnState::Draining);
+        emit connectionLog("📤 Отправляю сигнал завершения...");
+
+        // Пробуем корректно завершить: через management, иначе сигналом процессу.
+        // Завершение обрабатывается в onProcessFinished, drainTimer добивает зависший процесс
+        if (management->isConnected()) {
+            management->sendSignal("SIGTERM");
+        } else {
+            process->terminate();
+        }
+        drainTimer->start();
+        return;
+    }
+
+    VpnState finishedIn = m_state;
+    cleanup();
+    setState(VpnState::Idle);
+    emit finished(finishedIn, drainFromConnected, 0);
+}
+
+void VpnSession::setState(VpnState state) {
+    if (m_state == state) {
+        return;
+    }
+    m_state = state;
+
+    // Сессия закончилась, не дойдя до CONNECTED, — попытка неудачная
+    if (state == VpnState::Idle) {
+        finishTrace(false);
+    }
+    emit stateChanged(state);
+}
+
+void VpnSession::finishTrace(bool success) {
+    if (!trace.active) {
+        return;
+    }
+    trace.finish(success, QDateTime::currentMSecsSinceEpoch());
+    if (success) {
+        emit connectionLog(QString("⏱️ Фазы подключения: %1").arg(trace.summary()));
+    } else {
+        emit connectionLog(QString("⏱️ Попытка остановилась на фазе %1 (%2)")
+        .arg(connectPhaseName(trace.stalledPhase()))
+        .arg(trace.summary().isEmpty() ? QString("нет данных") : trace.summary()));
+    }
+    emit traceFinished(trace);
+}
+
+QString VpnSession::stateName(VpnState state) {
+    switch (state) {
+    case VpnState::Idle:
+        return "Отключено";
+    case VpnState::Spawning:
+        return "Запуск OpenVPN";
+    case VpnState::Handshaking:
+        return "Подключение...";
+    case VpnState::Connected:
+        return "Подключено";
+    case VpnState::Draining:
+        return "Отключение...";
+    }
+    return QString();
+}
+
+QString VpnSession::freeTunDevice(const QStringList& reserved) {
+    for (int i = 0; i < 64; ++i) {
+        QString name = QString("tun%1").arg(i);
+        if (!reserved.contains(name) && !QFileInfo::exists(QString("/sys/class/net/%1").arg(name))) {
+            return name;
+        }
+    }
+    return QString();
+}
+
+void VpnSession::onManagementState(const ManagementState& state) {
+    emit managementState(state);
+    emit connectionLog(QString("📡 Состояние OpenVPN: %1%2")
+    .arg(state.name)
+    .arg(state.description.isEmpty() ? QString() : QString(" (%1)").arg(state.description)));
+
+    ConnectPhase phase;
+    if (trace.active && connectPhaseForState(state.name, &phase)) {
+        trace.mark(phase, state.receivedMs);
+    }
+
+    if (state.name == "CONNECTED") {
+        localIp = state.localIp;
+        if (!state.remoteIp.isEmpty() && state.remoteIp != currentServer.ip) {
+            // Процесс сам перешел к следующему блоку <connection>
+            for (const VpnServer& fallback : fallbackServers) {
+                if (fallback.ip == state.remoteIp) {
+                    emit connectionLog(QString("🔁 OpenVPN перешел с %1 на запасной сервер %2")
+                    .arg(currentServer.name, fallback.name));
+                    currentServer = fallback;
+                    break;
+                }
+            }
+        }
+        if (state.description == "ERROR") {
+            emit connectionStatus("warning", "Проблема с маршрутизацией");
+            emit connectionLog("⚠️ OpenVPN сообщил об ошибках при настройке маршрутов");
+        }
+        if (m_state == VpnState::Spawning || m_state == VpnState::Handshaking) {
+            connectTimer->stop();
+            setState(VpnState::Connected);
+            // У подхваченного туннеля время подключения — из ответа openvpn
+            connectedTime = reattached && state.timestamp > 0
+            ? QDateTime::fromSecsSinceEpoch(state.timestamp)
+            : QDateTime::fromMSecsSinceEpoch(state.receivedMs);
+            SessionJournal::instance().setTunnel(journalKey, tunDevice, dnsServers, pushedRedirect);
+            if (!reattached) {
+                // Под sudo processId — это sudo; настоящий pid openvpn записал сам
+                QFile pidFile(QDir(sessionDir).filePath("openvpn.pid"));
+                if (pidFile.open(QIODevice::ReadOnly)) {
+                    qint64 pid = pidFile.readAll().trimmed().toLongLong();
+                    if (pid > 0) {
+                        SessionJournal::instance().setPid(journalKey, pid);
+                    }
+                }
+            }
+            finishTrace(true);
+            emit established();
+        }
+    } else if (state.name == "RECONNECTING") {
+        if (m_state == VpnState::Connected) {
+            // openvpn переподключается сам, процесс продолжает работать
+            setState(VpnState::Handshaking);
+            emit lost();
+            emit connectionStatus("warning", QString("Переподключение (%1)").arg(state.description));
+        } else if (m_state == VpnState::Handshaking && state.description == "tls-error") {
+            emit connectionStatus("error", "Ошибка TLS");
+            emit connectionLog("❌ Ошибка TLS handshake");
+            QTimer::singleShot(0, this, &VpnSession::stop);
+        }
+    }
+}
+
+// Состояние соединения приходит через >STATE, по логу только уточняем причины
+// проблем, которых нет в событиях management-интерфейса
+void VpnSession::handleLogLine(const QByteArray& line) {
+    QString text = QString::fromUtf8(line);
+
+    // Имя tun и присланные опции нужны для переключения маршрутов без openvpn
+    if (line.startsWith("TUN/TAP device ")) {
+        static const QRegularExpression deviceRe("^TUN/TAP device (\\S+) opened");
+        QRegularExpressionMatch match = deviceRe.match(text);
+        if (match.hasMatch()) {
+            tunDevice = match.captured(1);
+        }
+    } else if (line.startsWith("PUSH: Received control message")) {
+        static const QRegularExpression dnsRe("dhcp-option DNS ([0-9.]+)");
+        QRegularExpressionMatchIterator it = dnsRe.globalMatch(text);
+        while (it.hasNext()) {
+            QString dns = it.next().captured(1);
+            if (!dnsServers.contains(dns)) {
+                dnsServers.append(dns);
+            }
+        }
+        pushedRedirect = pushedRedirect || text.contains("redirect-gateway");
+    }
+
+    switch (LogClassifier::instance().classify(line)) {
+    case LogEvent::ConfigError:
+    case LogEvent::UpScriptFailed:
+        emit connectionStatus("error", "Ошибка конфигурации OpenVPN");
+        emit connectionLog(QString("❌ %1").arg(text));
+        break;
+    case LogEvent::TlsError:
+    case LogEvent::NetworkError:
+    case LogEvent::FatalExit:
+        emit connectionLog(QString("⚠️ %1").arg(text));
+        break;
+    case LogEvent::CompressionError:
+        if (!reportedProblems.contains(ConfigProblem::Compression)) {
+            emit connectionStatus("warning", "Конфликт настроек сжатия");
+        }
+        reportProblem(ConfigProblem::Compression, QString());
+        emit connectionLog(QString("⚠️ %1").arg(text));
+        break;
+    case LogEvent::CipherError:
+        reportProblem(ConfigProblem::Cipher, QString());
+        emit connectionLog(QString("⚠️ %1").arg(text));
+        break;
+    case LogEvent::FragmentError:
+        reportProblem(ConfigProblem::Fragment, QString());
+        emit connectionLog(QString("⚠️ %1").arg(text));
+        break;
+    case LogEvent::PathMtuError: {
+        // write UDPv4 [EMSGSIZE Path-MTU=1420]: Message too long
+        static const QRegularExpression mtuRe("Path-MTU=(\\d+)");
+        QRegularExpressionMatch match = mtuRe.match(text);
+        if (match.hasMatch()) {
+            reportProblem(ConfigProblem::PathMtu, match.captured(1));
+        }
+        emit connectionLog(QString("⚠️ %1").arg(text));
+        break;
+    }
+    case LogEvent::RouteError:
+        emit connectionStatus("warning", "Проблема с маршрутизацией");
+        emit connectionLog(QString("⚠️ %1").arg(text));
+        break;
+    case LogEvent::SoftRestart:
+        emit connectionLog(QString("🔄 %1").arg(text));
+        break;
+    case LogEvent::Warning:
+        emit connectionLog(QString("ℹ️ %1").arg(text));
+        break;
+    default:
+        emit connectionLog(QString("🔍 %1").arg(text));
+        break;
+    }
+}
+
+void VpnSession::resetThroughput() {
+    windowStartMs = 0;
+    windowRxBytes = 0;
+    windowTxBytes = 0;
+    peakRateMbps = 0.0;
+}
+
+void VpnSession::updateThroughput(qint64 in, qint64 out) {
+    // bytecount приходит раз в секунду; секундные замеры слишком шумные,
+    // поэтому скорость считается по окну в несколько секунд
+    qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+    if (windowStartMs == 0 || in < windowRxBytes || out < windowTxBytes) {
+        windowStartMs = nowMs;
+        windowRxBytes = in;
+        windowTxBytes = out;
+        return;
+    }
+    qint64 elapsedMs = nowMs - windowStartMs;
+    if (elapsedMs < ThroughputWindowMs) {
+        return;
+    }
+
+    qint64 bytes = qMax(in - windowRxBytes, out - windowTxBytes);
+    double mbps = bytes * 8.0 / (elapsedMs * 1000.0);
+    peakRateMbps = qMax(peakRateMbps, mbps);
+
+    windowStartMs = nowMs;
+    windowRxBytes = in;
+    windowTxBytes = out;
+}
+
+void VpnSession::reportProblem(ConfigProblem problem, const QString& detail) {
+    // Ошибка повторяется на каждом пакете — сообщаем о ней один раз за сессию
+    if (reportedProblems.contains(problem)) {
+        return;
+    }
+    reportedProblems.append(problem);
+    emit configProblem(problem, detail);
+}
+
+void VpnSession::onProcessFinished(int exitCode) {
+    VpnState finishedIn = m_state;
+    bool wasConnected = finishedIn == VpnState::Connected ||
+    (finishedIn == VpnState::Draining && drainFromConnected);
+    cleanup();
+    setState(VpnState::Idle);
+    emit finished(finishedIn, wasConnected, exitCode);
+}
+
+void VpnSession::cleanup() {
+    management->close();
+    connectTimer->stop();
+    drainTimer->stop();
+
+    if (process) {
+        QObject::disconnect(process, nullptr, this, nullptr);
+
+        // Не ждем процесс: если он еще жив, объект удалится после его завершения
+        OpenVpnProcess* currentProcess = process.data();
+        currentProcess->setParent(nullptr);
+        if (currentProcess->isRunning() && !released) {
+            connect(currentProcess, &OpenVpnProcess::finished, currentProcess, &QObject::deleteLater);
+            currentProcess->kill();
+        } else {
+            currentProcess->deleteLater();
+        }
+        process.clear();
+    }
+
+    // У openvpn свой дескриптор memfd или файл в каталоге сессии, наш не нужен
+    config.close();
+
+    // Процесса больше нет — запись журнала и каталог с сокетом не нужны
+    if (!released && !journalKey.isEmpty()) {
+        SessionJournal::instance().remove(journalKey);
+        SessionJournal::removeSessionDir(sessionDir);
+    }
+    journalKey.clear();
+    sessionDir.clear();
+}
@@ -0,0 +1,139 @@
+#ifndef VPNSESSION_H
+#define VPNSESSION_H
+
+#include <QObject>
+#include <QPointer>
+#include <QDateTime>
+#include <QStringList>
+#include "vpntypes.h"
+#include "managementclient.h"
+#include "memoryconfig.h"
+#include "connecttiming.h"
+#include "openvpnprocess.h"
+#include "serverprofiles.h"
+
+class QTimer;
+struct JournalEntry;
+
+// Жизненный цикл сессии. Все переходы идут по сигналам процесса,
+// management-интерфейса и таймерам — GUI-поток не ждет openvpn
+enum class VpnState {
+    Idle,          // Нет процесса
+    Spawning,      // Процесс запускается
+    Handshaking,   // Процесс работает, туннель еще не поднят (или переподключается)
+    Connected,     // Туннель поднят
+    Draining       // Отправлен SIGTERM, ждем завершения процесса
+};
+
+// Один процесс openvpn с management-интерфейсом.
+// VpnManager держит одну активную сессию и, при переключении, вторую —
+// на собственном tun, без установки маршрутов (route-noexec).
+class VpnSession : public QObject {
+    Q_OBJECT
+
+public:
+    static constexpr int ThroughputWindowMs = 3000;
+
+    explicit VpnSession(QObject *parent = nullptr);
+    ~VpnSession();
+
+    void setConnectTimeout(int seconds) { connectTimeout = seconds; }
+    void setDevice(const QString& name) { requestedDevice = name; }   // Пусто — как в конфиге (dev tun)
+    void setRouteNoExec(bool enabled) { routeNoExec = enabled; }      // Маршруты ставит VpnManager
+    // Серверы из блоков <connection> после основного: openvpn может перейти на любой
+    void setFallbacks(const QList<VpnServer>& servers) { fallbackServers = servers; }
+    // Маршрут до сервера через физический шлюз (для журнала сессий)
+    void setHostRoute(const QString& route) { hostRoute = route; }
+
+    // clickMs — момент нажатия, от него считается хронометраж
+    bool start(const VpnServer& server, const QByteArray& config, bool precomputed, qint64 clickMs);
+    void stop();
+    // Подхватить openvpn, оставшийся от прошлого запуска приложения
+    bool attach(const JournalEntry& entry);
+    // Оставить туннель работать после выхода: процесс не завершается
+    void release();
+    // Попытка отменена нами (проигравший в гонке) — в статистику не попадает
+    void discardTrace() { trace.active = false; }
+
+    VpnState state() const { return m_state; }
+    const VpnServer& server() const { return currentServer; }
+    bool routesManaged() const { return routeNoExec; }
+    QString journalId() const { return journalKey; }
+    QString requestedDeviceName() const { return requestedDevice; }
+    QString device() const { return tunDevice; }
+    QString tunnelIp() const { return localIp; }
+    QStringList pushedDns() const { return dnsServers; }
+    bool redirectsGateway() const { return pushedRedirect; }
+    qint64 bytesIn() const { return rxBytes; }
+    qint64 bytesOut() const { return txBytes; }
+    QDateTime connectedAt() const { return connectedTime; }
+    // Наибольшая скорость за окно ThroughputWindowMs, больший из двух направлений
+    double peakMbps() const { return peakRateMbps; }
+
+    static QString stateName(VpnState state);
+    // Первое свободное имя tunN. reserved — имена, которые уже отданы
+    // сессиям, но устройство еще не создано
+    static QString freeTunDevice(const QStringList& reserved = QStringList());
+
+signals:
+    void stateChanged(VpnState state);
+    void managementState(const ManagementState& state);
+    void connectionStatus(const QString& type, const QString& message);
+    void connectionLog(const QString& message);
+    void established();
+    void lost();
+    // Процесс завершился, сессия снова Idle. wasConnected — туннель работал до конца
+    // или до вызова stop()
+    void finished(VpnState finishedIn, bool wasConnected, int exitCode);
+    void trafficUpdated(qint64 bytesIn, qint64 bytesOut);
+    void traceFinished(const ConnectTrace& trace);
+    // Несовместимость конфига с сервером, по одному разу на вид за сессию
+    void configProblem(ConfigProblem problem, const QString& detail);
+
+private slots:
+    void onProcessFinished(int exitCode);
+    void onManagementState(const ManagementState& state);
+
+private:
+    QPointer<OpenVpnProcess> process;
+    VpnState m_state;
+    VpnServer currentServer;
+    MemoryConfig config;            // Конфиг сессии, на диск не пишется
+    int connectTimeout;
+    QString requestedDevice;
+    QList<VpnServer> fallbackServers;
+    bool routeNoExec;
+    QTimer* connectTimer;           // Общий таймаут Spawning + Handshaking
+    QTimer* drainTimer;             // Сколько ждем процесс после SIGTERM перед kill
+    ManagementClient* management;   // Управление openvpn через --management
+    QString sessionDir;             // Приватный каталог (0700): сокет, pid, лог
+    QString journalKey;             // Запись в журнале сессий
+    QString hostRoute;
+    QString tunDevice;
+    QString localIp;
+    QStringList dnsServers;         // dhcp-option DNS из PUSH_REPLY
+    bool pushedRedirect;            // Сервер прислал redirect-gateway
+    qint64 rxBytes;
+    qint64 txBytes;
+    qint64 windowStartMs;           // Окно замера скорости по bytecount (0 — не начато)
+    qint64 windowRxBytes;
+    qint64 windowTxBytes;
+    double peakRateMbps;
+    QDateTime connectedTime;
+    QList<ConfigProblem> reportedProblems;   // Уже сообщенные в этой сессии
+    int authFailures;               // AUTH_FAILED за попытку (несколько remote — по серверу)
+    ConnectTrace trace;             // Хронометраж попытки подключения
+    bool drainFromConnected;        // stop() вызван в состоянии Connected
+    bool reattached;                // Процесс остался от прошлого запуска приложения
+    bool released;                  // Туннель оставлен работать после выхода
+
+    void setState(VpnState state);
+    void finishTrace(bool success);
+    void cleanup();
+    void handleLogLine(const QByteArray& line);
+    void reportProblem(ConfigProblem problem, const QString& detail);
+    void updateThroughput(qint64 in, qint64 out);
+    void resetThroughput();
+};
+
+#endif // VPNSESSION_H
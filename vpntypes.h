@@ -4,6 +4,7 @@
 #include <QString>
 #include <QList>
 #include <QMetaType>
+#include "latencystats.h"
 
 struct VpnServer {
     QString name;
@@ -16,24 +17,57 @@ struct VpnServer {
     int score;
     int ping;
     double speedMbps;
+    double estimatedMbps;  // Грубая оценка по серии ICMP-пакетов размером с MTU (0 — не оценивалась)
     QString sessions;
     QString uptime;
     bool tested;
     bool available;
     int testPing;
     bool realConnectionTested;
+    int handshakeMs;       // Время поднятия туннеля при реальной проверке
+    double measuredMbps;   // Скорость, измеренная через туннель (0 — не измерялась)
+    int ttfbMs;            // Время до первого байта при замере скорости
+    LatencySketch latency; // Многократные замеры RTT и потерь
     QString username;
     QString password;
 
     VpnServer()
-    : port(1194), score(0), ping(999), speedMbps(0.0),
+    : port(1194), score(0), ping(999), speedMbps(0.0), estimatedMbps(0.0),
     tested(false), available(false), testPing(999),
-    realConnectionTested(false) {
+    realConnectionTested(false), handshakeMs(-1), measuredMbps(0.0), ttfbMs(-1) {
         // Устанавливаем стандартные учетные данные для VPNGate
         username = "vpn";
         password = "vpn";
     }
 
+    // Устойчивый ключ сервера для кэшей и профилей между обновлениями списка
+    QString identity() const {
+        return name + "@" + ip;
+    }
+
+    // Скорость для сортировки и выбора: измеренная, если есть, иначе из API
+    double effectiveSpeedMbps() const {
+        return measuredMbps > 0.0 ? measuredMbps : speedMbps;
+    }
+
+    // Задержка для ранжирования: медиана с поправкой на джиттер и потери.
+    // Сервер с хорошей медианой, но частыми потерями, должен уходить вниз
+    double latencyRankMs() const {
+        LatencyStats stats = latency.stats();
+        if (!stats.isValid()) {
+            return ping;
+        }
+        if (stats.p50Ms < 0.0) {
+            return 9999.0;
+        }
+        return stats.p50Ms + stats.jitterMs + stats.lossRate * 1000.0;
+    }
+
+    // Доля потерь по последним пробам (0, если замеров не было)
+    double lossRate() const {
+        return latency.stats().lossRate;
+    }
+
     // Добавляем операторы сравнения
     bool operator==(const VpnServer& other) const {
         return name == other.name &&
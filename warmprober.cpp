@@ -0,0 +1,173 @@
+#include "warmprober.h"
+#include <QProcess>
+#include <QDateTime>
+#include <QSet>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+
+namespace {
+// Результат фонового прохода
+struct WarmProbeBatch {
+    QList<UdpProbeResult> results;
+    QString interfaceName;
+    QString error;
+    bool bindFailed;
+
+    WarmProbeBatch() : bindFailed(false) {}
+};
+}
+
+WarmProber::WarmProber(QObject *parent)
+: QObject(parent)
+, timer(new QTimer(this))
+, warmCount(3)
+, intervalMs(15000)
+, busy(false)
+, bindWarningShown(false) {
+    timer->setInterval(intervalMs);
+    connect(timer, &QTimer::timeout, this, &WarmProber::probeNow);
+}
+
+void WarmProber::setIntervalSec(int seconds) {
+    intervalMs = qBound(5, seconds, 600) * 1000;
+    timer->setInterval(intervalMs);
+}
+
+void WarmProber::setCandidates(const QList<VpnServer>& candidates) {
+    targets.clear();
+    for (const VpnServer& server : candidates) {
+        if (server.protocol.toLower() != "udp") {
+            continue;
+        }
+        QHostAddress address(server.ip);
+        if (address.protocol() != QAbstractSocket::IPv4Protocol) {
+            continue;
+        }
+
+        UdpProbeTarget target;
+        target.identity = server.identity();
+        target.address = address;
+        target.port = static_cast<quint16>(server.port);
+        targets.append(target);
+
+        if (targets.size() >= warmCount) {
+            break;
+        }
+    }
+
+    // Серверы, выпавшие из набора (в т.ч. текущий), больше не считаются проверенными
+    QSet<QString> identities;
+    for (const UdpProbeTarget& target : targets) {
+        identities.insert(target.identity);
+    }
+    for (auto it = lastReplyMs.begin(); it != lastReplyMs.end();) {
+        if (identities.contains(it.key())) {
+            ++it;
+        } else {
+            it = lastReplyMs.erase(it);
+        }
+    }
+}
+
+void WarmProber::start() {
+    if (!timer->isActive()) {
+        timer->start();
+        QTimer::singleShot(0, this, &WarmProber::probeNow);
+    }
+}
+
+void WarmProber::stop() {
+    timer->stop();
+}
+
+bool WarmProber::isWarm(const QString& identity, qint64 maxAgeMs) const {
+    qint64 lastMs = lastReplyMs.value(identity, 0);
+    return lastMs > 0 && QDateTime::currentMSecsSinceEpoch() - lastMs <= maxAgeMs;
+}
+
+QString WarmProber::detectPhysicalInterface() {
+    QProcess process;
+    process.start("ip", QStringList() << "-o" << "-4" << "route" << "show" << "default");
+    if (!process.waitForFinished(2000)) {
+        process.kill();
+        return QString();
+    }
+
+    // default via 192.168.1.1 dev eth0 ... — туннельные маршруты пропускаем
+    const QStringList lines = QString::fromUtf8(process.readAllStandardOutput()).split('\n', Qt::SkipEmptyParts);
+    for (const QString& line : lines) {
+        QStringList parts = line.split(' ', Qt::SkipEmptyParts);
+        int devIndex = parts.indexOf("dev");
+        if (devIndex < 0 || devIndex + 1 >= parts.size()) {
+            continue;
+        }
+        QString device = parts[devIndex + 1];
+        if (!device.startsWith("tun") && !device.startsWith("tap")) {
+            return device;
+        }
+    }
+    return QString();
+}
+
+void WarmProber::probeNow() {
+    if (busy || targets.isEmpty()) {
+        return;
+    }
+    busy = true;
+
+    QList<UdpProbeTarget> batchTargets = targets;
+    QFutureWatcher<WarmProbeBatch>* watcher = new QFutureWatcher<WarmProbeBatch>(this);
+
+    connect(watcher, &QFutureWatcher<WarmProbeBatch>::finished, this, [this, watcher]() {
+        WarmProbeBatch batch = watcher->result();
+        watcher->deleteLater();
+        busy = false;
+
+        if (!batch.error.isEmpty()) {
+            emit probeWarning(QString("Фоновая проверка не удалась: %1").arg(batch.error));
+            return;
+        }
+
+        // Без привязки проба ушла бы через туннель и "проверила" бы его, а не
+        // сервер: проход пропускаем, прежние результаты остаются до устаревания
+        if (batch.bindFailed) {
+            if (!bindWarningShown) {
+                bindWarningShown = true;
+                emit probeWarning(batch.interfaceName.isEmpty() ?
+                QString("Не найден физический интерфейс, фоновые проверки приостановлены") :
+                QString("Нет прав на привязку к %1, фоновые проверки приостановлены")
+                .arg(batch.interfaceName));
+            }
+            return;
+        }
+        bindWarningShown = false;
+
+        qint64 now = QDateTime::currentMSecsSinceEpoch();
+        for (const UdpProbeResult& result : batch.results) {
+            if (result.replied()) {
+                lastReplyMs.insert(result.identity, now);
+            }
+            emit candidateProbed(result.identity, result.replied(), result.rttMs, result.lost);
+        }
+    });
+
+    // Небольшое число попыток: проверка постоянная и не должна нагружать канал
+    watcher->setFuture(QtConcurrent::run([batchTargets]() {
+        WarmProbeBatch batch;
+        batch.interfaceName = detectPhysicalInterface();
+
+        UdpProber prober;
+        if (batch.interfaceName.isEmpty()) {
+            batch.bindFailed = true;
+            return batch;
+        }
+        prober.setBindInterface(batch.interfaceName);
+        if (!prober.open()) {
+            batch.bindFailed = true;
+            return batch;
+        }
+
+        batch.results = prober.probe(batchTargets, 2, 1500, 200);
+        return batch;
+    }));
+}
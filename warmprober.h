@@ -0,0 +1,57 @@
+#ifndef WARMPROBER_H
+#define WARMPROBER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QHash>
+#include <QList>
+#include "vpntypes.h"
+#include "udpprober.h"
+
+// Фоновая проверка запасных серверов, пока туннель поднят.
+// Раз в interval секунд отправляет OpenVPN reset первым count кандидатам
+// через физический интерфейс (в обход туннеля), чтобы при обрыве
+// переключаться на сервер, проверенный несколько секунд назад.
+class WarmProber : public QObject {
+    Q_OBJECT
+
+public:
+    explicit WarmProber(QObject *parent = nullptr);
+
+    void setCount(int count) { warmCount = qBound(1, count, 16); }
+    void setIntervalSec(int seconds);
+    int count() const { return warmCount; }
+    int intervalSec() const { return intervalMs / 1000; }
+
+    // Кандидаты в порядке предпочтения, берутся первые count UDP серверов
+    void setCandidates(const QList<VpnServer>& candidates);
+
+    void start();
+    void stop();
+    bool isActive() const { return timer->isActive(); }
+
+    // Сервер ответил не раньше maxAgeMs назад
+    bool isWarm(const QString& identity, qint64 maxAgeMs) const;
+    // Максимальный возраст проверки, при котором сервер считается "теплым"
+    qint64 freshnessMs() const { return static_cast<qint64>(intervalMs) * 3; }
+
+signals:
+    void candidateProbed(const QString& identity, bool replied, const QList<double>& rttMs, int lost);
+    void probeWarning(const QString& message);
+
+private slots:
+    void probeNow();
+
+private:
+    QTimer* timer;
+    int warmCount;
+    int intervalMs;
+    bool busy;
+    bool bindWarningShown;
+    QList<UdpProbeTarget> targets;
+    QHash<QString, qint64> lastReplyMs;
+
+    static QString detectPhysicalInterface();
+};
+
+#endif // WARMPROBER_H